@@ -0,0 +1,8 @@
+#ifndef _LORAGW_CONFIGURATION_H
+#define _LORAGW_CONFIGURATION_H
+	#define LIBLORAGW_VERSION	"1.1.0"
+	#define DEBUG_AUX	0
+	#define DEBUG_HAL	0
+	#define DEBUG_MCU	0
+	#define DEBUG_CLK	0
+#endif
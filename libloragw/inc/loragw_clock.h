@@ -0,0 +1,107 @@
+/*!
+ * \brief     LoRa 2.4GHz concentrator clock tracking functions
+ *
+ * License: Revised BSD 3-Clause License, see LICENSE.TXT file include in the project
+ */
+
+#ifndef _LORAGW_CLOCK_H
+#define _LORAGW_CLOCK_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <time.h>       /* timespec */
+#include <pthread.h>    /* pthread_mutex_t */
+
+#include "config.h"    /* library configuration options (dynamically generated) */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define CLK_NB_SAMPLES          (16)    /* number of samples used to estimate the counter drift */
+#define CLK_SAMPLE_SPACING_MS   (1000)  /* minimum host time between two samples used for the drift fit */
+#define CLK_DRIFT_MAX_PPM       (100)   /* estimated drift is clamped to that range */
+#define CLK_RESYNC_US           (10000) /* a sample that far from the model restarts the tracking */
+#define CLK_SAMPLE_ERR_MAX_US   (5000)  /* samples with a longer half round trip are rejected once tracking */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+typedef struct {
+    int64_t host_us;    /* host time, in microseconds */
+    int64_t cnt_us;     /* concentrator counter, unwrapped to 64 bits */
+    int64_t err_us;     /* half of the request/answer round trip */
+} s_clk_sample;
+
+/**
+@struct s_clk
+@brief Clock model of one concentrator, protected by its own mutex
+
+Current model: cnt = anchor_cnt + (host - anchor_host) * (1 + drift)
+*/
+typedef struct {
+    pthread_mutex_t mx;
+    s_clk_sample samples[CLK_NB_SAMPLES];
+    int nb_samples;
+    int last_sample;
+    int64_t anchor_host_us;
+    int64_t anchor_cnt_us;
+    double drift;
+    double drift_err;
+    int64_t fit_err_us;
+} s_clk;
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Initialize a clock model, without any sample
+@param clk clock model
+*/
+void clk_init(s_clk * clk);
+
+/**
+@brief Forget all the samples collected so far
+@param clk clock model
+*/
+void clk_reset(s_clk * clk);
+
+/**
+@brief Add a sample of the concentrator counter to the clock model
+@param clk clock model
+@param cnt_us concentrator counter value, as returned by the MCU
+@param before host CLOCK_MONOTONIC time when the request was sent
+@param after host CLOCK_MONOTONIC time when the answer was received
+@return -1 if the sample was rejected, 0 else
+
+The counter is assumed to have been latched in the middle of the request/answer
+round trip, half of which is kept as the sample uncertainty. Samples with an
+uncertainty above CLK_SAMPLE_ERR_MAX_US are rejected, unless there is no other.
+*/
+int clk_add_sample(s_clk * clk, uint32_t cnt_us, const struct timespec * before, const struct timespec * after);
+
+/**
+@brief Estimate the concentrator counter value at a given host time
+@param clk clock model
+@param host host CLOCK_MONOTONIC time to get the counter for, NULL for now
+@param cnt_us pointer to receive the estimated counter value
+@param err_us pointer to receive the estimation error bound, can be NULL
+@return -1 if no sample has been collected yet, 0 else
+
+This function does not access the concentrator, and can be called from any
+thread.
+*/
+int clk_get_cnt(s_clk * clk, const struct timespec * host, uint32_t * cnt_us, uint32_t * err_us);
+
+/**
+@brief Return the estimated drift of the concentrator counter against the host clock
+@param clk clock model
+@param drift_ppm pointer to receive the drift, in part per million
+@return -1 if not enough samples have been collected yet, 0 else
+*/
+int clk_get_drift(s_clk * clk, double * drift_ppm);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
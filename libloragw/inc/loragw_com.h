@@ -0,0 +1,178 @@
+/*!
+ * \brief     LoRa 2.4GHz concentrator MCU command transport functions
+ *
+ * License: Revised BSD 3-Clause License, see LICENSE.TXT file include in the project
+ */
+
+#ifndef _LORAGW_COM_H
+#define _LORAGW_COM_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stddef.h>     /* size_t */
+#include <pthread.h>    /* pthread_mutex_t */
+
+#include "config.h"    /* library configuration options (dynamically generated) */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define COM_HEADER_SIZE         (4)
+#define COM_FRAME_SIZE_MAX      (COM_HEADER_SIZE + 300) /* biggest frame: PREPARE_TX request or RX event */
+#define COM_READ_SIZE           (4096)  /* bytes read from the com port at once, at most */
+#define COM_TIMEOUT_MS_DEFAULT  (1000)  /* maximum time to wait for a frame from the MCU */
+#define COM_REQ_NB_MAX          (8)     /* maximum number of requests written at once */
+#define COM_ACK_QUEUE_SIZE      (8)     /* ACKs received while waiting for another one */
+#define COM_EVT_QUEUE_SIZE      (16)    /* events received while waiting for an ACK */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct s_com_req
+@brief Request to be sent to the MCU, the id is set by the transport when written
+*/
+typedef struct {
+    uint8_t cmd;                /*!> request order id (see e_order_cmd) */
+    uint16_t size;              /*!> size of the payload */
+    const uint8_t * payload;    /*!> payload, can be NULL if size is 0 */
+    uint8_t id;                 /*!> frame id to be matched with the ACK */
+} s_com_req;
+
+/**
+@struct s_com
+@brief State of the transport to one MCU, frames are parsed from what was read
+from the com port and queued until asked for
+
+Writing and reading are locked separately, so that a request can be written
+while another thread is waiting for its ACK: the ACKs read by one thread for the
+others are queued. mx_id is only held while the ids are updated, it may be
+taken with one of the other two, never hold mx and mx_write together.
+*/
+typedef struct {
+    int fd;                                 /*!> file descriptor of the com port, -1 if not opened */
+    pthread_mutex_t mx_write;               /*!> protects the writes, next_id and headers */
+    pthread_mutex_t mx_id;                  /*!> protects id_pending, req_cmd and req_time_us */
+    pthread_mutex_t mx;                     /*!> protects the reads, the queues and rx_buf */
+    uint8_t next_id;                        /*!> id of the next request to be written */
+    bool id_pending[256];                   /*!> requests written, ACK not read yet */
+    uint8_t req_cmd[256];                   /*!> order id of the request written with each id */
+    uint64_t req_time_us[256];              /*!> monotonic time each request id was written, in us */
+    struct {
+        uint8_t frames[COM_EVT_QUEUE_SIZE][COM_FRAME_SIZE_MAX];
+        int nb;
+    } evt_queue;                            /*!> events received while waiting for an ACK */
+    struct {
+        uint8_t frames[COM_ACK_QUEUE_SIZE][COM_FRAME_SIZE_MAX];
+        int nb;
+    } ack_queue;                            /*!> ACKs received while waiting for another one */
+    int timeout_ms;                         /*!> maximum time to wait for a frame */
+    uint8_t headers[COM_REQ_NB_MAX][COM_HEADER_SIZE]; /*!> headers of the requests being written */
+    uint8_t rx_buf[COM_READ_SIZE];          /*!> everything read from the com port */
+    size_t rx_start;                        /*!> start of the first unparsed frame in rx_buf */
+    size_t rx_end;                          /*!> end of the data in rx_buf */
+} s_com;
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Initialize the transport state, with no com port attached
+@param com transport state
+*/
+void com_init(s_com * com);
+
+/**
+@brief Drop all the queued frames and outstanding requests
+@param com transport state
+*/
+void com_reset(s_com * com);
+
+/**
+@brief Set the maximum time to wait for a frame from the MCU
+@param com transport state
+@param timeout_ms timeout in milliseconds, 0 for COM_TIMEOUT_MS_DEFAULT, -1 to wait forever
+*/
+void com_set_timeout(s_com * com, int timeout_ms);
+
+/**
+@brief Send several requests to the MCU with a single write
+@param com transport state, attached to the com port
+@param reqs array of requests, their id field is set by this function
+@param nb_req number of requests in the array [1, COM_REQ_NB_MAX]
+@return -1 if the write failed, 0 else
+
+All requests are sent with a single writev() syscall without being copied, the
+MCU then handles them in order. Each ACK has to be read with com_read_ack(), in
+any order.
+*/
+int com_write_reqs(s_com * com, s_com_req * reqs, int nb_req);
+
+/**
+@brief Get the order id and write time of an outstanding request
+@param com transport state
+@param id id of the request, as set by com_write_reqs()
+@param cmd pointer to receive the order id of the request
+@param time_us pointer to receive the CLOCK_MONOTONIC time the request was written, in microseconds
+
+Both are set before the request is written, and are only valid until its ACK
+is read: the id can then be reused by another request.
+*/
+void com_get_req(s_com * com, uint8_t id, uint8_t * cmd, uint64_t * time_us);
+
+/**
+@brief Get the ACK of a given request
+@param com transport state, attached to the com port
+@param id id of the request, as set by com_write_reqs()
+@param buf buffer to receive the ACK frame (header included)
+@param buf_size size of the buffer
+@return -1 if the read failed, the ACK frame size else
+
+Events received while waiting are queued to be fetched by com_read_evt(), and
+the ACKs of other outstanding requests are kept until asked for. ACKs which are
+not matching any outstanding request are dropped. If the read fails, the
+request is no longer outstanding and its ACK will be dropped.
+*/
+int com_read_ack(s_com * com, uint8_t id, uint8_t * buf, size_t buf_size);
+
+/**
+@brief Same as com_read_ack(), with a timeout other than the one of the transport
+@param timeout_ms maximum time to wait for the ACK in milliseconds, -1 to wait forever
+*/
+int com_read_ack_timeout(s_com * com, uint8_t id, uint8_t * buf, size_t buf_size, int timeout_ms);
+
+/**
+@brief Get an event frame of a given type
+@param com transport state, attached to the com port
+@param type event order id (see e_order_cmd)
+@param wait true to block until such an event is received, false to only get the events already available
+@param buf buffer to receive the event frame (header included)
+@param buf_size size of the buffer
+@return -1 if the read failed, 0 if no event is available, the event frame size else
+*/
+int com_read_evt(s_com * com, uint8_t type, bool wait, uint8_t * buf, size_t buf_size);
+
+/**
+@brief Wait for a frame to be available from the MCU
+@param com transport state, attached to the com port
+@param timeout_ms maximum time to wait in milliseconds, 0 to return immediately, -1 to wait forever
+@return -1 if the com port is in error, 1 if data is available, 0 on timeout
+
+The com port is not read by this function, which can then be called while
+another thread is accessing the MCU. That thread may consume the data first, in
+which case there is nothing to fetch once this function returns.
+*/
+int com_wait(s_com * com, int timeout_ms);
+
+/**
+@brief Return the number of queued events
+@param com transport state
+*/
+int com_get_nb_evt(s_com * com);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -14,6 +14,7 @@
 #include <stdbool.h>    /* bool type */
 
 #include "config.h"     /* library configuration options (dynamically generated) */
+#include "loragw_hist.h"
 
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC MACROS -------------------------------------------------------- */
@@ -27,7 +28,9 @@
 
 /* radio parameters */
 #define LGW_RX_CHANNEL_NB_MAX 3    /* Maximum number of RX channels supported */
-#define LGW_TX_CHANNEL_NB_MAX 1    /* Maximum number of RX channels supported */
+#define LGW_TX_CHANNEL_NB_MAX 1    /* Maximum number of TX radios supported (the MCU TX request has no radio index) */
+#define LGW_RX_ARENA_SIZE   32768  /* Size of the buffer holding the payloads returned by lgw_receive_ref */
+#define LGW_MCU_NB_REQ      11     /* Number of MCU request types, see lgw_get_mcu_rtt */
 
 /* modulation parameters */
 #define HDR_LORA_PREAMBLE   12
@@ -113,12 +116,31 @@ typedef enum {
     TEMP_SRC_MCU    /* the temperature has been measured by the gateway MCU */
 } e_temperature_src;
 
+typedef enum {
+    TX_RESULT_OK,       /* the packet has been emitted */
+    TX_RESULT_FAILED,   /* the concentrator failed to emit the packet */
+    TX_RESULT_TIMEOUT,  /* the TX did not complete in time */
+    TX_RESULT_ABORTED   /* the TX has been aborted or replaced by another one */
+} e_tx_result;
+
+/**
+@brief Function called when a TX has been completed, see lgw_tx_set_callback()
+@param result outcome of the TX
+@param count_us concentrator counter at which the TX was expected to start
+@param arg user argument given to lgw_tx_set_callback()
+*/
+typedef void (*lgw_tx_cb)(e_tx_result result, uint32_t count_us, void * arg);
+
 /**
 @struct lgw_conf_board_s
 @brief Configuration structure for board specificities
 */
 struct lgw_conf_board_s {
     char tty_path[64];      /*!> Path to access the TTY device to connect to concentrator board */
+    bool rx_event_mode;     /*!> Rely on RX events pushed by the MCU instead of polling it with GET_RX_MSG requests */
+    uint32_t status_refresh_ms; /*!> Maximum age of the cached concentrator status, 0 to read it from the MCU on every access */
+    int32_t com_timeout_ms; /*!> Maximum time to wait for a frame from the MCU, 0 for default, -1 to wait forever */
+    bool fast_start;        /*!> Batch the start requests and poll the MCU instead of fixed waits, skip the resets on a warm restart */
 };
 
 /**
@@ -148,6 +170,7 @@ struct lgw_conf_channel_tx_s {
 */
 struct lgw_pkt_tx_s {
     uint32_t            freq_hz;        /*!> center frequency of TX */
+    uint8_t             rf_chain;       /*!> TX radio, [0, lgw_get_nb_tx_radio() - 1] */
     e_tx_mode           tx_mode;        /*!> select on what event/time the TX is triggered */
     uint32_t            count_us;       /*!> timestamp or delay in microseconds for TX trigger */
     int8_t              rf_power;       /*!> TX power, in dBm */
@@ -183,6 +206,31 @@ struct lgw_pkt_rx_s {
     uint8_t             payload[256];   /*!> buffer containing the payload */
 };
 
+/**
+@struct lgw_pkt_rx_ref_s
+@brief Same as lgw_pkt_rx_s, with the payload left in the HAL RX arena until released (see lgw_receive_ref)
+*/
+struct lgw_pkt_rx_ref_s {
+    uint32_t            freq_hz;        /*!> central frequency of the IF chain */
+    uint8_t             channel;        /*!> by which IF chain was packet received */
+    uint8_t             status;         /*!> status of the received packet */
+    uint32_t            count_us;       /*!> internal concentrator counter for timestamping, 1 microsecond resolution */
+    int32_t             foff_hz;        /*!> frequency error in Hz */
+    e_modulation        modulation;     /*!> modulation used by the packet */
+    e_bandwidth         bandwidth;      /*!> modulation bandwidth (LoRa only) */
+    e_spreading_factor  datarate;       /*!> RX datarate of the packet (SF for LoRa) */
+    e_coding_rate       coderate;       /*!> error-correcting code of the packet (LoRa only) */
+    float               rssi;           /*!> average packet RSSI in dB */
+    float               snr;            /*!> average packet SNR, in dB (LoRa only) */
+    uint16_t            size;           /*!> payload size in bytes */
+    const uint8_t *     payload;        /*!> payload in the RX arena, valid until released */
+};
+
+/**
+@brief Opaque state of one concentrator, see lgw_ctx_new()
+*/
+typedef struct lgw_ctx_s lgw_ctx_t;
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
 
@@ -225,9 +273,74 @@ int lgw_stop(void);
 @param max_pkt maximum number of packet that must be retrieved (equal to the size of the array of struct)
 @param pkt_data pointer to an array of struct that will receive the packet metadata and payload pointers
 @return LGW_HAL_ERROR id the operation failed, else the number of packets retrieved
+
+The concentrator buffer is fetched until it is drained or max_pkt packets have
+been retrieved. Packets lost because the buffer was full are counted, see
+lgw_get_rx_lost().
 */
 int lgw_receive(uint8_t max_pkt, struct lgw_pkt_rx_s * pkt_data);
 
+/**
+@brief Wait until the LoRa concentrator signals data on the link, or until timeout
+@param timeout_ms maximum time to wait in milliseconds, 0 to return immediately, -1 to wait forever
+@return LGW_HAL_ERROR id the operation failed, 1 if data is ready to be fetched, 0 on timeout
+
+This function does not exchange any command with the concentrator, it only
+waits for the link to become readable. It can return early because of the
+acknowledge of a command issued by another thread, the application then simply
+calls lgw_receive() which will find nothing new.
+*/
+int lgw_wait_rx(int timeout_ms);
+
+/**
+@brief A blocking version of lgw_receive, which waits for data to be signaled by the concentrator before fetching
+@param max_pkt maximum number of packet that must be retrieved (equal to the size of the array of struct)
+@param pkt_data pointer to an array of struct that will receive the packet metadata and payload pointers
+@param timeout_ms maximum time to wait in milliseconds before fetching, -1 to wait forever
+@return LGW_HAL_ERROR id the operation failed, else the number of packets retrieved
+*/
+int lgw_receive_wait(uint8_t max_pkt, struct lgw_pkt_rx_s * pkt_data, int timeout_ms);
+
+/**
+@brief Same as lgw_receive, without copying the payloads out of the HAL RX arena
+@param max_pkt maximum number of packet that must be retrieved (equal to the size of the array of struct)
+@param pkt_data pointer to an array of struct that will receive the packet metadata and payload pointers
+@return LGW_HAL_ERROR id the operation failed, else the number of packets retrieved
+
+The payloads are stored back to back in a LGW_RX_ARENA_SIZE bytes buffer owned
+by the HAL, and stay valid until released with lgw_release_rx(). Packets which
+do not fit in the arena are dropped and counted as lost, so the packets have to
+be released as soon as they have been handled. This function must not be mixed
+with lgw_receive(), which releases all the packets it fetched.
+*/
+int lgw_receive_ref(uint8_t max_pkt, struct lgw_pkt_rx_ref_s * pkt_data);
+
+/**
+@brief Release the payload of a packet returned by lgw_receive_ref, and of all the packets received before it
+@param pkt_data packet to be released, the latest one of an array to release them all
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+*/
+int lgw_release_rx(const struct lgw_pkt_rx_ref_s * pkt_data);
+
+/**
+@brief Return the number of packets dropped by the concentrator because its RX buffer was full
+@param nb_lost pointer to receive the number of packets lost since the concentrator was started
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+
+The counter is updated by lgw_receive(), this function does not access the
+concentrator.
+*/
+int lgw_get_rx_lost(uint32_t * nb_lost);
+
+/**
+@brief Return the number of TX radios which can be used to send packets
+@return the number of TX radios reported by the concentrator, up to LGW_TX_CHANNEL_NB_MAX, 0 if it is not started
+
+Each TX radio emits its own packets, independently of the others, the radio
+used by lgw_send() is selected by the rf_chain field of the packet.
+*/
+uint8_t lgw_get_nb_tx_radio(void);
+
 /**
 @brief Schedule a packet to be send immediately or after a delay depending on tx_mode
 @param pkt_data structure containing the data and metadata for the packet to send
@@ -259,9 +372,36 @@ int lgw_send(const struct lgw_pkt_tx_s * pkt_data);
 @param select is used to select what status we want to know
 @param code is used to return the status code
 @return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+
+The TX status is derived from the TX tracked by the HAL, see lgw_tx_poll(), and
+does not access the concentrator before the expected end of the TX.
 */
 int lgw_status(e_status_type select, e_status * code);
 
+/**
+@brief Check if the pending TX has been completed, and report it to the TX callback
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+
+The end of the TX is estimated from its start time and time on air, the
+concentrator is only accessed once that time has elapsed, to confirm the
+completion. EVT_TX_STATUS events pushed by the MCU, if any, complete the TX
+earlier. This function has to be called periodically while a TX is pending,
+lgw_status() also does it.
+*/
+int lgw_tx_poll(void);
+
+/**
+@brief Register a function to be called when a TX has been completed
+@param cb function to be called, NULL to disable the notification
+@param arg user argument given to the function
+@return LGW_HAL_SUCCESS
+
+The function is called from lgw_tx_poll(), lgw_status(), lgw_send() or
+lgw_abort_tx(), in the calling thread with the TX path locked, and must not call
+any other HAL function.
+*/
+int lgw_tx_set_callback(lgw_tx_cb cb, void * arg);
+
 /**
 @brief Abort a currently scheduled or ongoing TX
 @return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
@@ -272,6 +412,8 @@ int lgw_abort_tx(void);
 @brief Return value of internal counter when latest event (eg GPS pulse) was captured
 @param trig_cnt_us pointer to receive timestamp value
 @return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+
+The value is taken from the cached concentrator status (see status_refresh_ms).
 */
 int lgw_get_trigcnt(uint32_t * trig_cnt_us);
 
@@ -279,9 +421,43 @@ int lgw_get_trigcnt(uint32_t * trig_cnt_us);
 @brief Return instateneous value of internal counter
 @param inst_cnt_us pointer to receive timestamp value
 @return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+
+The value is extrapolated from the concentrator status samples (see
+status_refresh_ms), using a model of the counter drift against the host clock.
 */
 int lgw_get_instcnt(uint32_t * inst_cnt_us);
 
+/**
+@brief Estimate the instantaneous value of internal counter, without accessing the concentrator
+@param inst_cnt_us pointer to receive timestamp value
+@param err_us pointer to receive the estimation error bound in microseconds, can be NULL
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+
+This function only relies on the host-side clock model fed by the status reads
+of the other functions, it does not wait for any other HAL call.
+*/
+int lgw_get_instcnt_estimate(uint32_t * inst_cnt_us, uint32_t * err_us);
+
+/**
+@brief Read the concentrator status from the MCU, regardless of the cache age
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+*/
+int lgw_refresh_status(void);
+
+/**
+@brief Same as lgw_get_trigcnt(), with the status read from the MCU first
+@param trig_cnt_us pointer to receive timestamp value
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+*/
+int lgw_get_trigcnt_now(uint32_t * trig_cnt_us);
+
+/**
+@brief Same as lgw_get_instcnt(), with the status read from the MCU first
+@param inst_cnt_us pointer to receive timestamp value
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+*/
+int lgw_get_instcnt_now(uint32_t * inst_cnt_us);
+
 /**
 @brief Allow user to check the version/options of the library once compiled
 @return pointer on a human-readable null terminated string
@@ -303,17 +479,191 @@ int lgw_get_eui(uint64_t * eui);
 */
 int lgw_get_temperature(float * temperature, e_temperature_src * source);
 
+/**
+@brief Get and reset the round-trip times of a type of MCU request, from the request write to the ACK read
+@param req type of request [0..LGW_MCU_NB_REQ-1]
+@param rtt histogram receiving the round-trip times recorded since the last call, in microseconds
+@param name if not NULL, set with the name of the request
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+
+The round-trip times are recorded without lock, that function can be called by
+any thread while the concentrator is used.
+*/
+int lgw_get_mcu_rtt(uint8_t req, struct lgw_hist_s * rtt, const char ** name);
+
 /**
 @brief Return time on air of given packet, in milliseconds
 @param packet is a pointer to the packet structure
-@return the packet time on air in milliseconds
+@param result if not NULL, is set with the time on air computed with full floating point precision
+@return the packet time on air in milliseconds, rounded up
 */
 uint32_t lgw_time_on_air(const struct lgw_pkt_tx_s * pkt, double * result);
 
+/**
+@brief Return time on air of given packet, in microseconds, computed with integers only
+@param packet is a pointer to the packet structure
+@return the packet time on air in microseconds, rounded up, 0 if the modulation parameters are invalid
+*/
+uint32_t lgw_time_on_air_us(const struct lgw_pkt_tx_s * pkt);
+
 /**
  */
 uint16_t lgw_get_bw_khz(e_bandwidth bandwidth);
 
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES, MULTIPLE CONCENTRATORS -------------- */
+
+/*
+The functions above act on a default concentrator, created on first use. Several
+concentrators are handled from the same process with one context each, given to
+the lgw_ctx_ functions below which otherwise behave as their counterpart. Calls
+on different contexts are independent and can be made from different threads.
+Within a context, the RX, TX and status paths are locked separately and can be
+used from different threads, see the readme for the rules.
+*/
+
+/**
+@brief Create the context of a new concentrator, not configured
+@return pointer to the context, NULL if it cannot be allocated
+*/
+lgw_ctx_t * lgw_ctx_new(void);
+
+/**
+@brief Stop the concentrator if it is running, and free its context
+@param ctx context returned by lgw_ctx_new(), can be NULL
+*/
+void lgw_ctx_delete(lgw_ctx_t * ctx);
+
+/**
+@brief Same as lgw_board_setconf(), on the concentrator of the given context
+*/
+int lgw_ctx_board_setconf(lgw_ctx_t * ctx, const struct lgw_conf_board_s * conf);
+
+/**
+@brief Same as lgw_channel_rx_setconf(), on the concentrator of the given context
+*/
+int lgw_ctx_channel_rx_setconf(lgw_ctx_t * ctx, uint8_t channel, const struct lgw_conf_channel_rx_s * conf);
+
+/**
+@brief Same as lgw_channel_tx_setconf(), on the concentrator of the given context
+*/
+int lgw_ctx_channel_tx_setconf(lgw_ctx_t * ctx, const struct lgw_conf_channel_tx_s * conf);
+
+/**
+@brief Same as lgw_start(), on the concentrator of the given context
+*/
+int lgw_ctx_start(lgw_ctx_t * ctx);
+
+/**
+@brief Same as lgw_stop(), on the concentrator of the given context
+*/
+int lgw_ctx_stop(lgw_ctx_t * ctx);
+
+/**
+@brief Same as lgw_receive(), on the concentrator of the given context
+*/
+int lgw_ctx_receive(lgw_ctx_t * ctx, uint8_t max_pkt, struct lgw_pkt_rx_s * pkt_data);
+
+/**
+@brief Same as lgw_receive_ref(), on the concentrator of the given context
+*/
+int lgw_ctx_receive_ref(lgw_ctx_t * ctx, uint8_t max_pkt, struct lgw_pkt_rx_ref_s * pkt_data);
+
+/**
+@brief Same as lgw_release_rx(), on the concentrator of the given context
+*/
+int lgw_ctx_release_rx(lgw_ctx_t * ctx, const struct lgw_pkt_rx_ref_s * pkt_data);
+
+/**
+@brief Same as lgw_wait_rx(), on the concentrator of the given context
+*/
+int lgw_ctx_wait_rx(lgw_ctx_t * ctx, int timeout_ms);
+
+/**
+@brief Same as lgw_receive_wait(), on the concentrator of the given context
+*/
+int lgw_ctx_receive_wait(lgw_ctx_t * ctx, uint8_t max_pkt, struct lgw_pkt_rx_s * pkt_data, int timeout_ms);
+
+/**
+@brief Same as lgw_get_rx_lost(), on the concentrator of the given context
+*/
+int lgw_ctx_get_rx_lost(lgw_ctx_t * ctx, uint32_t * nb_lost);
+
+/**
+@brief Same as lgw_get_nb_tx_radio(), on the concentrator of the given context
+*/
+uint8_t lgw_ctx_get_nb_tx_radio(lgw_ctx_t * ctx);
+
+/**
+@brief Same as lgw_send(), on the concentrator of the given context
+*/
+int lgw_ctx_send(lgw_ctx_t * ctx, const struct lgw_pkt_tx_s * pkt_data);
+
+/**
+@brief Same as lgw_tx_poll(), on the concentrator of the given context
+*/
+int lgw_ctx_tx_poll(lgw_ctx_t * ctx);
+
+/**
+@brief Same as lgw_tx_set_callback(), on the concentrator of the given context
+*/
+int lgw_ctx_tx_set_callback(lgw_ctx_t * ctx, lgw_tx_cb cb, void * arg);
+
+/**
+@brief Same as lgw_status(), on the concentrator of the given context
+*/
+int lgw_ctx_status(lgw_ctx_t * ctx, e_status_type select, e_status * code);
+
+/**
+@brief Same as lgw_abort_tx(), on the concentrator of the given context
+*/
+int lgw_ctx_abort_tx(lgw_ctx_t * ctx);
+
+/**
+@brief Same as lgw_get_trigcnt(), on the concentrator of the given context
+*/
+int lgw_ctx_get_trigcnt(lgw_ctx_t * ctx, uint32_t * trig_cnt_us);
+
+/**
+@brief Same as lgw_get_instcnt(), on the concentrator of the given context
+*/
+int lgw_ctx_get_instcnt(lgw_ctx_t * ctx, uint32_t * inst_cnt_us);
+
+/**
+@brief Same as lgw_get_instcnt_estimate(), on the concentrator of the given context
+*/
+int lgw_ctx_get_instcnt_estimate(lgw_ctx_t * ctx, uint32_t * inst_cnt_us, uint32_t * err_us);
+
+/**
+@brief Same as lgw_refresh_status(), on the concentrator of the given context
+*/
+int lgw_ctx_refresh_status(lgw_ctx_t * ctx);
+
+/**
+@brief Same as lgw_get_trigcnt_now(), on the concentrator of the given context
+*/
+int lgw_ctx_get_trigcnt_now(lgw_ctx_t * ctx, uint32_t * trig_cnt_us);
+
+/**
+@brief Same as lgw_get_instcnt_now(), on the concentrator of the given context
+*/
+int lgw_ctx_get_instcnt_now(lgw_ctx_t * ctx, uint32_t * inst_cnt_us);
+
+/**
+@brief Same as lgw_get_eui(), on the concentrator of the given context
+*/
+int lgw_ctx_get_eui(lgw_ctx_t * ctx, uint64_t * eui);
+
+/**
+@brief Same as lgw_get_temperature(), on the concentrator of the given context
+*/
+int lgw_ctx_get_temperature(lgw_ctx_t * ctx, float * temperature, e_temperature_src * source);
+
+/**
+@brief Same as lgw_get_mcu_rtt(), on the concentrator of the given context
+*/
+int lgw_ctx_get_mcu_rtt(lgw_ctx_t * ctx, uint8_t req, struct lgw_hist_s * rtt, const char ** name);
+
 #endif
 
 /* --- EOF ------------------------------------------------------------------ */
\ No newline at end of file
@@ -0,0 +1,82 @@
+/*!
+ * \brief     LoRa 2.4GHz concentrator : lock-free latency histograms
+ *
+ * License: Revised BSD 3-Clause License, see LICENSE.TXT file include in the project
+ */
+
+#ifndef _LORAGW_HIST_H
+#define _LORAGW_HIST_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define LGW_HIST_SUB_BITS   3   /* 8 buckets per power of 2, values are known with a 12.5% precision */
+#define LGW_HIST_NB_BUCKET  ((32 - LGW_HIST_SUB_BITS + 1) << LGW_HIST_SUB_BITS)
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct lgw_hist_s
+@brief Distribution of durations, in microseconds
+
+Values below 2^LGW_HIST_SUB_BITS have their own bucket, each power of 2 above is
+split in 2^LGW_HIST_SUB_BITS buckets of the same width, as done by HDR
+histograms. Values are recorded with atomic operations, by any thread.
+*/
+struct lgw_hist_s {
+    uint32_t count;                         /*!> number of values recorded */
+    uint32_t max;                           /*!> highest value recorded */
+    uint64_t sum;                           /*!> sum of the values recorded */
+    uint32_t bucket[LGW_HIST_NB_BUCKET];    /*!> number of values recorded in each bucket */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Clear a histogram
+@param hist histogram, not being recorded to
+*/
+void lgw_hist_reset(struct lgw_hist_s * hist);
+
+/**
+@brief Record a value, lock-free
+@param hist histogram
+@param value duration, in microseconds
+*/
+void lgw_hist_record(struct lgw_hist_s * hist, uint32_t value);
+
+/**
+@brief Move the values recorded to another histogram, lock-free
+@param hist histogram, cleared by the call, can be recorded to meanwhile
+@param snapshot histogram receiving the values, its previous content is lost
+
+A value recorded during the call may be accounted in the snapshot or left in
+hist, it is never lost nor counted twice.
+*/
+void lgw_hist_collect(struct lgw_hist_s * hist, struct lgw_hist_s * snapshot);
+
+/**
+@brief Add the values of a histogram to another one
+@param hist histogram receiving the values, not being recorded to
+@param other histogram added
+*/
+void lgw_hist_merge(struct lgw_hist_s * hist, const struct lgw_hist_s * other);
+
+/**
+@brief Get a percentile of a histogram
+@param hist histogram, not being recorded to
+@param percent percentile to get [0..100]
+@return highest value of the bucket the percentile falls in, bounded by the max, 0 if empty
+*/
+uint32_t lgw_hist_percentile(const struct lgw_hist_s * hist, float percent);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
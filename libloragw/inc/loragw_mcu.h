@@ -11,6 +11,8 @@
 /* --- DEPENDANCIES --------------------------------------------------------- */
 
 #include "loragw_hal.h"
+#include "loragw_com.h"
+#include "loragw_hist.h"
 
 #include "config.h"    /* library configuration options (dynamically generated) */
 
@@ -22,6 +24,9 @@
 
 #define NB_RADIO_RX_MAX                 (3)
 
+#define MCU_WRITE_SIZE_MAX              (280)   /* biggest request payload */
+#define MCU_READ_SIZE_MAX               (500)   /* biggest ACK or event frame */
+
 // Command without payload
 #define ORDER_REQ_PING_SIZE             (0)
 #define ORDER_REQ_GET_STATUS_SIZE       (0)
@@ -273,36 +278,94 @@ typedef struct {
     uint8_t lost_message;
 } s_rx_msg;
 
+struct timespec; /* from time.h, only used through pointers */
+
+/**
+@struct s_mcu
+@brief State of one MCU, set by mcu_open() and passed to all the other mcu_ functions
+
+RX arena: payloads of the received packets, stored back to back and used as a
+ring. Payloads are released in the order they were received, the space left at
+the end of the arena when an allocation does not fit is skipped.
+
+Requests and ACKs are built in buffers local to each call, so that mcu_
+functions may be called from several threads at once. The RX arena is not
+locked, only one thread at a time may receive packets and release them. The
+TX radio reset time is not locked either, only one thread at a time may reset
+the radios and send packets.
+
+The host time each request is written is kept by request id, each id being used
+by a single request until its ACK is read, to record the round-trip times.
+*/
+typedef struct {
+    s_com com;                              /*!> transport to the MCU */
+    uint8_t nb_radio_rx;                    /*!> number of RX radios, as returned by PING */
+    uint8_t nb_radio_tx;                    /*!> number of TX radios, as returned by PING */
+    uint8_t rx_arena[LGW_RX_ARENA_SIZE];    /*!> payloads of the received packets */
+    size_t arena_head;                      /*!> next allocation offset */
+    size_t arena_tail;                      /*!> offset of the oldest payload not released yet */
+    size_t arena_fill;                      /*!> bytes in use, including the skipped space */
+    bool arena_wrapped;                     /*!> the head wrapped to the beginning of the arena, not the tail yet */
+    uint64_t tx_ready_us;                   /*!> host time the TX radio is ready after a batched reset, 0 if it is */
+    struct lgw_hist_s rtt[LGW_MCU_NB_REQ];  /*!> round-trip times from request write to ACK read, by order id */
+} s_mcu;
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
 
-int mcu_open(const char * tty_path);
+int mcu_open(s_mcu * mcu, const char * tty_path);
+
+/* Same as mcu_open(), the com port is drained until quiet instead of waiting a fixed time */
+int mcu_open_fast(s_mcu * mcu, const char * tty_path);
+
+int mcu_close(s_mcu * mcu);
+
+int mcu_get_status(s_mcu * mcu, s_status * status);
+
+int mcu_get_tx_status(s_mcu * mcu, e_tx_msg_status * status);
+
+int mcu_ping(s_mcu * mcu, s_ping_info * info);
+
+int mcu_prepare_tx(s_mcu * mcu, const struct lgw_pkt_tx_s * pkt_data, bool blocking);
+
+int mcu_config_rx(s_mcu * mcu, uint8_t channel, const struct lgw_conf_channel_rx_s * conf);
+
+/* Configure several channels with a single write, conf is indexed by channel.
+Channels failing to be configured are retried until their radio is ready */
+int mcu_config_rx_batch(s_mcu * mcu, const uint8_t * channels, int nb_channel, const struct lgw_conf_channel_rx_s * conf);
+
+int mcu_receive(s_mcu * mcu, uint8_t max_pkt, struct lgw_pkt_rx_ref_s * pkt, uint8_t * nb_pkt, s_rx_msg * info);
+
+int mcu_receive_status(s_mcu * mcu, uint8_t max_pkt, struct lgw_pkt_rx_ref_s * pkt, uint8_t * nb_pkt, s_rx_msg * info, s_status * status, struct timespec * status_time);
 
-int mcu_close(int fd);
+int mcu_receive_evt(s_mcu * mcu, uint8_t max_pkt, struct lgw_pkt_rx_ref_s * pkt, uint8_t * nb_pkt);
 
-int mcu_get_status(int fd, s_status * status);
+int mcu_release_rx(s_mcu * mcu, const struct lgw_pkt_rx_ref_s * pkt);
 
-int mcu_get_tx_status(int fd, e_tx_msg_status * status);
+int mcu_receive_tx_evt(s_mcu * mcu, e_tx_msg_status * status);
 
-int mcu_ping(int fd, s_ping_info * info);
+int mcu_wait_event(s_mcu * mcu, int timeout_ms);
 
-int mcu_prepare_tx(int fd, const struct lgw_pkt_tx_s * pkt_data, bool blocking);
+int mcu_reset(s_mcu * mcu, e_reset_type reset_type);
 
-int mcu_config_rx(int fd, uint8_t channel, const struct lgw_conf_channel_rx_s * conf);
+/* Reset several elements with a single write, then poll the MCU until ready
+instead of waiting a fixed time */
+int mcu_reset_batch(s_mcu * mcu, const e_reset_type * reset_types, int nb_reset);
 
-int mcu_receive(int fd, uint8_t max_pkt, struct lgw_pkt_rx_s * pkt, uint8_t * nb_pkt);
+int mcu_boot(s_mcu * mcu);
 
-int mcu_reset(int fd, e_reset_type reset_type);
+int mcu_read_register(s_mcu * mcu, uint8_t radio_idx, uint16_t addr, uint8_t * value);
 
-int mcu_boot(int fd);
+int mcu_write_register(s_mcu * mcu, uint8_t radio_idx, uint16_t addr, const uint8_t value);
 
-int mcu_read_register(int fd, uint8_t radio_idx, uint16_t addr, uint8_t * value);
+uint8_t mcu_get_nb_rx_radio(s_mcu * mcu);
 
-int mcu_write_register(int fd, uint8_t radio_idx, uint16_t addr, const uint8_t value);
+uint8_t mcu_get_nb_tx_radio(s_mcu * mcu);
 
-uint8_t mcu_get_nb_rx_radio(void);
+/* Get and reset the round-trip times of a type of request, lock-free */
+int mcu_get_rtt(s_mcu * mcu, uint8_t cmd, struct lgw_hist_s * rtt);
 
-uint8_t mcu_get_nb_tx_radio(void);
+const char * cmd_get_str(const uint8_t cmd);
 
 #endif
 
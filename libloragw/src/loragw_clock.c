@@ -0,0 +1,257 @@
+/*!
+ * \brief     LoRa 2.4GHz concentrator clock tracking functions
+ *
+ * License: Revised BSD 3-Clause License, see LICENSE.TXT file include in the project
+ */
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf fprintf */
+#include <stdlib.h>     /* llabs */
+#include <time.h>       /* clock_gettime */
+#include <math.h>       /* fabs */
+#include <pthread.h>    /* pthread_mutex */
+
+#include "loragw_clock.h"
+#include "loragw_aux.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#if DEBUG_CLK == 1
+    #define DEBUG_MSG(str)                fprintf(stderr, str)
+    #define DEBUG_PRINTF(fmt, args...)    fprintf(stderr, fmt, args)
+    #define CHECK_NULL(a)                 if(a==NULL){fprintf(stderr,"%s:%d: ERROR: NULL POINTER AS ARGUMENT\n", __FUNCTION__, __LINE__);return -1;}
+#else
+    #define DEBUG_MSG(str)
+    #define DEBUG_PRINTF(fmt, args...)
+    #define CHECK_NULL(a)                 if(a==NULL){return -1;}
+#endif
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
+
+static int64_t timespec_to_us(const struct timespec * t);
+
+static int64_t model_cnt(const s_clk * clk, int64_t host_us);
+
+static int64_t model_err(const s_clk * clk, int64_t host_us);
+
+static void model_fit(s_clk * clk);
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static int64_t timespec_to_us(const struct timespec * t) {
+    return ((int64_t)t->tv_sec * 1000000) + (t->tv_nsec / 1000);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int64_t model_cnt(const s_clk * clk, int64_t host_us) {
+    double dt = (double)(host_us - clk->anchor_host_us);
+
+    return clk->anchor_cnt_us + (int64_t)(dt * (1.0 + clk->drift));
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int64_t model_err(const s_clk * clk, int64_t host_us) {
+    double dt = fabs((double)(host_us - clk->anchor_host_us));
+
+    return clk->fit_err_us + (int64_t)ceil(dt * clk->drift_err);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void model_fit(s_clk * clk) {
+    int i;
+    const s_clk_sample * last = &clk->samples[clk->last_sample];
+    const s_clk_sample * s;
+    double x, y, sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0;
+    double span, res, res_max = 0.0;
+
+    /* Least square fit of the counter against the host time, relative to the
+    latest sample to keep the values small */
+    for (i = 0; i < clk->nb_samples; i++) {
+        s = &clk->samples[i];
+        x = (double)(s->host_us - last->host_us);
+        y = (double)(s->cnt_us - last->cnt_us) - x;
+        sx += x;
+        sy += y;
+        sxx += x * x;
+        sxy += x * y;
+    }
+    span = (double)(last->host_us - clk->samples[(clk->last_sample + 1) % clk->nb_samples].host_us);
+
+    /* Not enough history to estimate the drift, only follow the latest sample */
+    if ((clk->nb_samples < 2) || (span < (CLK_SAMPLE_SPACING_MS * 1000.0))) {
+        clk->drift = 0.0;
+        clk->drift_err = CLK_DRIFT_MAX_PPM / 1e6;
+        clk->anchor_host_us = last->host_us;
+        clk->anchor_cnt_us = last->cnt_us;
+        clk->fit_err_us = last->err_us;
+        return;
+    }
+
+    clk->drift = ((clk->nb_samples * sxy) - (sx * sy)) / ((clk->nb_samples * sxx) - (sx * sx));
+    clk->drift = MAX(MIN(clk->drift, CLK_DRIFT_MAX_PPM / 1e6), -CLK_DRIFT_MAX_PPM / 1e6);
+
+    /* Anchor the model on the fitted value at the latest sample */
+    clk->anchor_host_us = last->host_us;
+    clk->anchor_cnt_us = last->cnt_us + (int64_t)((sy - (clk->drift * sx)) / clk->nb_samples);
+
+    /* Error bound: worst residual, on top of the latest sample uncertainty */
+    for (i = 0; i < clk->nb_samples; i++) {
+        s = &clk->samples[i];
+        res = fabs((double)(s->cnt_us - model_cnt(clk, s->host_us)));
+        res_max = MAX(res_max, res);
+    }
+    clk->fit_err_us = (int64_t)ceil(res_max) + last->err_us;
+    clk->drift_err = MIN((2.0 * clk->fit_err_us) / span, CLK_DRIFT_MAX_PPM / 1e6);
+
+    DEBUG_PRINTF("INFO: clock model updated, %d samples, drift:%.3f ppm, err:%lld us\n", clk->nb_samples, clk->drift * 1e6, (long long)clk->fit_err_us);
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+void clk_init(s_clk * clk) {
+    pthread_mutex_init(&clk->mx, NULL);
+    clk->nb_samples = 0;
+    clk->last_sample = 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void clk_reset(s_clk * clk) {
+    pthread_mutex_lock(&clk->mx);
+    clk->nb_samples = 0;
+    clk->last_sample = 0;
+    pthread_mutex_unlock(&clk->mx);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int clk_add_sample(s_clk * clk, uint32_t cnt_us, const struct timespec * before, const struct timespec * after) {
+    s_clk_sample sample;
+    int64_t t0, t1, pred;
+    int prev;
+
+    CHECK_NULL(before);
+    CHECK_NULL(after);
+
+    t0 = timespec_to_us(before);
+    t1 = timespec_to_us(after);
+    if (t1 < t0) {
+        printf("ERROR: invalid clock sample, answer received before request was sent\n");
+        return -1;
+    }
+    sample.host_us = t0 + ((t1 - t0) / 2);
+    sample.err_us = (t1 - t0 + 1) / 2;
+
+    pthread_mutex_lock(&clk->mx);
+
+    /* A slow answer gives a poor sample, only keep it if there is nothing better */
+    if ((clk->nb_samples > 0) && (sample.err_us > CLK_SAMPLE_ERR_MAX_US)) {
+        pthread_mutex_unlock(&clk->mx);
+        DEBUG_PRINTF("INFO: clock sample rejected, round trip too long (%lld us)\n", (long long)(t1 - t0));
+        return -1;
+    }
+
+    if (clk->nb_samples == 0) {
+        sample.cnt_us = cnt_us;
+    } else {
+        /* Unwrap the 32-bits counter around the model prediction */
+        pred = model_cnt(clk, sample.host_us);
+        sample.cnt_us = pred + (int32_t)(cnt_us - (uint32_t)pred);
+
+        /* Restart the tracking if the counter jumped (concentrator reset...) */
+        if (llabs(sample.cnt_us - pred) > (CLK_RESYNC_US + model_err(clk, sample.host_us) + sample.err_us)) {
+            printf("WARNING: concentrator counter jumped by %lld us, restarting clock tracking\n", (long long)(sample.cnt_us - pred));
+            clk->nb_samples = 0;
+            clk->last_sample = 0;
+            sample.cnt_us = cnt_us;
+        }
+    }
+
+    /* The latest sample is only kept in the history once it is far enough from
+    the previous one to improve the drift estimate, otherwise it is replaced */
+    prev = (clk->last_sample + CLK_NB_SAMPLES - 1) % CLK_NB_SAMPLES;
+    if (clk->nb_samples == 0) {
+        clk->samples[0] = sample;
+        clk->nb_samples = 1;
+    } else if ((clk->nb_samples > 1) && ((clk->samples[clk->last_sample].host_us - clk->samples[prev].host_us) < ((int64_t)CLK_SAMPLE_SPACING_MS * 1000))) {
+        clk->samples[clk->last_sample] = sample;
+    } else {
+        clk->last_sample = (clk->last_sample + 1) % CLK_NB_SAMPLES;
+        clk->samples[clk->last_sample] = sample;
+        clk->nb_samples = MIN(clk->nb_samples + 1, CLK_NB_SAMPLES);
+    }
+
+    model_fit(clk);
+
+    pthread_mutex_unlock(&clk->mx);
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int clk_get_cnt(s_clk * clk, const struct timespec * host, uint32_t * cnt_us, uint32_t * err_us) {
+    struct timespec now;
+    int64_t t, err;
+
+    CHECK_NULL(cnt_us);
+
+    if (host == NULL) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        host = &now;
+    }
+    t = timespec_to_us(host);
+
+    pthread_mutex_lock(&clk->mx);
+    if (clk->nb_samples == 0) {
+        pthread_mutex_unlock(&clk->mx);
+        return -1;
+    }
+    *cnt_us = (uint32_t)model_cnt(clk, t);
+    err = model_err(clk, t);
+    pthread_mutex_unlock(&clk->mx);
+
+    if (err_us != NULL) {
+        *err_us = (uint32_t)MIN(err, UINT32_MAX);
+    }
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int clk_get_drift(s_clk * clk, double * drift_ppm) {
+    int x = 0;
+
+    CHECK_NULL(drift_ppm);
+
+    pthread_mutex_lock(&clk->mx);
+    if (clk->nb_samples < 2) {
+        x = -1;
+    } else {
+        *drift_ppm = clk->drift * 1e6;
+    }
+    pthread_mutex_unlock(&clk->mx);
+
+    return x;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
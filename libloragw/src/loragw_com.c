@@ -0,0 +1,561 @@
+/*!
+ * \brief     LoRa 2.4GHz concentrator MCU command transport functions
+ *
+ * License: Revised BSD 3-Clause License, see LICENSE.TXT file include in the project
+ */
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf fprintf */
+#include <string.h>     /* memcpy */
+#include <errno.h>      /* errno */
+#include <unistd.h>     /* read, write */
+#include <poll.h>       /* poll */
+#include <time.h>       /* clock_gettime */
+#include <sys/uio.h>    /* writev */
+#include <pthread.h>    /* pthread_mutex */
+
+#include "loragw_com.h"
+#include "loragw_mcu.h"
+#include "loragw_aux.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#if DEBUG_MCU == 1
+    #define DEBUG_MSG(str)                fprintf(stderr, str)
+    #define DEBUG_PRINTF(fmt, args...)    fprintf(stderr, fmt, args)
+    #define CHECK_NULL(a)                 if(a==NULL){fprintf(stderr,"%s:%d: ERROR: NULL POINTER AS ARGUMENT\n", __FUNCTION__, __LINE__);return -1;}
+#else
+    #define DEBUG_MSG(str)
+    #define DEBUG_PRINTF(fmt, args...)
+    #define CHECK_NULL(a)                 if(a==NULL){return -1;}
+#endif
+
+#define FRAME_ID(buf)   ((buf)[CMD_OFFSET__ID])
+#define FRAME_TYPE(buf) ((buf)[CMD_OFFSET__CMD])
+#define FRAME_SIZE(buf) (COM_HEADER_SIZE + (((size_t)(buf)[CMD_OFFSET__SIZE_MSB] << 8) | (buf)[CMD_OFFSET__SIZE_LSB]))
+
+/* EVT_* order ids have their MSB set, UNKNOW_CMD is the answer to an unknown request */
+#define FRAME_IS_EVT(buf) (((FRAME_TYPE(buf) & 0x80) != 0) && (FRAME_TYPE(buf) != ORDER_ID__UNKNOW_CMD))
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
+
+static int fill_rx_buf(s_com * com, int timeout_ms);
+
+static int parse_frame(s_com * com, const uint8_t ** frame);
+
+static int read_frame(s_com * com, bool wait, int timeout_ms, const uint8_t ** frame);
+
+static int dispatch_frame(s_com * com, const uint8_t * buf, int size);
+
+static bool frame_available(s_com * com);
+
+static int write_reqs(s_com * com, s_com_req * reqs, int nb_req);
+
+static int read_ack(s_com * com, uint8_t id, uint8_t * buf, size_t buf_size, int timeout_ms);
+
+static int read_evt(s_com * com, uint8_t type, bool wait, uint8_t * buf, size_t buf_size);
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static int fill_rx_buf(s_com * com, int timeout_ms) {
+    struct pollfd pfd;
+    int n;
+
+    /* Move the remaining partial frame, if any, to the beginning of the buffer */
+    if (com->rx_start > 0) {
+        memmove(com->rx_buf, &com->rx_buf[com->rx_start], com->rx_end - com->rx_start);
+        com->rx_end -= com->rx_start;
+        com->rx_start = 0;
+    }
+
+    pfd.fd = com->fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    n = poll(&pfd, 1, timeout_ms);
+    if (n < 0) {
+        if (errno == EINTR) {
+            return 0;
+        }
+        perror("ERROR: Unable to poll /dev/ttyACMx - ");
+        return -1;
+    } else if (n == 0) {
+        return 0;
+    }
+    if ((pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) != 0) {
+        printf("ERROR: com port is in error state (revents:0x%X)\n", pfd.revents);
+        return -1;
+    }
+
+    /* Drain everything available in a single read */
+    n = read(com->fd, &com->rx_buf[com->rx_end], sizeof com->rx_buf - com->rx_end);
+    if (n < 0) {
+        if ((errno == EINTR) || (errno == EAGAIN)) {
+            return 0;
+        }
+        perror("ERROR: Unable to read /dev/ttyACMx - ");
+        return -1;
+    }
+    DEBUG_PRINTF("INFO: read %d bytes from gateway\n", n);
+    com->rx_end += n;
+
+    return n;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int parse_frame(s_com * com, const uint8_t ** frame) {
+    size_t size;
+
+    if ((com->rx_end - com->rx_start) < COM_HEADER_SIZE) {
+        return 0;
+    }
+
+    size = FRAME_SIZE(&com->rx_buf[com->rx_start]);
+    if (size > COM_FRAME_SIZE_MAX) {
+        printf("ERROR: invalid frame size (%zu), dropping %zu bytes\n", size, com->rx_end - com->rx_start);
+        com->rx_start = 0;
+        com->rx_end = 0;
+        return -1;
+    }
+    if ((com->rx_end - com->rx_start) < size) {
+        return 0;
+    }
+
+    *frame = &com->rx_buf[com->rx_start];
+    com->rx_start += size;
+
+#if DEBUG_MCU == 1
+    size_t i;
+    for (i = 0; i < size; i++) {
+        DEBUG_PRINTF("%02X ", (*frame)[i]);
+    }
+    DEBUG_MSG("\n");
+#endif
+
+    return (int)size;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int read_frame(s_com * com, bool wait, int timeout_ms, const uint8_t ** frame) {
+    struct timespec start, now;
+    int n, elapsed_ms, poll_ms;
+
+    /* A full frame may have been read already */
+    n = parse_frame(com, frame);
+    if (n != 0) {
+        return n;
+    }
+
+    /* Without waiting, only get what is currently available */
+    if (wait == false) {
+        if (fill_rx_buf(com, 0) < 0) {
+            return -1;
+        }
+        return parse_frame(com, frame);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (1) {
+        poll_ms = timeout_ms;
+        if (timeout_ms > 0) {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            elapsed_ms = (int)(((now.tv_sec - start.tv_sec) * 1000) + ((now.tv_nsec - start.tv_nsec) / 1000000));
+            if (elapsed_ms >= timeout_ms) {
+                printf("ERROR: timeout waiting for a frame from the MCU (%zu bytes pending)\n", com->rx_end - com->rx_start);
+                return -1;
+            }
+            poll_ms = timeout_ms - elapsed_ms;
+        }
+
+        if (fill_rx_buf(com, poll_ms) < 0) {
+            return -1;
+        }
+
+        n = parse_frame(com, frame);
+        if (n != 0) {
+            return n;
+        }
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static bool id_is_pending(s_com * com, uint8_t id) {
+    bool pending;
+
+    pthread_mutex_lock(&com->mx_id);
+    pending = com->id_pending[id];
+    pthread_mutex_unlock(&com->mx_id);
+
+    return pending;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void id_release(s_com * com, uint8_t id) {
+    pthread_mutex_lock(&com->mx_id);
+    com->id_pending[id] = false;
+    pthread_mutex_unlock(&com->mx_id);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int dispatch_frame(s_com * com, const uint8_t * buf, int size) {
+    if (FRAME_IS_EVT(buf)) {
+        /* Keep the event aside, to be fetched with com_read_evt() */
+        if (com->evt_queue.nb == COM_EVT_QUEUE_SIZE) {
+            printf("WARNING: event queue is full, dropping oldest event 0x%02X\n", FRAME_TYPE(com->evt_queue.frames[0]));
+            memmove(com->evt_queue.frames[0], com->evt_queue.frames[1], (COM_EVT_QUEUE_SIZE - 1) * COM_FRAME_SIZE_MAX);
+            com->evt_queue.nb -= 1;
+        }
+        memcpy(com->evt_queue.frames[com->evt_queue.nb], buf, size);
+        com->evt_queue.nb += 1;
+        DEBUG_PRINTF("INFO: event 0x%02X queued (%d in queue)\n", FRAME_TYPE(buf), com->evt_queue.nb);
+    } else if (id_is_pending(com, FRAME_ID(buf)) == true) {
+        /* ACK of another outstanding request, keep it until asked for */
+        if (com->ack_queue.nb == COM_ACK_QUEUE_SIZE) {
+            printf("ERROR: ACK queue is full, dropping ACK 0x%02X (id:0x%02X)\n", FRAME_TYPE(buf), FRAME_ID(buf));
+            return -1;
+        }
+        memcpy(com->ack_queue.frames[com->ack_queue.nb], buf, size);
+        com->ack_queue.nb += 1;
+    } else {
+        printf("WARNING: dropping ACK 0x%02X not matching any request (id:0x%02X)\n", FRAME_TYPE(buf), FRAME_ID(buf));
+    }
+
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+void com_init(s_com * com) {
+    memset(com, 0, sizeof *com);
+    pthread_mutex_init(&com->mx, NULL);
+    pthread_mutex_init(&com->mx_write, NULL);
+    pthread_mutex_init(&com->mx_id, NULL);
+    com->fd = -1;
+    com->timeout_ms = COM_TIMEOUT_MS_DEFAULT;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void com_reset(s_com * com) {
+    pthread_mutex_lock(&com->mx);
+    com->evt_queue.nb = 0;
+    com->ack_queue.nb = 0;
+    com->rx_start = 0;
+    com->rx_end = 0;
+    pthread_mutex_lock(&com->mx_id);
+    memset(com->id_pending, 0, sizeof com->id_pending);
+    pthread_mutex_unlock(&com->mx_id);
+    pthread_mutex_unlock(&com->mx);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void com_set_timeout(s_com * com, int timeout_ms) {
+    com->timeout_ms = (timeout_ms == 0) ? COM_TIMEOUT_MS_DEFAULT : timeout_ms;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static bool frame_available(s_com * com) {
+    return (com->evt_queue.nb > 0) || (((com->rx_end - com->rx_start) >= COM_HEADER_SIZE) && ((com->rx_end - com->rx_start) >= FRAME_SIZE(&com->rx_buf[com->rx_start])));
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int write_reqs(s_com * com, s_com_req * reqs, int nb_req) {
+    struct iovec iov[2 * COM_REQ_NB_MAX];
+    struct iovec * v = iov;
+    int i, n;
+    int nb_iov = 0;
+    struct timespec now;
+    uint64_t now_us;
+
+    CHECK_NULL(reqs);
+    if ((nb_req < 1) || (nb_req > COM_REQ_NB_MAX)) {
+        printf("ERROR: invalid number of requests (%d)\n", nb_req);
+        return -1;
+    }
+
+    for (i = 0; i < nb_req; i++) {
+        if ((reqs[i].size > 0) && (reqs[i].payload == NULL)) {
+            printf("ERROR: invalid payload\n");
+            return -1;
+        }
+    }
+
+    /* Monotonic ids, skipping the ones still waiting for their ACK. They are
+    marked pending before being written, for a thread reading the com port
+    meanwhile to queue their ACK instead of dropping it. The requests are
+    pipelined, the round trip of each one starts with the write */
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    now_us = ((uint64_t)now.tv_sec * 1000000) + ((uint64_t)now.tv_nsec / 1000);
+    pthread_mutex_lock(&com->mx_id);
+    for (i = 0; i < nb_req; i++) {
+        while (com->id_pending[com->next_id] == true) {
+            com->next_id += 1;
+        }
+        reqs[i].id = com->next_id;
+        com->id_pending[reqs[i].id] = true;
+        com->req_cmd[reqs[i].id] = reqs[i].cmd;
+        com->req_time_us[reqs[i].id] = now_us;
+        com->next_id += 1;
+    }
+    pthread_mutex_unlock(&com->mx_id);
+
+    /* Gather headers and payloads of all requests */
+    for (i = 0; i < nb_req; i++) {
+        com->headers[i][CMD_OFFSET__ID] = reqs[i].id;
+        com->headers[i][CMD_OFFSET__SIZE_MSB] = (uint8_t)(reqs[i].size >> 8);
+        com->headers[i][CMD_OFFSET__SIZE_LSB] = (uint8_t)(reqs[i].size >> 0);
+        com->headers[i][CMD_OFFSET__CMD] = reqs[i].cmd;
+        iov[nb_iov].iov_base = com->headers[i];
+        iov[nb_iov].iov_len = COM_HEADER_SIZE;
+        nb_iov += 1;
+        if (reqs[i].size > 0) {
+            iov[nb_iov].iov_base = (void *)reqs[i].payload;
+            iov[nb_iov].iov_len = reqs[i].size;
+            nb_iov += 1;
+        }
+
+        DEBUG_PRINTF("INFO: write_req 0x%02X, id:0x%02X\n", reqs[i].cmd, reqs[i].id);
+    }
+
+    /* Write everything with a single syscall, unless interrupted */
+    while (nb_iov > 0) {
+        n = writev(com->fd, v, nb_iov);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            printf("ERROR: failed to write requests to com port\n");
+            for (i = 0; i < nb_req; i++) {
+                id_release(com, reqs[i].id);
+            }
+            return -1;
+        }
+        while ((nb_iov > 0) && ((size_t)n >= v->iov_len)) {
+            n -= v->iov_len;
+            v += 1;
+            nb_iov -= 1;
+        }
+        if (nb_iov > 0) {
+            v->iov_base = (uint8_t *)v->iov_base + n;
+            v->iov_len -= n;
+        }
+    }
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int read_ack(s_com * com, uint8_t id, uint8_t * buf, size_t buf_size, int timeout_ms) {
+    const uint8_t * frame;
+    int i, n;
+
+    CHECK_NULL(buf);
+
+    if (id_is_pending(com, id) == false) {
+        printf("ERROR: no request waiting for an ACK with id 0x%02X\n", id);
+        return -1;
+    }
+
+    /* ACK may already have been received while waiting for another one */
+    for (i = 0; i < com->ack_queue.nb; i++) {
+        if (FRAME_ID(com->ack_queue.frames[i]) == id) {
+            n = (int)FRAME_SIZE(com->ack_queue.frames[i]);
+            if ((size_t)n > buf_size) {
+                printf("ERROR: not enough memory to store ACK (%d)\n", n);
+                return -1;
+            }
+            memcpy(buf, com->ack_queue.frames[i], n);
+            com->ack_queue.nb -= 1;
+            memmove(com->ack_queue.frames[i], com->ack_queue.frames[i + 1], (com->ack_queue.nb - i) * COM_FRAME_SIZE_MAX);
+            id_release(com, id);
+            return n;
+        }
+    }
+
+    /* Read frames until getting the expected ACK */
+    while (1) {
+        n = read_frame(com, true, timeout_ms, &frame);
+        if (n < 0) {
+            return -1;
+        }
+
+        if (!FRAME_IS_EVT(frame) && (FRAME_ID(frame) == id)) {
+            if ((size_t)n > buf_size) {
+                printf("ERROR: not enough memory to store ACK (%d)\n", n);
+                return -1;
+            }
+            memcpy(buf, frame, n);
+            id_release(com, id);
+            return n;
+        }
+
+        if (dispatch_frame(com, frame, n) != 0) {
+            return -1;
+        }
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int read_evt(s_com * com, uint8_t type, bool wait, uint8_t * buf, size_t buf_size) {
+    const uint8_t * frame;
+    int i, n;
+
+    CHECK_NULL(buf);
+
+    while (1) {
+        /* Get the oldest queued event of the requested type */
+        for (i = 0; i < com->evt_queue.nb; i++) {
+            if (FRAME_TYPE(com->evt_queue.frames[i]) == type) {
+                n = (int)FRAME_SIZE(com->evt_queue.frames[i]);
+                if ((size_t)n > buf_size) {
+                    printf("ERROR: not enough memory to store event (%d)\n", n);
+                    return -1;
+                }
+                memcpy(buf, com->evt_queue.frames[i], n);
+                com->evt_queue.nb -= 1;
+                memmove(com->evt_queue.frames[i], com->evt_queue.frames[i + 1], (com->evt_queue.nb - i) * COM_FRAME_SIZE_MAX);
+                return n;
+            }
+        }
+
+        /* Unless asked to wait, only parse what is available from the com port */
+        n = read_frame(com, wait, com->timeout_ms, &frame);
+        if (n <= 0) {
+            return n;
+        }
+        if (dispatch_frame(com, frame, n) != 0) {
+            return -1;
+        }
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int com_write_reqs(s_com * com, s_com_req * reqs, int nb_req) {
+    int x;
+
+    pthread_mutex_lock(&com->mx_write);
+    x = write_reqs(com, reqs, nb_req);
+    pthread_mutex_unlock(&com->mx_write);
+
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void com_get_req(s_com * com, uint8_t id, uint8_t * cmd, uint64_t * time_us) {
+    pthread_mutex_lock(&com->mx_id);
+    *cmd = com->req_cmd[id];
+    *time_us = com->req_time_us[id];
+    pthread_mutex_unlock(&com->mx_id);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int com_read_ack(s_com * com, uint8_t id, uint8_t * buf, size_t buf_size) {
+    return com_read_ack_timeout(com, id, buf, buf_size, com->timeout_ms);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int com_read_ack_timeout(s_com * com, uint8_t id, uint8_t * buf, size_t buf_size, int timeout_ms) {
+    int x;
+
+    pthread_mutex_lock(&com->mx);
+    x = read_ack(com, id, buf, buf_size, timeout_ms);
+    if (x < 0) {
+        /* Give up on that ACK, it is dropped if it ever comes */
+        id_release(com, id);
+    }
+    pthread_mutex_unlock(&com->mx);
+
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int com_read_evt(s_com * com, uint8_t type, bool wait, uint8_t * buf, size_t buf_size) {
+    int x;
+
+    pthread_mutex_lock(&com->mx);
+    x = read_evt(com, type, wait, buf, buf_size);
+    pthread_mutex_unlock(&com->mx);
+
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int com_wait(s_com * com, int timeout_ms) {
+    struct pollfd pfd;
+    bool available;
+    int n;
+
+    /* Frames already read or queued are available without waiting */
+    pthread_mutex_lock(&com->mx);
+    available = frame_available(com);
+    pthread_mutex_unlock(&com->mx);
+    if (available == true) {
+        return 1;
+    }
+
+    /* Only wait for the com port to be readable, without reading it: another
+    thread may be waiting for an ACK which is part of that data */
+    pfd.fd = com->fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    n = poll(&pfd, 1, timeout_ms);
+    if (n < 0) {
+        if (errno == EINTR) {
+            return 0;
+        }
+        perror("ERROR: Unable to poll /dev/ttyACMx - ");
+        return -1;
+    } else if (n == 0) {
+        return 0;
+    }
+    if ((pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) != 0) {
+        printf("ERROR: com port is in error state (revents:0x%X)\n", pfd.revents);
+        return -1;
+    }
+
+    return 1;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int com_get_nb_evt(s_com * com) {
+    int nb;
+
+    pthread_mutex_lock(&com->mx);
+    nb = com->evt_queue.nb;
+    pthread_mutex_unlock(&com->mx);
+
+    return nb;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
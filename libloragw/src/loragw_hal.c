@@ -7,15 +7,27 @@
 /* -------------------------------------------------------------------------- */
 /* --- DEPENDANCIES --------------------------------------------------------- */
 
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
 #include <stdint.h>     /* C99 types */
 #include <stdbool.h>    /* bool type */
 #include <stdio.h>      /* printf fprintf */
+#include <stdlib.h>     /* malloc free */
 #include <string.h>     /* memcpy */
 #include <math.h>       /* ceil */
+#include <time.h>       /* clock_gettime */
+#include <pthread.h>    /* pthread_once, pthread_mutex */
 
 #include "loragw_hal.h"
 #include "loragw_mcu.h"
 #include "loragw_aux.h"
+#include "loragw_com.h"
+#include "loragw_clock.h"
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE MACROS ------------------------------------------------------- */
@@ -40,128 +52,472 @@
 const char lgw_version_string[] = "Version: " LIBLORAGW_VERSION ";";
 const char mcu_version_string[] = "01.00.01";
 
-/* -------------------------------------------------------------------------- */
-/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+#define TX_TRACK_MARGIN_US      (10000)     /* TX start delay and MCU latency, added to the expected TX end */
+#define TX_TRACK_RECHECK_US     (10000)     /* time between two TX status requests once the TX should be completed */
+#define TX_TRACK_TIMEOUT_US     (1000000)   /* TX not completed that long after its expected end is timed out */
+#define TX_TRACK_GPS_DELAY_US   (1000000)   /* worst case delay of an ON_GPS TX, up to the next PPS */
 
 /*
-The following static variables are the configuration set that the user can
-modify using board_setconf, channel_rx_setconffunctions.
-The functions _start and _send then use that set to configure the hardware.
+Terms of the time on air which only depend on the modulation, see
+lgw_time_on_air() for the reference formula. Times are counted in quarters of
+symbol, for the preamble to be an integer.
+*/
+struct toa_sf_s {
+    uint8_t bits_symbol;        /* payload bits per symbol */
+    uint8_t bits_symbol_start;  /* bits per symbol of the first 8 symbols, long interleaving without header */
+    uint8_t bits_header[2];     /* payload bits carried with the header symbols, with and without header */
+    uint8_t qsym_preamble;      /* quarters of symbol added to the preamble length (4.25 symbols, +2 for SF5/6) */
+};
+
+/*
+State of one concentrator, see lgw_ctx_new().
+
+The configuration set is modified using board_setconf, channel_rx_setconf
+functions. The functions _start and _send then use that set to configure the
+hardware.
 
 Parameters validity and coherency is verified by the _setconf functions and
 the _start and _send functions assume they are valid.
-*/
 
-static char mcu_tty_path[64];
-static int  mcu_fd;
+The RX, TX and status paths are locked separately, for a TX not to wait for the
+packets being fetched. When several are needed, they are taken in that order;
+_start and _stop take all of them.
+*/
+struct lgw_ctx_s {
+    char mcu_tty_path[64];
+    bool rx_event_mode;
+    uint32_t status_refresh_ms;
+    int32_t com_timeout_ms;
+    bool fast_start;
+
+    /*
+    Warm restart with fast_start: radios reset by the last stop of the MCU with
+    that unique id, and not configured since. The resets are then skipped.
+    */
+    bool radios_reset;
+    uint32_t radios_reset_uid[3];
+
+    pthread_mutex_t mx_rx;      /* protects rx_ref, rx_lost_count and the RX arena */
+    pthread_mutex_t mx_tx;      /* protects tx_track and the TX callback */
+    pthread_mutex_t mx_status;  /* protects the status cache */
+
+    bool lgw_is_started;
+
+    uint32_t rx_lost_count; /* packets dropped by the MCU because its buffer was full, since start */
+
+    struct lgw_pkt_rx_ref_s rx_ref[UINT8_MAX]; /* packets fetched by lgw_receive, before being copied */
+
+    struct lgw_conf_channel_rx_s rx_channel[LGW_RX_CHANNEL_NB_MAX];
+    struct lgw_conf_channel_tx_s tx_channel;
+
+    /*
+    Latest concentrator status read from the MCU, and host time at which it was
+    read. It is shared by all the functions returning status information, and
+    only read again from the MCU when older than status_refresh_ms.
+    */
+    s_status status_cache;
+    bool status_cache_valid;
+    struct timespec status_cache_time;
+
+    /*
+    TX handed to the MCU and not completed yet, with its expected start and end
+    times (concentrator counter). The TX status is derived from it, the MCU is
+    only asked for it once the TX should be completed.
+    */
+    struct {
+        bool pending;
+        uint32_t start_us;
+        uint32_t end_us;
+        uint32_t check_us;  /* next time the MCU has to be asked for the TX status */
+    } tx_track;
+    lgw_tx_cb tx_callback;
+    void * tx_callback_arg;
+
+    s_mcu mcu;  /* MCU link, valid once started */
+    s_clk clk;  /* concentrator counter model, fed by the status reads */
+};
 
-static bool lgw_is_started;
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
 
-static struct lgw_conf_channel_rx_s rx_channel[LGW_RX_CHANNEL_NB_MAX];
-static struct lgw_conf_channel_tx_s tx_channel;
+/* Time on air terms, indexed by SF - 5 */
+static const struct toa_sf_s toa_sf[8] = {
+    /* bits_symbol, bits_symbol_start, bits_header (header, no header), qsym_preamble */
+    {  5,  5, {  0, 20 }, 25 },     /* SF5 */
+    {  6,  6, {  4, 24 }, 25 },     /* SF6 */
+    {  7,  5, {  0, 20 }, 17 },     /* SF7 */
+    {  8,  6, {  4, 24 }, 17 },     /* SF8 */
+    {  9,  7, {  8, 28 }, 17 },     /* SF9 */
+    { 10,  8, { 12, 32 }, 17 },     /* SF10 */
+    {  9,  9, { 16, 36 }, 17 },     /* SF11, low datarate optimization */
+    { 10, 10, { 20, 40 }, 17 }      /* SF12, low datarate optimization */
+};
+
+/* Coded bits per 4 payload bits, indexed by coderate (4/5 to 4/8, then long interleaving 4/5, 4/6, 4/8) */
+static const uint8_t toa_cr_bits[8] = { 0, 5, 6, 7, 8, 5, 6, 8 };
+
+/* Radios reset by the fast start, RX first as done one by one otherwise */
+static const e_reset_type reset_all[2] = { RESET_TYPE__RX_ALL, RESET_TYPE__TX };
+
+/* Context used by the functions without a context argument, created on first use */
+static pthread_once_t default_ctx_once = PTHREAD_ONCE_INIT;
+static struct lgw_ctx_s default_ctx;
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
 
+static uint64_t status_age_us(lgw_ctx_t * ctx);
+
+static bool status_outdated(lgw_ctx_t * ctx);
+
+static void status_store(lgw_ctx_t * ctx, const s_status * status, const struct timespec * before, const struct timespec * after);
+
+static int status_update(lgw_ctx_t * ctx, bool force);
+
+static bool tx_status_is_final(e_tx_msg_status status, e_tx_result * result);
+
+static void tx_track_done(lgw_ctx_t * ctx, e_tx_result result);
+
+static int receive_ref(lgw_ctx_t * ctx, uint8_t max_pkt, struct lgw_pkt_rx_ref_s * pkt_data);
+
+static int tx_send(lgw_ctx_t * ctx, const struct lgw_pkt_tx_s * pkt_data);
+
+static int tx_poll(lgw_ctx_t * ctx);
+
+static int start(lgw_ctx_t * ctx);
+
+static void lock_all(lgw_ctx_t * ctx);
+
+static int32_t ceil_div(int32_t a, int32_t b);
+
+static int toa_params(const struct lgw_pkt_tx_s * pkt, uint32_t * qsym, uint16_t * bw);
+
+static void unlock_all(lgw_ctx_t * ctx);
+
+static void ctx_init(lgw_ctx_t * ctx);
+
+static void default_ctx_init(void);
+
+static lgw_ctx_t * get_default_ctx(void);
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
 
-/* -------------------------------------------------------------------------- */
-/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+static uint64_t status_age_us(lgw_ctx_t * ctx) {
+    struct timespec now;
+    int64_t age_us;
 
-int lgw_board_setconf(const struct lgw_conf_board_s * conf) {
-    CHECK_NULL(conf);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    age_us  = (int64_t)(now.tv_sec - ctx->status_cache_time.tv_sec) * 1000000;
+    age_us += (now.tv_nsec - ctx->status_cache_time.tv_nsec) / 1000;
 
-    /* check if the concentrator is running */
-    if (lgw_is_started == true) {
-        printf("ERROR: CONCENTRATOR IS RUNNING, STOP IT BEFORE TOUCHING CONFIGURATION\n");
-        return -1;
+    return (age_us > 0) ? (uint64_t)age_us : 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static bool status_outdated(lgw_ctx_t * ctx) {
+    return (ctx->status_cache_valid == false) || (status_age_us(ctx) >= ((uint64_t)ctx->status_refresh_ms * 1000));
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void status_store(lgw_ctx_t * ctx, const s_status * status, const struct timespec * before, const struct timespec * after) {
+    int i;
+
+    ctx->status_cache = *status;
+    ctx->status_cache_time = *after;
+    ctx->status_cache_valid = true;
+
+    /* Feed the concentrator clock model */
+    clk_add_sample(&ctx->clk, ctx->status_cache.precise_time_us, before, after);
+
+    for (i = 0; i < (int)mcu_get_nb_rx_radio(&ctx->mcu); i++) {
+        if (ctx->status_cache.rx_crc_ok[i] > 0) {
+            DEBUG_PRINTF("INFO: [%d] Number of packets received with CRC OK:  %u\n", i, ctx->status_cache.rx_crc_ok[i]);
+        }
+        if (ctx->status_cache.rx_crc_err[i] > 0) {
+            DEBUG_PRINTF("INFO: [%d] Number of packets received with CRC ERR: %u\n", i, ctx->status_cache.rx_crc_err[i]);
+        }
     }
+}
 
-    /* set internal config according to parameters */
-    strncpy(mcu_tty_path, conf->tty_path, sizeof mcu_tty_path);
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int status_update(lgw_ctx_t * ctx, bool force) {
+    struct timespec before, after;
+    s_status status;
+
+    /* Keep the cached status if it is recent enough */
+    if ((force == false) && (status_outdated(ctx) == false)) {
+        return 0;
+    }
+
+    ctx->status_cache_valid = false;
+    clock_gettime(CLOCK_MONOTONIC, &before);
+    if (mcu_get_status(&ctx->mcu, &status) != 0) {
+        printf("ERROR: Failed to get concentrator status\n");
+        return -1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &after);
+    status_store(ctx, &status, &before, &after);
 
     return 0;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int lgw_channel_rx_setconf(uint8_t channel, const struct lgw_conf_channel_rx_s * conf) {
-    CHECK_NULL(conf);
-    if (channel >= LGW_RX_CHANNEL_NB_MAX) {
-        printf("ERROR: invalid channel number\n");
+static bool tx_status_is_final(e_tx_msg_status status, e_tx_result * result) {
+    switch (status) {
+        case TX_STATUS__LOADED:
+        case TX_STATUS__ON_AIR:
+            return false;
+        case TX_STATUS__IDLE:
+        case TX_STATUS__DONE:
+            *result = TX_RESULT_OK;
+            return true;
+        case TX_STATUS__ERROR_TX_TIMEOUT:
+            *result = TX_RESULT_TIMEOUT;
+            return true;
+        default:
+            *result = TX_RESULT_FAILED;
+            return true;
     }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void tx_track_done(lgw_ctx_t * ctx, e_tx_result result) {
+    if (ctx->tx_track.pending == false) {
+        return;
+    }
+    ctx->tx_track.pending = false;
+
+    DEBUG_PRINTF("INFO: TX scheduled at %u completed with result %d\n", ctx->tx_track.start_us, result);
+    if (ctx->tx_callback != NULL) {
+        ctx->tx_callback(result, ctx->tx_track.start_us, ctx->tx_callback_arg);
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int receive_ref(lgw_ctx_t * ctx, uint8_t max_pkt, struct lgw_pkt_rx_ref_s * pkt_data) {
+    uint8_t nb_pkt_fetch; /* loop variable and return value */
+    uint8_t nb_pkt_evt = 0;
+    uint8_t nb_pkt_req = 0;
+    s_rx_msg rx_msg;
+    s_status status;
+    struct timespec before, after;
+    bool outdated;
+    int i, x;
+
+    CHECK_NULL(pkt_data);
 
     /* check if the concentrator is running */
-    if (lgw_is_started == true) {
-        printf("ERROR: CONCENTRATOR IS RUNNING, STOP IT BEFORE TOUCHING CONFIGURATION\n");
+    if (ctx->lgw_is_started == false) {
+        printf("ERROR: CONCENTRATOR IS NOT RUNNING, START IT BEFORE RECEIVING\n");
         return -1;
     }
 
-    /* set internal config according to parameters */
-    rx_channel[channel].enable = conf->enable;
-    rx_channel[channel].freq_hz = conf->freq_hz;
-    rx_channel[channel].datarate = conf->datarate;
-    rx_channel[channel].bandwidth = conf->bandwidth;
-    rx_channel[channel].rssi_offset = conf->rssi_offset;
-    rx_channel[channel].sync_word = conf->sync_word;
+    /* Get packets already pushed by the concentrator, if any */
+    if (mcu_receive_evt(&ctx->mcu, max_pkt, pkt_data, &nb_pkt_evt) != 0) {
+        return -1;
+    }
 
-    if (conf->enable == true) {
-        DEBUG_PRINTF("INFO: Setting channel %u configuration => en:%d freq:%u sf:%d bw:%ukhz rssi_offset:%.1f sync_word:0x%02X\n",   channel,
-                                                                                                    rx_channel[channel].enable,
-                                                                                                    rx_channel[channel].freq_hz,
-                                                                                                    rx_channel[channel].datarate,
-                                                                                                    lgw_get_bw_khz(rx_channel[channel].bandwidth),
-                                                                                                    rx_channel[channel].rssi_offset,
-                                                                                                    rx_channel[channel].sync_word);
-    } else {
-        DEBUG_PRINTF("INFO: Channel %u is disabled\n", channel);
+    /* Get packets buffered by the concentrator, until drained or no room left */
+    nb_pkt_fetch = nb_pkt_evt;
+    if (ctx->rx_event_mode == false) {
+        do {
+            if (nb_pkt_fetch >= max_pkt) {
+                DEBUG_MSG("INFO: no room left to fetch pending packets\n");
+                break;
+            }
+            pthread_mutex_lock(&ctx->mx_status);
+            outdated = status_outdated(ctx);
+            pthread_mutex_unlock(&ctx->mx_status);
+            if (outdated == true) {
+                /* Pipeline the status request with the packets one */
+                clock_gettime(CLOCK_MONOTONIC, &before);
+                if (mcu_receive_status(&ctx->mcu, max_pkt - nb_pkt_fetch, &pkt_data[nb_pkt_fetch], &nb_pkt_req, &rx_msg, &status, &after) != 0) {
+                    return -1;
+                }
+                pthread_mutex_lock(&ctx->mx_status);
+                status_store(ctx, &status, &before, &after);
+                pthread_mutex_unlock(&ctx->mx_status);
+            } else {
+                if (mcu_receive(&ctx->mcu, max_pkt - nb_pkt_fetch, &pkt_data[nb_pkt_fetch], &nb_pkt_req, &rx_msg) != 0) {
+                    return -1;
+                }
+            }
+            nb_pkt_fetch += nb_pkt_req;
+
+            /* Count packets lost by the MCU, and the ones which did not fit in the given array */
+            ctx->rx_lost_count += rx_msg.lost_message + (rx_msg.nb_msg - nb_pkt_req);
+        } while (rx_msg.pending != 0);
+    }
+
+    /* Get RX status (for info), only if the cached one is outdated */
+    pthread_mutex_lock(&ctx->mx_status);
+    x = status_update(ctx, false);
+    pthread_mutex_unlock(&ctx->mx_status);
+    if (x != 0) {
+        return -1;
     }
 
+    /* Update missing metadata */
+    for (i = 0; i < nb_pkt_fetch; i++) {
+        /* channel is already set */
+        /* count_us is already set */
+        /* snr is already set */
+        pkt_data[i].freq_hz = ctx->rx_channel[pkt_data[i].channel].freq_hz;
+        pkt_data[i].status = STAT_CRC_OK;
+        pkt_data[i].modulation = MOD_LORA;
+        pkt_data[i].bandwidth = ctx->rx_channel[pkt_data[i].channel].bandwidth;
+        pkt_data[i].datarate = ctx->rx_channel[pkt_data[i].channel].datarate;
+        pkt_data[i].coderate = CR_LORA_LI_4_8;
+
+        /* Apply RSSI offset calibrated for the board/channel*/
+        pkt_data[i].rssi += ctx->rx_channel[pkt_data[i].channel].rssi_offset;
+    }
+
+    return (int)nb_pkt_fetch;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int tx_send(lgw_ctx_t * ctx, const struct lgw_pkt_tx_s * pkt_data) {
+    uint32_t now_us;
+    uint32_t start_us;
+    bool track = true;
+
+    CHECK_NULL(pkt_data);
+
+    /* check if the concentrator is running */
+    if (ctx->lgw_is_started == false) {
+        printf("ERROR: CONCENTRATOR IS NOT RUNNING, START IT BEFORE RECEIVING\n");
+        return -1;
+    }
+
+    /* check the TX radio */
+    if (pkt_data->rf_chain >= lgw_ctx_get_nb_tx_radio(ctx)) {
+        printf("ERROR: TX RADIO %u NOT AVAILABLE\n", pkt_data->rf_chain);
+        return -1;
+    }
+
+    /* Get the expected start of the TX before it is handed to the MCU, nothing can fail once it is */
+    switch (pkt_data->tx_mode) {
+        case TIMESTAMPED:
+            start_us = pkt_data->count_us;
+            break;
+        case ON_GPS:
+            track = (clk_get_cnt(&ctx->clk, NULL, &now_us, NULL) == 0);
+            start_us = now_us + TX_TRACK_GPS_DELAY_US;
+            break;
+        default:
+            track = (clk_get_cnt(&ctx->clk, NULL, &now_us, NULL) == 0);
+            start_us = now_us;
+            break;
+    }
+
+    /* Prepare non-blocking TX */
+    if (mcu_prepare_tx(&ctx->mcu, pkt_data, false) != 0) {
+        return -1;
+    }
+
+    /* The new TX replaces the pending one, if any */
+    tx_track_done(ctx, TX_RESULT_ABORTED);
+
+    /* Track the TX until its expected end */
+    if (track == false) {
+        printf("WARNING: concentrator clock is not tracked, TX sent without completion tracking\n");
+        return 0;
+    }
+    ctx->tx_track.start_us = start_us;
+    ctx->tx_track.end_us = ctx->tx_track.start_us + lgw_time_on_air_us(pkt_data) + TX_TRACK_MARGIN_US;
+    ctx->tx_track.check_us = ctx->tx_track.end_us;
+    ctx->tx_track.pending = true;
+
     return 0;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int lgw_channel_tx_setconf(const struct lgw_conf_channel_tx_s * conf) {
-    CHECK_NULL(conf);
+static int tx_poll(lgw_ctx_t * ctx) {
+    e_tx_msg_status tx_status;
+    e_tx_result result;
+    uint32_t now_us;
+    int n;
 
     /* check if the concentrator is running */
-    if (lgw_is_started == true) {
-        printf("ERROR: CONCENTRATOR IS RUNNING, STOP IT BEFORE TOUCHING CONFIGURATION\n");
+    if (ctx->lgw_is_started == false) {
+        printf("ERROR: CONCENTRATOR IS NOT RUNNING\n");
         return -1;
     }
 
-    /* set internal config according to parameters */
-    tx_channel.enable = conf->enable;
+    /* Completion pushed by the MCU, if the firmware does */
+    while ((n = mcu_receive_tx_evt(&ctx->mcu, &tx_status)) == 1) {
+        if (tx_status_is_final(tx_status, &result) == true) {
+            tx_track_done(ctx, result);
+        }
+    }
+    if (n < 0) {
+        return -1;
+    }
+    if (ctx->tx_track.pending == false) {
+        return 0;
+    }
 
-    DEBUG_PRINTF("INFO: Setting TX %s\n", (tx_channel.enable == true) ? "Enabled" : "Disabled");
+    /* Nothing to ask the MCU before the TX is expected to be completed */
+    if (clk_get_cnt(&ctx->clk, NULL, &now_us, NULL) != 0) {
+        return -1;
+    }
+    if ((int32_t)(now_us - ctx->tx_track.check_us) < 0) {
+        return 0;
+    }
+
+    if (mcu_get_tx_status(&ctx->mcu, &tx_status) != 0) {
+        printf("ERROR: Failed to get TX status\n");
+        return -1;
+    }
+    if (tx_status_is_final(tx_status, &result) == true) {
+        tx_track_done(ctx, result);
+    } else if ((int32_t)(now_us - ctx->tx_track.end_us) > TX_TRACK_TIMEOUT_US) {
+        printf("WARNING: TX scheduled at %u is not completed, giving up\n", ctx->tx_track.start_us);
+        tx_track_done(ctx, TX_RESULT_TIMEOUT);
+    } else {
+        ctx->tx_track.check_us = now_us + TX_TRACK_RECHECK_US;
+    }
 
     return 0;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int lgw_start(void) {
-    int i;
+static int start(lgw_ctx_t * ctx) {
+    int i, x;
     uint8_t idx;
+    uint8_t channels[LGW_RX_CHANNEL_NB_MAX];
+    int nb_channel = 0;
     s_ping_info gw_info;
-    s_status status;
+    bool warm;
 
     /* check if the concentrator is running */
-    if (lgw_is_started == true) {
+    if (ctx->lgw_is_started == true) {
         printf("ERROR: CONCENTRATOR IS ALREADY RUNNING\n");
         return -1;
     }
 
-    DEBUG_PRINTF("## opening %s\n", mcu_tty_path);
-    mcu_fd = mcu_open(mcu_tty_path);
-    if (mcu_fd == -1) {
+    DEBUG_PRINTF("## opening %s\n", ctx->mcu_tty_path);
+    x = (ctx->fast_start == true) ? mcu_open_fast(&ctx->mcu, ctx->mcu_tty_path) : mcu_open(&ctx->mcu, ctx->mcu_tty_path);
+    if (x != 0) {
         return -1;
     }
+    com_set_timeout(&ctx->mcu.com, ctx->com_timeout_ms);
+    ctx->rx_lost_count = 0;
+    ctx->tx_track.pending = false;
 
     /* Get information from the connected concentrator (mandatory) */
-    if (mcu_ping(mcu_fd, &gw_info) != 0) {
+    if (mcu_ping(&ctx->mcu, &gw_info) != 0) {
         return -1;
     }
 
@@ -172,21 +528,41 @@ int lgw_start(void) {
     }
     printf("INFO: Concentrator MCU version is %s\n", gw_info.version);
 
-    /* Reset RX radios */
-    if (mcu_reset(mcu_fd, RESET_TYPE__RX_ALL) != 0) {
-        printf("ERROR: Failed to reset concentrator RX radios\n");
-        return -1;
-    }
+    /* Radios already reset by the last stop of the same MCU need no reset */
+    warm = (ctx->fast_start == true) && (ctx->radios_reset == true) &&
+           (ctx->radios_reset_uid[0] == gw_info.unique_id_high) &&
+           (ctx->radios_reset_uid[1] == gw_info.unique_id_mid) &&
+           (ctx->radios_reset_uid[2] == gw_info.unique_id_low);
+    ctx->radios_reset = false;
+    ctx->radios_reset_uid[0] = gw_info.unique_id_high;
+    ctx->radios_reset_uid[1] = gw_info.unique_id_mid;
+    ctx->radios_reset_uid[2] = gw_info.unique_id_low;
+
+    if (warm == true) {
+        printf("INFO: Concentrator radios already reset, warm start\n");
+    } else if (ctx->fast_start == true) {
+        /* Reset RX and TX radios at once */
+        if (mcu_reset_batch(&ctx->mcu, reset_all, 2) != 0) {
+            printf("ERROR: Failed to reset concentrator radios\n");
+            return -1;
+        }
+    } else {
+        /* Reset RX radios */
+        if (mcu_reset(&ctx->mcu, RESET_TYPE__RX_ALL) != 0) {
+            printf("ERROR: Failed to reset concentrator RX radios\n");
+            return -1;
+        }
 
-    /* Reset TX radio */
-    if (mcu_reset(mcu_fd, RESET_TYPE__TX) != 0) {
-        printf("ERROR: Failed to reset concentrator TX radios\n");
-        return -1;
+        /* Reset TX radio */
+        if (mcu_reset(&ctx->mcu, RESET_TYPE__TX) != 0) {
+            printf("ERROR: Failed to reset concentrator TX radios\n");
+            return -1;
+        }
     }
 
     /* Get status */
-    if (mcu_get_status(mcu_fd, &status) != 0) {
-        printf("ERROR: Failed to get concentrator status\n");
+    clk_reset(&ctx->clk);
+    if (status_update(ctx, true) != 0) {
         return -1;
     }
 
@@ -195,156 +571,474 @@ int lgw_start(void) {
         /* Set index to configure radio #1 first (TODO: to be removed) */
         idx = (i + 1) % 3;
         /* Configure radio */
-        if (rx_channel[idx].enable == true) {
+        if (ctx->rx_channel[idx].enable == true) {
             /* TODO: enforce radio #1 to be enabled. Temporary workaround until hardware is fixed */
-            if (rx_channel[1].enable == false) {
+            if (ctx->rx_channel[1].enable == false) {
                 printf("ERROR: Channel 1 cannot be disabled (radio #1 needs to be configured)\n");
                 return -1;
             }
 
             printf("INFO: Configuring RX channel %d => freq:%u sf:%d bw:%ukhz\n",   idx,
-                                                                                    rx_channel[idx].freq_hz,
-                                                                                    rx_channel[idx].datarate,
-                                                                                    lgw_get_bw_khz(rx_channel[idx].bandwidth));
-            if (mcu_config_rx(mcu_fd, idx, &rx_channel[idx]) != 0) {
+                                                                                    ctx->rx_channel[idx].freq_hz,
+                                                                                    ctx->rx_channel[idx].datarate,
+                                                                                    lgw_get_bw_khz(ctx->rx_channel[idx].bandwidth));
+            if (ctx->fast_start == true) {
+                channels[nb_channel++] = idx;
+            } else if (mcu_config_rx(&ctx->mcu, idx, &ctx->rx_channel[idx]) != 0) {
                 printf("ERROR: Failed to configure radio #%u\n", idx);
                 return -1;
             }
         }
     }
+    if ((nb_channel > 0) && (mcu_config_rx_batch(&ctx->mcu, channels, nb_channel, ctx->rx_channel) != 0)) {
+        printf("ERROR: Failed to configure RX radios\n");
+        return -1;
+    }
+
+    ctx->lgw_is_started = true;
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Integer division rounded up, b > 0 */
+static int32_t ceil_div(int32_t a, int32_t b) {
+    return (a > 0) ? ((a + b - 1) / b) : -((-a) / b);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Time on air of a packet, in quarters of symbol, and the bandwidth to convert it (kHz) */
+static int toa_params(const struct lgw_pkt_tx_s * pkt, uint32_t * qsym, uint16_t * bw) {
+    const struct toa_sf_s * p;
+    int32_t nb_bytes, bits_payload, bits_header, cr_bits, nb_sym_start;
+    int32_t nb_sym_data;
+
+    if ((pkt->datarate < DR_LORA_SF5) || (pkt->datarate > DR_LORA_SF12) || (pkt->coderate < CR_LORA_4_5) || (pkt->coderate > CR_LORA_LI_4_8)) {
+        printf("ERROR: invalid datarate or coderate, failed to compute time on air\n");
+        return -1;
+    }
+    switch (pkt->bandwidth) {
+        case BW_200KHZ:     *bw = 203; break;
+        case BW_400KHZ:     *bw = 406; break;
+        case BW_800KHZ:     *bw = 812; break;
+        case BW_1600KHZ:    *bw = 1625; break;
+        default:
+            printf("ERROR: invalid bandwidth, failed to compute time on air\n");
+            return -1;
+    }
+
+    p = &toa_sf[pkt->datarate - DR_LORA_SF5];
+    cr_bits = toa_cr_bits[pkt->coderate];
+    nb_bytes = pkt->size + ((pkt->no_crc == false) ? 2 : 0);
+    bits_header = p->bits_header[(pkt->no_header == false) ? 0 : 1];
+
+    /* Only the payload scales the number of data symbols */
+    if (pkt->coderate <= CR_LORA_4_8) {
+        bits_payload = MAX(0, 8 * nb_bytes - bits_header);
+        nb_sym_data = 8 + ceil_div(bits_payload, 4 * p->bits_symbol) * cr_bits;
+    } else if (pkt->no_header == false) {
+        if (bits_header < 8 * nb_bytes) {
+            bits_header = MIN(bits_header, 8 * pkt->size);
+        }
+        bits_payload = MAX(0, 8 * nb_bytes - bits_header);
+        nb_sym_data = 8 + ceil_div(bits_payload * cr_bits, 4 * p->bits_symbol);
+    } else {
+        /* 8 * nb_bytes payload bits, coded with cr_bits per 4 bits */
+        nb_sym_start = ceil_div(2 * nb_bytes * cr_bits, p->bits_symbol_start);
+        if (nb_sym_start < 8) {
+            nb_sym_data = nb_sym_start;
+        } else {
+            nb_sym_data = 8 + ceil_div(2 * nb_bytes * cr_bits - 8 * p->bits_symbol_start, p->bits_symbol);
+        }
+    }
+
+    *qsym = (4 * (uint32_t)pkt->preamble) + p->qsym_preamble + (4 * (uint32_t)nb_sym_data);
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void lock_all(lgw_ctx_t * ctx) {
+    pthread_mutex_lock(&ctx->mx_rx);
+    pthread_mutex_lock(&ctx->mx_tx);
+    pthread_mutex_lock(&ctx->mx_status);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void unlock_all(lgw_ctx_t * ctx) {
+    pthread_mutex_unlock(&ctx->mx_status);
+    pthread_mutex_unlock(&ctx->mx_tx);
+    pthread_mutex_unlock(&ctx->mx_rx);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void ctx_init(lgw_ctx_t * ctx) {
+    memset(ctx, 0, sizeof *ctx);
+    pthread_mutex_init(&ctx->mx_rx, NULL);
+    pthread_mutex_init(&ctx->mx_tx, NULL);
+    pthread_mutex_init(&ctx->mx_status, NULL);
+    com_init(&ctx->mcu.com);
+    clk_init(&ctx->clk);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void default_ctx_init(void) {
+    ctx_init(&default_ctx);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static lgw_ctx_t * get_default_ctx(void) {
+    pthread_once(&default_ctx_once, default_ctx_init);
+    return &default_ctx;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+lgw_ctx_t * lgw_ctx_new(void) {
+    lgw_ctx_t * ctx;
+
+    ctx = malloc(sizeof *ctx);
+    if (ctx == NULL) {
+        printf("ERROR: failed to allocate concentrator context\n");
+        return NULL;
+    }
+    ctx_init(ctx);
+
+    return ctx;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void lgw_ctx_delete(lgw_ctx_t * ctx) {
+    if (ctx == NULL) {
+        return;
+    }
+    if (ctx->lgw_is_started == true) {
+        lgw_ctx_stop(ctx);
+    }
+    free(ctx);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_board_setconf(lgw_ctx_t * ctx, const struct lgw_conf_board_s * conf) {
+    CHECK_NULL(conf);
+
+    /* check if the concentrator is running */
+    if (ctx->lgw_is_started == true) {
+        printf("ERROR: CONCENTRATOR IS RUNNING, STOP IT BEFORE TOUCHING CONFIGURATION\n");
+        return -1;
+    }
+
+    /* set internal config according to parameters */
+    strncpy(ctx->mcu_tty_path, conf->tty_path, sizeof ctx->mcu_tty_path);
+    ctx->rx_event_mode = conf->rx_event_mode;
+    ctx->status_refresh_ms = conf->status_refresh_ms;
+    ctx->com_timeout_ms = conf->com_timeout_ms;
+    ctx->fast_start = conf->fast_start;
+
+    DEBUG_PRINTF("INFO: RX packets will be %s\n", (ctx->rx_event_mode == true) ? "pushed by the MCU" : "polled from the MCU");
+    DEBUG_PRINTF("INFO: concentrator status refreshed every %u ms\n", ctx->status_refresh_ms);
+    DEBUG_PRINTF("INFO: MCU frames timeout set to %d ms\n", ctx->com_timeout_ms);
+    DEBUG_PRINTF("INFO: fast start %s\n", (ctx->fast_start == true) ? "enabled" : "disabled");
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_channel_rx_setconf(lgw_ctx_t * ctx, uint8_t channel, const struct lgw_conf_channel_rx_s * conf) {
+    CHECK_NULL(conf);
+    if (channel >= LGW_RX_CHANNEL_NB_MAX) {
+        printf("ERROR: invalid channel number\n");
+    }
+
+    /* check if the concentrator is running */
+    if (ctx->lgw_is_started == true) {
+        printf("ERROR: CONCENTRATOR IS RUNNING, STOP IT BEFORE TOUCHING CONFIGURATION\n");
+        return -1;
+    }
+
+    /* set internal config according to parameters */
+    ctx->rx_channel[channel].enable = conf->enable;
+    ctx->rx_channel[channel].freq_hz = conf->freq_hz;
+    ctx->rx_channel[channel].datarate = conf->datarate;
+    ctx->rx_channel[channel].bandwidth = conf->bandwidth;
+    ctx->rx_channel[channel].rssi_offset = conf->rssi_offset;
+    ctx->rx_channel[channel].sync_word = conf->sync_word;
+
+    if (conf->enable == true) {
+        DEBUG_PRINTF("INFO: Setting channel %u configuration => en:%d freq:%u sf:%d bw:%ukhz rssi_offset:%.1f sync_word:0x%02X\n",   channel,
+                                                                                                    ctx->rx_channel[channel].enable,
+                                                                                                    ctx->rx_channel[channel].freq_hz,
+                                                                                                    ctx->rx_channel[channel].datarate,
+                                                                                                    lgw_get_bw_khz(ctx->rx_channel[channel].bandwidth),
+                                                                                                    ctx->rx_channel[channel].rssi_offset,
+                                                                                                    ctx->rx_channel[channel].sync_word);
+    } else {
+        DEBUG_PRINTF("INFO: Channel %u is disabled\n", channel);
+    }
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_channel_tx_setconf(lgw_ctx_t * ctx, const struct lgw_conf_channel_tx_s * conf) {
+    CHECK_NULL(conf);
+
+    /* check if the concentrator is running */
+    if (ctx->lgw_is_started == true) {
+        printf("ERROR: CONCENTRATOR IS RUNNING, STOP IT BEFORE TOUCHING CONFIGURATION\n");
+        return -1;
+    }
+
+    /* set internal config according to parameters */
+    ctx->tx_channel.enable = conf->enable;
+
+    DEBUG_PRINTF("INFO: Setting TX %s\n", (ctx->tx_channel.enable == true) ? "Enabled" : "Disabled");
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_start(lgw_ctx_t * ctx) {
+    int x;
+
+    lock_all(ctx);
+    x = start(ctx);
+    unlock_all(ctx);
+
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_stop(lgw_ctx_t * ctx) {
+    lock_all(ctx);
+    ctx->lgw_is_started = false;
+    ctx->status_cache_valid = false;
+    tx_track_done(ctx, TX_RESULT_ABORTED);
+
+    if (ctx->fast_start == true) {
+        /* Reset RX and TX radios at once, the next start can then skip it */
+        if (mcu_reset_batch(&ctx->mcu, reset_all, 2) != 0) {
+            printf("WARNING: FAILED TO RESET CONCENTRATOR RADIOS\n");
+        } else {
+            ctx->radios_reset = true;
+        }
+    } else {
+        /* Reset concentrator RX radios */
+        if (mcu_reset(&ctx->mcu, RESET_TYPE__RX_ALL) != 0) {
+            printf("WARNING: FAILED TO RESET CONCENTRATOR RX RADIOS\n");
+        }
+
+        /* Reset concentrator TX radio */
+        if (mcu_reset(&ctx->mcu, RESET_TYPE__TX) != 0) {
+            printf("WARNING: FAILED TO RESET CONCENTRATOR TX RADIO\n");
+        }
+    }
+
+    DEBUG_PRINTF("## closing %s\n", ctx->mcu_tty_path);
+    mcu_close(&ctx->mcu);
+    unlock_all(ctx);
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_receive(lgw_ctx_t * ctx, uint8_t max_pkt, struct lgw_pkt_rx_s * pkt_data) {
+    struct lgw_pkt_rx_s * p;
+    int i, nb_pkt;
+
+    CHECK_NULL(pkt_data);
+
+    pthread_mutex_lock(&ctx->mx_rx);
+    nb_pkt = receive_ref(ctx, max_pkt, ctx->rx_ref);
+    if (nb_pkt <= 0) {
+        pthread_mutex_unlock(&ctx->mx_rx);
+        return nb_pkt;
+    }
+
+    /* Copy the packets out of the arena */
+    for (i = 0; i < nb_pkt; i++) {
+        p = &pkt_data[i];
+        p->freq_hz = ctx->rx_ref[i].freq_hz;
+        p->channel = ctx->rx_ref[i].channel;
+        p->status = ctx->rx_ref[i].status;
+        p->count_us = ctx->rx_ref[i].count_us;
+        p->foff_hz = ctx->rx_ref[i].foff_hz;
+        p->modulation = ctx->rx_ref[i].modulation;
+        p->bandwidth = ctx->rx_ref[i].bandwidth;
+        p->datarate = ctx->rx_ref[i].datarate;
+        p->coderate = ctx->rx_ref[i].coderate;
+        p->rssi = ctx->rx_ref[i].rssi;
+        p->snr = ctx->rx_ref[i].snr;
+        p->size = ctx->rx_ref[i].size;
+        memcpy(p->payload, ctx->rx_ref[i].payload, ctx->rx_ref[i].size);
+    }
+    mcu_release_rx(&ctx->mcu, &ctx->rx_ref[nb_pkt - 1]);
+    pthread_mutex_unlock(&ctx->mx_rx);
+
+    return nb_pkt;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_receive_ref(lgw_ctx_t * ctx, uint8_t max_pkt, struct lgw_pkt_rx_ref_s * pkt_data) {
+    int nb_pkt;
+
+    pthread_mutex_lock(&ctx->mx_rx);
+    nb_pkt = receive_ref(ctx, max_pkt, pkt_data);
+    pthread_mutex_unlock(&ctx->mx_rx);
+
+    return nb_pkt;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_release_rx(lgw_ctx_t * ctx, const struct lgw_pkt_rx_ref_s * pkt_data) {
+    int x;
+
+    CHECK_NULL(pkt_data);
+
+    pthread_mutex_lock(&ctx->mx_rx);
+    x = mcu_release_rx(&ctx->mcu, pkt_data);
+    pthread_mutex_unlock(&ctx->mx_rx);
+
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_wait_rx(lgw_ctx_t * ctx, int timeout_ms) {
+    /* check if the concentrator is running */
+    if (ctx->lgw_is_started == false) {
+        printf("ERROR: CONCENTRATOR IS NOT RUNNING, START IT BEFORE RECEIVING\n");
+        return -1;
+    }
+
+    return mcu_wait_event(&ctx->mcu, timeout_ms);
+}
 
-    lgw_is_started = true;
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-    return 0;
+int lgw_ctx_receive_wait(lgw_ctx_t * ctx, uint8_t max_pkt, struct lgw_pkt_rx_s * pkt_data, int timeout_ms) {
+    if (lgw_ctx_wait_rx(ctx, timeout_ms) < 0) {
+        return -1;
+    }
+
+    return lgw_ctx_receive(ctx, max_pkt, pkt_data);
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int lgw_stop(void) {
-    lgw_is_started = false;
-
-    /* Reset concentrator RX radios */
-    if (mcu_reset(mcu_fd, RESET_TYPE__RX_ALL) != 0) {
-        printf("WARNING: FAILED TO RESET CONCENTRATOR RX RADIOS\n");
-    }
+int lgw_ctx_get_rx_lost(lgw_ctx_t * ctx, uint32_t * nb_lost) {
+    CHECK_NULL(nb_lost);
 
-    /* Reset concentrator TX radio */
-    if (mcu_reset(mcu_fd, RESET_TYPE__TX) != 0) {
-        printf("WARNING: FAILED TO RESET CONCENTRATOR TX RADIO\n");
+    /* check if the concentrator is running */
+    if (ctx->lgw_is_started == false) {
+        printf("ERROR: CONCENTRATOR IS NOT RUNNING\n");
+        return -1;
     }
 
-    DEBUG_PRINTF("## closing %s\n", mcu_tty_path);
-    mcu_close(mcu_fd);
+    pthread_mutex_lock(&ctx->mx_rx);
+    *nb_lost = ctx->rx_lost_count;
+    pthread_mutex_unlock(&ctx->mx_rx);
 
     return 0;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int lgw_receive(uint8_t max_pkt, struct lgw_pkt_rx_s * pkt_data) {
-    uint8_t nb_pkt_fetch; /* loop variable and return value */
-    s_status status;
-    int i;
-
-    CHECK_NULL(pkt_data);
+uint8_t lgw_ctx_get_nb_tx_radio(lgw_ctx_t * ctx) {
+    uint8_t nb_radio;
 
-    /* check if the concentrator is running */
-    if (lgw_is_started == false) {
-        printf("ERROR: CONCENTRATOR IS NOT RUNNING, START IT BEFORE RECEIVING\n");
-        return -1;
+    if (ctx->lgw_is_started == false) {
+        return 0;
     }
 
-    /* Get packets from the concentrator */
-    if (mcu_receive(mcu_fd, max_pkt, pkt_data, &nb_pkt_fetch) != 0) {
-        return -1;
-    }
+    nb_radio = mcu_get_nb_tx_radio(&ctx->mcu);
+    return (nb_radio < LGW_TX_CHANNEL_NB_MAX) ? nb_radio : LGW_TX_CHANNEL_NB_MAX;
+}
 
-    /* Get RX status (for info) */
-    if (mcu_get_status(mcu_fd, &status) != 0) {
-        return -1;
-    }
-    for (i = 0; i < (int)mcu_get_nb_rx_radio(); i++) {
-        if (status.rx_crc_ok[i] > 0) {
-            DEBUG_PRINTF("INFO: [%d] Number of packets received with CRC OK:  %u\n", i, status.rx_crc_ok[i]);
-        }
-        if (status.rx_crc_err[i] > 0) {
-            DEBUG_PRINTF("INFO: [%d] Number of packets received with CRC ERR: %u\n", i, status.rx_crc_err[i]);
-        }
-    }
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-    /* Update missing metadata */
-    for (i = 0; i < nb_pkt_fetch; i++) {
-        /* channel is already set */
-        /* count_us is already set */
-        /* snr is already set */
-        pkt_data[i].freq_hz = rx_channel[pkt_data[i].channel].freq_hz;
-        pkt_data[i].status = STAT_CRC_OK;
-        pkt_data[i].modulation = MOD_LORA;
-        pkt_data[i].bandwidth = rx_channel[pkt_data[i].channel].bandwidth;
-        pkt_data[i].datarate = rx_channel[pkt_data[i].channel].datarate;
-        pkt_data[i].coderate = CR_LORA_LI_4_8;
+int lgw_ctx_send(lgw_ctx_t * ctx, const struct lgw_pkt_tx_s * pkt_data) {
+    int x;
 
-        /* Apply RSSI offset calibrated for the board/channel*/
-        pkt_data[i].rssi += rx_channel[pkt_data[i].channel].rssi_offset;
-    }
+    pthread_mutex_lock(&ctx->mx_tx);
+    x = tx_send(ctx, pkt_data);
+    pthread_mutex_unlock(&ctx->mx_tx);
 
-    return (int)nb_pkt_fetch;
+    return x;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int lgw_send(const struct lgw_pkt_tx_s * pkt_data) {
-    CHECK_NULL(pkt_data);
+int lgw_ctx_tx_poll(lgw_ctx_t * ctx) {
+    int x;
 
-    /* check if the concentrator is running */
-    if (lgw_is_started == false) {
-        printf("ERROR: CONCENTRATOR IS NOT RUNNING, START IT BEFORE RECEIVING\n");
-        return -1;
-    }
+    pthread_mutex_lock(&ctx->mx_tx);
+    x = tx_poll(ctx);
+    pthread_mutex_unlock(&ctx->mx_tx);
 
-    /* Prepare non-blocking TX */
-    if (mcu_prepare_tx(mcu_fd, pkt_data, false) != 0) {
-        return -1;
-    }
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_tx_set_callback(lgw_ctx_t * ctx, lgw_tx_cb cb, void * arg) {
+    pthread_mutex_lock(&ctx->mx_tx);
+    ctx->tx_callback = cb;
+    ctx->tx_callback_arg = arg;
+    pthread_mutex_unlock(&ctx->mx_tx);
 
     return 0;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int lgw_status(e_status_type select, e_status * code) {
-    e_tx_msg_status tx_status;
+int lgw_ctx_status(lgw_ctx_t * ctx, e_status_type select, e_status * code) {
+    uint32_t now_us;
 
     CHECK_NULL(code);
 
     /* Get Status */
     if (select == TX_STATUS) {
-        if (lgw_is_started == false) {
+        pthread_mutex_lock(&ctx->mx_tx);
+        if (ctx->lgw_is_started == false) {
             *code = TX_OFF;
         } else {
-            if (mcu_get_tx_status(mcu_fd, &tx_status) != 0) {
+            if (tx_poll(ctx) != 0) {
+                pthread_mutex_unlock(&ctx->mx_tx);
                 printf("ERROR: Failed to get TX status\n");
                 return -1;
             }
-            switch(tx_status) {
-                case TX_STATUS__IDLE:
-                case TX_STATUS__DONE:
-                    *code = TX_FREE;
-                    break;
-                case TX_STATUS__LOADED:
-                    *code = TX_SCHEDULED;
-                    break;
-                case TX_STATUS__ON_AIR:
-                    *code = TX_EMITTING;
-                    break;
-                default:
-                    *code = TX_STATUS_UNKNOWN;
-                    break;
+            if (ctx->tx_track.pending == false) {
+                *code = TX_FREE;
+            } else if (clk_get_cnt(&ctx->clk, NULL, &now_us, NULL) != 0) {
+                *code = TX_STATUS_UNKNOWN;
+            } else if ((int32_t)(now_us - ctx->tx_track.start_us) < 0) {
+                *code = TX_SCHEDULED;
+            } else {
+                *code = TX_EMITTING;
             }
         }
+        pthread_mutex_unlock(&ctx->mx_tx);
 
     } else if (select == RX_STATUS) {
-        if (lgw_is_started == false) {
+        if (ctx->lgw_is_started == false) {
             *code = RX_OFF;
         } else {
             *code = RX_ON;
@@ -359,78 +1053,149 @@ int lgw_status(e_status_type select, e_status * code) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int lgw_abort_tx(void) {
+int lgw_ctx_abort_tx(lgw_ctx_t * ctx) {
+    int x;
+
     /* Reset concentrator TX radio */
-    if (mcu_reset(mcu_fd, RESET_TYPE__TX) != 0) {
+    pthread_mutex_lock(&ctx->mx_tx);
+    x = (ctx->fast_start == true) ? mcu_reset_batch(&ctx->mcu, &reset_all[1], 1) : mcu_reset(&ctx->mcu, RESET_TYPE__TX);
+    if (x != 0) {
+        pthread_mutex_unlock(&ctx->mx_tx);
         printf("ERROR: Failed to reset concentrator TX radio\n");
         return -1;
     }
+    tx_track_done(ctx, TX_RESULT_ABORTED);
+    pthread_mutex_unlock(&ctx->mx_tx);
 
     return 0;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int lgw_get_trigcnt(uint32_t * trig_cnt_us) {
-    s_status status;
-
+int lgw_ctx_get_trigcnt(lgw_ctx_t * ctx, uint32_t * trig_cnt_us) {
     CHECK_NULL(trig_cnt_us);
 
     /* check if the concentrator is running */
-    if (lgw_is_started == false) {
+    if (ctx->lgw_is_started == false) {
         printf("ERROR: CONCENTRATOR IS NOT RUNNING\n");
         return -1;
     }
 
     /* Get counter from status */
-    if (mcu_get_status(mcu_fd, &status) == -1) {
+    pthread_mutex_lock(&ctx->mx_status);
+    if (status_update(ctx, false) == -1) {
+        pthread_mutex_unlock(&ctx->mx_status);
         return -1;
     }
-
-    *trig_cnt_us = status.pps_time_us;
+    *trig_cnt_us = ctx->status_cache.pps_time_us;
+    pthread_mutex_unlock(&ctx->mx_status);
 
     return 0;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int lgw_get_instcnt(uint32_t * inst_cnt_us) {
-    s_status status;
+int lgw_ctx_get_instcnt(lgw_ctx_t * ctx, uint32_t * inst_cnt_us) {
+    int x;
 
     CHECK_NULL(inst_cnt_us);
 
     /* check if the concentrator is running */
-    if (lgw_is_started == false) {
+    if (ctx->lgw_is_started == false) {
         printf("ERROR: CONCENTRATOR IS NOT RUNNING\n");
         return -1;
     }
 
     /* Get counter from status */
-    if (mcu_get_status(mcu_fd, &status) == -1) {
+    pthread_mutex_lock(&ctx->mx_status);
+    x = status_update(ctx, false);
+    pthread_mutex_unlock(&ctx->mx_status);
+    if (x == -1) {
         return -1;
     }
 
-    *inst_cnt_us = status.precise_time_us;
+    /* Extrapolate the counter from the clock model */
+    if (clk_get_cnt(&ctx->clk, NULL, inst_cnt_us, NULL) != 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_get_instcnt_estimate(lgw_ctx_t * ctx, uint32_t * inst_cnt_us, uint32_t * err_us) {
+    CHECK_NULL(inst_cnt_us);
+
+    /* check if the concentrator is running */
+    if (ctx->lgw_is_started == false) {
+        printf("ERROR: CONCENTRATOR IS NOT RUNNING\n");
+        return -1;
+    }
+
+    /* No access to the concentrator, only rely on the clock model */
+    if (clk_get_cnt(&ctx->clk, NULL, inst_cnt_us, err_us) != 0) {
+        printf("ERROR: concentrator clock is not tracked yet\n");
+        return -1;
+    }
 
     return 0;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+int lgw_ctx_refresh_status(lgw_ctx_t * ctx) {
+    int x;
+
+    /* check if the concentrator is running */
+    if (ctx->lgw_is_started == false) {
+        printf("ERROR: CONCENTRATOR IS NOT RUNNING\n");
+        return -1;
+    }
+
+    pthread_mutex_lock(&ctx->mx_status);
+    x = status_update(ctx, true);
+    pthread_mutex_unlock(&ctx->mx_status);
+
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_get_trigcnt_now(lgw_ctx_t * ctx, uint32_t * trig_cnt_us) {
+    if (lgw_ctx_refresh_status(ctx) != 0) {
+        return -1;
+    }
+
+    return lgw_ctx_get_trigcnt(ctx, trig_cnt_us);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_get_instcnt_now(lgw_ctx_t * ctx, uint32_t * inst_cnt_us) {
+    if (lgw_ctx_refresh_status(ctx) != 0) {
+        return -1;
+    }
+
+    return lgw_ctx_get_instcnt(ctx, inst_cnt_us);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 const char* lgw_version_info(void) {
     return lgw_version_string;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int lgw_get_eui(uint64_t * eui) {
+int lgw_ctx_get_eui(lgw_ctx_t * ctx, uint64_t * eui) {
     s_ping_info gw_info;
     uint32_t ID1, ID2, ID3;
     uint8_t id[8];
 
     CHECK_NULL(eui);
 
-    if (mcu_ping(mcu_fd, &gw_info) != 0) {
+    if (mcu_ping(&ctx->mcu, &gw_info) != 0) {
         return -1;
     }
 
@@ -463,25 +1228,47 @@ int lgw_get_eui(uint64_t * eui) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int lgw_get_temperature(float * temperature, e_temperature_src * source) {
-    s_status status;
-
+int lgw_ctx_get_temperature(lgw_ctx_t * ctx, float * temperature, e_temperature_src * source) {
     CHECK_NULL(temperature);
 
     /* check if the concentrator is running */
-    if (lgw_is_started == false) {
+    if (ctx->lgw_is_started == false) {
         printf("ERROR: CONCENTRATOR IS NOT RUNNING\n");
         return -1;
     }
 
     /* Get temperature from status */
-    if (mcu_get_status(mcu_fd, &status) == -1) {
+    pthread_mutex_lock(&ctx->mx_status);
+    if (status_update(ctx, false) == -1) {
+        pthread_mutex_unlock(&ctx->mx_status);
         return -1;
     }
-
-    *temperature = status.temperature.value;
+    *temperature = ctx->status_cache.temperature.value;
     if (source != NULL) {
-        *source = status.temperature.source;
+        *source = ctx->status_cache.temperature.source;
+    }
+    pthread_mutex_unlock(&ctx->mx_status);
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_get_mcu_rtt(lgw_ctx_t * ctx, uint8_t req, struct lgw_hist_s * rtt, const char ** name) {
+    CHECK_NULL(rtt);
+
+    /* check if the concentrator is running */
+    if (ctx->lgw_is_started == false) {
+        printf("ERROR: CONCENTRATOR IS NOT RUNNING\n");
+        return -1;
+    }
+
+    /* No access to the concentrator, the histograms are recorded lock-free by the MCU functions */
+    if (mcu_get_rtt(&ctx->mcu, req, rtt) != 0) {
+        return -1;
+    }
+    if (name != NULL) {
+        *name = cmd_get_str(req);
     }
 
     return 0;
@@ -489,7 +1276,22 @@ int lgw_get_temperature(float * temperature, e_temperature_src * source) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+uint32_t lgw_time_on_air_us(const struct lgw_pkt_tx_s * pkt) {
+    uint32_t qsym;
+    uint16_t bw;
+
+    if ((pkt == NULL) || (toa_params(pkt, &qsym, &bw) != 0)) {
+        return 0;
+    }
+
+    /* A symbol lasts 2^SF / bw ms, 250 * 2^SF / bw us per quarter */
+    return (uint32_t)((((uint64_t)qsym << pkt->datarate) * 250 + bw - 1) / bw);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 uint32_t lgw_time_on_air(const struct lgw_pkt_tx_s * pkt, double * result) {
+    uint32_t qsym;
     uint16_t bw = 0.0;
     double LocalTimeOnAir;
     double symbolPeriod;
@@ -502,7 +1304,17 @@ uint32_t lgw_time_on_air(const struct lgw_pkt_tx_s * pkt, double * result) {
     double tx_infobits_header;
     double tx_infobits_payload;
 
-    CHECK_NULL(pkt);
+    if (pkt == NULL) {
+        return 0;
+    }
+
+    /* Integer computation, the floating point one is only done when its full precision is asked for */
+    if (result == NULL) {
+        if (toa_params(pkt, &qsym, &bw) != 0) {
+            return 0;
+        }
+        return (uint32_t)((((uint64_t)qsym << pkt->datarate) + (4 * bw) - 1) / (4 * bw));
+    }
 
     bool fine_synch = (pkt->datarate <= 6);
     bool long_interleaving = (pkt->coderate > 4);
@@ -567,9 +1379,7 @@ uint32_t lgw_time_on_air(const struct lgw_pkt_tx_s * pkt, double * result) {
     LocalTimeOnAir = (symbols_nb_preamble + symbols_nb_data) * symbolPeriod;
 
     /* Return result with full precision, and ceiled */
-    if (result != NULL) {
-        *result = LocalTimeOnAir;
-    }
+    *result = LocalTimeOnAir;
     return (uint32_t)(ceil(LocalTimeOnAir));
 }
 
@@ -591,4 +1401,161 @@ uint16_t lgw_get_bw_khz(e_bandwidth bandwidth) {
     }
 }
 
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION, DEFAULT CONTEXT ------------------------- */
+
+int lgw_board_setconf(const struct lgw_conf_board_s * conf) {
+    return lgw_ctx_board_setconf(get_default_ctx(), conf);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_channel_rx_setconf(uint8_t channel, const struct lgw_conf_channel_rx_s * conf) {
+    return lgw_ctx_channel_rx_setconf(get_default_ctx(), channel, conf);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_channel_tx_setconf(const struct lgw_conf_channel_tx_s * conf) {
+    return lgw_ctx_channel_tx_setconf(get_default_ctx(), conf);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_start(void) {
+    return lgw_ctx_start(get_default_ctx());
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_stop(void) {
+    return lgw_ctx_stop(get_default_ctx());
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_receive(uint8_t max_pkt, struct lgw_pkt_rx_s * pkt_data) {
+    return lgw_ctx_receive(get_default_ctx(), max_pkt, pkt_data);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_receive_ref(uint8_t max_pkt, struct lgw_pkt_rx_ref_s * pkt_data) {
+    return lgw_ctx_receive_ref(get_default_ctx(), max_pkt, pkt_data);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_release_rx(const struct lgw_pkt_rx_ref_s * pkt_data) {
+    return lgw_ctx_release_rx(get_default_ctx(), pkt_data);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_wait_rx(int timeout_ms) {
+    return lgw_ctx_wait_rx(get_default_ctx(), timeout_ms);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_receive_wait(uint8_t max_pkt, struct lgw_pkt_rx_s * pkt_data, int timeout_ms) {
+    return lgw_ctx_receive_wait(get_default_ctx(), max_pkt, pkt_data, timeout_ms);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_get_rx_lost(uint32_t * nb_lost) {
+    return lgw_ctx_get_rx_lost(get_default_ctx(), nb_lost);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+uint8_t lgw_get_nb_tx_radio(void) {
+    return lgw_ctx_get_nb_tx_radio(get_default_ctx());
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_send(const struct lgw_pkt_tx_s * pkt_data) {
+    return lgw_ctx_send(get_default_ctx(), pkt_data);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_tx_poll(void) {
+    return lgw_ctx_tx_poll(get_default_ctx());
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_tx_set_callback(lgw_tx_cb cb, void * arg) {
+    return lgw_ctx_tx_set_callback(get_default_ctx(), cb, arg);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_status(e_status_type select, e_status * code) {
+    return lgw_ctx_status(get_default_ctx(), select, code);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_abort_tx(void) {
+    return lgw_ctx_abort_tx(get_default_ctx());
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_get_trigcnt(uint32_t * trig_cnt_us) {
+    return lgw_ctx_get_trigcnt(get_default_ctx(), trig_cnt_us);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_get_instcnt(uint32_t * inst_cnt_us) {
+    return lgw_ctx_get_instcnt(get_default_ctx(), inst_cnt_us);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_get_instcnt_estimate(uint32_t * inst_cnt_us, uint32_t * err_us) {
+    return lgw_ctx_get_instcnt_estimate(get_default_ctx(), inst_cnt_us, err_us);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_refresh_status(void) {
+    return lgw_ctx_refresh_status(get_default_ctx());
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_get_trigcnt_now(uint32_t * trig_cnt_us) {
+    return lgw_ctx_get_trigcnt_now(get_default_ctx(), trig_cnt_us);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_get_instcnt_now(uint32_t * inst_cnt_us) {
+    return lgw_ctx_get_instcnt_now(get_default_ctx(), inst_cnt_us);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_get_eui(uint64_t * eui) {
+    return lgw_ctx_get_eui(get_default_ctx(), eui);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_get_temperature(float * temperature, e_temperature_src * source) {
+    return lgw_ctx_get_temperature(get_default_ctx(), temperature, source);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_get_mcu_rtt(uint8_t req, struct lgw_hist_s * rtt, const char ** name) {
+    return lgw_ctx_get_mcu_rtt(get_default_ctx(), req, rtt, name);
+}
+
 /* --- EOF ------------------------------------------------------------------ */
\ No newline at end of file
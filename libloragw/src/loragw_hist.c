@@ -0,0 +1,137 @@
+/*!
+ * \brief     LoRa 2.4GHz concentrator : lock-free latency histograms
+ *
+ * License: Revised BSD 3-Clause License, see LICENSE.TXT file include in the project
+ */
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <string.h>     /* memset */
+
+#include "loragw_hist.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define SUB_NB  (1 << LGW_HIST_SUB_BITS)
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
+
+static int bucket_index(uint32_t value);
+
+static uint32_t bucket_high(int index);
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static int bucket_index(uint32_t value) {
+    int e;
+
+    if (value < SUB_NB) {
+        return (int)value;
+    }
+    e = 31 - __builtin_clz(value); /* power of 2, LGW_HIST_SUB_BITS to 31 */
+    return ((e - LGW_HIST_SUB_BITS + 1) << LGW_HIST_SUB_BITS) + (int)((value >> (e - LGW_HIST_SUB_BITS)) & (SUB_NB - 1));
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static uint32_t bucket_high(int index) {
+    int shift;
+    uint64_t low;
+
+    if (index < SUB_NB) {
+        return (uint32_t)index;
+    }
+    shift = (index >> LGW_HIST_SUB_BITS) - 1; /* width of the buckets of that power of 2 */
+    low = (uint64_t)(SUB_NB + (index & (SUB_NB - 1))) << shift;
+    return (uint32_t)(low + ((uint64_t)1 << shift) - 1);
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+void lgw_hist_reset(struct lgw_hist_s * hist) {
+    memset(hist, 0, sizeof *hist);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void lgw_hist_record(struct lgw_hist_s * hist, uint32_t value) {
+    uint32_t max;
+
+    __atomic_fetch_add(&hist->bucket[bucket_index(value)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->sum, value, __ATOMIC_RELAXED);
+    max = __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+    while ((value > max) && !__atomic_compare_exchange_n(&hist->max, &max, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        /* max updated by another thread meanwhile, and reloaded */
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void lgw_hist_collect(struct lgw_hist_s * hist, struct lgw_hist_s * snapshot) {
+    int i;
+
+    /* the count is that of the buckets, for the percentiles to be consistent */
+    __atomic_exchange_n(&hist->count, 0, __ATOMIC_RELAXED);
+    snapshot->count = 0;
+    for (i = 0; i < LGW_HIST_NB_BUCKET; i++) {
+        snapshot->bucket[i] = __atomic_exchange_n(&hist->bucket[i], 0, __ATOMIC_RELAXED);
+        snapshot->count += snapshot->bucket[i];
+    }
+    snapshot->sum = __atomic_exchange_n(&hist->sum, 0, __ATOMIC_RELAXED);
+    snapshot->max = __atomic_exchange_n(&hist->max, 0, __ATOMIC_RELAXED);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void lgw_hist_merge(struct lgw_hist_s * hist, const struct lgw_hist_s * other) {
+    int i;
+
+    for (i = 0; i < LGW_HIST_NB_BUCKET; i++) {
+        hist->bucket[i] += other->bucket[i];
+    }
+    hist->count += other->count;
+    hist->sum += other->sum;
+    if (other->max > hist->max) {
+        hist->max = other->max;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+uint32_t lgw_hist_percentile(const struct lgw_hist_s * hist, float percent) {
+    uint64_t rank;
+    uint64_t n = 0;
+    uint32_t x;
+    int i;
+
+    if (hist->count == 0) {
+        return 0;
+    }
+
+    /* rank of the value, from 1 to count */
+    rank = (uint64_t)((percent / 100.0f) * (float)hist->count + 0.5f);
+    if (rank < 1) {
+        rank = 1;
+    } else if (rank > hist->count) {
+        rank = hist->count;
+    }
+
+    for (i = 0; i < LGW_HIST_NB_BUCKET; i++) {
+        n += hist->bucket[i];
+        if (n >= rank) {
+            break;
+        }
+    }
+    x = bucket_high((i < LGW_HIST_NB_BUCKET) ? i : (LGW_HIST_NB_BUCKET - 1));
+    return (x < hist->max) ? x : hist->max;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -7,17 +7,26 @@
 /* -------------------------------------------------------------------------- */
 /* --- DEPENDANCIES --------------------------------------------------------- */
 
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
 #include <stdint.h>     /* C99 types */
 #include <stdbool.h>    /* bool type */
 #include <stdio.h>      /* printf fprintf */
 #include <string.h>     /* memcpy */
-#include <stdlib.h>     /* rand */
 #include <fcntl.h>      /* open/close */
 #include <errno.h>      /* perror */
-#include <unistd.h>     /* read, write */
+#include <unistd.h>     /* close */
+#include <time.h>       /* clock_gettime */
+#include <poll.h>       /* poll */
 #include <termios.h>    /* POSIX terminal control definitions */
 
 #include "loragw_mcu.h"
+#include "loragw_com.h"
 #include "loragw_aux.h"
 
 /* -------------------------------------------------------------------------- */
@@ -43,8 +52,22 @@
 
 /* Commands */
 #define HEADER_CMD_SIZE  4
-#define WRITE_SIZE_MAX 280
-#define READ_SIZE_MAX 500
+#define RX_PAYLOAD_SIZE_MAX 255
+
+/* Fast bring-up: the com port is drained until quiet instead of waiting before
+flushing it, and the MCU is polled until it answers instead of waiting after a
+reset. Each poll waits at most for what is left of READY_TIMEOUT_MS. */
+#define OPEN_QUIET_MS       10
+#define OPEN_DRAIN_MS_MAX   100
+#define READY_TIMEOUT_MS    500
+#define READY_RETRY_MS      10
+
+/* Time for the TX radio to get ready after a reset, the MCU answers before it is */
+#define TX_RESET_SETTLE_US  500000
+
+/* Space used by a payload in the RX arena, empty ones still take a byte to keep
+the release order known */
+#define ARENA_SLOT_SIZE(size) MAX((size_t)(size), 1)
 
 /*!
 * \brief Represents the ramping time for radio power amplifier
@@ -60,22 +83,23 @@ typedef enum {
     RADIO_RAMP_20_US = 0xE0,
 } RampTimes_t;
 
-/* -------------------------------------------------------------------------- */
-/* --- PRIVATE VARIABLES ---------------------------------------------------- */
-
-/* Hardware */
-static uint8_t nb_radio_rx = 0;
-static uint8_t nb_radio_tx = 0;
-
-static uint8_t buf_req[WRITE_SIZE_MAX];
-static uint8_t buf_ack[READ_SIZE_MAX];
-
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
 
+static uint64_t host_time_us(void);
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
 
+static uint64_t host_time_us(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1000000) + (now.tv_nsec / 1000);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 const char * cmd_get_str(const uint8_t cmd) {
     switch (cmd) {
         case ORDER_ID__REQ_PING:
@@ -125,41 +149,28 @@ uint8_t cmd_get_type(const uint8_t * bytes) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int write_req(int fd, e_order_cmd cmd, uint16_t size, const uint8_t * payload) {
-    uint8_t buf_w[HEADER_CMD_SIZE];
-    int n;
+int write_reqs(s_mcu * mcu, s_com_req * reqs, int nb_req) {
+    /* the transport stamps each request before writing it, for read_ack() to get its round trip */
+    return com_write_reqs(&mcu->com, reqs, nb_req);
+}
 
-    /* Write command header */
-    buf_w[0] = rand() % 255;
-    buf_w[1] = (uint8_t)(size >> 8); /* MSB */
-    buf_w[2] = (uint8_t)(size >> 0); /* LSB */
-    buf_w[3] = cmd;
-    n = write(fd, buf_w, HEADER_CMD_SIZE);
-    if (n < 0) {
-        printf("ERROR: failed to write command header to com port\n");
-        return -1;
-    }
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-    /* Write command payload */
-    if (size > 0) {
-        if (payload == NULL) {
-            printf("ERROR: invalid payload\n");
-            return -1;
-        }
-        n = write(fd, payload, size);
-        if (n < 0) {
-            printf("ERROR: failed to write command payload to com port\n");
-            return -1;
-        }
+int write_req(s_mcu * mcu, e_order_cmd cmd, uint16_t size, const uint8_t * payload, uint8_t * id) {
+    s_com_req req;
+
+    req.cmd = cmd;
+    req.size = size;
+    req.payload = payload;
+    if (write_reqs(mcu, &req, 1) != 0) {
+        return -1;
     }
+    *id = req.id;
 
-    DEBUG_PRINTF("\nINFO: write_req 0x%02X (%s) done, id:0x%02X\n", cmd, cmd_get_str(cmd), buf_w[0]);
+    DEBUG_PRINTF("\nINFO: write_req 0x%02X (%s) done, id:0x%02X\n", cmd, cmd_get_str(cmd), req.id);
 
 #if DEBUG_VERBOSE
     int i;
-    for (i = 0; i < 4; i++) {
-        DEBUG_PRINTF("%02X ", buf_w[i]);
-    }
     for (i = 0; i < size; i++) {
         DEBUG_PRINTF("%02X ", payload[i]);
     }
@@ -171,67 +182,32 @@ int write_req(int fd, e_order_cmd cmd, uint16_t size, const uint8_t * payload) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int read_ack(int fd, uint8_t * buf, size_t buf_size) {
-    int i, n;
-    size_t size;
-    int nb_read = 0;
-
-    /* Read message header first */
-    n = read(fd, &buf[0], (size_t)HEADER_CMD_SIZE);
-    if (errno == EINTR) {
-        printf("INFO: syscall was interrupted, continue...\n");
-        return -1;
-    } else if (n == -1) {
-        perror("ERROR: Unable to read /dev/ttyACMx - ");
-        return -1;
-    } else {
-        DEBUG_PRINTF("INFO: read %d bytes for header from gateway\n", n);
-        nb_read += n;
-    }
+int read_ack_timeout(s_mcu * mcu, uint8_t id, uint8_t * buf, size_t buf_size, int timeout_ms) {
+    int x;
+    uint8_t cmd;
+    uint64_t req_time_us;
 
-    /* debug print */
-    for (i = 0; i < (int)(HEADER_CMD_SIZE); i++) {
-        DEBUG_PRINTF("%02X ", buf[i]);
-    }
-    DEBUG_MSG("\n");
+    /* Once the ACK is read the id is released, and may be reused by another thread */
+    com_get_req(&mcu->com, id, &cmd, &req_time_us);
 
-    /* Get remaining payload size (metadata + pkt payload) */
-    size  = (size_t)buf[CMD_OFFSET__SIZE_MSB] << 8;
-    size |= (size_t)buf[CMD_OFFSET__SIZE_LSB] << 0;
-    if (((size_t)HEADER_CMD_SIZE + size) > buf_size) {
-        printf("ERROR: not enough memory to store all data (%zd)\n", (size_t)HEADER_CMD_SIZE + size);
-        return -1;
+    /* Get the ACK of the given request, events and other ACKs are queued meanwhile */
+    x = com_read_ack_timeout(&mcu->com, id, buf, buf_size, timeout_ms);
+    if ((x >= 0) && (cmd < LGW_MCU_NB_REQ)) {
+        lgw_hist_record(&mcu->rtt[cmd], (uint32_t)(host_time_us() - req_time_us));
     }
 
-    /* Read payload if any */
-    if (size > 0) {
-        do {
-            n = read(fd, &buf[nb_read], size - (nb_read - HEADER_CMD_SIZE));
-            if (errno == EINTR) {
-                printf("INFO: syscall was interrupted, continue...\n");
-                return -1;
-            } else if (n == -1) {
-                perror("ERROR: Unable to read /dev/ttyACMx - ");
-                return -1;
-            } else {
-                DEBUG_PRINTF("INFO: read %d bytes from gateway\n", n);
-                nb_read += n;
-            }
-        } while ((nb_read - HEADER_CMD_SIZE) < (int)size); /* we want to read only the expected payload, not more */
+    return x;
+}
 
-        /* debug print */
-        for (i = HEADER_CMD_SIZE; i < (int)(HEADER_CMD_SIZE + size); i++) {
-            DEBUG_PRINTF("%02X ", buf[i]);
-        }
-        DEBUG_MSG("\n");
-    }
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-    return nb_read;
+int read_ack(s_mcu * mcu, uint8_t id, uint8_t * buf, size_t buf_size) {
+    return read_ack_timeout(mcu, id, buf, buf_size, mcu->com.timeout_ms);
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int decode_ack_get_status(const uint8_t * payload, s_status * status) {
+int decode_ack_get_status(const uint8_t * payload, uint8_t nb_radio_rx, s_status * status) {
     int i;
     int16_t temperature_sensor;
     int8_t temperature_mcu;
@@ -283,7 +259,7 @@ int decode_ack_get_status(const uint8_t * payload, s_status * status) {
     DEBUG_PRINTF("   precise_time:  %u\n", status->precise_time_us);
     DEBUG_PRINTF("   pps_status:    0x%02X\n", status->pps_status);
     DEBUG_PRINTF("   pps_time:      %u\n", status->pps_time_us);
-    DEBUG_PRINTF("   temperature:   %.1f\n", status->temperature);
+    DEBUG_PRINTF("   temperature:   %.1f\n", status->temperature.value);
     for (i = 0; i < nb_radio_rx; i++) {
         DEBUG_PRINTF("   rx_crc_ok[%d]:  %u\n", i, status->rx_crc_ok[i]);
         DEBUG_PRINTF("   rx_crc_err[%d]: %u\n", i, status->rx_crc_err[i]);
@@ -319,10 +295,6 @@ int decode_ack_ping(const uint8_t * payload, s_ping_info * info) {
 
     info->nb_radio_rx = payload[HEADER_CMD_SIZE + ACK_PING__NB_RADIO_RX];
 
-    /* store local context */
-    nb_radio_rx = info->nb_radio_rx;
-    nb_radio_tx = info->nb_radio_tx;
-
 #if DEBUG_VERBOSE
     DEBUG_MSG   ("## ACK_PING\n");
     DEBUG_PRINTF("   id:           0x%02X\n", cmd_get_id(payload));
@@ -372,8 +344,9 @@ int decode_ack_tx_status(const uint8_t * payload, e_tx_msg_status * tx_status) {
         return -1;
     }
 
-    if (cmd_get_type(payload) != ORDER_ID__ACK_GET_TX_STATUS) {
-        printf("ERROR: wrong type for EVT_TX_STATUS (expected:0x%02X, got 0x%02X)\n", ORDER_ID__ACK_GET_TX_STATUS, cmd_get_type(payload));
+    /* EVT_TX_STATUS has the same payload as the ACK_GET_TX_STATUS */
+    if ((cmd_get_type(payload) != ORDER_ID__ACK_GET_TX_STATUS) && (cmd_get_type(payload) != ORDER_ID__EVT_TX_STATUS)) {
+        printf("ERROR: wrong type for EVT_TX_STATUS (expected:0x%02X or 0x%02X, got 0x%02X)\n", ORDER_ID__ACK_GET_TX_STATUS, ORDER_ID__EVT_TX_STATUS, cmd_get_type(payload));
         return -1;
     }
 
@@ -481,7 +454,7 @@ int decode_ack_get_rx_msg(const uint8_t * payload, s_rx_msg * rx_msg) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int decode_evt_msg_received(const uint8_t * payload, struct lgw_pkt_rx_s * pkt) {
+int decode_evt_msg_received(const uint8_t * payload, struct lgw_pkt_rx_ref_s * pkt) {
     /* sanity checks */
     if (payload == NULL) {
         printf("ERROR: invalid parameter\n");
@@ -494,14 +467,14 @@ int decode_evt_msg_received(const uint8_t * payload, struct lgw_pkt_rx_s * pkt)
     }
 
     /* payload info */
-    memset(pkt, 0, sizeof (struct lgw_pkt_rx_s));
+    memset(pkt, 0, sizeof (struct lgw_pkt_rx_ref_s));
     pkt->channel = payload[HEADER_CMD_SIZE + EVT_MSG_RECEIVE__RADIO_IDX];
     pkt->count_us = bytes_be_to_uint32_le(&payload[HEADER_CMD_SIZE + EVT_MSG_RECEIVE__TIMESTAMP_31_24]);
     pkt->foff_hz = bytes_be_to_int32_le(&payload[HEADER_CMD_SIZE + EVT_MSG_RECEIVE__ERROR_FREQ_31_24]);
     pkt->snr = (float)((int8_t)payload[HEADER_CMD_SIZE + EVT_MSG_RECEIVE__SNR]);
     pkt->rssi = (float)((int8_t)payload[HEADER_CMD_SIZE + EVT_MSG_RECEIVE__RSSI]);
     pkt->size = payload[HEADER_CMD_SIZE + EVT_MSG_RECEIVE__PAYLOAD_LEN];
-    memcpy(pkt->payload, payload + HEADER_CMD_SIZE + EVT_MSG_RECEIVE__PAYLOAD, pkt->size);
+    pkt->payload = payload + HEADER_CMD_SIZE + EVT_MSG_RECEIVE__PAYLOAD; /* still in the event frame */
 
 #if DEBUG_VERBOSE
     int i;
@@ -622,89 +595,363 @@ int decode_ack_write_register(const uint8_t * payload) {
     return 0;
 }
 
-/* -------------------------------------------------------------------------- */
-/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int mcu_open(const char * tty_path) {
-    int fd;
-    struct termios tty;
+void arena_reset(s_mcu * mcu) {
+    mcu->arena_head = 0;
+    mcu->arena_tail = 0;
+    mcu->arena_fill = 0;
+    mcu->arena_wrapped = false;
+}
 
-    fd = open(tty_path, O_RDWR | O_NOCTTY | O_SYNC);
-    if (fd == -1) {
-        perror("ERROR: Unable to open tty_path - ");
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+size_t arena_room(s_mcu * mcu) {
+    /* Biggest payload that can be stored, after the head or at the beginning of the arena */
+    if (mcu->arena_wrapped == false) {
+        return MAX(LGW_RX_ARENA_SIZE - mcu->arena_head, mcu->arena_tail);
+    } else {
+        return mcu->arena_tail - mcu->arena_head;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int arena_store(s_mcu * mcu, struct lgw_pkt_rx_ref_s * pkt) {
+    size_t offset;
+    size_t size = ARENA_SLOT_SIZE(pkt->size);
+
+    /* Get contiguous room for the payload, after the head or wrapping to the beginning of the arena */
+    if (mcu->arena_wrapped == false) {
+        if (size <= (LGW_RX_ARENA_SIZE - mcu->arena_head)) {
+            offset = mcu->arena_head;
+        } else if (size <= mcu->arena_tail) {
+            mcu->arena_fill += LGW_RX_ARENA_SIZE - mcu->arena_head;
+            mcu->arena_wrapped = true;
+            offset = 0;
+        } else {
+            return -1;
+        }
+    } else if (size <= (mcu->arena_tail - mcu->arena_head)) {
+        offset = mcu->arena_head;
     } else {
-        memset(&tty, 0, sizeof tty);
+        return -1;
+    }
+
+    memcpy(&mcu->rx_arena[offset], pkt->payload, pkt->size);
+    pkt->payload = &mcu->rx_arena[offset];
+    mcu->arena_head = offset + size;
+    mcu->arena_fill += size;
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int store_rx_pkt(s_mcu * mcu, const uint8_t * evt, struct lgw_pkt_rx_ref_s * pkt) {
+    if (decode_evt_msg_received(evt, pkt) != 0) {
+        printf("ERROR: invalid EVT_MSG_RECEIVED evt\n");
+        return -1;
+    }
+
+    if (arena_store(mcu, pkt) != 0) {
+        printf("WARNING: dropping packet, RX arena is full (%zu bytes in use), packets not released ?\n", mcu->arena_fill);
+        return 1;
+    }
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int read_rx_msg(s_mcu * mcu, uint8_t id, uint8_t max_pkt, struct lgw_pkt_rx_ref_s * pkt, uint8_t * nb_pkt, s_rx_msg * info) {
+    uint8_t buf_ack[MCU_READ_SIZE_MAX];
+    s_rx_msg rx_msg;
+    int i, x;
+
+    *nb_pkt = 0;
+
+    if (read_ack(mcu, id, buf_ack, sizeof buf_ack) < 0) {
+        printf("ERROR: failed to read GET_RX_MSG ack\n");
+        return -1;
+    }
+
+    if (decode_ack_get_rx_msg(buf_ack, &rx_msg) != 0) {
+        printf("ERROR: invalid GET_RX_MSG ack\n");
+        return -1;
+    }
 
-        /* Get current attributes */
-        if (tcgetattr(fd, &tty) != 0) {
-            printf("ERROR: tcgetattr failed with %d - %s", errno, strerror(errno));
+    if (rx_msg.lost_message > 0) {
+        printf("WARNING: %u packets lost\n", rx_msg.lost_message);
+    }
+
+    /* Get packets one by one */
+    for (i = 0; i < rx_msg.nb_msg; i++) {
+        if (com_read_evt(&mcu->com, ORDER_ID__EVT_MSG_RECEIVE, true, buf_ack, sizeof buf_ack) < 0) {
+            printf("ERROR: failed to read EVT_MSG_RECEIVED\n");
             return -1;
         }
 
-        cfsetospeed(&tty, 115200);
-        cfsetispeed(&tty, 115200);
-
-        /* Control Modes */
-        tty.c_cflag = (tty.c_cflag & ~CSIZE) | CS8; /* set 8-bit characters */
-        tty.c_cflag |= CLOCAL;                      /* local connection, no modem control */
-        tty.c_cflag |= CREAD;                       /* enable receiving characters */
-        tty.c_cflag &= ~PARENB;                     /* no parity */
-        tty.c_cflag &= ~CSTOPB;                     /* one stop bit */
-        /* Input Modes */
-        tty.c_iflag &= ~IGNBRK;
-        tty.c_iflag &= ~(IXON | IXOFF | IXANY | ICRNL);
-        /* Output Modes */
-        tty.c_oflag &= ~IGNBRK;
-        tty.c_oflag &= ~(IXON | IXOFF | IXANY | ICRNL);
-        /* Local Modes */
-        tty.c_lflag = 0;
-        /* Settings for non-canonical mode */
-        /* set blocking mode, need at least n char to return */
-        tty.c_cc[VMIN] = HEADER_CMD_SIZE;   /* x bytes minimum for full message header */
-        tty.c_cc[VTIME] = 1;                /* 100ms */
-
-        /* set attributes */
-        if (tcsetattr(fd, TCSANOW, &tty) != 0) {
-            DEBUG_PRINTF("ERROR: tcsetattr(TCSANOW) failed with %d - %s", errno, strerror(errno));
+        /* Drop packets that cannot be stored in given buffer */
+        if (*nb_pkt >= max_pkt) {
+            printf("WARNING: dropping packet, not enough room in buffer to store it\n");
+            continue;
+        }
+
+        /* Store packet in given array, and its payload in the arena */
+        x = store_rx_pkt(mcu, buf_ack, &pkt[*nb_pkt]);
+        if (x < 0) {
             return -1;
+        } else if (x == 0) {
+            *nb_pkt += 1;
         }
+    }
 
-        /* flush input/ouput queues */
-        wait_ms(100);
-        if (tcflush(fd, TCIOFLUSH) != 0) {
-            DEBUG_PRINTF("ERROR: tcflush failed with %d - %s", errno, strerror(errno));
+    /* Let the caller fetch the pending messages and count the lost ones */
+    if (info != NULL) {
+        *info = rx_msg;
+    }
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int ms_since(const struct timespec * start) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int)(((now.tv_sec - start->tv_sec) * 1000) + ((now.tv_nsec - start->tv_nsec) / 1000000));
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Drop what the MCU may still be sending from a previous session, until the port is quiet */
+static void drain_port(int fd) {
+    struct pollfd pfd;
+    struct timespec start;
+    uint8_t buf[64];
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    do {
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, OPEN_QUIET_MS) <= 0) {
+            return;
+        }
+        if (read(fd, buf, sizeof buf) <= 0) {
+            return;
+        }
+    } while (ms_since(&start) < OPEN_DRAIN_MS_MAX);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* The MCU answers requests in order, a PING is answered once it is done with the previous ones */
+static int wait_ready(s_mcu * mcu) {
+    uint8_t buf_ack[MCU_READ_SIZE_MAX];
+    s_ping_info info;
+    struct timespec start;
+    uint8_t id;
+    int left_ms;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (1) {
+        /* Each PING only waits for what is left of the budget */
+        left_ms = READY_TIMEOUT_MS - ms_since(&start);
+        if (left_ms <= 0) {
+            printf("ERROR: MCU not ready after %d ms\n", READY_TIMEOUT_MS);
             return -1;
         }
+        if ((mcu->com.timeout_ms > 0) && (mcu->com.timeout_ms < left_ms)) {
+            left_ms = mcu->com.timeout_ms;
+        }
+        if ((write_req(mcu, ORDER_ID__REQ_PING, 0, NULL, &id) == 0) &&
+            (read_ack_timeout(mcu, id, buf_ack, sizeof buf_ack, left_ms) >= 0) &&
+            (decode_ack_ping(buf_ack, &info) == 0)) {
+            return 0;
+        }
+        wait_ms(READY_RETRY_MS);
     }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-    /* Initialize pseudo-randoml generator for request ID */
-    srand(0);
+/* A TX radio just reset may not be ready yet although the MCU answers, wait for it */
+static void wait_tx_ready(s_mcu * mcu) {
+    uint64_t now_us;
 
-    return fd;
+    now_us = host_time_us();
+    if (now_us < mcu->tx_ready_us) {
+        DEBUG_PRINTF("INFO: waiting %u us for the TX radio to get ready after reset\n", (unsigned)(mcu->tx_ready_us - now_us));
+        wait_ms((unsigned long)((mcu->tx_ready_us - now_us + 999) / 1000));
+    }
+    mcu->tx_ready_us = 0;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int mcu_close(int fd) {
-    return close(fd);
+/* Build the CONFIG_RX request of a channel */
+static int encode_req_config_rx(s_mcu * mcu, uint8_t channel, const struct lgw_conf_channel_rx_s * conf, uint8_t * buf_req) {
+    uint16_t preamble_length;
+
+    /* Check params */
+    CHECK_NULL(conf);
+    if (channel >= mcu->nb_radio_rx) {
+        printf("ERROR: cannot configure channel %u, not enough radios available (%u)\n", channel, mcu->nb_radio_rx);
+        return -1;
+    }
+    if ((conf->sync_word != LORA_SYNC_WORD_PRIVATE) && (conf->sync_word != LORA_SYNC_WORD_PUBLIC)) {
+        printf("ERROR: invlid sync_word for channel %u\n", channel);
+        return -1;
+    }
+    // TODO: check all params
+
+    buf_req[REQ_CONF_RX__RADIO_IDX] = channel;
+
+    buf_req[REQ_CONF_RX__FREQ_31_24] = (uint8_t)(conf->freq_hz >> 24);
+    buf_req[REQ_CONF_RX__FREQ_23_16] = (uint8_t)(conf->freq_hz >> 16);
+    buf_req[REQ_CONF_RX__FREQ_15_8]  = (uint8_t)(conf->freq_hz >> 8);
+    buf_req[REQ_CONF_RX__FREQ_7_0]   = (uint8_t)(conf->freq_hz >> 0);
+
+    preamble_length = ((conf->datarate == DR_LORA_SF5) || (conf->datarate == DR_LORA_SF6)) ? HDR_LORA_PREAMBLE : STD_LORA_PREAMBLE;
+    buf_req[REQ_CONF_RX__PREAMBLE_LEN_15_8] = (uint8_t)(preamble_length >> 8);
+    buf_req[REQ_CONF_RX__PREAMBLE_LEN_7_0]  = (uint8_t)(preamble_length >> 0);
+
+    buf_req[REQ_CONF_RX__SF] = (uint8_t)(conf->datarate);
+
+    buf_req[REQ_CONF_RX__BW] = (uint8_t)(conf->bandwidth);
+
+    buf_req[REQ_CONF_RX__USE_IQ_INVERTED] = 0;
+
+    buf_req[REQ_CONF_RX__SYNC_WORD] = conf->sync_word;
+
+    return 0;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int mcu_get_status(int fd, s_status * status) {
+static int open_tty(s_mcu * mcu, const char * tty_path, bool drain) {
+    int fd;
+    struct termios tty;
+
+    CHECK_NULL(mcu);
+
+    /* Start without frames and packets left over from a previous session */
+    com_init(&mcu->com);
+    mcu->nb_radio_rx = 0;
+    mcu->nb_radio_tx = 0;
+    mcu->tx_ready_us = 0;
+    arena_reset(mcu);
+    memset(mcu->rtt, 0, sizeof mcu->rtt);
+
+    fd = open(tty_path, O_RDWR | O_NOCTTY | O_SYNC);
+    if (fd == -1) {
+        perror("ERROR: Unable to open tty_path - ");
+        return -1;
+    }
+    memset(&tty, 0, sizeof tty);
+
+    /* Get current attributes */
+    if (tcgetattr(fd, &tty) != 0) {
+        printf("ERROR: tcgetattr failed with %d - %s", errno, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    cfsetospeed(&tty, 115200);
+    cfsetispeed(&tty, 115200);
+
+    /* Control Modes */
+    tty.c_cflag = (tty.c_cflag & ~CSIZE) | CS8; /* set 8-bit characters */
+    tty.c_cflag |= CLOCAL;                      /* local connection, no modem control */
+    tty.c_cflag |= CREAD;                       /* enable receiving characters */
+    tty.c_cflag &= ~PARENB;                     /* no parity */
+    tty.c_cflag &= ~CSTOPB;                     /* one stop bit */
+    /* Input Modes */
+    tty.c_iflag &= ~IGNBRK;
+    tty.c_iflag &= ~(IXON | IXOFF | IXANY | ICRNL);
+    /* Output Modes */
+    tty.c_oflag &= ~IGNBRK;
+    tty.c_oflag &= ~(IXON | IXOFF | IXANY | ICRNL);
+    /* Local Modes */
+    tty.c_lflag = 0;
+    /* Settings for non-canonical mode */
+    /* read returns whatever is available, waiting for data is done with poll (see loragw_com) */
+    tty.c_cc[VMIN] = 0;
+    tty.c_cc[VTIME] = 0;
+
+    /* set attributes */
+    if (tcsetattr(fd, TCSANOW, &tty) != 0) {
+        DEBUG_PRINTF("ERROR: tcsetattr(TCSANOW) failed with %d - %s", errno, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    /* flush input/ouput queues */
+    if (drain == false) {
+        wait_ms(100);
+    }
+    if (tcflush(fd, TCIOFLUSH) != 0) {
+        DEBUG_PRINTF("ERROR: tcflush failed with %d - %s", errno, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    if (drain == true) {
+        drain_port(fd);
+    }
+
+    mcu->com.fd = fd;
+
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int mcu_open(s_mcu * mcu, const char * tty_path) {
+    return open_tty(mcu, tty_path, false);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int mcu_open_fast(s_mcu * mcu, const char * tty_path) {
+    return open_tty(mcu, tty_path, true);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int mcu_close(s_mcu * mcu) {
+    int x;
+
+    CHECK_NULL(mcu);
+
+    x = close(mcu->com.fd);
+    mcu->com.fd = -1;
+
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int mcu_get_status(s_mcu * mcu, s_status * status) {
+    uint8_t buf_ack[MCU_READ_SIZE_MAX];
+    uint8_t id;
+
     CHECK_NULL(status);
 
-    if (write_req(fd, ORDER_ID__REQ_GET_STATUS, 0, NULL) != 0) {
+    if (write_req(mcu, ORDER_ID__REQ_GET_STATUS, 0, NULL, &id) != 0) {
         printf("ERROR: failed to write GET_STATUS request\n");
         return -1;
     }
 
-    if (read_ack(fd, buf_ack, sizeof buf_ack) < 0) {
+    if (read_ack(mcu, id, buf_ack, sizeof buf_ack) < 0) {
         printf("ERROR: failed to read GET_STATUS ack\n");
         return -1;
     }
 
-    if (decode_ack_get_status(buf_ack, status) != 0) {
+    if (decode_ack_get_status(buf_ack, mcu->nb_radio_rx, status) != 0) {
         printf("ERROR: invalid GET_STATUS ack\n");
         return -1;
     }
@@ -714,15 +961,18 @@ int mcu_get_status(int fd, s_status * status) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int mcu_get_tx_status(int fd, e_tx_msg_status * status) {
+int mcu_get_tx_status(s_mcu * mcu, e_tx_msg_status * status) {
+    uint8_t buf_ack[MCU_READ_SIZE_MAX];
+    uint8_t id;
+
     CHECK_NULL(status);
 
-    if (write_req(fd, ORDER_ID__REQ_GET_TX_STATUS, 0, NULL) != 0) {
+    if (write_req(mcu, ORDER_ID__REQ_GET_TX_STATUS, 0, NULL, &id) != 0) {
         printf("ERROR: failed to write GET_TX_STATUS request\n");
         return -1;
     }
 
-    if (read_ack(fd, buf_ack, sizeof buf_ack) < 0) {
+    if (read_ack(mcu, id, buf_ack, sizeof buf_ack) < 0) {
         printf("ERROR: failed to read GET_TX_STATUS ack\n");
         return -1;
     }
@@ -737,15 +987,18 @@ int mcu_get_tx_status(int fd, e_tx_msg_status * status) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int mcu_ping(int fd, s_ping_info * info) {
+int mcu_ping(s_mcu * mcu, s_ping_info * info) {
+    uint8_t buf_ack[MCU_READ_SIZE_MAX];
+    uint8_t id;
+
     CHECK_NULL(info);
 
-    if (write_req(fd, ORDER_ID__REQ_PING, 0, NULL) != 0) {
+    if (write_req(mcu, ORDER_ID__REQ_PING, 0, NULL, &id) != 0) {
         printf("ERROR: failed to write PING request\n");
         return -1;
     }
 
-    if (read_ack(fd, buf_ack, sizeof buf_ack) < 0) {
+    if (read_ack(mcu, id, buf_ack, sizeof buf_ack) < 0) {
         printf("ERROR: failed to read PING ack\n");
         return -1;
     }
@@ -755,12 +1008,19 @@ int mcu_ping(int fd, s_ping_info * info) {
         return -1;
     }
 
+    /* store local context */
+    mcu->nb_radio_rx = info->nb_radio_rx;
+    mcu->nb_radio_tx = info->nb_radio_tx;
+
     return 0;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int mcu_prepare_tx(int fd, const struct lgw_pkt_tx_s * pkt_data, bool blocking) {
+int mcu_prepare_tx(s_mcu * mcu, const struct lgw_pkt_tx_s * pkt_data, bool blocking) {
+    uint8_t buf_req[MCU_WRITE_SIZE_MAX];
+    uint8_t buf_ack[MCU_READ_SIZE_MAX];
+    uint8_t id;
     e_prepare_tx_status tx_prepare_status;
     e_tx_msg_status tx_status;
     bool tx_complete = false;
@@ -769,10 +1029,11 @@ int mcu_prepare_tx(int fd, const struct lgw_pkt_tx_s * pkt_data, bool blocking)
     if (pkt_data == NULL) {
         return -1;
     }
-    if (nb_radio_tx < 1) {
+    if (mcu->nb_radio_tx < 1) {
         printf("ERROR: cannot prepare tx, no radio available\n");
         return -1;
     }
+    wait_tx_ready(mcu);
 
     /* Trigger type */
     buf_req[REQ_PREPARE_TX__MSG_IS_TIMESTAMP] = (uint8_t)pkt_data->tx_mode;
@@ -852,13 +1113,13 @@ int mcu_prepare_tx(int fd, const struct lgw_pkt_tx_s * pkt_data, bool blocking)
     memcpy(&buf_req[REQ_PREPARE_TX__PAYLOAD], pkt_data->payload, pkt_data->size);
 
     /* Send TX request */
-    if (write_req(fd, ORDER_ID__REQ_PREPARE_TX, (uint16_t)REQ_PREPARE_TX__PAYLOAD + pkt_data->size, buf_req) != 0) {
+    if (write_req(mcu, ORDER_ID__REQ_PREPARE_TX, (uint16_t)REQ_PREPARE_TX__PAYLOAD + pkt_data->size, buf_req, &id) != 0) {
         printf("ERROR: failed to write PREPARE_TX request\n");
         return -1;
     }
 
     /* Wait for ACK */
-    if (read_ack(fd, buf_ack, sizeof buf_ack) < 0) {
+    if (read_ack(mcu, id, buf_ack, sizeof buf_ack) < 0) {
         printf("ERROR: failed to read PREPARE_TX ack\n");
         return -1;
     }
@@ -876,12 +1137,12 @@ int mcu_prepare_tx(int fd, const struct lgw_pkt_tx_s * pkt_data, bool blocking)
     /* Wait for TX to be done if requested */
     if (blocking == true) {
         do {
-            if (write_req(fd, ORDER_ID__REQ_GET_TX_STATUS, 0, NULL) != 0) {
+            if (write_req(mcu, ORDER_ID__REQ_GET_TX_STATUS, 0, NULL, &id) != 0) {
                 printf("ERROR: failed to write GET_TX_STATUS request\n");
                 return -1;
             }
 
-            if (read_ack(fd, buf_ack, sizeof buf_ack) < 0) {
+            if (read_ack(mcu, id, buf_ack, sizeof buf_ack) < 0) {
                 printf("ERROR: failed to read GET_TX_STATUS ack\n");
                 return -1;
             }
@@ -906,51 +1167,24 @@ int mcu_prepare_tx(int fd, const struct lgw_pkt_tx_s * pkt_data, bool blocking)
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int mcu_config_rx(int fd, uint8_t channel, const struct lgw_conf_channel_rx_s * conf) {
+int mcu_config_rx(s_mcu * mcu, uint8_t channel, const struct lgw_conf_channel_rx_s * conf) {
+    uint8_t buf_req[MCU_WRITE_SIZE_MAX];
+    uint8_t buf_ack[MCU_READ_SIZE_MAX];
+    uint8_t id;
     e_config_rx_status config_rx_status;
-    uint16_t preamble_length;
 
-    /* Check params */
-    if (conf == NULL) {
-        return -1;
-    }
-    if (channel >= nb_radio_rx) {
-        printf("ERROR: cannot configure channel %u, not enough radios available (%u)\n", channel, nb_radio_rx);
-        return -1;
-    }
-    if ((conf->sync_word != LORA_SYNC_WORD_PRIVATE) && (conf->sync_word != LORA_SYNC_WORD_PUBLIC)) {
-        printf("ERROR: invlid sync_word for channel %u\n", channel);
+    if (encode_req_config_rx(mcu, channel, conf, buf_req) != 0) {
         return -1;
     }
-    // TODO: check all params
-
-    buf_req[REQ_CONF_RX__RADIO_IDX] = channel;
-
-    buf_req[REQ_CONF_RX__FREQ_31_24] = (uint8_t)(conf->freq_hz >> 24);
-    buf_req[REQ_CONF_RX__FREQ_23_16] = (uint8_t)(conf->freq_hz >> 16);
-    buf_req[REQ_CONF_RX__FREQ_15_8]  = (uint8_t)(conf->freq_hz >> 8);
-    buf_req[REQ_CONF_RX__FREQ_7_0]   = (uint8_t)(conf->freq_hz >> 0);
-
-    preamble_length = ((conf->datarate == DR_LORA_SF5) || (conf->datarate == DR_LORA_SF6)) ? HDR_LORA_PREAMBLE : STD_LORA_PREAMBLE;
-    buf_req[REQ_CONF_RX__PREAMBLE_LEN_15_8] = (uint8_t)(preamble_length >> 8);
-    buf_req[REQ_CONF_RX__PREAMBLE_LEN_7_0]  = (uint8_t)(preamble_length >> 0);
-
-    buf_req[REQ_CONF_RX__SF] = (uint8_t)(conf->datarate);
-
-    buf_req[REQ_CONF_RX__BW] = (uint8_t)(conf->bandwidth);
-
-    buf_req[REQ_CONF_RX__USE_IQ_INVERTED] = 0;
-
-    buf_req[REQ_CONF_RX__SYNC_WORD] = conf->sync_word;
 
     /* Send CONFIG_RX request */
-    if (write_req(fd, ORDER_ID__REQ_CONFIG_RX, REQ_CONF_RX_SIZE, buf_req) != 0) {
+    if (write_req(mcu, ORDER_ID__REQ_CONFIG_RX, REQ_CONF_RX_SIZE, buf_req, &id) != 0) {
         printf("ERROR: failed to write CONFIG_RX request\n");
         return -1;
     }
 
     /* Wait for ACK */
-    if (read_ack(fd, buf_ack, sizeof buf_ack) < 0) {
+    if (read_ack(mcu, id, buf_ack, sizeof buf_ack) < 0) {
         printf("ERROR: failed to read CONFIG_RX ack\n");
         return -1;
     }
@@ -970,62 +1204,197 @@ int mcu_config_rx(int fd, uint8_t channel, const struct lgw_conf_channel_rx_s *
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int mcu_receive(int fd, uint8_t max_pkt, struct lgw_pkt_rx_s * pkt, uint8_t * nb_pkt) {
-    s_rx_msg rx_msg;
+int mcu_config_rx_batch(s_mcu * mcu, const uint8_t * channels, int nb_channel, const struct lgw_conf_channel_rx_s * conf) {
+    uint8_t buf_req[COM_REQ_NB_MAX][MCU_WRITE_SIZE_MAX];
+    uint8_t buf_ack[MCU_READ_SIZE_MAX];
+    s_com_req reqs[COM_REQ_NB_MAX];
+    uint8_t todo[COM_REQ_NB_MAX];
+    int nb_todo, nb_failed;
+    e_config_rx_status config_rx_status;
+    struct timespec start;
     int i;
-    struct lgw_pkt_rx_s * p;
+
+    CHECK_NULL(channels);
+    CHECK_NULL(conf);
+    if ((nb_channel < 0) || (nb_channel > COM_REQ_NB_MAX)) {
+        printf("ERROR: invalid number of channels to configure (%d)\n", nb_channel);
+        return -1;
+    }
+
+    memcpy(todo, channels, nb_channel);
+    nb_todo = nb_channel;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (nb_todo > 0) {
+        /* All the requests in a single write, applied in order by the MCU */
+        for (i = 0; i < nb_todo; i++) {
+            if (encode_req_config_rx(mcu, todo[i], &conf[todo[i]], buf_req[i]) != 0) {
+                return -1;
+            }
+            reqs[i].cmd = ORDER_ID__REQ_CONFIG_RX;
+            reqs[i].size = REQ_CONF_RX_SIZE;
+            reqs[i].payload = buf_req[i];
+        }
+        if (write_reqs(mcu, reqs, nb_todo) != 0) {
+            printf("ERROR: failed to write CONFIG_RX requests\n");
+            return -1;
+        }
+
+        /* Radios still getting ready after a reset are retried, the others are done */
+        nb_failed = 0;
+        for (i = 0; i < nb_todo; i++) {
+            if (read_ack(mcu, reqs[i].id, buf_ack, sizeof buf_ack) < 0) {
+                printf("ERROR: failed to read CONFIG_RX ack\n");
+                return -1;
+            }
+            if (decode_ack_config_rx(buf_ack, &config_rx_status) != 0) {
+                printf("ERROR: invalid CONFIG_RX ack\n");
+                return -1;
+            }
+            if (config_rx_status == CONFIG_RX_SATUS__ERROR_FAILED) {
+                todo[nb_failed] = todo[i];
+                nb_failed += 1;
+            } else if (config_rx_status != CONFIG_RX_SATUS__DONE) {
+                printf("ERROR: CONFIG_RX of channel %u rejected with 0x%02X\n", todo[i], config_rx_status);
+                return -1;
+            }
+        }
+        nb_todo = nb_failed;
+        if ((nb_todo > 0) && (ms_since(&start) >= READY_TIMEOUT_MS)) {
+            printf("ERROR: CONFIG_RX of channel %u still failing after %d ms\n", todo[0], READY_TIMEOUT_MS);
+            return -1;
+        }
+        if (nb_todo > 0) {
+            wait_ms(READY_RETRY_MS);
+        }
+    }
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int mcu_receive(s_mcu * mcu, uint8_t max_pkt, struct lgw_pkt_rx_ref_s * pkt, uint8_t * nb_pkt, s_rx_msg * info) {
+    uint8_t id;
 
     /* Check params */
     CHECK_NULL(pkt)
     CHECK_NULL(nb_pkt);
 
-    *nb_pkt = 0;
-
     /* Check if there are packets received */
-    if (write_req(fd, ORDER_ID__REQ_GET_RX_MSG, 0, NULL) != 0) {
+    if (write_req(mcu, ORDER_ID__REQ_GET_RX_MSG, 0, NULL, &id) != 0) {
         printf("ERROR: failed to write GET_RX_MSG request\n");
         return -1;
     }
 
-    if (read_ack(fd, buf_ack, sizeof buf_ack) < 0) {
-        printf("ERROR: failed to read GET_RX_MSG ack\n");
+    return read_rx_msg(mcu, id, max_pkt, pkt, nb_pkt, info);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int mcu_receive_status(s_mcu * mcu, uint8_t max_pkt, struct lgw_pkt_rx_ref_s * pkt, uint8_t * nb_pkt, s_rx_msg * info, s_status * status, struct timespec * status_time) {
+    uint8_t buf_ack[MCU_READ_SIZE_MAX];
+    s_com_req reqs[2];
+
+    /* Check params */
+    CHECK_NULL(pkt)
+    CHECK_NULL(nb_pkt);
+    CHECK_NULL(status);
+
+    /* Pipeline both requests in a single write, status first to get a precise
+    time reference before the RX messages are transferred */
+    reqs[0].cmd = ORDER_ID__REQ_GET_STATUS;
+    reqs[0].size = 0;
+    reqs[0].payload = NULL;
+    reqs[1].cmd = ORDER_ID__REQ_GET_RX_MSG;
+    reqs[1].size = 0;
+    reqs[1].payload = NULL;
+    if (write_reqs(mcu, reqs, 2) != 0) {
+        printf("ERROR: failed to write GET_STATUS + GET_RX_MSG requests\n");
         return -1;
     }
 
-    if (decode_ack_get_rx_msg(buf_ack, &rx_msg) != 0) {
-        printf("ERROR: invalid GET_RX_MSG ack\n");
+    if (read_ack(mcu, reqs[0].id, buf_ack, sizeof buf_ack) < 0) {
+        printf("ERROR: failed to read GET_STATUS ack\n");
         return -1;
     }
+    if (status_time != NULL) {
+        clock_gettime(CLOCK_MONOTONIC, status_time);
+    }
 
-    if (rx_msg.lost_message > 0) {
-        printf("WARNING: %u packets lost\n", rx_msg.lost_message);
+    if (decode_ack_get_status(buf_ack, mcu->nb_radio_rx, status) != 0) {
+        printf("ERROR: invalid GET_STATUS ack\n");
+        return -1;
     }
 
-    /* Get packets one by one */
-    for (i = 0; i < rx_msg.nb_msg; i++) {
-        if (read_ack(fd, buf_ack, sizeof buf_ack) < 0) {
+    return read_rx_msg(mcu, reqs[1].id, max_pkt, pkt, nb_pkt, info);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int mcu_receive_evt(s_mcu * mcu, uint8_t max_pkt, struct lgw_pkt_rx_ref_s * pkt, uint8_t * nb_pkt) {
+    uint8_t buf_ack[MCU_READ_SIZE_MAX];
+    int n, x;
+
+    /* Check params */
+    CHECK_NULL(pkt);
+    CHECK_NULL(nb_pkt);
+
+    *nb_pkt = 0;
+
+    /* Get the RX events already queued or available on the com port, up to
+    max_pkt packets, as long as the arena can store them (the others are kept
+    queued) */
+    while ((*nb_pkt < max_pkt) && (arena_room(mcu) >= RX_PAYLOAD_SIZE_MAX)) {
+        n = com_read_evt(&mcu->com, ORDER_ID__EVT_MSG_RECEIVE, false, buf_ack, sizeof buf_ack);
+        if (n < 0) {
             printf("ERROR: failed to read EVT_MSG_RECEIVED\n");
             return -1;
+        } else if (n == 0) {
+            break; /* nothing more to read */
         }
 
-        /* Drop packets that cannot be stored in given buffer */
-        if (i >= max_pkt) {
-            printf("WARNING: dropping packet, not enough room in buffer to store it\n");
-            continue;
-        }
-
-        /* Store packet in given array */
-        p = &pkt[i];
-        if (decode_evt_msg_received(buf_ack, p) != 0) {
-            printf("ERROR: invalid EVT_MSG_RECEIVED evt\n");
+        x = store_rx_pkt(mcu, buf_ack, &pkt[*nb_pkt]);
+        if (x < 0) {
             return -1;
+        } else if (x == 0) {
+            *nb_pkt += 1;
         }
+    }
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int mcu_release_rx(s_mcu * mcu, const struct lgw_pkt_rx_ref_s * pkt) {
+    size_t start, end;
+
+    CHECK_NULL(pkt);
+
+    if ((pkt->payload < mcu->rx_arena) || (pkt->payload > &mcu->rx_arena[LGW_RX_ARENA_SIZE])) {
+        printf("ERROR: packet payload is not in the RX arena\n");
+        return -1;
+    }
+    if (mcu->arena_fill == 0) {
+        return 0; /* already released */
+    }
 
-        *nb_pkt += 1;
+    /* Release everything up to the end of that payload, including the space
+    skipped when wrapping if the payload was stored after the wrap */
+    start = (size_t)(pkt->payload - mcu->rx_arena);
+    end = start + ARENA_SLOT_SIZE(pkt->size);
+    if ((mcu->arena_wrapped == true) && (start < mcu->arena_tail)) {
+        mcu->arena_fill -= (LGW_RX_ARENA_SIZE - mcu->arena_tail) + end;
+        mcu->arena_wrapped = false;
+    } else if (end >= mcu->arena_tail) {
+        mcu->arena_fill -= end - mcu->arena_tail;
+    } else {
+        return 0; /* already released */
     }
+    mcu->arena_tail = end;
 
-    if (rx_msg.pending != 0) {
-        printf("INFO: there are pending messages\n"); /* TODO: let the application call back to get the pending packets or automatically do it here ? */
+    if (mcu->arena_fill == 0) {
+        arena_reset(mcu);
     }
 
     return 0;
@@ -1033,17 +1402,55 @@ int mcu_receive(int fd, uint8_t max_pkt, struct lgw_pkt_rx_s * pkt, uint8_t * nb
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int mcu_reset(int fd, e_reset_type reset_type) {
+int mcu_receive_tx_evt(s_mcu * mcu, e_tx_msg_status * status) {
+    uint8_t buf_ack[MCU_READ_SIZE_MAX];
+    int n;
+
+    CHECK_NULL(status);
+
+    /* Only look at the events already received, the com port is read by the RX path */
+    if (com_get_nb_evt(&mcu->com) == 0) {
+        return 0;
+    }
+
+    n = com_read_evt(&mcu->com, ORDER_ID__EVT_TX_STATUS, false, buf_ack, sizeof buf_ack);
+    if (n < 0) {
+        printf("ERROR: failed to read EVT_TX_STATUS\n");
+        return -1;
+    } else if (n == 0) {
+        return 0;
+    }
+
+    if (decode_ack_tx_status(buf_ack, status) != 0) {
+        printf("ERROR: invalid EVT_TX_STATUS evt\n");
+        return -1;
+    }
+
+    return 1;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int mcu_wait_event(s_mcu * mcu, int timeout_ms) {
+    return com_wait(&mcu->com, timeout_ms);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int mcu_reset(s_mcu * mcu, e_reset_type reset_type) {
+    uint8_t buf_req[MCU_WRITE_SIZE_MAX];
+    uint8_t buf_ack[MCU_READ_SIZE_MAX];
+    uint8_t id;
     uint8_t status;
 
     /* Reset selected element (RX, TX, MCU...) */
     buf_req[REQ_RESET__TYPE] = reset_type;
-    if (write_req(fd, ORDER_ID__REQ_RESET, REQ_RESET_SIZE, buf_req) != 0) {
+    if (write_req(mcu, ORDER_ID__REQ_RESET, REQ_RESET_SIZE, buf_req, &id) != 0) {
         printf("ERROR: failed to write RESET request\n");
         return -1;
     }
 
-    if (read_ack(fd, buf_ack, sizeof buf_ack) < 0) {
+    if (read_ack(mcu, id, buf_ack, sizeof buf_ack) < 0) {
         printf("ERROR: failed to read RESET ack\n");
         return -1;
     }
@@ -1066,13 +1473,69 @@ int mcu_reset(int fd, e_reset_type reset_type) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int mcu_boot(int fd) {
-    if (write_req(fd, ORDER_ID__REQ_BOOTLOADER_MODE, 0, NULL) != 0) {
+int mcu_reset_batch(s_mcu * mcu, const e_reset_type * reset_types, int nb_reset) {
+    uint8_t buf_req[COM_REQ_NB_MAX][REQ_RESET_SIZE];
+    uint8_t buf_ack[MCU_READ_SIZE_MAX];
+    s_com_req reqs[COM_REQ_NB_MAX];
+    uint8_t status;
+    int i;
+
+    CHECK_NULL(reset_types);
+    if ((nb_reset < 1) || (nb_reset > COM_REQ_NB_MAX)) {
+        printf("ERROR: invalid number of resets (%d)\n", nb_reset);
+        return -1;
+    }
+
+    /* All the resets in a single write */
+    for (i = 0; i < nb_reset; i++) {
+        buf_req[i][REQ_RESET__TYPE] = reset_types[i];
+        reqs[i].cmd = ORDER_ID__REQ_RESET;
+        reqs[i].size = REQ_RESET_SIZE;
+        reqs[i].payload = buf_req[i];
+    }
+    if (write_reqs(mcu, reqs, nb_reset) != 0) {
+        printf("ERROR: failed to write RESET requests\n");
+        return -1;
+    }
+
+    for (i = 0; i < nb_reset; i++) {
+        if (read_ack(mcu, reqs[i].id, buf_ack, sizeof buf_ack) < 0) {
+            printf("ERROR: failed to read RESET ack\n");
+            return -1;
+        }
+        if (decode_ack_reset(buf_ack, &status) != 0) {
+            printf("ERROR: invalid RESET ack\n");
+            return -1;
+        }
+        if (status != 0) {
+            printf("ERROR: Failed to reset element %u\n", reset_types[i]);
+            return -1;
+        }
+    }
+
+    /* The TX radio gets the fixed wait before its first request only, see wait_tx_ready */
+    for (i = 0; i < nb_reset; i++) {
+        if (reset_types[i] == RESET_TYPE__TX) {
+            mcu->tx_ready_us = host_time_us() + TX_RESET_SETTLE_US;
+        }
+    }
+
+    /* Poll the MCU instead of waiting a fixed time for it to get ready */
+    return wait_ready(mcu);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int mcu_boot(s_mcu * mcu) {
+    uint8_t buf_ack[MCU_READ_SIZE_MAX];
+    uint8_t id;
+
+    if (write_req(mcu, ORDER_ID__REQ_BOOTLOADER_MODE, 0, NULL, &id) != 0) {
         printf("ERROR: failed to write BOOTLOADER_MODE request\n");
         return -1;
     }
 
-    if (read_ack(fd, buf_ack, sizeof buf_ack) < 0) {
+    if (read_ack(mcu, id, buf_ack, sizeof buf_ack) < 0) {
         printf("ERROR: failed to read BOOTLOADER_MODE ack\n");
         return -1;
     }
@@ -1087,19 +1550,23 @@ int mcu_boot(int fd) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int mcu_read_register(int fd, uint8_t radio_idx, uint16_t addr, uint8_t * value) {
+int mcu_read_register(s_mcu * mcu, uint8_t radio_idx, uint16_t addr, uint8_t * value) {
+    uint8_t buf_req[MCU_WRITE_SIZE_MAX];
+    uint8_t buf_ack[MCU_READ_SIZE_MAX];
+    uint8_t id;
+
     CHECK_NULL(value);
 
     buf_req[REQ_READ_REGS__RADIO_IDX] = radio_idx;
     buf_req[REQ_READ_REGS__ADDR_15_8] = (uint8_t)(addr >> 8);
     buf_req[REQ_READ_REGS__ADDR_7_0]  = (uint8_t)(addr >> 0);
 
-    if (write_req(fd, ORDER_ID__REQ_READ_REGS, REQ_READ_REGS_SIZE, buf_req) != 0) {
+    if (write_req(mcu, ORDER_ID__REQ_READ_REGS, REQ_READ_REGS_SIZE, buf_req, &id) != 0) {
         printf("ERROR: failed to write REQ_READ_REGS request\n");
         return -1;
     }
 
-    if (read_ack(fd, buf_ack, sizeof buf_ack) < 0) {
+    if (read_ack(mcu, id, buf_ack, sizeof buf_ack) < 0) {
         printf("ERROR: failed to read REQ_READ_REGS ack\n");
         return -1;
     }
@@ -1114,18 +1581,22 @@ int mcu_read_register(int fd, uint8_t radio_idx, uint16_t addr, uint8_t * value)
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int mcu_write_register(int fd, uint8_t radio_idx, uint16_t addr, const uint8_t value) {
+int mcu_write_register(s_mcu * mcu, uint8_t radio_idx, uint16_t addr, const uint8_t value) {
+    uint8_t buf_req[MCU_WRITE_SIZE_MAX];
+    uint8_t buf_ack[MCU_READ_SIZE_MAX];
+    uint8_t id;
+
     buf_req[REQ_WRITE_REGS__RADIO_IDX] = radio_idx;
     buf_req[REQ_WRITE_REGS__ADDR_15_8] = (uint8_t)(addr >> 8);
     buf_req[REQ_WRITE_REGS__ADDR_7_0]  = (uint8_t)(addr >> 0);
     buf_req[REQ_WRITE_REGS__DATA] = value;
 
-    if (write_req(fd, ORDER_ID__REQ_WRITE_REGS, REQ_WRITE_REGS_SIZE, buf_req) != 0) {
+    if (write_req(mcu, ORDER_ID__REQ_WRITE_REGS, REQ_WRITE_REGS_SIZE, buf_req, &id) != 0) {
         printf("ERROR: failed to write REQ_WRITE_REGS request\n");
         return -1;
     }
 
-    if (read_ack(fd, buf_ack, sizeof buf_ack) < 0) {
+    if (read_ack(mcu, id, buf_ack, sizeof buf_ack) < 0) {
         printf("ERROR: failed to read REQ_WRITE_REGS ack\n");
         return -1;
     }
@@ -1140,14 +1611,28 @@ int mcu_write_register(int fd, uint8_t radio_idx, uint16_t addr, const uint8_t v
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-uint8_t mcu_get_nb_rx_radio(void) {
-    return nb_radio_rx;
+uint8_t mcu_get_nb_rx_radio(s_mcu * mcu) {
+    return mcu->nb_radio_rx;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+uint8_t mcu_get_nb_tx_radio(s_mcu * mcu) {
+    return mcu->nb_radio_tx;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-uint8_t mcu_get_nb_tx_radio(void) {
-    return nb_radio_tx;
+int mcu_get_rtt(s_mcu * mcu, uint8_t cmd, struct lgw_hist_s * rtt) {
+    CHECK_NULL(mcu);
+    CHECK_NULL(rtt);
+    if (cmd >= LGW_MCU_NB_REQ) {
+        return -1;
+    }
+
+    lgw_hist_collect(&mcu->rtt[cmd], rtt);
+
+    return 0;
 }
 
-/* --- EOF ------------------------------------------------------------------ */
\ No newline at end of file
+/* --- EOF ------------------------------------------------------------------ */
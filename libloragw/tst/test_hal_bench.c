@@ -0,0 +1,584 @@
+/*!
+ * \brief     Hardware-in-the-loop benchmark: start/stop time, RX throughput, TX
+ *            scheduling accuracy and MCU request round-trip times, written as
+ *            JSON or CSV to be compared across MCU firmwares and host platforms
+ *
+ * License: Revised BSD 3-Clause License, see LICENSE.TXT file include in the project
+ */
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf fprintf */
+#include <stdlib.h>     /* EXIT_FAILURE */
+#include <signal.h>     /* sigaction */
+#include <getopt.h>     /* getopt_long */
+#include <string.h>     /* strcmp */
+#include <time.h>       /* clock_gettime, time */
+#include <sys/utsname.h> /* uname */
+
+#include "loragw_hal.h"
+#include "loragw_aux.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define TTY_PATH_DEFAULT    "/dev/ttyACM0"
+#define OUT_PATH_DEFAULT    "hal_bench"     /* extension added according to the format */
+#define NB_PKT_MAX          8
+#define RX_WAIT_MS          100
+#define TX_LEAD_MS          50              /* TX scheduled that far after the current counter */
+#define TX_POLL_MS          1
+#define TX_TIMEOUT_MS       5000
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+/* Results writer, each result is a distribution or a single value */
+struct bench_out_s {
+    FILE * fd;
+    bool csv;
+    bool first;
+};
+
+/* TX done reported by the HAL callback */
+struct tx_report_s {
+    bool done;
+    e_tx_result result;
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+/* Signal handling variables */
+static int exit_sig = 0; /* 1 -> application terminates cleanly (shut down hardware, close open files, etc) */
+static int quit_sig = 0; /* 1 -> application terminates without shutting down the hardware */
+
+/* histograms are large, keep them off the stack */
+static struct lgw_hist_s hist_start;
+static struct lgw_hist_s hist_stop;
+static struct lgw_hist_s hist_fetch;
+static struct lgw_hist_s hist_send;
+static struct lgw_hist_s hist_tx_err;
+static struct lgw_hist_s hist_tx_done;
+static struct lgw_hist_s hist_rtt;
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
+
+static uint64_t monotonic_us(void);
+
+static void out_dist(struct bench_out_s * out, const char * section, const char * name, const char * unit, const struct lgw_hist_s * hist);
+
+static void out_value(struct bench_out_s * out, const char * section, const char * name, const char * unit, double value);
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* describe command line options */
+void usage(void) {
+    printf("Library version information: %s\n", lgw_version_info());
+    printf("Available options:\n");
+    printf(" -h print this help\n");
+    printf(" -d <path>  TTY device to be used to access the concentrator board\n");
+    printf("                      => default path: " TTY_PATH_DEFAULT "\n");
+    printf(" -f <float> LoRa channel frequency in MHz, ]2400..2500[\n");
+    printf(" -s <uint>  LoRa channel datarate [5..12]\n");
+    printf(" -b <uint>  LoRa channel bandwidth in khz [200, 400, 800, 1600]\n");
+    printf(" -o <path>  Results file, without extension (default: " OUT_PATH_DEFAULT ")\n");
+    printf( "~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n" );
+    printf(" --csv      Write the results as CSV instead of JSON\n");
+    printf(" --tag <string> Label of the run in the results (eg. MCU firmware build)\n");
+    printf(" --start <uint> Number of start/stop cycles measured (default 5)\n");
+    printf(" --rx <uint>    RX measurement duration in seconds, 0 to skip (default 10)\n");
+    printf(" --tx <uint>    Number of scheduled TX measured, 0 to skip (default 10)\n");
+    printf(" --pwr <int>    TX power in dBm (default 0)\n");
+    printf(" --event    Rely on RX events pushed by the MCU\n");
+    printf(" --fast     Use the fast_start board option\n");
+    printf("The TX accuracy is measured with the trigger counter, which requires the\n");
+    printf("TX indicator of the board to be wired to its PPS input.\n");
+}
+
+/* handle signals */
+static void sig_handler(int sigio)
+{
+    if (sigio == SIGQUIT) {
+        quit_sig = 1;
+    }
+    else if((sigio == SIGINT) || (sigio == SIGTERM)) {
+        exit_sig = 1;
+    }
+}
+
+static uint64_t monotonic_us(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1000000) + (now.tv_nsec / 1000);
+}
+
+static void tx_done(e_tx_result result, uint32_t count_us, void * arg) {
+    struct tx_report_s * report = (struct tx_report_s *)arg;
+
+    (void)count_us;
+    report->result = result;
+    report->done = true;
+}
+
+static void out_begin(struct bench_out_s * out, const char * tag) {
+    struct utsname host;
+    uint64_t eui = 0;
+    char date[32];
+    time_t t;
+
+    t = time(NULL);
+    strftime(date, sizeof date, "%FT%TZ", gmtime(&t));
+    if (uname(&host) != 0) {
+        memset(&host, 0, sizeof host);
+    }
+    lgw_get_eui(&eui);
+
+    if (out->csv == true) {
+        fprintf(out->fd, "# %s, tag %s, %s, host %s %s %s, EUI %016llX\n", date, tag, lgw_version_info(), host.sysname, host.release, host.machine, (unsigned long long)eui);
+        fprintf(out->fd, "section,name,unit,n,p50,p99,max,mean,value\n");
+    } else {
+        fprintf(out->fd, "{\"date\":\"%s\",\"tag\":\"%s\",\"lib\":\"%s\",\"host\":\"%s %s %s\",\"eui\":\"%016llX\",\"results\":[\n", date, tag, lgw_version_info(), host.sysname, host.release, host.machine, (unsigned long long)eui);
+    }
+    out->first = true;
+}
+
+static void out_end(struct bench_out_s * out) {
+    if (out->csv == false) {
+        fprintf(out->fd, "\n]}\n");
+    }
+}
+
+static void out_dist(struct bench_out_s * out, const char * section, const char * name, const char * unit, const struct lgw_hist_s * hist) {
+    double mean = (hist->count > 0) ? ((double)hist->sum / hist->count) : 0.0;
+    uint32_t p50 = lgw_hist_percentile(hist, 50.0);
+    uint32_t p99 = lgw_hist_percentile(hist, 99.0);
+
+    printf("%s %s: %u, p50 %u %s, p99 %u %s, max %u %s\n", section, name, hist->count, p50, unit, p99, unit, hist->max, unit);
+    if (out->csv == true) {
+        fprintf(out->fd, "%s,%s,%s,%u,%u,%u,%u,%.1f,\n", section, name, unit, hist->count, p50, p99, hist->max, mean);
+    } else {
+        fprintf(out->fd, "%s{\"section\":\"%s\",\"name\":\"%s\",\"unit\":\"%s\",\"n\":%u,\"p50\":%u,\"p99\":%u,\"max\":%u,\"mean\":%.1f}", out->first ? "" : ",\n", section, name, unit, hist->count, p50, p99, hist->max, mean);
+    }
+    out->first = false;
+}
+
+static void out_value(struct bench_out_s * out, const char * section, const char * name, const char * unit, double value) {
+    printf("%s %s: %.2f %s\n", section, name, value, unit);
+    if (out->csv == true) {
+        fprintf(out->fd, "%s,%s,%s,,,,,,%.3f\n", section, name, unit, value);
+    } else {
+        fprintf(out->fd, "%s{\"section\":\"%s\",\"name\":\"%s\",\"unit\":\"%s\",\"value\":%.3f}", out->first ? "" : ",\n", section, name, unit, value);
+    }
+    out->first = false;
+}
+
+/* start and stop the concentrator several times, leave it started */
+static int bench_start(unsigned int nb_start) {
+    uint64_t t;
+    unsigned int i;
+
+    lgw_hist_reset(&hist_start);
+    lgw_hist_reset(&hist_stop);
+    for (i = 0; (i < nb_start) && (quit_sig != 1) && (exit_sig != 1); i++) {
+        t = monotonic_us();
+        if (lgw_start() != LGW_HAL_SUCCESS) {
+            printf("ERROR: failed to start the concentrator\n");
+            return -1;
+        }
+        lgw_hist_record(&hist_start, (uint32_t)((monotonic_us() - t) / 1000));
+        if (i == (nb_start - 1)) {
+            break; /* last start is kept for the other measurements */
+        }
+        t = monotonic_us();
+        if (lgw_stop() != LGW_HAL_SUCCESS) {
+            printf("ERROR: failed to stop the concentrator\n");
+            return -1;
+        }
+        lgw_hist_record(&hist_stop, (uint32_t)((monotonic_us() - t) / 1000));
+    }
+    return 0;
+}
+
+/* receive the packets sent by a node for some time, count them per radio */
+static int bench_rx(struct bench_out_s * out, unsigned int duration_s) {
+    struct lgw_pkt_rx_s pkt[NB_PKT_MAX];
+    uint32_t nb_radio[LGW_RX_CHANNEL_NB_MAX] = { 0 };
+    uint32_t nb_crc_ok = 0;
+    uint32_t nb_lost_start = 0, nb_lost = 0;
+    uint32_t nb_total = 0;
+    uint64_t start, end, t;
+    double elapsed_s;
+    char name[16];
+    int nb_pkt, i;
+
+    lgw_hist_reset(&hist_fetch);
+    lgw_get_rx_lost(&nb_lost_start);
+    start = monotonic_us();
+    end = start + (uint64_t)duration_s * 1000000;
+    while ((monotonic_us() < end) && (quit_sig != 1) && (exit_sig != 1)) {
+        t = monotonic_us();
+        nb_pkt = lgw_receive_wait(NB_PKT_MAX, pkt, RX_WAIT_MS);
+        if (nb_pkt < 0) {
+            printf("ERROR: failed to fetch packets\n");
+            return -1;
+        }
+        if (nb_pkt == 0) {
+            continue;
+        }
+        lgw_hist_record(&hist_fetch, (uint32_t)(monotonic_us() - t));
+        for (i = 0; i < nb_pkt; i++) {
+            if (pkt[i].channel < LGW_RX_CHANNEL_NB_MAX) {
+                nb_radio[pkt[i].channel] += 1;
+            }
+            if (pkt[i].status == STAT_CRC_OK) {
+                nb_crc_ok += 1;
+            }
+        }
+        nb_total += nb_pkt;
+    }
+    elapsed_s = (double)(monotonic_us() - start) / 1e6;
+    lgw_get_rx_lost(&nb_lost);
+
+    for (i = 0; i < LGW_RX_CHANNEL_NB_MAX; i++) {
+        snprintf(name, sizeof name, "radio%d", i);
+        out_value(out, "rx", name, "pkt/s", nb_radio[i] / elapsed_s);
+    }
+    out_value(out, "rx", "total", "pkt/s", nb_total / elapsed_s);
+    out_value(out, "rx", "crc_ok", "%", (nb_total > 0) ? (100.0 * nb_crc_ok / nb_total) : 0.0);
+    out_value(out, "rx", "lost", "pkt", nb_lost - nb_lost_start);
+    out_dist(out, "rx", "lgw_receive_wait", "us", &hist_fetch); /* from the call to the packets fetched */
+    return 0;
+}
+
+/* schedule packets, measure the error between their timestamp and the trigger captured when emitted */
+static int bench_tx(struct bench_out_s * out, unsigned int nb_tx, const struct lgw_pkt_tx_s * pkt_ref) {
+    static struct tx_report_s report;
+    struct lgw_pkt_tx_s pkt = *pkt_ref;
+    uint32_t trig_prev = 0, trig;
+    uint32_t nb_ok = 0, nb_fail = 0, nb_trig = 0;
+    int32_t err_us, err_min = INT32_MAX, err_max = INT32_MIN;
+    uint64_t t, deadline;
+    unsigned int i;
+
+    lgw_hist_reset(&hist_send);
+    lgw_hist_reset(&hist_tx_err);
+    lgw_hist_reset(&hist_tx_done);
+    lgw_tx_set_callback(tx_done, &report);
+    lgw_get_trigcnt_now(&trig_prev);
+    for (i = 0; (i < nb_tx) && (quit_sig != 1) && (exit_sig != 1); i++) {
+        if (lgw_get_instcnt(&pkt.count_us) != LGW_HAL_SUCCESS) {
+            printf("ERROR: failed to get the concentrator counter\n");
+            return -1;
+        }
+        pkt.count_us += TX_LEAD_MS * 1000;
+        pkt.payload[0] = (uint8_t)i;
+        report.done = false;
+
+        t = monotonic_us();
+        if (lgw_send(&pkt) != LGW_HAL_SUCCESS) {
+            printf("ERROR: failed to send packet %u\n", i);
+            nb_fail += 1;
+            continue;
+        }
+        lgw_hist_record(&hist_send, (uint32_t)(monotonic_us() - t));
+
+        /* wait for the TX to be reported done */
+        deadline = t + TX_TIMEOUT_MS * 1000;
+        while ((report.done == false) && (monotonic_us() < deadline)) {
+            wait_ms(TX_POLL_MS);
+            lgw_tx_poll();
+        }
+        if ((report.done == false) || (report.result != TX_RESULT_OK)) {
+            printf("WARNING: TX %u not completed (result %d)\n", i, report.done ? (int)report.result : -1);
+            nb_fail += 1;
+            continue;
+        }
+        nb_ok += 1;
+        lgw_hist_record(&hist_tx_done, (uint32_t)((monotonic_us() - t) / 1000));
+
+        /* the trigger is only captured if the TX indicator is wired to it */
+        if ((lgw_get_trigcnt_now(&trig) == LGW_HAL_SUCCESS) && (trig != trig_prev)) {
+            err_us = (int32_t)(trig - pkt.count_us);
+            err_min = (err_us < err_min) ? err_us : err_min;
+            err_max = (err_us > err_max) ? err_us : err_max;
+            lgw_hist_record(&hist_tx_err, (uint32_t)((err_us < 0) ? -err_us : err_us));
+            nb_trig += 1;
+            trig_prev = trig;
+        }
+    }
+    lgw_tx_set_callback(NULL, NULL);
+
+    out_value(out, "tx", "ok", "pkt", nb_ok);
+    out_value(out, "tx", "fail", "pkt", nb_fail);
+    out_dist(out, "tx", "lgw_send", "us", &hist_send);
+    out_dist(out, "tx", "send_to_done", "ms", &hist_tx_done);
+    if (nb_trig > 0) {
+        out_dist(out, "tx", "abs_error", "us", &hist_tx_err);
+        out_value(out, "tx", "error_min", "us", err_min);
+        out_value(out, "tx", "error_max", "us", err_max);
+    } else {
+        printf("INFO: no trigger captured, TX accuracy not measured\n");
+    }
+    return 0;
+}
+
+/* round-trip times of the requests sent to the MCU since the last start */
+static void bench_mcu(struct bench_out_s * out) {
+    const char * name;
+    int i;
+
+    for (i = 0; i < LGW_MCU_NB_REQ; i++) {
+        if ((lgw_get_mcu_rtt(i, &hist_rtt, &name) == LGW_HAL_SUCCESS) && (hist_rtt.count > 0)) {
+            out_dist(out, "mcu", name, "us", &hist_rtt);
+        }
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv) {
+    int i, x;
+    double arg_d = 0.0;
+    unsigned int arg_u;
+    int arg_i;
+
+    uint32_t ft = 2425000000;
+    e_spreading_factor sf = DR_LORA_SF12;
+    e_bandwidth bw_khz = BW_800KHZ;
+    int8_t rf_power = 0;
+    unsigned int nb_start = 5;
+    unsigned int rx_duration_s = 10;
+    unsigned int nb_tx = 10;
+    bool rx_event_mode = false;
+    bool fast_start = false;
+    const char * tag = "";
+    const char * out_path = OUT_PATH_DEFAULT;
+    char out_name[256];
+    struct bench_out_s out;
+
+    struct lgw_conf_board_s boardconf;
+    struct lgw_conf_channel_rx_s channelconf;
+    struct lgw_pkt_tx_s txpk;
+
+    /* TTY interfaces */
+    const char tty_path_default[] = TTY_PATH_DEFAULT;
+    const char * tty_path = tty_path_default;
+
+    static struct sigaction sigact; /* SIGQUIT&SIGINT&SIGTERM signal handling */
+
+    /* Parameter parsing */
+    int option_index = 0;
+    static struct option long_options[] = {
+        {"csv", 0, 0, 0},
+        {"tag", required_argument, 0, 0},
+        {"start", required_argument, 0, 0},
+        {"rx", required_argument, 0, 0},
+        {"tx", required_argument, 0, 0},
+        {"pwr", required_argument, 0, 0},
+        {"event", 0, 0, 0},
+        {"fast", 0, 0, 0},
+        {0, 0, 0, 0}
+    };
+
+    memset(&out, 0, sizeof out);
+
+    /* parse command line options */
+    while ((i = getopt_long (argc, argv, "hd:f:s:b:o:", long_options, &option_index)) != -1) {
+        switch (i) {
+            case 'h':
+                usage();
+                return -1;
+                break;
+            case 'd':
+                if (optarg != NULL) {
+                    tty_path = optarg;
+                }
+                break;
+            case 'f': /* <float> Radio frequency in MHz */
+                i = sscanf(optarg, "%lf", &arg_d);
+                if (i != 1 || (arg_d < 2400) || (arg_d > 2500)) {
+                    printf("ERROR: argument parsing of -f argument. Use -h to print help\n");
+                    return EXIT_FAILURE;
+                } else {
+                    ft = (uint32_t)((arg_d*1e6) + 0.5); /* .5 Hz offset to get rounding instead of truncating */
+                }
+                break;
+            case 's': /* <uint> LoRa datarate */
+                i = sscanf(optarg, "%u", &arg_u);
+                if ((i != 1) || (arg_u < 5) || (arg_u > 12)) {
+                    printf("ERROR: argument parsing of -s argument. Use -h to print help\n");
+                    return EXIT_FAILURE;
+                } else {
+                    sf = (uint8_t)arg_u;
+                }
+                break;
+            case 'b': /* <uint> LoRa bandwidth in khz */
+                i = sscanf(optarg, "%u", &arg_u);
+                if (i != 1) {
+                    printf("ERROR: argument parsing of -b argument. Use -h to print help\n");
+                    return EXIT_FAILURE;
+                }
+                switch (arg_u) {
+                    case 200:
+                    case 203:
+                        bw_khz = BW_200KHZ;
+                        break;
+                    case 400:
+                    case 406:
+                        bw_khz = BW_400KHZ;
+                        break;
+                    case 800:
+                    case 812:
+                        bw_khz = BW_800KHZ;
+                        break;
+                    case 1600:
+                    case 1625:
+                        bw_khz = BW_1600KHZ;
+                        break;
+                    default:
+                        printf("ERROR: argument parsing of -b argument. Use -h to print help\n");
+                        return EXIT_FAILURE;
+                }
+                break;
+            case 'o':
+                out_path = optarg;
+                break;
+            case 0:
+                if (strcmp(long_options[option_index].name, "csv") == 0) {
+                    out.csv = true;
+                } else if (strcmp(long_options[option_index].name, "tag") == 0) {
+                    tag = optarg;
+                } else if (strcmp(long_options[option_index].name, "event") == 0) {
+                    rx_event_mode = true;
+                } else if (strcmp(long_options[option_index].name, "fast") == 0) {
+                    fast_start = true;
+                } else if (strcmp(long_options[option_index].name, "pwr") == 0) {
+                    i = sscanf(optarg, "%d", &arg_i);
+                    if ((i != 1) || (arg_i < -18) || (arg_i > 13)) {
+                        printf("ERROR: argument parsing of --pwr argument. Use -h to print help\n");
+                        return EXIT_FAILURE;
+                    }
+                    rf_power = (int8_t)arg_i;
+                } else {
+                    i = sscanf(optarg, "%u", &arg_u);
+                    if (i != 1) {
+                        printf("ERROR: argument parsing of --%s argument. Use -h to print help\n", long_options[option_index].name);
+                        return EXIT_FAILURE;
+                    }
+                    if (strcmp(long_options[option_index].name, "start") == 0) {
+                        nb_start = (arg_u > 0) ? arg_u : 1; /* the concentrator has to be started once at least */
+                    } else if (strcmp(long_options[option_index].name, "rx") == 0) {
+                        rx_duration_s = arg_u;
+                    } else {
+                        nb_tx = arg_u;
+                    }
+                }
+                break;
+            default:
+                printf("ERROR: argument parsing\n");
+                usage();
+                return EXIT_FAILURE;
+        }
+    }
+
+    printf("### LoRa 2.4GHz Gateway - HAL benchmark ###\n");
+    printf("%u start/stop cycles, RX for %u s, %u TX on %u Hz (BW %u kHz, SF %i)\n", nb_start, rx_duration_s, nb_tx, ft, lgw_get_bw_khz(bw_khz), sf);
+
+    /* Configure signal handling */
+    sigemptyset( &sigact.sa_mask );
+    sigact.sa_flags = 0;
+    sigact.sa_handler = sig_handler;
+    sigaction( SIGQUIT, &sigact, NULL );
+    sigaction( SIGINT, &sigact, NULL );
+    sigaction( SIGTERM, &sigact, NULL );
+
+    /* Configure the gateway */
+    memset(&boardconf, 0, sizeof boardconf);
+    strncpy(boardconf.tty_path, tty_path, sizeof boardconf.tty_path - 1);
+    boardconf.rx_event_mode = rx_event_mode;
+    boardconf.fast_start = fast_start;
+    if (lgw_board_setconf(&boardconf) != 0) {
+        printf("ERROR: failed to configure board\n");
+        return EXIT_FAILURE;
+    }
+
+    /* Configure RX channels, all on the frequency of the node sending the traffic */
+    memset(&channelconf, 0, sizeof channelconf);
+    for (i = 0; i < LGW_RX_CHANNEL_NB_MAX; i++) {
+        channelconf.enable = true;
+        channelconf.freq_hz = ft;
+        channelconf.datarate = sf;
+        channelconf.bandwidth = bw_khz;
+        channelconf.rssi_offset = 0.0;
+        channelconf.sync_word = LORA_SYNC_WORD_PUBLIC;
+        if (lgw_channel_rx_setconf(i, &channelconf) != 0) {
+            printf("ERROR: failed to configure channel %u\n", i);
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* Packet used for the TX measurements */
+    memset(&txpk, 0, sizeof txpk);
+    txpk.freq_hz = ft;
+    txpk.rf_chain = 0;
+    txpk.tx_mode = TIMESTAMPED;
+    txpk.rf_power = rf_power;
+    txpk.bandwidth = bw_khz;
+    txpk.datarate = sf;
+    txpk.coderate = CR_LORA_LI_4_8;
+    txpk.invert_pol = false;
+    txpk.preamble = 8;
+    txpk.sync_word = LORA_SYNC_WORD_PUBLIC;
+    txpk.no_crc = false;
+    txpk.no_header = false;
+    txpk.size = 16;
+
+    snprintf(out_name, sizeof out_name, "%s.%s", out_path, (out.csv == true) ? "csv" : "json");
+    out.fd = fopen(out_name, "w");
+    if (out.fd == NULL) {
+        printf("ERROR: impossible to create results file %s\n", out_name);
+        return EXIT_FAILURE;
+    }
+
+    x = bench_start(nb_start);
+    if (x == 0) {
+        out_begin(&out, tag); /* the EUI is known once started */
+        out_dist(&out, "start", "lgw_start", "ms", &hist_start);
+        out_dist(&out, "start", "lgw_stop", "ms", &hist_stop);
+        if (rx_duration_s > 0) {
+            x |= bench_rx(&out, rx_duration_s);
+        }
+        if ((nb_tx > 0) && (x == 0)) {
+            x |= bench_tx(&out, nb_tx, &txpk);
+        }
+        bench_mcu(&out);
+        out_end(&out);
+        lgw_stop();
+    }
+    fclose(out.fd);
+
+    if (x != 0) {
+        printf("FAILED: benchmark not completed\n");
+        return EXIT_FAILURE;
+    }
+    printf("### Results written to %s ###\n", out_name);
+
+    return EXIT_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,215 @@
+/*!
+ * \brief     Check the percentiles of the latency histograms, and measure the recording cost
+ *
+ * License: Revised BSD 3-Clause License, see LICENSE.TXT file include in the project
+ */
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf */
+#include <stdlib.h>     /* EXIT_FAILURE qsort rand */
+#include <unistd.h>     /* getopt */
+#include <pthread.h>
+#include <time.h>       /* clock_gettime */
+
+#include "loragw_hist.h"
+#include "bench.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define NB_VALUE        100000
+#define NB_THREAD       4
+#define PRECISION       (1.0 / (1 << LGW_HIST_SUB_BITS)) /* relative width of the buckets */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static struct lgw_hist_s hist_shared;
+static struct lgw_hist_s snapshot;
+static uint32_t values[NB_VALUE];
+static unsigned int nb_loop = 1000000;
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* describe command line options */
+void usage(void) {
+    printf("Available options:\n");
+    printf(" -h print this help\n");
+    printf(" -n <uint>  number of values recorded by each thread for the benchmark [1..]\n");
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* the percentile must be in the bucket of the exact one, or above it by the bucket width at most */
+static bool check_percentile(const struct lgw_hist_s *hist, const uint32_t *sorted, int nb, float percent) {
+    uint32_t p = lgw_hist_percentile(hist, percent);
+    int rank = (int)((percent / 100.0f) * (float)nb + 0.5f);
+    uint32_t ref;
+
+    if (rank < 1) {
+        rank = 1;
+    } else if (rank > nb) {
+        rank = nb;
+    }
+    ref = sorted[rank - 1];
+    if ((p < ref) || ((double)p > (double)ref * (1.0 + PRECISION) + 1.0)) {
+        printf("ERROR: p%.1f is %u, expected %u\n", percent, p, ref);
+        return false;
+    }
+    return true;
+}
+
+static int check_distribution(uint32_t range) {
+    static struct lgw_hist_s hist;
+    static const float percent[] = { 0.0, 1.0, 25.0, 50.0, 90.0, 99.0, 99.9, 100.0 };
+    uint64_t sum = 0;
+    int nb_err = 0;
+    int i;
+
+    /* long tailed distribution, most values are low */
+    lgw_hist_reset(&hist);
+    for (i = 0; i < NB_VALUE; i++) {
+        values[i] = (uint32_t)(((uint64_t)rand() * rand()) % range) >> (rand() % 8);
+        lgw_hist_record(&hist, values[i]);
+        sum += values[i];
+    }
+    qsort(values, NB_VALUE, sizeof values[0], cmp_u32);
+
+    if ((hist.count != NB_VALUE) || (hist.sum != sum) || (hist.max != values[NB_VALUE - 1])) {
+        printf("ERROR: count %u, sum %llu or max %u do not match\n", hist.count, (unsigned long long)hist.sum, hist.max);
+        nb_err += 1;
+    }
+    for (i = 0; i < (int)(sizeof percent / sizeof percent[0]); i++) {
+        if (check_percentile(&hist, values, NB_VALUE, percent[i]) == false) {
+            nb_err += 1;
+        }
+    }
+    return nb_err;
+}
+
+static int check_limits(void) {
+    static struct lgw_hist_s hist;
+    static struct lgw_hist_s other;
+    int nb_err = 0;
+
+    lgw_hist_reset(&hist);
+    if (lgw_hist_percentile(&hist, 50.0) != 0) {
+        printf("ERROR: percentile of an empty histogram\n");
+        nb_err += 1;
+    }
+    lgw_hist_record(&hist, 0);
+    lgw_hist_record(&hist, UINT32_MAX);
+    if ((lgw_hist_percentile(&hist, 50.0) != 0) || (lgw_hist_percentile(&hist, 100.0) != UINT32_MAX)) {
+        printf("ERROR: lowest and highest values not recorded\n");
+        nb_err += 1;
+    }
+
+    /* merge, then collect which clears the histogram */
+    lgw_hist_reset(&other);
+    lgw_hist_record(&other, 1000);
+    lgw_hist_merge(&hist, &other);
+    lgw_hist_collect(&hist, &other);
+    if ((other.count != 3) || (other.max != UINT32_MAX) || (lgw_hist_percentile(&other, 50.0) < 1000) || (lgw_hist_percentile(&other, 50.0) > 1000 * (1.0 + PRECISION))) {
+        printf("ERROR: merged histogram not collected\n");
+        nb_err += 1;
+    }
+    if ((hist.count != 0) || (hist.max != 0) || (hist.sum != 0)) {
+        printf("ERROR: histogram not cleared by the collect\n");
+        nb_err += 1;
+    }
+    return nb_err;
+}
+
+/* record values, while the main thread collects them */
+static void * thread_record(void *arg) {
+    unsigned int k;
+
+    (void)arg;
+    for (k = 0; k < nb_loop; k++) {
+        lgw_hist_record(&hist_shared, k & 0xFFFF);
+    }
+    return NULL;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv) {
+    int i, j;
+    unsigned int arg_u;
+    pthread_t thrid[NB_THREAD];
+    struct timespec start, end;
+    uint64_t nb_collected = 0;
+
+    /* parse command line options */
+    while ((i = getopt (argc, argv, "hn:")) != -1) {
+        switch (i) {
+            case 'h':
+                usage();
+                return EXIT_SUCCESS;
+            case 'n':
+                j = sscanf(optarg, "%u", &arg_u);
+                if ((j != 1) || (arg_u < 1)) {
+                    printf("ERROR: argument parsing of -n argument. Use -h to print help\n");
+                    return EXIT_FAILURE;
+                }
+                nb_loop = arg_u;
+                break;
+            default:
+                printf("ERROR: argument parsing\n");
+                usage();
+                return EXIT_FAILURE;
+        }
+    }
+
+    srand(1);
+    j = check_limits() + check_distribution(1000) + check_distribution(10000000);
+    if (j > 0) {
+        printf("FAILED: %d errors\n", j);
+        return EXIT_FAILURE;
+    }
+    printf("Percentiles are within %.1f%% of the exact ones\n", 100.0 * PRECISION);
+
+    /* the threads record while the values are collected, none is lost */
+    lgw_hist_reset(&hist_shared);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < NB_THREAD; i++) {
+        pthread_create(&thrid[i], NULL, thread_record, NULL);
+    }
+    for (i = 0; i < 100; i++) {
+        lgw_hist_collect(&hist_shared, &snapshot);
+        nb_collected += snapshot.count;
+    }
+    for (i = 0; i < NB_THREAD; i++) {
+        pthread_join(thrid[i], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    lgw_hist_collect(&hist_shared, &snapshot);
+    nb_collected += snapshot.count;
+    if (nb_collected != (uint64_t)NB_THREAD * nb_loop) {
+        printf("FAILED: %llu values collected, %llu recorded\n", (unsigned long long)nb_collected, (unsigned long long)NB_THREAD * nb_loop);
+        return EXIT_FAILURE;
+    }
+    printf("record: %.1f ns/value (%d threads, %u values each)\n", elapsed_ns(start, end) / nb_loop, NB_THREAD, nb_loop);
+
+    return EXIT_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
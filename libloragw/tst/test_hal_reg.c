@@ -55,7 +55,7 @@ void usage(void) {
 
 int main(int argc, char **argv) {
     int i, x;
-    int fd;
+    static s_mcu mcu;
     uint8_t reg_val;
     unsigned int arg_u;
     struct lgw_conf_channel_rx_s conf;
@@ -123,13 +123,13 @@ int main(int argc, char **argv) {
     printf("### LoRa 2.4GHz Gateway - Radio Register Read/Write ###\n");
 
     /*  */
-    fd = mcu_open(tty_path);
-    if (fd == -1) {
+    x = mcu_open(&mcu, tty_path);
+    if (x != 0) {
         printf("ERROR: failed to connect\n");
         return EXIT_FAILURE;
     }
 
-    x = mcu_ping(fd, &gw_info);
+    x = mcu_ping(&mcu, &gw_info);
     if (x != 0) {
         printf("ERROR: failed to ping the concentrator\n");
         return EXIT_FAILURE;
@@ -141,14 +141,14 @@ int main(int argc, char **argv) {
     conf.bandwidth = BW_800KHZ;
     conf.rssi_offset = 0.0;
     conf.sync_word = LORA_SYNC_WORD_PUBLIC;
-    x = mcu_config_rx(fd, radio_idx, &conf);
+    x = mcu_config_rx(&mcu, radio_idx, &conf);
     if (x != 0) {
         printf("ERROR: failed to configure radio %u\n", 0);
         return EXIT_FAILURE;
     }
 
     /*  */
-    x = mcu_read_register(fd, radio_idx, reg_addr, &reg_val);
+    x = mcu_read_register(&mcu, radio_idx, reg_addr, &reg_val);
     if (x != 0) {
         printf("ERROR: failed to connect\n");
         return EXIT_FAILURE;
@@ -156,13 +156,13 @@ int main(int argc, char **argv) {
     printf("Read register 0x%04X:  0x%02X\n", reg_addr, reg_val);
 
     printf("Write register 0x%04X: 0x%02X\n", reg_addr, reg_val_wr);
-    x = mcu_write_register(fd, radio_idx, reg_addr, reg_val_wr);
+    x = mcu_write_register(&mcu, radio_idx, reg_addr, reg_val_wr);
     if (x != 0) {
         printf("ERROR: failed to connect\n");
         return EXIT_FAILURE;
     }
 
-    x = mcu_read_register(fd, radio_idx, reg_addr, &reg_val);
+    x = mcu_read_register(&mcu, radio_idx, reg_addr, &reg_val);
     if (x != 0) {
         printf("ERROR: failed to connect\n");
         return EXIT_FAILURE;
@@ -170,7 +170,7 @@ int main(int argc, char **argv) {
     printf("Read register 0x%04X:  0x%02X\n", reg_addr, reg_val);
 
     /*  */
-    x = mcu_close(fd);
+    x = mcu_close(&mcu);
     if (x != 0) {
         printf("ERROR: failed to disconnect\n");
         return EXIT_FAILURE;
@@ -17,6 +17,7 @@
 #include <stdio.h>      /* printf fprintf */
 #include <stdlib.h>     /* EXIT_FAILURE */
 #include <getopt.h>     /* getopt_long */
+#include <time.h>       /* clock_gettime */
 
 #include "loragw_aux.h"
 #include "loragw_mcu.h"
@@ -45,6 +46,7 @@ void usage(void) {
     printf(" -h print this help\n");
     printf(" -d <path>  TTY device to be used to access the concentrator board\n");
     printf("                      => default path: " TTY_PATH_DEFAULT "\n");
+    printf(" -f         reset the radios at once and poll the MCU until ready (fast start)\n");
 }
 
 /* -------------------------------------------------------------------------- */
@@ -52,8 +54,11 @@ void usage(void) {
 
 int main(int argc, char **argv) {
     int i, x;
-    int fd;
+    static s_mcu mcu;
     s_ping_info gw_info;
+    bool fast = false;
+    const e_reset_type reset_radios[2] = { RESET_TYPE__RX_ALL, RESET_TYPE__TX };
+    struct timespec start, end;
 
     /* TTY interfaces */
     const char tty_path_default[] = TTY_PATH_DEFAULT;
@@ -66,7 +71,7 @@ int main(int argc, char **argv) {
     };
 
     /* parse command line options */
-    while ((i = getopt_long (argc, argv, "hd:", long_options, &option_index)) != -1) {
+    while ((i = getopt_long (argc, argv, "hd:f", long_options, &option_index)) != -1) {
         switch (i) {
             case 'h':
                 usage();
@@ -77,6 +82,9 @@ int main(int argc, char **argv) {
                     tty_path = optarg;
                 }
                 break;
+            case 'f':
+                fast = true;
+                break;
             default:
                 printf("ERROR: unkown argument. Use -h to print help\n");
                 return EXIT_FAILURE;
@@ -86,37 +94,48 @@ int main(int argc, char **argv) {
     printf("### LoRa 2.4GHz Gateway - Reset MCU ###\n");
 
     /*  */
-    fd = mcu_open(tty_path);
-    if (fd == -1) {
+    x = (fast == true) ? mcu_open_fast(&mcu, tty_path) : mcu_open(&mcu, tty_path);
+    if (x != 0) {
         printf("ERROR: failed to connect\n");
         return EXIT_FAILURE;
     }
 
-    x = mcu_ping(fd, &gw_info);
+    x = mcu_ping(&mcu, &gw_info);
     if (x != 0) {
         printf("ERROR: failed to ping the concentrator\n");
         return EXIT_FAILURE;
     }
 
-    x = mcu_reset(fd, RESET_TYPE__RX_ALL);
-    if (x != 0) {
-        printf("ERROR: failed to reset the concentrator RX radios\n");
-        return EXIT_FAILURE;
-    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (fast == true) {
+        x = mcu_reset_batch(&mcu, reset_radios, 2);
+        if (x != 0) {
+            printf("ERROR: failed to reset the concentrator radios\n");
+            return EXIT_FAILURE;
+        }
+    } else {
+        x = mcu_reset(&mcu, RESET_TYPE__RX_ALL);
+        if (x != 0) {
+            printf("ERROR: failed to reset the concentrator RX radios\n");
+            return EXIT_FAILURE;
+        }
 
-    x = mcu_reset(fd, RESET_TYPE__TX);
-    if (x != 0) {
-        printf("ERROR: failed to reset the concentrator TX radio\n");
-        return EXIT_FAILURE;
+        x = mcu_reset(&mcu, RESET_TYPE__TX);
+        if (x != 0) {
+            printf("ERROR: failed to reset the concentrator TX radio\n");
+            return EXIT_FAILURE;
+        }
     }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("INFO: radios reset in %ld ms\n", (long)((end.tv_sec - start.tv_sec) * 1000 + (end.tv_nsec - start.tv_nsec) / 1000000));
 
-    x = mcu_reset(fd, RESET_TYPE__GTW);
+    x = mcu_reset(&mcu, RESET_TYPE__GTW);
     if (x != 0) {
         printf("ERROR: failed to reset the concentrator MCU\n");
         return EXIT_FAILURE;
     }
 
-    x = mcu_close(fd);
+    x = mcu_close(&mcu);
     if (x != 0) {
         printf("ERROR: failed to disconnect\n");
         return EXIT_FAILURE;
@@ -92,6 +92,7 @@ int main(int argc, char **argv) {
     e_bandwidth bw_khz = BW_800KHZ;
     unsigned int nb_loop = 0, cnt_loop;
     int nb_pkt = 0, nb_pkt_total = 0;
+    uint32_t nb_lost;
     unsigned long rx_delay = RX_DELAY_MS;
 
     struct lgw_conf_board_s boardconf;
@@ -254,6 +255,7 @@ int main(int argc, char **argv) {
         /* Configure mote (for automatic testing bench) */
         if (config_end_node == true) {
             txpk.freq_hz = 2403000000;
+            txpk.rf_chain = 0;
             txpk.tx_mode = IMMEDIATE;
             txpk.coderate = CR_LORA_LI_4_8;
             txpk.datarate = 5;
@@ -337,6 +339,11 @@ int main(int argc, char **argv) {
             }
         }
 
+        /* Report packets lost by the concentrator */
+        if (lgw_get_rx_lost(&nb_lost) == 0) {
+            printf("INFO: %u packets lost by the concentrator (RX buffer full)\n", nb_lost);
+        }
+
         /* Stop the LoRa concentrator */
         if (lgw_stop() != 0) {
             return EXIT_FAILURE;
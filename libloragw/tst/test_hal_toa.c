@@ -19,8 +19,11 @@
 #include <signal.h>     /* sigaction */
 #include <getopt.h>     /* getopt_long */
 #include <string.h>     /* strcmp */
+#include <math.h>       /* ceil */
+#include <time.h>       /* clock_gettime */
 
 #include "loragw_hal.h"
+#include "bench.h"
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE MACROS ------------------------------------------------------- */
@@ -28,12 +31,23 @@
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE CONSTANTS ---------------------------------------------------- */
 
+#define ROUNDING_EPSILON    1e-6    /* float reference results closer than this to an integer may be rounded either way */
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE VARIABLES ---------------------------------------------------- */
 
+/* Modulation parameters swept by the regression test */
+static const uint8_t test_bw[] = { BW_200KHZ, BW_400KHZ, BW_800KHZ, BW_1600KHZ };
+static const uint8_t test_cr[] = { CR_LORA_4_5, CR_LORA_4_6, CR_LORA_4_7, CR_LORA_4_8, CR_LORA_LI_4_5, CR_LORA_LI_4_6, CR_LORA_LI_4_8 };
+static const uint16_t test_preamble[] = { 6, 8, 12, 65535 };
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
 
+static bool check_rounded(uint32_t value, double ref);
+
+static int test_sweep(void);
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
 
@@ -49,6 +63,89 @@ void usage(void) {
     printf(" -z <uint>  Payload length [0..255]\n");
     printf(" -i         Implicit header (no header)\n");
     printf(" -r         CRC enabled\n");
+    printf(" -t         Check the integer computation against the floating point one on all packets, and compare their speed\n");
+}
+
+/* Check an integer result is the float reference rounded up, allowing for float rounding errors on integers */
+static bool check_rounded(uint32_t value, double ref) {
+    double r = floor(ref + 0.5);
+
+    if ((double)value == ceil(ref)) {
+        return true;
+    }
+    return ((fabs(ref - r) < ROUNDING_EPSILON) && ((double)value == r));
+}
+
+/* Sweep all modulations and payload sizes, return the number of errors */
+static int test_sweep(void) {
+    struct lgw_pkt_tx_s pkt;
+    unsigned int sf, b, c, h, r, p, sz;
+    unsigned int nb_pkt = 0;
+    int nb_err = 0;
+    double toa_ms;
+    uint32_t toa_u, toa_us;
+    volatile uint32_t sink; /* keep the benchmarked calls */
+    double ns_ref = 0.0, ns = 0.0;
+    struct timespec start, end;
+
+    memset(&pkt, 0, sizeof pkt);
+    for (sf = DR_LORA_SF5; sf <= DR_LORA_SF12; sf++) {
+        for (b = 0; b < sizeof test_bw; b++) {
+            for (c = 0; c < sizeof test_cr; c++) {
+                for (h = 0; h < 2; h++) {
+                    for (r = 0; r < 2; r++) {
+                        for (p = 0; p < sizeof test_preamble / sizeof test_preamble[0]; p++) {
+                            pkt.datarate = sf;
+                            pkt.bandwidth = test_bw[b];
+                            pkt.coderate = test_cr[c];
+                            pkt.no_header = (h != 0);
+                            pkt.no_crc = (r != 0);
+                            pkt.preamble = test_preamble[p];
+
+                            /* results */
+                            for (sz = 0; sz <= 255; sz++) {
+                                pkt.size = sz;
+                                lgw_time_on_air(&pkt, &toa_ms);
+                                toa_u = lgw_time_on_air(&pkt, NULL);
+                                toa_us = lgw_time_on_air_us(&pkt);
+                                if (!check_rounded(toa_u, toa_ms) || !check_rounded(toa_us, toa_ms * 1000.0)) {
+                                    if (nb_err < 10) {
+                                        printf("ERROR: SF%u bw:%u cr:%u no_header:%u no_crc:%u preamble:%u size:%u => %.6f ms, got %u ms and %u us\n",
+                                               sf, pkt.bandwidth, pkt.coderate, h, r, pkt.preamble, sz, toa_ms, toa_u, toa_us);
+                                    }
+                                    nb_err += 1;
+                                }
+                            }
+
+                            /* speed, on the same packets */
+                            clock_gettime(CLOCK_MONOTONIC, &start);
+                            for (sz = 0; sz <= 255; sz++) {
+                                pkt.size = sz;
+                                sink = lgw_time_on_air(&pkt, &toa_ms);
+                            }
+                            clock_gettime(CLOCK_MONOTONIC, &end);
+                            ns_ref += elapsed_ns(start, end);
+                            clock_gettime(CLOCK_MONOTONIC, &start);
+                            for (sz = 0; sz <= 255; sz++) {
+                                pkt.size = sz;
+                                sink = lgw_time_on_air_us(&pkt);
+                            }
+                            clock_gettime(CLOCK_MONOTONIC, &end);
+                            ns += elapsed_ns(start, end);
+                            nb_pkt += 256;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    printf("%u packets checked, %d errors\n", nb_pkt, nb_err);
+    (void)sink;
+    printf("floating point:  %.1f ns/packet\n", ns_ref / nb_pkt);
+    printf("integer:         %.1f ns/packet (x%.1f)\n", ns / nb_pkt, ns_ref / ns);
+
+    return nb_err;
 }
 
 /* -------------------------------------------------------------------------- */
@@ -79,7 +176,7 @@ int main(int argc, char **argv) {
     pkt.no_crc = true;
 
     /* parse command line options */
-    while ((i = getopt_long (argc, argv, "hirs:b:z:l:c:", long_options, &option_index)) != -1) {
+    while ((i = getopt_long (argc, argv, "hirts:b:z:l:c:", long_options, &option_index)) != -1) {
         switch (i) {
             case 'h':
                 usage();
@@ -91,6 +188,8 @@ int main(int argc, char **argv) {
             case 'r':
                 pkt.no_crc = false;
                 break;
+            case 't':
+                return (test_sweep() == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
             case 'l':
                 preamb = true; /* param set */
                 i = sscanf(optarg, "%u", &arg_u);
@@ -206,7 +305,7 @@ int main(int argc, char **argv) {
         }
 
     toa_u = lgw_time_on_air(&pkt, &toa_ms);
-    printf("=> %.4f ms (%u ms)\n", toa_ms, toa_u);
+    printf("=> %.4f ms (%u ms, %u us)\n", toa_ms, toa_u, lgw_time_on_air_us(&pkt));
 
     return 0;
 }
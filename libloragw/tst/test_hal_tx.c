@@ -321,6 +321,7 @@ int main(int argc, char **argv) {
         /* Configure mote (for automatic testing bench) */
         if (config_end_node == true) {
             txpk.freq_hz = 2403000000;
+            txpk.rf_chain = 0;
             txpk.tx_mode = IMMEDIATE;
             txpk.coderate = CR_LORA_LI_4_8;
             txpk.datarate = 5;
@@ -394,6 +395,7 @@ int main(int argc, char **argv) {
             }
             pkt.rf_power = rf_power;
             pkt.freq_hz = ft;
+            pkt.rf_chain = 0;
             pkt.bandwidth = bw_khz;
             pkt.datarate = sf;
             pkt.coderate = CR_LORA_LI_4_8;
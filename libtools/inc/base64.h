@@ -47,6 +47,30 @@ int bin_to_b64(const uint8_t * in, int size, char * out, int max_len);
 */
 int b64_to_bin(const char * in, int size, uint8_t * out, int max_len);
 
+/* === batch and implementation selection === */
+
+/**
+@brief Encode several binary payloads in Base64 strings (with added padding)
+@param in array of pointers to the binary payloads
+@param size array of the number of bytes of each payload
+@param nb number of payloads
+@param out pointer to a buffer where the strings are written one after the other, each one null terminated
+@param max_len size of the out buffer
+@param len array receiving the length of each string (w/o null char), can be NULL
+@return >=0 number of characters written (null chars included), -1 for error
+*/
+int bin_to_b64_batch(const uint8_t * const in[], const int size[], int nb, char * out, int max_len, int len[]);
+
+/**
+@brief Select the implementation used for encoding and decoding
+@param simd 0 to use the portable code only, 1 to use the fastest SIMD code supported (default)
+@return name of the implementation selected ("scalar", "ssse3", "avx2" or "neon")
+
+SSSE3 and AVX2 are detected at runtime on x86, NEON is used if the library is
+built for it. Building with -DBASE64_NO_SIMD removes all SIMD code.
+*/
+const char * b64_select_impl(int simd);
+
 #endif
 
 /* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,30 @@
+/*!
+ * \brief     Timing helper of the benchmarks of the test programs
+ *
+ * License: Revised BSD 3-Clause License, see LICENSE.TXT file include in the project
+ */
+
+#ifndef _BENCH_H
+#define _BENCH_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <time.h>          /* timespec, clock_gettime */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS ----------------------------------------------------- */
+
+/**
+@brief Time between two clock_gettime() readings
+@param start first reading
+@param end second reading, of the same clock
+@return elapsed time in nanoseconds
+*/
+static inline double elapsed_ns(struct timespec start, struct timespec end) {
+    return (double)(end.tv_sec - start.tv_sec) * 1e9 + (double)(end.tv_nsec - start.tv_nsec);
+}
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
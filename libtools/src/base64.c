@@ -10,9 +10,20 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
 
 #include "base64.h"
 
+/* SIMD implementations, can be disabled at build time with -DBASE64_NO_SIMD */
+#if !defined(BASE64_NO_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define B64_SIMD_X86    /* SSSE3 and AVX2, selected at runtime */
+    #include <immintrin.h>
+#endif
+#if !defined(BASE64_NO_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+    #define B64_SIMD_NEON   /* NEON, selected at build time */
+    #include <arm_neon.h>
+#endif
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE MACROS ------------------------------------------------------- */
 
@@ -32,6 +43,12 @@ static char code_62 = '+';    /* RFC 1421 standard character for code 62 */
 static char code_63 = '/';    /* RFC 1421 standard character for code 63 */
 static char code_pad = '=';    /* RFC 1421 padding character if padding */
 
+/* SIMD implementation, processing the beginning of the data (NULL if none) */
+static bool impl_selected = false;
+static const char * impl_name = "scalar";
+static int (*encode_simd)(const uint8_t * in, int size, char * out) = NULL;
+static int (*decode_simd)(const char * in, int size, uint8_t * out, int max_len) = NULL;
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
 
@@ -45,6 +62,11 @@ char code_to_char(uint8_t x);
 */
 uint8_t char_to_code(char x);
 
+/**
+@brief Select the SIMD implementation on first use
+*/
+static void select_impl(void);
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
 
@@ -82,9 +104,314 @@ uint8_t char_to_code(char x) {
     } //TODO: improve error management
 }
 
+
+/* SIMD encoders: convert as many 3 bytes blocks as possible, return the number
+of bytes consumed. Input beyond the consumed bytes may be read, within size. */
+
+/* SIMD decoders: convert as many 4 chars blocks as possible, return the number
+of chars consumed. They stop before a block containing invalid characters, so
+that it is handled by the scalar code. Output may be written up to max_len. */
+
+#ifdef B64_SIMD_X86
+
+/* Split 12 bytes (in a 16 bytes lane) to 16 codes in the range 0-63 */
+__attribute__((target("ssse3")))
+static inline __m128i enc_split_ssse3(__m128i in) {
+    __m128i t0, t1, t2, t3;
+
+    in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+    t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+    t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+    t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+    return _mm_or_si128(t1, t3);
+}
+
+/* Convert 16 codes to ASCII: an offset is added, selected by the code range */
+__attribute__((target("ssse3")))
+static inline __m128i enc_ascii_ssse3(__m128i codes) {
+    const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                          '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    __m128i range;
+
+    range = _mm_subs_epu8(codes, _mm_set1_epi8(51));
+    range = _mm_or_si128(range, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), codes), _mm_set1_epi8(13)));
+    return _mm_add_epi8(codes, _mm_shuffle_epi8(offsets, range));
+}
+
+/* Convert 16 ASCII chars to codes, return false if any char is invalid */
+__attribute__((target("ssse3")))
+static inline bool dec_codes_ssse3(__m128i in, __m128i * codes) {
+    const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask_nibble = _mm_set1_epi8(0x0F);
+    __m128i hi_nibble, lo_nibble, lo, hi, roll;
+
+    hi_nibble = _mm_and_si128(_mm_srli_epi32(in, 4), mask_nibble);
+    lo_nibble = _mm_and_si128(in, mask_nibble);
+    lo = _mm_shuffle_epi8(lut_lo, lo_nibble);
+    hi = _mm_shuffle_epi8(lut_hi, hi_nibble);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())) != 0xFFFF) {
+        return false;
+    }
+    roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(_mm_cmpeq_epi8(in, _mm_set1_epi8('/')), hi_nibble));
+    *codes = _mm_add_epi8(in, roll);
+    return true;
+}
+
+/* Pack 16 codes to 12 bytes, at the beginning of the lane */
+__attribute__((target("ssse3")))
+static inline __m128i dec_pack_ssse3(__m128i codes) {
+    __m128i t;
+
+    t = _mm_maddubs_epi16(codes, _mm_set1_epi32(0x01400140));
+    t = _mm_madd_epi16(t, _mm_set1_epi32(0x00011000));
+    return _mm_shuffle_epi8(t, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+}
+
+__attribute__((target("ssse3")))
+static int encode_ssse3(const uint8_t * in, int size, char * out) {
+    int i = 0; /* bytes consumed */
+    int j = 0; /* chars written */
+
+    while ((size - i) >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(in + i));
+        _mm_storeu_si128((__m128i *)(out + j), enc_ascii_ssse3(enc_split_ssse3(v)));
+        i += 12;
+        j += 16;
+    }
+    return i;
+}
+
+__attribute__((target("ssse3")))
+static int decode_ssse3(const char * in, int size, uint8_t * out, int max_len) {
+    int i = 0; /* chars consumed */
+    int j = 0; /* bytes written */
+    __m128i codes;
+
+    while (((size - i) >= 16) && ((max_len - j) >= 16)) {
+        if (dec_codes_ssse3(_mm_loadu_si128((const __m128i *)(in + i)), &codes) == false) {
+            break;
+        }
+        _mm_storeu_si128((__m128i *)(out + j), dec_pack_ssse3(codes));
+        i += 16;
+        j += 12;
+    }
+    return i;
+}
+
+/* The AVX2 versions process 2 lanes of 12 bytes / 16 chars at once */
+
+__attribute__((target("avx2")))
+static int encode_avx2(const uint8_t * in, int size, char * out) {
+    const __m256i shuf = _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+                                         10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+    const __m256i offsets = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                             '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+                                             'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                             '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    int i = 0; /* bytes consumed */
+    int j = 0; /* chars written */
+    __m256i v, t0, t1, t2, t3, range;
+
+    while ((size - i) >= 28) {
+        v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(in + i))),
+                                    _mm_loadu_si128((const __m128i *)(in + i + 12)), 1);
+        v = _mm256_shuffle_epi8(v, shuf);
+        t0 = _mm256_and_si256(v, _mm256_set1_epi32(0x0fc0fc00));
+        t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+        t2 = _mm256_and_si256(v, _mm256_set1_epi32(0x003f03f0));
+        t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+        v = _mm256_or_si256(t1, t3);
+        range = _mm256_subs_epu8(v, _mm256_set1_epi8(51));
+        range = _mm256_or_si256(range, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), v), _mm256_set1_epi8(13)));
+        v = _mm256_add_epi8(v, _mm256_shuffle_epi8(offsets, range));
+        _mm256_storeu_si256((__m256i *)(out + j), v);
+        i += 24;
+        j += 32;
+    }
+    /* finish with 128-bit lanes */
+    return i + encode_ssse3(in + i, size - i, out + j);
+}
+
+__attribute__((target("avx2")))
+static int decode_avx2(const char * in, int size, uint8_t * out, int max_len) {
+    const __m256i lut_lo = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+                                            0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m256i lut_hi = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+                                            0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i lut_roll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+                                              0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i pack = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                          2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m256i mask_nibble = _mm256_set1_epi8(0x0F);
+    int i = 0; /* chars consumed */
+    int j = 0; /* bytes written */
+    __m256i v, hi_nibble, lo, hi, roll;
+
+    while (((size - i) >= 32) && ((max_len - j) >= 32)) {
+        v = _mm256_loadu_si256((const __m256i *)(in + i));
+        hi_nibble = _mm256_and_si256(_mm256_srli_epi32(v, 4), mask_nibble);
+        lo = _mm256_shuffle_epi8(lut_lo, _mm256_and_si256(v, mask_nibble));
+        hi = _mm256_shuffle_epi8(lut_hi, hi_nibble);
+        if (_mm256_testz_si256(lo, hi) == 0) {
+            break;
+        }
+        roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('/')), hi_nibble));
+        v = _mm256_add_epi8(v, roll);
+        v = _mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140));
+        v = _mm256_madd_epi16(v, _mm256_set1_epi32(0x00011000));
+        v = _mm256_shuffle_epi8(v, pack);
+        v = _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7)); /* 24 bytes at the beginning */
+        _mm256_storeu_si256((__m256i *)(out + j), v);
+        i += 32;
+        j += 24;
+    }
+    /* finish with 128-bit lanes */
+    return i + decode_ssse3(in + i, size - i, out + j, max_len - j);
+}
+
+#endif /* B64_SIMD_X86 */
+
+#ifdef B64_SIMD_NEON
+
+/* 16 entries table lookup */
+static inline uint8x16_t lut16_neon(uint8x16_t table, uint8x16_t idx) {
+#if defined(__aarch64__)
+    return vqtbl1q_u8(table, idx);
+#else
+    uint8x8x2_t t = {{ vget_low_u8(table), vget_high_u8(table) }};
+    return vcombine_u8(vtbl2_u8(t, vget_low_u8(idx)), vtbl2_u8(t, vget_high_u8(idx)));
+#endif
+}
+
+static inline bool any_nonzero_neon(uint8x16_t v) {
+#if defined(__aarch64__)
+    return (vmaxvq_u8(v) != 0);
+#else
+    uint8x8_t m = vorr_u8(vget_low_u8(v), vget_high_u8(v));
+    return (vget_lane_u64(vreinterpret_u64_u8(m), 0) != 0);
+#endif
+}
+
+/* Convert 16 codes to ASCII: an offset is added, selected by the code range */
+static inline uint8x16_t enc_ascii_neon(uint8x16_t codes) {
+    static const uint8_t offsets[16] = { (uint8_t)('a' - 26), (uint8_t)('0' - 52), (uint8_t)('0' - 52), (uint8_t)('0' - 52),
+                                         (uint8_t)('0' - 52), (uint8_t)('0' - 52), (uint8_t)('0' - 52), (uint8_t)('0' - 52),
+                                         (uint8_t)('0' - 52), (uint8_t)('0' - 52), (uint8_t)('0' - 52), (uint8_t)('+' - 62),
+                                         (uint8_t)('/' - 63), 'A', 0, 0 };
+    uint8x16_t range;
+
+    range = vqsubq_u8(codes, vdupq_n_u8(51));
+    range = vorrq_u8(range, vandq_u8(vcltq_u8(codes, vdupq_n_u8(26)), vdupq_n_u8(13)));
+    return vaddq_u8(codes, lut16_neon(vld1q_u8(offsets), range));
+}
+
+/* Convert 16 ASCII chars to codes, return false if any char is invalid */
+static inline bool dec_codes_neon(uint8x16_t in, uint8x16_t * codes) {
+    static const uint8_t lut_lo[16] = { 0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A };
+    static const uint8_t lut_hi[16] = { 0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10 };
+    static const uint8_t lut_roll[16] = { 0, 16, 19, 4, (uint8_t)-65, (uint8_t)-65, (uint8_t)-71, (uint8_t)-71, 0, 0, 0, 0, 0, 0, 0, 0 };
+    uint8x16_t hi_nibble, lo, hi, roll;
+
+    hi_nibble = vshrq_n_u8(in, 4);
+    lo = lut16_neon(vld1q_u8(lut_lo), vandq_u8(in, vdupq_n_u8(0x0F)));
+    hi = lut16_neon(vld1q_u8(lut_hi), hi_nibble);
+    if (any_nonzero_neon(vandq_u8(lo, hi))) {
+        return false;
+    }
+    roll = lut16_neon(vld1q_u8(lut_roll), vaddq_u8(vceqq_u8(in, vdupq_n_u8('/')), hi_nibble));
+    *codes = vaddq_u8(in, roll);
+    return true;
+}
+
+/* The NEON versions de-interleave 16 blocks at once */
+
+static int encode_neon(const uint8_t * in, int size, char * out) {
+    const uint8x16_t mask = vdupq_n_u8(0x3F);
+    int i = 0; /* bytes consumed */
+    int j = 0; /* chars written */
+    uint8x16x3_t v;
+    uint8x16x4_t c;
+
+    while ((size - i) >= 48) {
+        v = vld3q_u8(in + i);
+        c.val[0] = vshrq_n_u8(v.val[0], 2);
+        c.val[1] = vandq_u8(vorrq_u8(vshlq_n_u8(v.val[0], 4), vshrq_n_u8(v.val[1], 4)), mask);
+        c.val[2] = vandq_u8(vorrq_u8(vshlq_n_u8(v.val[1], 2), vshrq_n_u8(v.val[2], 6)), mask);
+        c.val[3] = vandq_u8(v.val[2], mask);
+        c.val[0] = enc_ascii_neon(c.val[0]);
+        c.val[1] = enc_ascii_neon(c.val[1]);
+        c.val[2] = enc_ascii_neon(c.val[2]);
+        c.val[3] = enc_ascii_neon(c.val[3]);
+        vst4q_u8((uint8_t *)(out + j), c);
+        i += 48;
+        j += 64;
+    }
+    return i;
+}
+
+static int decode_neon(const char * in, int size, uint8_t * out, int max_len) {
+    int i = 0; /* chars consumed */
+    int j = 0; /* bytes written */
+    uint8x16x4_t v;
+    uint8x16x3_t b;
+
+    while (((size - i) >= 64) && ((max_len - j) >= 48)) {
+        v = vld4q_u8((const uint8_t *)(in + i));
+        if (!dec_codes_neon(v.val[0], &v.val[0]) || !dec_codes_neon(v.val[1], &v.val[1]) ||
+            !dec_codes_neon(v.val[2], &v.val[2]) || !dec_codes_neon(v.val[3], &v.val[3])) {
+            break;
+        }
+        b.val[0] = vorrq_u8(vshlq_n_u8(v.val[0], 2), vshrq_n_u8(v.val[1], 4));
+        b.val[1] = vorrq_u8(vshlq_n_u8(v.val[1], 4), vshrq_n_u8(v.val[2], 2));
+        b.val[2] = vorrq_u8(vshlq_n_u8(v.val[2], 6), v.val[3]);
+        vst3q_u8(out + j, b);
+        i += 64;
+        j += 48;
+    }
+    return i;
+}
+
+#endif /* B64_SIMD_NEON */
+
+static void select_impl(void) {
+    if (impl_selected == false) {
+        b64_select_impl(1);
+    }
+}
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
 
+const char * b64_select_impl(int simd) {
+    encode_simd = NULL;
+    decode_simd = NULL;
+    impl_name = "scalar";
+    if (simd != 0) {
+#ifdef B64_SIMD_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            encode_simd = encode_avx2;
+            decode_simd = decode_avx2;
+            impl_name = "avx2";
+        } else if (__builtin_cpu_supports("ssse3")) {
+            encode_simd = encode_ssse3;
+            decode_simd = decode_ssse3;
+            impl_name = "ssse3";
+        }
+#endif
+#ifdef B64_SIMD_NEON
+        encode_simd = encode_neon;
+        decode_simd = decode_neon;
+        impl_name = "neon";
+#endif
+    }
+    impl_selected = true;
+    return impl_name;
+}
+
 int bin_to_b64_nopad(const uint8_t * in, int size, char * out, int max_len) {
     int i;
     int result_len; /* size of the result */
@@ -127,8 +454,13 @@ int bin_to_b64_nopad(const uint8_t * in, int size, char * out, int max_len) {
         return -1;
     }
 
-    /* process all the full blocks */
-    for (i=0; i < full_blocks; ++i) {
+    /* process the full blocks, with SIMD first if available */
+    select_impl();
+    i = 0;
+    if (encode_simd != NULL) {
+        i = encode_simd(in, size, out) / 3;
+    }
+    for (; i < full_blocks; ++i) {
         b  = (0xFF & in[3*i]    ) << 16;
         b |= (0xFF & in[3*i + 1]) << 8;
         b |=  0xFF & in[3*i + 2];
@@ -204,8 +536,13 @@ int b64_to_bin_nopad(const char * in, int size, uint8_t * out, int max_len) {
         return -1;
     }
 
-    /* process all the full blocks */
-    for (i=0; i < full_blocks; ++i) {
+    /* process the full blocks, with SIMD first if available */
+    select_impl();
+    i = 0;
+    if (decode_simd != NULL) {
+        i = decode_simd(in, 4*full_blocks, out, max_len) / 4;
+    }
+    for (; i < full_blocks; ++i) {
         b  = (0x3F & char_to_code(in[4*i]    )) << 18;
         b |= (0x3F & char_to_code(in[4*i + 1])) << 12;
         b |= (0x3F & char_to_code(in[4*i + 2])) << 6;
@@ -294,5 +631,26 @@ int b64_to_bin(const char * in, int size, uint8_t * out, int max_len) {
     }
 }
 
+int bin_to_b64_batch(const uint8_t * const in[], const int size[], int nb, char * out, int max_len, int len[]) {
+    int i;
+    int ret;
+    int n = 0; /* chars written, null chars included */
+
+    if ((in == NULL) || (size == NULL) || (out == NULL)) {
+        DEBUG("ERROR: NULL POINTER AS OUTPUT OR INPUT IN BIN_TO_B64_BATCH\n");
+        return -1;
+    }
+    for (i = 0; i < nb; i++) {
+        ret = bin_to_b64(in[i], size[i], out + n, max_len - n);
+        if (ret == -1) {
+            return -1;
+        }
+        if (len != NULL) {
+            len[i] = ret;
+        }
+        n += ret + 1;
+    }
+    return n;
+}
 
 /* --- EOF ------------------------------------------------------------------ */
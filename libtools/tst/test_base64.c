@@ -0,0 +1,184 @@
+/*!
+ * \brief     Check the SIMD Base64 code against the portable one, and measure their speed
+ *
+ * License: Revised BSD 3-Clause License, see LICENSE.TXT file include in the project
+ */
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdio.h>      /* printf */
+#include <stdlib.h>     /* EXIT_FAILURE, rand */
+#include <unistd.h>     /* getopt */
+#include <string.h>     /* memcmp, memset */
+#include <time.h>       /* clock_gettime */
+
+#include "base64.h"
+#include "bench.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define SIZE_MAX_TEST   600     /* biggest payload checked */
+#define PAYLOAD_SIZE    255     /* payload size for the benchmark */
+#define NB_PAYLOAD      3       /* payloads per batch for the benchmark (1 per radio) */
+#define CANARY          0xA5
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static uint8_t bin[SIZE_MAX_TEST];
+static uint8_t dec[SIZE_MAX_TEST + 16];
+static char ref[SIZE_MAX_TEST * 2];
+static char enc[SIZE_MAX_TEST * 2];
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* describe command line options */
+void usage(void) {
+    printf("Available options:\n");
+    printf(" -h print this help\n");
+    printf(" -n <uint>  number of batches of %d payloads of %d bytes for the benchmark [1..]\n", NB_PAYLOAD, PAYLOAD_SIZE);
+}
+
+static int check(void) {
+    int size, n_ref, n, k;
+    int nb_err = 0;
+
+    for (size = 0; size < SIZE_MAX_TEST; size++) {
+        for (k = 0; k < size; k++) {
+            bin[k] = (uint8_t)rand();
+        }
+
+        /* encoding */
+        b64_select_impl(0);
+        n_ref = bin_to_b64(bin, size, ref, sizeof ref);
+        b64_select_impl(1);
+        memset(enc, CANARY, sizeof enc);
+        n = bin_to_b64(bin, size, enc, n_ref + 1); /* exact output size */
+        if ((n != n_ref) || (memcmp(enc, ref, n + 1) != 0) || ((uint8_t)enc[n + 1] != CANARY)) {
+            printf("ERROR: encoding mismatch for %d bytes\n", size);
+            nb_err += 1;
+            continue;
+        }
+
+        /* decoding, padded and not padded */
+        memset(dec, CANARY, sizeof dec);
+        n = b64_to_bin(enc, n_ref, dec, size); /* exact output size */
+        if ((n != size) || (memcmp(dec, bin, size) != 0) || (dec[size] != CANARY)) {
+            printf("ERROR: decoding mismatch for %d bytes\n", size);
+            nb_err += 1;
+        }
+        n = bin_to_b64_nopad(bin, size, enc, sizeof enc);
+        if ((b64_to_bin_nopad(enc, n, dec, sizeof dec) != size) || (memcmp(dec, bin, size) != 0)) {
+            printf("ERROR: unpadded decoding mismatch for %d bytes\n", size);
+            nb_err += 1;
+        }
+    }
+
+    return nb_err;
+}
+
+static double bench_encode(unsigned int nb_loop) {
+    const uint8_t *in[NB_PAYLOAD];
+    int size[NB_PAYLOAD];
+    static char out[NB_PAYLOAD * (PAYLOAD_SIZE * 2)];
+    struct timespec start, end;
+    unsigned int i;
+    int k;
+
+    for (k = 0; k < NB_PAYLOAD; k++) {
+        in[k] = bin + k * 16;
+        size[k] = PAYLOAD_SIZE;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < nb_loop; i++) {
+        if (bin_to_b64_batch(in, size, NB_PAYLOAD, out, sizeof out, NULL) < 0) {
+            return -1.0;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return elapsed_ns(start, end) / ((double)nb_loop * NB_PAYLOAD);
+}
+
+static double bench_decode(unsigned int nb_loop) {
+    struct timespec start, end;
+    unsigned int i;
+    int n, k;
+
+    n = bin_to_b64(bin, PAYLOAD_SIZE, enc, sizeof enc);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < nb_loop; i++) {
+        for (k = 0; k < NB_PAYLOAD; k++) {
+            if (b64_to_bin(enc, n, dec, sizeof dec) != PAYLOAD_SIZE) {
+                return -1.0;
+            }
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return elapsed_ns(start, end) / ((double)nb_loop * NB_PAYLOAD);
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv) {
+    int i, j;
+    unsigned int arg_u;
+    unsigned int nb_loop = 100000;
+    const char *name;
+    double enc_ref, dec_ref, enc_simd, dec_simd;
+
+    /* parse command line options */
+    while ((i = getopt (argc, argv, "hn:")) != -1) {
+        switch (i) {
+            case 'h':
+                usage();
+                return EXIT_SUCCESS;
+            case 'n':
+                j = sscanf(optarg, "%u", &arg_u);
+                if ((j != 1) || (arg_u < 1)) {
+                    printf("ERROR: argument parsing of -n argument. Use -h to print help\n");
+                    return EXIT_FAILURE;
+                }
+                nb_loop = arg_u;
+                break;
+            default:
+                printf("ERROR: argument parsing\n");
+                usage();
+                return EXIT_FAILURE;
+        }
+    }
+
+    /* check the selected implementation against the portable one */
+    srand(1);
+    name = b64_select_impl(1);
+    if (check() != 0) {
+        printf("FAILED: %s implementation\n", name);
+        return EXIT_FAILURE;
+    }
+    printf("Base64 %s implementation matches the scalar one\n", name);
+
+    /* benchmark both */
+    b64_select_impl(0);
+    enc_ref = bench_encode(nb_loop);
+    dec_ref = bench_decode(nb_loop);
+    b64_select_impl(1);
+    enc_simd = bench_encode(nb_loop);
+    dec_simd = bench_decode(nb_loop);
+    printf("encoding %d bytes: scalar %.0f ns, %s %.0f ns (x%.1f)\n", PAYLOAD_SIZE, enc_ref, name, enc_simd, enc_ref / enc_simd);
+    printf("decoding %d bytes: scalar %.0f ns, %s %.0f ns (x%.1f)\n", PAYLOAD_SIZE, dec_ref, name, dec_simd, dec_ref / dec_simd);
+
+    return EXIT_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,137 @@
+/*!
+ * \brief     LoRa 2.4Ghz concentrator : TX airtime accounting over a sliding window
+ *
+ * License: Revised BSD 3-Clause License, see LICENSE.TXT file include in the project
+ */
+
+#ifndef _LORA_PKTFWD_AIRTIME_H
+#define _LORA_PKTFWD_AIRTIME_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <pthread.h>
+
+#include "loragw_hal.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define AIRTIME_NB_BIN          60      /* Number of bins the window is cut into, the window slides by one bin at a time */
+#define AIRTIME_NB_CHAN_MAX     16      /* Maximum number of TX frequencies accounted separately */
+#define AIRTIME_WINDOW_MAX_S    3600    /* Longest window, for 100% of it to fit in 32 bits of microseconds */
+#define AIRTIME_WINDOW_DEFAULT  3600    /* Default window, in seconds */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/*
+TX time accumulated during the last AIRTIME_NB_BIN bins, bin number "last" being
+the current one, stored at index last % AIRTIME_NB_BIN. The airtime of the
+packets queued is kept apart until they are sent or dropped.
+*/
+struct airtime_bins_s {
+    uint64_t last;                      /* Number of the current bin, host time divided by the bin duration */
+    uint32_t sum_us;                    /* Airtime of the whole window, in microseconds */
+    uint32_t pending_us;                /* Airtime of the packets queued and not sent yet, in microseconds */
+    uint32_t bin_us[AIRTIME_NB_BIN];    /* Airtime of each bin, in microseconds */
+};
+
+struct airtime_s {
+    pthread_mutex_t mx;                 /* Control access to the ledger, updated by the downstream thread and read for statistics */
+    uint32_t bin_ms;                    /* Duration of a bin, in milliseconds */
+    uint32_t max_radio_us;              /* Airtime budget of a TX radio over the window, 0 for no limit */
+    uint32_t max_chan_us;               /* Airtime budget of a TX frequency over the window, 0 for no limit */
+    struct airtime_bins_s radio[LGW_TX_CHANNEL_NB_MAX];
+    uint8_t nb_chan;                    /* Number of TX frequencies used */
+    uint32_t chan_freq[AIRTIME_NB_CHAN_MAX]; /* TX frequency of each channel, in Hz */
+    struct airtime_bins_s chan[AIRTIME_NB_CHAN_MAX];
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Initialize an airtime ledger.
+
+@param at[in] Ledger to be initialized. Memory should have been allocated already.
+@param window_s[in] Duration of the sliding window, in seconds [1..AIRTIME_WINDOW_MAX_S]
+@param max_radio[in] Airtime budget of each TX radio, in percent of the window, 0 for no limit
+@param max_chan[in] Airtime budget of each TX frequency, in percent of the window, 0 for no limit
+@return 0 if the parameters are valid, -1 otherwise
+*/
+int airtime_init(struct airtime_s *at, uint32_t window_s, float max_radio, float max_chan);
+
+/**
+@brief Check if a packet fits in the airtime budgets of a radio and of its frequency, the packets queued included.
+
+@param at[in/out] Airtime ledger
+@param time_ms[in] Current host time, in milliseconds on a monotonic clock
+@param radio[in] TX radio the packet would be sent by
+@param freq_hz[in] TX frequency of the packet
+@param toa_us[in] Time on air of the packet, in microseconds
+@return true if the packet can be sent, false if it would exceed a budget
+*/
+bool airtime_check(struct airtime_s *at, uint64_t time_ms, uint8_t radio, uint32_t freq_hz, uint32_t toa_us);
+
+/**
+@brief Account the time on air of a packet accepted for TX, as pending.
+
+@param at[in/out] Airtime ledger
+@param time_ms[in] Current host time, in milliseconds on a monotonic clock
+@param radio[in] TX radio the packet is to be sent by
+@param freq_hz[in] TX frequency of the packet
+@param toa_us[in] Time on air of the packet, in microseconds
+
+The packets waiting in the JiT queues are part of the budget. Their airtime is
+moved to the window by airtime_sent(), or given back by airtime_sub().
+*/
+void airtime_add(struct airtime_s *at, uint64_t time_ms, uint8_t radio, uint32_t freq_hz, uint32_t toa_us);
+
+/**
+@brief Move the pending airtime of a packet to the window, once it is sent.
+
+@param at[in/out] Airtime ledger
+@param time_ms[in] Current host time, in milliseconds on a monotonic clock
+@param radio[in] TX radio the packet was sent by
+@param freq_hz[in] TX frequency of the packet
+@param toa_us[in] Time on air of the packet, in microseconds
+*/
+void airtime_sent(struct airtime_s *at, uint64_t time_ms, uint8_t radio, uint32_t freq_hz, uint32_t toa_us);
+
+/**
+@brief Give back the pending airtime of a packet which is not sent.
+
+@param at[in/out] Airtime ledger
+@param radio[in] TX radio the packet was queued for
+@param freq_hz[in] TX frequency of the packet
+@param toa_us[in] Time on air of the packet, in microseconds
+*/
+void airtime_sub(struct airtime_s *at, uint8_t radio, uint32_t freq_hz, uint32_t toa_us);
+
+/**
+@brief Get the occupancy of a TX radio over the window.
+
+@param at[in/out] Airtime ledger
+@param time_ms[in] Current host time, in milliseconds on a monotonic clock
+@param radio[in] TX radio
+@return airtime of the packets sent during the window, in percent of the window
+*/
+float airtime_radio_occupancy(struct airtime_s *at, uint64_t time_ms, uint8_t radio);
+
+/**
+@brief Get the occupancy of the TX frequencies over the window.
+
+@param at[in/out] Airtime ledger
+@param time_ms[in] Current host time, in milliseconds on a monotonic clock
+@param freq_hz[out] TX frequency of each channel, in Hz
+@param occupancy[out] Airtime of the packets sent on each channel, in percent of the window
+@param size[in] Number of elements of the arrays
+@return number of channels written in the arrays
+*/
+int airtime_chan_occupancy(struct airtime_s *at, uint64_t time_ms, uint32_t *freq_hz, float *occupancy, int size);
+
+#endif
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,95 @@
+/*!
+ * \brief     LoRa 2.4Ghz concentrator : binary framing of uplink and downlink packets
+ *
+ * License: Revised BSD 3-Clause License, see LICENSE.TXT file include in the project
+ */
+
+#ifndef _LORA_PKTFWD_BINPK_H
+#define _LORA_PKTFWD_BINPK_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+
+#include "loragw_hal.h"
+#include "txpk.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define BINPK_PROTOCOL_VERSION  3   /* protocol version byte of the datagrams in binary mode */
+
+#define BINPK_PUSH_HEADER_SIZE  2   /* number of rxpk records, flags */
+#define BINPK_RXPK_HEADER_SIZE  24  /* rxpk record, without its payload */
+#define BINPK_STAT_SIZE         28  /* stat record */
+#define BINPK_TXPK_HEADER_SIZE  18  /* txpk record, without its payload */
+
+/* Flags of the PUSH_DATA header */
+#define BINPK_PUSH_FLAG_STAT    0x01    /* a stat record follows the rxpk records */
+
+/* Flags of the txpk record */
+#define BINPK_TXPK_FLAG_IMME    0x01    /* send immediately, tmst is ignored */
+#define BINPK_TXPK_FLAG_IPOL    0x02    /* invert polarity */
+#define BINPK_TXPK_FLAG_NCRC    0x04    /* no CRC */
+
+#define BINPK_MODU_LORA         1
+
+/* Coderate field: 4/5 to 4/8 are coded 5 to 8, long interleaving adds 0x10 */
+#define BINPK_CODR_LI           0x10
+
+/* Maximum size of a rxpk record, for a given payload size */
+#define BINPK_RXPK_SIZE_MAX(size)   (BINPK_RXPK_HEADER_SIZE + (size))
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+struct binpk_stat_s {
+    uint32_t time;          /* UTC system time of the gateway, in seconds since the Epoch */
+    uint32_t rxnb;          /* Number of radio packets received */
+    uint32_t rxok;          /* Number of radio packets received with a valid PHY CRC */
+    uint32_t rxfw;          /* Number of radio packets forwarded */
+    float ackr;             /* Percentage of upstream datagrams that were acknowledged */
+    uint32_t dwnb;          /* Number of downlink datagrams received */
+    uint32_t txnb;          /* Number of packets emitted */
+    float temp;             /* Concentrator temperature in degree celcius */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Serialize received packets, and an optional status, as a binary PUSH_DATA payload.
+
+@param pkt[in] Array of pointers to the packets to be serialized
+@param nb_pkt[in] Number of packets in the array [0..255]
+@param stat[in] Status to be added after the packets, NULL if none
+@param buf[out] Buffer where the payload is written, after the 12-byte header
+@param buf_size[in] Size of the buffer
+@return the number of bytes written, -1 if one of the packets cannot be
+serialized or if the buffer is too small
+
+The payload starts with the number of rxpk records and the flags, followed by
+the fixed-layout records, each one immediately followed by its raw payload.
+Multi-byte fields are big endian, see PROTOCOL.md for the layout.
+*/
+int binpk_rxpk_serialize_batch(const struct lgw_pkt_rx_ref_s * const pkt[], int nb_pkt, const struct binpk_stat_s *stat, uint8_t *buf, int buf_size);
+
+/**
+@brief Parse a binary PULL_RESP payload.
+
+@param buf[in] Payload of the datagram, after the 4-byte header
+@param size[in] Size of the payload
+@param pkt[out] Packet filled with the record fields, the others are set to 0
+@param info[out] Fields found, and field in error if any
+@return TXPK_OK if the packet was parsed, an error code else (TXPK_ERROR_JSON
+if the record is truncated)
+
+The packet and info are filled the same way as txpk_parse() does, so that the
+caller handles both framings alike. A preamble of 0 leaves TXPK_FIELD_PREA
+unset, for the default preamble to be used.
+*/
+enum txpk_error_e binpk_txpk_parse(const uint8_t *buf, int size, struct lgw_pkt_tx_s *pkt, struct txpk_info_s *info);
+
+#endif
+/* --- EOF ------------------------------------------------------------------ */
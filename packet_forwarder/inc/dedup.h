@@ -0,0 +1,86 @@
+/*!
+ * \brief     LoRa 2.4Ghz concentrator : removal of the uplinks received by several radios
+ *
+ * License: Revised BSD 3-Clause License, see LICENSE.TXT file include in the project
+ */
+
+#ifndef _LORA_PKTFWD_DEDUP_H
+#define _LORA_PKTFWD_DEDUP_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+
+#include "loragw_hal.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define DEDUP_HIST_NB           64      /* Number of packets remembered, must be a power of 2 */
+#define DEDUP_WINDOW_DEFAULT    10000   /* Default count_us window, in microseconds */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/* Packet forwarded, identified by a hash of its payload */
+struct dedup_entry_s {
+    uint32_t hash;                      /* FNV-1a hash of the payload */
+    uint32_t count_us;                  /* Timestamp of the packet, on the counter of its board */
+    uint16_t size;
+    uint8_t brd;                        /* Board the packet was received by */
+    bool valid;
+    int idx;                            /* Index of the packet in the batch being filtered, -1 for older batches */
+};
+
+/*
+Ring of the packets last forwarded, the oldest entry being overwritten, used by
+the upstream thread only.
+*/
+struct dedup_s {
+    uint32_t window_us;                 /* Largest count_us difference between copies of a packet */
+    uint32_t last;                      /* Number of packets remembered, the next one is at last % DEDUP_HIST_NB */
+    struct dedup_entry_s hist[DEDUP_HIST_NB];
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Initialize a deduplication history.
+
+@param dd[in] History to be initialized. Memory should have been allocated already.
+@param window_us[in] Largest count_us difference between two copies of a packet, in microseconds
+*/
+void dedup_init(struct dedup_s *dd, uint32_t window_us);
+
+/**
+@brief Compute the hash identifying a payload.
+
+@param payload[in] Payload of the packet
+@param size[in] Size of the payload, in bytes
+@return FNV-1a 32-bit hash of the payload
+*/
+uint32_t dedup_hash(const uint8_t *payload, uint16_t size);
+
+/**
+@brief Remove from a batch of packets the copies of a same packet.
+
+@param dd[in/out] History of the packets forwarded
+@param pkt[in/out] Packets of the batch, compacted in place
+@param brd[in/out] Board of each packet, compacted in place
+@param time_us[in/out] Host time of each packet, compacted in place
+@param nb[in] Number of packets of the batch
+@return number of packets kept, at the beginning of the arrays
+
+Packets of a same board with the same payload, and count_us not more than the
+window apart, are copies of a same packet: the one with the highest RSSI is kept,
+with its board and host time, at the place of the first copy. A copy of a packet already
+forwarded by a previous batch is dropped. Counters of different boards are not
+related, their packets are never considered as copies.
+*/
+int dedup_filter(struct dedup_s *dd, const struct lgw_pkt_rx_ref_s **pkt, uint8_t *brd, uint64_t *time_us, int nb);
+
+#endif
+/* --- EOF ------------------------------------------------------------------ */
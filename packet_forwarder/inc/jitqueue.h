@@ -22,6 +22,15 @@
 #define JIT_QUEUE_MAX           32  /* Maximum number of packets to be stored in JiT queue */
 #define JIT_NUM_BEACON_IN_QUEUE 3   /* Number of beacons to be loaded in JiT queue at any time */
 
+#define TX_START_DELAY          1500    /* microseconds */
+#define TX_MARGIN_DELAY         1000    /* Packet overlap margin in microseconds */
+#define TX_JIT_DELAY            30000   /* Pre-delay to program packet for TX in microseconds */
+#define TX_MAX_ADVANCE_DELAY    ((JIT_NUM_BEACON_IN_QUEUE + 1) * 128 * 1E6) /* Maximum advance delay accepted for a TX packet, compared to current time */
+
+#define BEACON_GUARD            3000000 /* Interval where no ping slot can be placed,
+                                            to ensure beacon can be sent */
+#define BEACON_RESERVED         2120000 /* Time on air of the beacon, with some margin */
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC TYPES --------------------------------------------------------- */
 
@@ -43,6 +52,7 @@ enum jit_error_e {
     JIT_ERROR_TX_FREQ,      /* The required frequency for downlink is not supported */
     JIT_ERROR_TX_POWER,     /* The required power for downlink is not supported */
     JIT_ERROR_GPS_UNLOCKED, /* GPS timestamp could not be used as GPS is unlocked */
+    JIT_ERROR_AIRTIME,      /* The airtime budget of the TX radios or of the frequency would be exceeded */
     JIT_ERROR_INVALID       /* Packet is invalid */
 };
 
@@ -56,10 +66,23 @@ struct jit_node_s {
     uint32_t post_delay;            /* Amount of time after packet timestamp to be reserved (time on air) */
 };
 
+/**
+@brief Function called when a queued packet is dropped, see jit_queue_set_drop_cb()
+@param pkt packet dropped, its rf_chain being the radio it was queued for
+@param pkt_type type of the packet dropped
+@param arg user argument given to jit_queue_set_drop_cb()
+*/
+typedef void (*jit_drop_cb)(const struct lgw_pkt_tx_s *pkt, enum jit_pkt_type_e pkt_type, void *arg);
+
 struct jit_queue_s {
     uint8_t num_pkt;                /* Total number of packets in the queue (downlinks, beacons...) */
     uint8_t num_beacon;             /* Number of beacons in the queue */
-    struct jit_node_s nodes[JIT_QUEUE_MAX]; /* Nodes/packets array in the queue */
+    uint8_t index[JIT_QUEUE_MAX];   /* Nodes in ascending order of packet timestamp, the num_pkt first ones are in use, the others are free */
+    uint32_t max_pre_delay;         /* Longest pre_delay of the packets queued since the queue was last empty */
+    uint32_t max_post_delay;        /* Longest post_delay of the packets queued since the queue was last empty */
+    struct jit_node_s nodes[JIT_QUEUE_MAX]; /* Nodes/packets pool, ordered through index */
+    jit_drop_cb drop_cb;            /* Called for each outdated packet dropped by jit_peek, NULL if none */
+    void *drop_arg;                 /* User argument of drop_cb */
 };
 
 /* -------------------------------------------------------------------------- */
@@ -90,6 +113,15 @@ This function is used to reset every elements in the allocated queue.
 */
 void jit_queue_init(struct jit_queue_s *queue);
 
+/**
+@brief Set the function called when jit_peek drops an outdated packet of a JiT queue.
+
+@param queue[in/out] Just in Time queue, initialized already
+@param cb[in] function to be called, with the JiT queue locked, NULL for none
+@param arg[in] user argument passed to the function
+*/
+void jit_queue_set_drop_cb(struct jit_queue_s *queue, jit_drop_cb cb, void *arg);
+
 /**
 @brief Add a packet in a Just-in-Time queue
 
@@ -109,7 +141,7 @@ enum jit_error_e jit_enqueue(struct jit_queue_s *queue, uint32_t time_us, struct
 @brief Dequeue a packet from a Just-in-Time queue
 
 @param queue[in/out] Just in Time queue from which the packet should be removed
-@param index[in] in the queue where to get the packet to be removed
+@param index[in] node of the queue where to get the packet to be removed
 @param packet[out] that was at index
 @param pkt_type[out] Type of packet dequeued: Downlink, Beacon
 @return success if the function was able to dequeue the packet
@@ -124,15 +156,31 @@ enum jit_error_e jit_dequeue(struct jit_queue_s *queue, int index, struct lgw_pk
 
 @param queue[in] Just in Time queue to parse for peeking a packet
 @param time_us[in] Current concentrator time
-@param pkt_idx[out] Packet index which is soon to be dequeued.
+@param pkt_idx[out] Node index of the packet which is soon to be dequeued.
 @return success if the function was able to parse the queue. pkt_idx is set to -1 if no packet found.
 
 This function is typically used to check in JiT queue if there is a packet soon to be sent.
-It search the packet with the highest priority in queue, and check if its timestamp is near
-enough the current concentrator time.
+The packet with the highest priority is the first one of the queue, its timestamp is checked to
+be near enough the current concentrator time. Outdated packets are dropped first,
+and reported to the drop callback of the queue.
 */
 enum jit_error_e jit_peek(struct jit_queue_s *queue, uint32_t time_us, int *pkt_idx);
 
+/**
+@brief Wait until a packet of the JiT queues is soon to be sent, or a new packet becomes the first of a queue.
+
+@param queue[in] Array of Just in Time queues to be waited for
+@param nb_queue[in] Number of queues in the array
+@param time_us[in] Current concentrator time
+@param max_wait_us[in] Maximum time to wait, in microseconds
+@return lateness of the wakeup after the end of the wait in microseconds, -1 if woken by a new packet or not waiting
+
+This function is typically used by the thread dequeuing the packets, to call jit_peek()
+only when a packet may be found. The concentrator time is converted to host time by
+assuming both clocks have the same rate, the caller just peeks again if it woke up early.
+*/
+int32_t jit_wait(struct jit_queue_s *queue, int nb_queue, uint32_t time_us, uint32_t max_wait_us);
+
 /**
 @brief Debug function to print the queue's content on console
 
@@ -0,0 +1,113 @@
+/*!
+ * \brief     LoRa 2.4Ghz concentrator : lock-free statistics counters
+ *
+ * License: Revised BSD 3-Clause License, see LICENSE.TXT file include in the project
+ */
+
+#ifndef _LORA_PKTFWD_MEAS_H
+#define _LORA_PKTFWD_MEAS_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define MEAS_NB_SLOT    16  /* Number of threads with their own counters, others share an extra set */
+#define MEAS_CACHE_LINE 64  /* Alignment of the counters of each thread, in bytes */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/* Counters, monotonic since meas_init */
+enum meas_e {
+    MEAS_NB_RX_RCV,                     /* packets received */
+    MEAS_NB_RX_OK,                      /* packets received with PAYLOAD CRC OK */
+    MEAS_NB_RX_BAD,                     /* packets received with PAYLOAD CRC ERROR */
+    MEAS_NB_RX_NOCRC,                   /* packets received with NO PAYLOAD CRC */
+    MEAS_NB_RX_LOST,                    /* packets lost because the concentrator RX buffer was full */
+    MEAS_UP_PKT_FWD,                    /* radio packets forwarded to the server */
+    MEAS_UP_DEDUP,                      /* radio packets not forwarded, copies of another one received by several radios */
+    MEAS_UP_NETWORK_BYTE,               /* UDP bytes sent for upstream traffic */
+    MEAS_UP_PAYLOAD_BYTE,               /* radio payload bytes sent for upstream traffic */
+    MEAS_UP_DGRAM_SENT,                 /* datagrams sent for upstream traffic */
+    MEAS_UP_ACK_RCV,                    /* datagrams acknowledged for upstream traffic */
+    MEAS_UP_ACK_LOST,                   /* datagrams not acknowledged before time-out */
+    MEAS_UP_ACK_RTT_SUM,                /* PUSH_ACK round-trip times, in ms */
+    MEAS_DW_PULL_SENT,                  /* PULL requests sent for downstream traffic */
+    MEAS_DW_ACK_RCV,                    /* PULL requests acknowledged for downstream traffic */
+    MEAS_DW_DGRAM_RCV,                  /* PULL response datagrams received for downstream traffic */
+    MEAS_DW_NETWORK_BYTE,               /* UDP bytes received for downstream traffic */
+    MEAS_DW_PAYLOAD_BYTE,               /* radio payload bytes received for downstream traffic */
+    MEAS_NB_TX_OK,                      /* packets emitted successfully */
+    MEAS_NB_TX_FAIL,                    /* packets which TX failed for other reasons */
+    MEAS_NB_TX_REQUESTED,               /* TX requests from server (downlinks) */
+    MEAS_NB_TX_REJ_COLLISION_PACKET,    /* TX requests rejected due to collision with a packet already programmed */
+    MEAS_NB_TX_REJ_COLLISION_BEACON,    /* TX requests rejected due to collision with a beacon already programmed */
+    MEAS_NB_TX_REJ_TOO_LATE,            /* TX requests rejected because it is too late to program them */
+    MEAS_NB_TX_REJ_TOO_EARLY,           /* TX requests rejected because their timestamp is too much in advance */
+    MEAS_NB_TX_REJ_AIRTIME,             /* TX requests rejected because an airtime budget would be exceeded */
+    MEAS_JIT_LATE,                      /* JIT thread wakeups too late after their deadline */
+    MEAS_NB
+};
+
+/* Extreme values, reset each time they are collected */
+enum meas_peak_e {
+    MEAS_UP_ACK_RTT_MIN,                /* shortest PUSH_ACK round-trip time, in ms */
+    MEAS_UP_ACK_RTT_MAX,                /* longest PUSH_ACK round-trip time, in ms */
+    MEAS_NB_PEAK
+};
+
+/*
+Each thread updates its own set of counters, on its own cache lines, without
+any lock nor atomic read-modify-write. The collector reads all the sets, and
+computes the differences between two collections.
+*/
+struct meas_set_s {
+    uint64_t cnt[MEAS_NB];
+    uint32_t peak[MEAS_NB_PEAK];
+} __attribute__((aligned(MEAS_CACHE_LINE)));
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Clear all the counters.
+
+Must be called before the threads updating the counters are started.
+*/
+void meas_init(void);
+
+/**
+@brief Add to a counter of the calling thread.
+
+@param id[in] counter
+@param n[in] value added
+*/
+void meas_add(enum meas_e id, uint64_t n);
+
+/**
+@brief Update an extreme value with a new sample.
+
+@param id[in] extreme value, MEAS_UP_ACK_RTT_MIN keeps the lowest sample, MEAS_UP_ACK_RTT_MAX the highest
+@param value[in] sample
+*/
+void meas_peak(enum meas_peak_e id, uint32_t value);
+
+/**
+@brief Get the counters of all the threads, without lock.
+
+@param cnt[out] sum of each counter of the threads, since meas_init
+@param peak[out] extreme values since the previous collection of them (UINT32_MAX and 0 if no sample), NULL to leave them
+
+Counters are monotonic, the number of events between two collections is the
+difference of their values. An update made during the collection may only be
+accounted by the next one.
+*/
+void meas_collect(uint64_t cnt[MEAS_NB], uint32_t peak[MEAS_NB_PEAK]);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
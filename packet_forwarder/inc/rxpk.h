@@ -0,0 +1,84 @@
+/*!
+ * \brief     LoRa 2.4Ghz concentrator : JSON serialization of received packets
+ *
+ * License: Revised BSD 3-Clause License, see LICENSE.TXT file include in the project
+ */
+
+#ifndef _LORA_PKTFWD_RXPK_H
+#define _LORA_PKTFWD_RXPK_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+
+#include "loragw_hal.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define RXPK_FRAME_FORMAT   1   /* JSON rxpk frame format version (jver) */
+#define RXPK_META_SIZE_MAX  200 /* Maximum size of a rxpk object, without its base64 payload */
+
+/* Maximum size of a rxpk object, for a given payload size */
+#define RXPK_SIZE_MAX(size) (RXPK_META_SIZE_MAX + 4 * (((size) + 2) / 3))
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Serialize a received packet as a JSON rxpk object.
+
+@param pkt[in] Packet to be serialized
+@param buf[out] Buffer where the object is written, not null terminated
+@param buf_size[in] Size of the buffer
+@return the number of characters written, -1 if the packet cannot be serialized
+or if the buffer is smaller than RXPK_SIZE_MAX(pkt->size)
+
+Fields are written in the same order and with the same format as snprintf would
+("freq" with 6 decimals, "lsnr" with 1 decimal, rounded "rssi"), using integer
+arithmetic only.
+*/
+int rxpk_serialize(const struct lgw_pkt_rx_ref_s *pkt, char *buf, int buf_size);
+
+/**
+@brief Same as rxpk_serialize(), with the board that received the packet.
+
+@param pkt[in] Packet to be serialized
+@param brd[in] Board number written in the "brd" field [0..255], -1 for none
+@param buf[out] Buffer where the object is written, not null terminated
+@param buf_size[in] Size of the buffer
+@return the number of characters written, -1 if the packet cannot be serialized
+or if the buffer is smaller than RXPK_SIZE_MAX(pkt->size)
+*/
+int rxpk_serialize_brd(const struct lgw_pkt_rx_ref_s *pkt, int brd, char *buf, int buf_size);
+
+/**
+@brief Serialize several received packets as comma separated JSON rxpk objects.
+
+@param pkt[in] Array of pointers to the packets to be serialized
+@param nb_pkt[in] Number of packets in the array
+@param buf[out] Buffer where the objects are written, not null terminated
+@param buf_size[in] Size of the buffer
+@return the number of characters written, -1 if one of the packets cannot be
+serialized or if the buffer is too small
+
+The result is the content of the "rxpk" JSON array, without the brackets.
+*/
+int rxpk_serialize_batch(const struct lgw_pkt_rx_ref_s * const pkt[], int nb_pkt, char *buf, int buf_size);
+
+/**
+@brief Same as rxpk_serialize_batch(), with the board of each packet.
+
+@param pkt[in] Array of pointers to the packets to be serialized
+@param brd[in] Board of each packet, NULL for no "brd" field
+@param nb_pkt[in] Number of packets in the arrays
+@param buf[out] Buffer where the objects are written, not null terminated
+@param buf_size[in] Size of the buffer
+@return the number of characters written, -1 if one of the packets cannot be
+serialized or if the buffer is too small
+*/
+int rxpk_serialize_batch_brd(const struct lgw_pkt_rx_ref_s * const pkt[], const uint8_t brd[], int nb_pkt, char *buf, int buf_size);
+
+#endif
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,120 @@
+/*!
+ * \brief     LoRa 2.4Ghz concentrator : lock-free queue of received packets
+ *
+ * License: Revised BSD 3-Clause License, see LICENSE.TXT file include in the project
+ */
+
+#ifndef _LORA_PKTFWD_RXRING_H
+#define _LORA_PKTFWD_RXRING_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+
+#include "loragw_hal.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define RX_RING_SIZE    128 /* Maximum number of packets waiting to be forwarded, must be a power of 2 */
+
+#if (RX_RING_SIZE * 256) > LGW_RX_ARENA_SIZE
+    #error "the HAL RX arena must hold the payloads of a full RX ring"
+#endif
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/*
+Single producer, single consumer ring: the producer thread only writes head, the
+consumer thread only writes tail, both being free running counters. Only the
+packet descriptors are queued, their payloads stay in the HAL RX arena until
+the consumer releases them.
+*/
+struct rx_ring_s {
+    struct lgw_pkt_rx_ref_s pkt[RX_RING_SIZE]; /* Packets array */
+    uint64_t time_us[RX_RING_SIZE];         /* Host time each packet was pushed, for latency statistics */
+    uint32_t head;                          /* Number of packets pushed since init */
+    uint32_t tail;                          /* Number of packets popped since init */
+    uint32_t nb_drop;                       /* Number of packets dropped because the ring was full */
+    uint32_t nb_max;                        /* Highest number of packets queued, since last counters reset */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Initialize a RX ring.
+
+@param ring[in] RX ring to be initialized. Memory should have been allocated already.
+
+Must be called before the producer and consumer threads are started.
+*/
+void rx_ring_init(struct rx_ring_s *ring);
+
+/**
+@brief Get the next free packet slot of the ring (producer side).
+
+@param ring[in/out] RX ring
+@return pointer to the slot to be filled, or NULL if the ring is full
+
+If the ring is full, the packet is counted as dropped. The slot is only visible
+to the consumer once rx_ring_commit is called.
+*/
+struct lgw_pkt_rx_ref_s * rx_ring_reserve(struct rx_ring_s *ring);
+
+/**
+@brief Make the slot got with rx_ring_reserve available to the consumer (producer side).
+
+@param ring[in/out] RX ring
+@param time_us[in] host time the packet was fetched, in microseconds on a monotonic clock
+*/
+void rx_ring_commit(struct rx_ring_s *ring, uint64_t time_us);
+
+/**
+@brief Get the number of packets waiting in the ring (consumer side).
+
+@param ring[in] RX ring
+@return number of packets which can be read with rx_ring_peek
+*/
+uint32_t rx_ring_count(struct rx_ring_s *ring);
+
+/**
+@brief Get a packet waiting in the ring, without removing it (consumer side).
+
+@param ring[in] RX ring
+@param index[in] index of the packet, from 0 (oldest) to rx_ring_count - 1
+@return pointer to the packet, valid until it is removed with rx_ring_pop, its payload until released from the HAL
+*/
+struct lgw_pkt_rx_ref_s * rx_ring_peek(struct rx_ring_s *ring, uint32_t index);
+
+/**
+@brief Get the host time a packet waiting in the ring was pushed (consumer side).
+
+@param ring[in] RX ring
+@param index[in] index of the packet, from 0 (oldest) to rx_ring_count - 1
+@return time given to rx_ring_commit
+*/
+uint64_t rx_ring_time(struct rx_ring_s *ring, uint32_t index);
+
+/**
+@brief Remove the oldest packets from the ring (consumer side).
+
+@param ring[in/out] RX ring
+@param nb_pkt[in] number of packets to be removed, at most rx_ring_count
+*/
+void rx_ring_pop(struct rx_ring_s *ring, uint32_t nb_pkt);
+
+/**
+@brief Get and reset the ring counters (any thread).
+
+@param ring[in/out] RX ring
+@param nb_drop[out] number of packets dropped since last call, can be NULL
+@param nb_max[out] highest number of packets queued since last call, can be NULL
+*/
+void rx_ring_get_stats(struct rx_ring_s *ring, uint32_t *nb_drop, uint32_t *nb_max);
+
+#endif
+/* --- EOF ------------------------------------------------------------------ */
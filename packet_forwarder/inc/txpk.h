@@ -0,0 +1,94 @@
+/*!
+ * \brief     LoRa 2.4Ghz concentrator : JSON parsing of packets to be sent
+ *
+ * License: Revised BSD 3-Clause License, see LICENSE.TXT file include in the project
+ */
+
+#ifndef _LORA_PKTFWD_TXPK_H
+#define _LORA_PKTFWD_TXPK_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+
+#include "loragw_hal.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+/* Fields found in the txpk object */
+#define TXPK_FIELD_IMME     (1 << 0)
+#define TXPK_FIELD_TMST     (1 << 1)
+#define TXPK_FIELD_NCRC     (1 << 2)
+#define TXPK_FIELD_FREQ     (1 << 3)
+#define TXPK_FIELD_POWE     (1 << 4)
+#define TXPK_FIELD_DATR     (1 << 5)
+#define TXPK_FIELD_CODR     (1 << 6)
+#define TXPK_FIELD_IPOL     (1 << 7)
+#define TXPK_FIELD_PREA     (1 << 8)
+#define TXPK_FIELD_SIZE     (1 << 9)
+#define TXPK_FIELD_DATA     (1 << 10)
+#define TXPK_FIELD_BRD      (1 << 11)
+
+/* Fields which must be present, in addition to "imme" or "tmst" */
+#define TXPK_FIELD_MANDATORY    (TXPK_FIELD_FREQ | TXPK_FIELD_DATR | TXPK_FIELD_CODR | TXPK_FIELD_SIZE | TXPK_FIELD_DATA)
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+enum txpk_error_e {
+    TXPK_OK,                /* Packet parsed */
+    TXPK_ERROR_JSON,        /* Invalid JSON */
+    TXPK_ERROR_NO_TXPK,     /* No "txpk" object */
+    TXPK_ERROR_MISSING,     /* A mandatory field is missing */
+    TXPK_ERROR_FORMAT       /* A field has an invalid type or value */
+};
+
+struct txpk_info_s {
+    uint32_t fields;        /* Fields found (TXPK_FIELD_xxx) */
+    bool imme;              /* True if "imme" is true */
+    int data_size;          /* Number of bytes decoded from "data" */
+    uint8_t brd;            /* Board of the packet, "brd" or 0 if absent */
+    const char *field;      /* Name of the field in error, for TXPK_ERROR_MISSING and TXPK_ERROR_FORMAT */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Parse a PULL_RESP JSON payload, in a single pass and without allocation.
+
+@param json[in] Null terminated JSON string, containing a "txpk" object
+@param pkt[out] Packet filled with the fields found, the others are set to 0
+@param info[out] Fields found, and field in error if any
+@return TXPK_OK if the packet was parsed, an error code else
+
+The "txpk" fields are decoded straight into pkt: "tmst" in count_us, "freq" in
+freq_hz, "powe" in rf_power (antenna gain not removed), "prea" in preamble, and
+"data" in payload. The board number "brd" goes to info. The tx_mode and
+sync_word fields are left to the caller.
+Comments are allowed in the JSON string, unknown fields are skipped.
+*/
+enum txpk_error_e txpk_parse(const char *json, struct lgw_pkt_tx_s *pkt, struct txpk_info_s *info);
+
+/**
+@brief Parse a PULL_RESP JSON payload holding a "txpk" object or an array of them.
+
+@param json[in] Null terminated JSON string, containing a "txpk" object or array
+@param pkt[out] Packets array, filled as done by txpk_parse
+@param info[out] Info array, one per packet
+@param err[out] Parsing result of each packet, TXPK_ERROR_MISSING or TXPK_ERROR_FORMAT for an invalid one
+@param size[in] Number of elements of the pkt, info and err arrays
+@param nb_pkt[out] Number of txpk objects found, only the first size ones are decoded
+@param is_array[out] True if "txpk" is an array
+@return TXPK_OK if at least one txpk object was found, TXPK_ERROR_JSON or TXPK_ERROR_NO_TXPK else
+
+An invalid txpk object does not prevent the next ones from being decoded, only
+a JSON syntax error does.
+*/
+enum txpk_error_e txpk_parse_batch(const char *json, struct lgw_pkt_tx_s *pkt, struct txpk_info_s *info, enum txpk_error_e *err, int size, int *nb_pkt, bool *is_array);
+
+#endif
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,222 @@
+/*!
+ * \brief     LoRa 2.4Ghz concentrator : TX airtime accounting over a sliding window
+ *
+ * License: Revised BSD 3-Clause License, see LICENSE.TXT file include in the project
+ */
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdio.h>      /* printf, fprintf, snprintf, fopen, fputs */
+#include <string.h>     /* memset */
+
+#include "trace.h"
+#include "airtime.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* Slide the window up to the bin of the given time, the airtime of the bins leaving the window is dropped */
+static void bins_advance(struct airtime_s *at, struct airtime_bins_s *bins, uint64_t time_ms) {
+    uint64_t bin = time_ms / at->bin_ms;
+    uint64_t n;
+
+    if (bin <= bins->last) {
+        return;
+    }
+    if ((bin - bins->last) >= AIRTIME_NB_BIN) {
+        memset(bins->bin_us, 0, sizeof bins->bin_us);
+        bins->sum_us = 0;
+    } else {
+        for (n = bins->last + 1; n <= bin; n++) {
+            bins->sum_us -= bins->bin_us[n % AIRTIME_NB_BIN];
+            bins->bin_us[n % AIRTIME_NB_BIN] = 0;
+        }
+    }
+    bins->last = bin;
+}
+
+static bool bins_fit(const struct airtime_bins_s *bins, uint32_t max_us, uint32_t toa_us) {
+    return ((max_us == 0) || (((uint64_t)bins->sum_us + bins->pending_us + toa_us) <= max_us));
+}
+
+static void bins_add(struct airtime_bins_s *bins, uint32_t toa_us) {
+    bins->bin_us[bins->last % AIRTIME_NB_BIN] += toa_us;
+    bins->sum_us += toa_us;
+}
+
+static void bins_unpend(struct airtime_bins_s *bins, uint32_t toa_us) {
+    bins->pending_us = (bins->pending_us > toa_us) ? (bins->pending_us - toa_us) : 0;
+}
+
+static float bins_occupancy(const struct airtime_s *at, const struct airtime_bins_s *bins) {
+    return (float)bins->sum_us / ((float)at->bin_ms * AIRTIME_NB_BIN * 10.0f); /* us to percent of ms */
+}
+
+/* Channel of a TX frequency, a new one is taken if create is true, return its index or -1 */
+static int chan_find(struct airtime_s *at, uint64_t time_ms, uint32_t freq_hz, bool create) {
+    int i;
+
+    for (i = 0; i < at->nb_chan; i++) {
+        if (at->chan_freq[i] == freq_hz) {
+            return i;
+        }
+    }
+    if (create == false) {
+        return -1;
+    }
+
+    /* new frequency, or reuse a channel which has not been used during the window, nor is queued for */
+    if (at->nb_chan < AIRTIME_NB_CHAN_MAX) {
+        i = at->nb_chan++;
+    } else {
+        for (i = 0; i < at->nb_chan; i++) {
+            bins_advance(at, &at->chan[i], time_ms);
+            if ((at->chan[i].sum_us == 0) && (at->chan[i].pending_us == 0)) {
+                break;
+            }
+        }
+        if (i == at->nb_chan) {
+            MSG("WARNING: [airtime] more than %d TX frequencies in use, %u Hz is not accounted\n", AIRTIME_NB_CHAN_MAX, freq_hz);
+            return -1;
+        }
+    }
+    memset(&at->chan[i], 0, sizeof at->chan[i]);
+    at->chan_freq[i] = freq_hz;
+    return i;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ----------------------------------------- */
+
+int airtime_init(struct airtime_s *at, uint32_t window_s, float max_radio, float max_chan) {
+    if ((window_s < 1) || (window_s > AIRTIME_WINDOW_MAX_S) || (max_radio < 0.0f) || (max_radio > 100.0f) || (max_chan < 0.0f) || (max_chan > 100.0f)) {
+        return -1;
+    }
+
+    memset(at, 0, sizeof(*at));
+    pthread_mutex_init(&at->mx, NULL);
+    at->bin_ms = (window_s * 1000) / AIRTIME_NB_BIN;
+    at->max_radio_us = (uint32_t)((float)at->bin_ms * AIRTIME_NB_BIN * 10.0f * max_radio); /* percent of ms to us */
+    at->max_chan_us = (uint32_t)((float)at->bin_ms * AIRTIME_NB_BIN * 10.0f * max_chan);
+
+    return 0;
+}
+
+bool airtime_check(struct airtime_s *at, uint64_t time_ms, uint8_t radio, uint32_t freq_hz, uint32_t toa_us) {
+    bool fit;
+    int i;
+
+    if (radio >= LGW_TX_CHANNEL_NB_MAX) {
+        return false;
+    }
+
+    pthread_mutex_lock(&at->mx);
+
+    bins_advance(at, &at->radio[radio], time_ms);
+    fit = bins_fit(&at->radio[radio], at->max_radio_us, toa_us);
+
+    /* a frequency not used yet has all its budget */
+    i = chan_find(at, time_ms, freq_hz, false);
+    if (i >= 0) {
+        bins_advance(at, &at->chan[i], time_ms);
+        fit = fit && bins_fit(&at->chan[i], at->max_chan_us, toa_us);
+    } else {
+        fit = fit && ((at->max_chan_us == 0) || (toa_us <= at->max_chan_us));
+    }
+
+    pthread_mutex_unlock(&at->mx);
+
+    return fit;
+}
+
+void airtime_add(struct airtime_s *at, uint64_t time_ms, uint8_t radio, uint32_t freq_hz, uint32_t toa_us) {
+    int i;
+
+    if (radio >= LGW_TX_CHANNEL_NB_MAX) {
+        return;
+    }
+
+    pthread_mutex_lock(&at->mx);
+
+    at->radio[radio].pending_us += toa_us;
+    i = chan_find(at, time_ms, freq_hz, true);
+    if (i >= 0) {
+        at->chan[i].pending_us += toa_us;
+    }
+
+    pthread_mutex_unlock(&at->mx);
+}
+
+void airtime_sent(struct airtime_s *at, uint64_t time_ms, uint8_t radio, uint32_t freq_hz, uint32_t toa_us) {
+    int i;
+
+    if (radio >= LGW_TX_CHANNEL_NB_MAX) {
+        return;
+    }
+
+    pthread_mutex_lock(&at->mx);
+
+    bins_advance(at, &at->radio[radio], time_ms);
+    bins_unpend(&at->radio[radio], toa_us);
+    bins_add(&at->radio[radio], toa_us);
+    i = chan_find(at, time_ms, freq_hz, false); /* not accounted if the table was full when queued */
+    if (i >= 0) {
+        bins_advance(at, &at->chan[i], time_ms);
+        bins_unpend(&at->chan[i], toa_us);
+        bins_add(&at->chan[i], toa_us);
+    }
+
+    pthread_mutex_unlock(&at->mx);
+}
+
+void airtime_sub(struct airtime_s *at, uint8_t radio, uint32_t freq_hz, uint32_t toa_us) {
+    int i;
+
+    if (radio >= LGW_TX_CHANNEL_NB_MAX) {
+        return;
+    }
+
+    pthread_mutex_lock(&at->mx);
+
+    bins_unpend(&at->radio[radio], toa_us);
+    i = chan_find(at, 0, freq_hz, false);
+    if (i >= 0) {
+        bins_unpend(&at->chan[i], toa_us);
+    }
+
+    pthread_mutex_unlock(&at->mx);
+}
+
+float airtime_radio_occupancy(struct airtime_s *at, uint64_t time_ms, uint8_t radio) {
+    float occupancy;
+
+    if (radio >= LGW_TX_CHANNEL_NB_MAX) {
+        return 0.0f;
+    }
+
+    pthread_mutex_lock(&at->mx);
+    bins_advance(at, &at->radio[radio], time_ms);
+    occupancy = bins_occupancy(at, &at->radio[radio]);
+    pthread_mutex_unlock(&at->mx);
+
+    return occupancy;
+}
+
+int airtime_chan_occupancy(struct airtime_s *at, uint64_t time_ms, uint32_t *freq_hz, float *occupancy, int size) {
+    int i;
+    int n = 0;
+
+    pthread_mutex_lock(&at->mx);
+    for (i = 0; (i < at->nb_chan) && (n < size); i++) {
+        bins_advance(at, &at->chan[i], time_ms);
+        freq_hz[n] = at->chan_freq[i];
+        occupancy[n] = bins_occupancy(at, &at->chan[i]);
+        n++;
+    }
+    pthread_mutex_unlock(&at->mx);
+
+    return n;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
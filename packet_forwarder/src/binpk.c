@@ -0,0 +1,233 @@
+/*!
+ * \brief     LoRa 2.4Ghz concentrator : binary framing of uplink and downlink packets
+ *
+ * License: Revised BSD 3-Clause License, see LICENSE.TXT file include in the project
+ */
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <string.h>     /* memcpy, memset */
+#include <math.h>       /* lroundf */
+
+#include "binpk.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static void put_u16(uint8_t *p, uint16_t x) {
+    p[0] = (uint8_t)(x >> 8);
+    p[1] = (uint8_t)x;
+}
+
+static void put_u32(uint8_t *p, uint32_t x) {
+    p[0] = (uint8_t)(x >> 24);
+    p[1] = (uint8_t)(x >> 16);
+    p[2] = (uint8_t)(x >> 8);
+    p[3] = (uint8_t)x;
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+/* Convert to tenths, saturated to a 16-bit signed integer */
+static uint16_t tenths(float x) {
+    long n = lroundf(x * 10.0f);
+
+    if (n > INT16_MAX) {
+        n = INT16_MAX;
+    } else if (n < INT16_MIN) {
+        n = INT16_MIN;
+    }
+    return (uint16_t)(int16_t)n;
+}
+
+static uint16_t bw_khz(uint8_t bandwidth) {
+    switch (bandwidth) {
+        case BW_200KHZ:     return 203;
+        case BW_400KHZ:     return 406;
+        case BW_800KHZ:     return 812;
+        case BW_1600KHZ:    return 1625;
+        default:            return 0;
+    }
+}
+
+static uint8_t codr_code(uint8_t coderate) {
+    switch (coderate) {
+        case CR_LORA_4_5:       return 5;
+        case CR_LORA_4_6:       return 6;
+        case CR_LORA_4_7:       return 7;
+        case CR_LORA_4_8:       return 8;
+        case CR_LORA_LI_4_5:    return BINPK_CODR_LI | 5;
+        case CR_LORA_LI_4_6:    return BINPK_CODR_LI | 6;
+        case CR_LORA_LI_4_8:    return BINPK_CODR_LI | 8;
+        default:                return 0;
+    }
+}
+
+/* Write one rxpk record and its payload, return the number of bytes or -1 */
+static int rxpk_record(const struct lgw_pkt_rx_ref_s *pkt, uint8_t *buf, int buf_size) {
+    int8_t stat;
+    uint16_t bw;
+    uint8_t codr;
+
+    if ((pkt->modulation != MOD_LORA) || (pkt->size > 255) || (buf_size < BINPK_RXPK_SIZE_MAX(pkt->size))) {
+        return -1;
+    }
+    switch (pkt->status) {
+        case STAT_CRC_OK:   stat = 1; break;
+        case STAT_CRC_BAD:  stat = -1; break;
+        case STAT_NO_CRC:   stat = 0; break;
+        default:            return -1;
+    }
+    bw = bw_khz(pkt->bandwidth);
+    codr = codr_code(pkt->coderate);
+    if ((bw == 0) || (codr == 0) || (pkt->datarate < DR_LORA_SF5) || (pkt->datarate > DR_LORA_SF12)) {
+        return -1;
+    }
+
+    put_u32(buf, pkt->count_us);
+    put_u32(buf + 4, pkt->freq_hz);
+    put_u32(buf + 8, (uint32_t)pkt->foff_hz);
+    buf[12] = pkt->channel;
+    buf[13] = (uint8_t)stat;
+    buf[14] = BINPK_MODU_LORA;
+    buf[15] = (uint8_t)pkt->datarate;
+    put_u16(buf + 16, bw);
+    buf[18] = codr;
+    buf[19] = (uint8_t)pkt->size;
+    put_u16(buf + 20, tenths(pkt->rssi));
+    put_u16(buf + 22, tenths(pkt->snr));
+    memcpy(buf + BINPK_RXPK_HEADER_SIZE, pkt->payload, pkt->size);
+
+    return BINPK_RXPK_SIZE_MAX(pkt->size);
+}
+
+/* Write the stat record */
+static void stat_record(const struct binpk_stat_s *stat, uint8_t *buf) {
+    float ackr = stat->ackr;
+
+    ackr = (ackr < 0.0f) ? 0.0f : ((ackr > 100.0f) ? 100.0f : ackr);
+    put_u32(buf, stat->time);
+    put_u32(buf + 4, stat->rxnb);
+    put_u32(buf + 8, stat->rxok);
+    put_u32(buf + 12, stat->rxfw);
+    put_u16(buf + 16, tenths(ackr));
+    put_u32(buf + 18, stat->dwnb);
+    put_u32(buf + 22, stat->txnb);
+    put_u16(buf + 26, tenths(stat->temp));
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int binpk_rxpk_serialize_batch(const struct lgw_pkt_rx_ref_s * const pkt[], int nb_pkt, const struct binpk_stat_s *stat, uint8_t *buf, int buf_size) {
+    int i, j;
+    int n = BINPK_PUSH_HEADER_SIZE;
+
+    if ((nb_pkt < 0) || (nb_pkt > 255) || (buf_size < BINPK_PUSH_HEADER_SIZE)) {
+        return -1;
+    }
+    buf[0] = (uint8_t)nb_pkt;
+    buf[1] = (stat != NULL) ? BINPK_PUSH_FLAG_STAT : 0;
+
+    for (i = 0; i < nb_pkt; i++) {
+        j = rxpk_record(pkt[i], buf + n, buf_size - n);
+        if (j < 0) {
+            return -1;
+        }
+        n += j;
+    }
+
+    if (stat != NULL) {
+        if ((buf_size - n) < BINPK_STAT_SIZE) {
+            return -1;
+        }
+        stat_record(stat, buf + n);
+        n += BINPK_STAT_SIZE;
+    }
+
+    return n;
+}
+
+enum txpk_error_e binpk_txpk_parse(const uint8_t *buf, int size, struct lgw_pkt_tx_s *pkt, struct txpk_info_s *info) {
+    uint8_t flags;
+    uint8_t codr;
+
+    memset(pkt, 0, sizeof *pkt);
+    memset(info, 0, sizeof *info);
+
+    if (size < BINPK_TXPK_HEADER_SIZE) {
+        return TXPK_ERROR_JSON;
+    }
+
+    /* flags, the timestamp is always present */
+    flags = buf[0];
+    info->imme = (flags & BINPK_TXPK_FLAG_IMME) ? true : false;
+    pkt->invert_pol = (flags & BINPK_TXPK_FLAG_IPOL) ? true : false;
+    pkt->no_crc = (flags & BINPK_TXPK_FLAG_NCRC) ? true : false;
+    pkt->count_us = get_u32(buf + 1);
+    pkt->freq_hz = get_u32(buf + 5);
+    pkt->rf_power = (int8_t)buf[9];
+    info->fields = TXPK_FIELD_IMME | TXPK_FIELD_TMST | TXPK_FIELD_NCRC | TXPK_FIELD_FREQ | TXPK_FIELD_POWE | TXPK_FIELD_IPOL;
+
+    /* modulation and datarate, only those accepted in JSON are accepted */
+    if (buf[10] != BINPK_MODU_LORA) {
+        info->field = "modu";
+        return TXPK_ERROR_FORMAT;
+    }
+    if ((buf[11] < DR_LORA_SF5) || (buf[11] > DR_LORA_SF12)) {
+        info->field = "datr";
+        return TXPK_ERROR_FORMAT;
+    }
+    pkt->datarate = buf[11];
+    switch (get_u16(buf + 12)) {
+        case 812: pkt->bandwidth = BW_800KHZ; break;
+        case 800: pkt->bandwidth = BW_800KHZ; break;
+        default:
+            info->field = "datr";
+            return TXPK_ERROR_FORMAT;
+    }
+    info->fields |= TXPK_FIELD_DATR;
+    codr = buf[14];
+    if ((codr == (BINPK_CODR_LI | 8)) || (codr == (BINPK_CODR_LI | 7))) {
+        pkt->coderate = CR_LORA_LI_4_8;
+    } else {
+        info->field = "codr";
+        return TXPK_ERROR_FORMAT;
+    }
+    info->fields |= TXPK_FIELD_CODR;
+
+    /* preamble, 0 for the default one */
+    pkt->preamble = get_u16(buf + 15);
+    if (pkt->preamble != 0) {
+        info->fields |= TXPK_FIELD_PREA;
+    }
+
+    /* raw payload, up to the end of the datagram */
+    pkt->size = buf[17];
+    info->data_size = size - BINPK_TXPK_HEADER_SIZE;
+    if (info->data_size > (int)sizeof pkt->payload) {
+        info->field = "data";
+        return TXPK_ERROR_FORMAT;
+    }
+    memcpy(pkt->payload, buf + BINPK_TXPK_HEADER_SIZE, info->data_size);
+    info->fields |= TXPK_FIELD_SIZE | TXPK_FIELD_DATA;
+
+    return TXPK_OK;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
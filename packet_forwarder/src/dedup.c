@@ -0,0 +1,101 @@
+/*!
+ * \brief     LoRa 2.4Ghz concentrator : removal of the uplinks received by several radios
+ *
+ * License: Revised BSD 3-Clause License, see LICENSE.TXT file include in the project
+ */
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <string.h>     /* memset, memcmp */
+
+#include "dedup.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* Entry of a copy of the packet, -1 if not found */
+static int hist_find(const struct dedup_s *dd, uint32_t hash, const struct lgw_pkt_rx_ref_s *p, uint8_t brd) {
+    const struct dedup_entry_s *e;
+    int32_t diff;
+    int i;
+
+    for (i = 0; i < DEDUP_HIST_NB; i++) {
+        e = &dd->hist[i];
+        if (!e->valid || (e->hash != hash) || (e->size != p->size) || (e->brd != brd)) {
+            continue;
+        }
+        diff = (int32_t)(p->count_us - e->count_us); /* the counter wraps */
+        if ((diff <= (int32_t)dd->window_us) && (diff >= -(int32_t)dd->window_us)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+void dedup_init(struct dedup_s *dd, uint32_t window_us) {
+    memset(dd, 0, sizeof *dd);
+    dd->window_us = window_us;
+}
+
+uint32_t dedup_hash(const uint8_t *payload, uint16_t size) {
+    uint32_t h = 2166136261u;
+    uint16_t i;
+
+    for (i = 0; i < size; i++) {
+        h = (h ^ payload[i]) * 16777619u;
+    }
+    return h;
+}
+
+int dedup_filter(struct dedup_s *dd, const struct lgw_pkt_rx_ref_s **pkt, uint8_t *brd, uint64_t *time_us, int nb) {
+    struct dedup_entry_s *e;
+    const struct lgw_pkt_rx_ref_s *p;
+    uint32_t hash;
+    int nb_kept = 0;
+    int i, k;
+
+    for (i = 0; i < nb; i++) {
+        p = pkt[i];
+        hash = dedup_hash(p->payload, p->size);
+        k = hist_find(dd, hash, p, brd[i]);
+        e = (k >= 0) ? &dd->hist[k] : NULL;
+        /* the payloads of the batch are compared, the ones already sent are only known by their hash */
+        if ((e != NULL) && ((e->idx < 0) || (memcmp(p->payload, pkt[e->idx]->payload, p->size) == 0))) {
+            /* a copy in the batch replaces the first one if it was heard better, with its board and time */
+            if ((e->idx >= 0) && (p->rssi > pkt[e->idx]->rssi)) {
+                pkt[e->idx] = p;
+                brd[e->idx] = brd[i];
+                time_us[e->idx] = time_us[i];
+                e->count_us = p->count_us;
+            }
+            continue;
+        }
+
+        /* a new packet, remembered in place of the oldest one */
+        e = &dd->hist[dd->last % DEDUP_HIST_NB];
+        dd->last += 1;
+        e->hash = hash;
+        e->count_us = p->count_us;
+        e->size = p->size;
+        e->brd = brd[i];
+        e->valid = true;
+        e->idx = nb_kept;
+        pkt[nb_kept] = p;
+        brd[nb_kept] = brd[i];
+        time_us[nb_kept] = time_us[i];
+        nb_kept += 1;
+    }
+
+    /* the packets kept are part of the history of the next batches */
+    for (i = 0; i < DEDUP_HIST_NB; i++) {
+        dd->hist[i].idx = -1;
+    }
+
+    return nb_kept;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
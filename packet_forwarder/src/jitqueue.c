@@ -7,10 +7,17 @@
 /* -------------------------------------------------------------------------- */
 /* --- DEPENDANCIES --------------------------------------------------------- */
 
-#define _GNU_SOURCE     /* needed for qsort_r to be defined */
-#include <stdlib.h>     /* qsort_r */
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
 #include <stdio.h>      /* printf, fprintf, snprintf, fopen, fputs */
 #include <string.h>     /* memset, memcpy */
+#include <time.h>       /* clock_gettime */
+#include <errno.h>      /* ETIMEDOUT */
 #include <pthread.h>
 #include <assert.h>
 #include <math.h>
@@ -23,22 +30,127 @@
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE CONSTANTS & TYPES -------------------------------------------- */
-#define TX_START_DELAY          1500    /* microseconds */
-#define TX_MARGIN_DELAY         1000    /* Packet overlap margin in microseconds */
-#define TX_JIT_DELAY            30000   /* Pre-delay to program packet for TX in microseconds */
-#define TX_MAX_ADVANCE_DELAY    ((JIT_NUM_BEACON_IN_QUEUE + 1) * 128 * 1E6) /* Maximum advance delay accepted for a TX packet, compared to current time */
-
-#define BEACON_GUARD            3000000 /* Interval where no ping slot can be placed,
-                                            to ensure beacon can be sent */
-#define BEACON_RESERVED         2120000 /* Time on air of the beacon, with some margin */
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE VARIABLES (GLOBAL) ------------------------------------------- */
 static pthread_mutex_t mx_jit_queue = PTHREAD_MUTEX_INITIALIZER; /* control access to JIT queue */
+static pthread_cond_t cv_jit_queue; /* signaled when a packet becomes the first of a queue, on the monotonic clock */
+static pthread_once_t cv_jit_once = PTHREAD_ONCE_INIT;
+static uint32_t jit_head_changes = 0; /* number of times a packet became the first of a queue */
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
 
+static void jit_cond_init(void) {
+    pthread_condattr_t attr;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&cv_jit_queue, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+/* Roll-over aware ordering of timestamps: true if a is before b
+ * (valid as long as queued packets are less than 2^31 us apart, which TX_MAX_ADVANCE_DELAY ensures)
+ */
+static bool jit_before(uint32_t a, uint32_t b) {
+    return ((int32_t)(a - b) < 0);
+}
+
+static uint32_t jit_count_us(struct jit_queue_s *queue, int pos) {
+    return queue->nodes[queue->index[pos]].pkt.count_us;
+}
+
+/* Position in the queue of the first packet which is not before count_us (binary search) */
+static int jit_lower_bound(struct jit_queue_s *queue, uint32_t count_us) {
+    int lo = 0;
+    int hi = queue->num_pkt;
+    int mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (jit_before(jit_count_us(queue, mid), count_us)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/* Take a free node and insert it at the given position, return the node index */
+static int jit_insert_node(struct jit_queue_s *queue, int pos) {
+    uint8_t node = queue->index[queue->num_pkt];
+
+    memmove(&queue->index[pos + 1], &queue->index[pos], queue->num_pkt - pos);
+    queue->index[pos] = node;
+    queue->num_pkt++;
+    return node;
+}
+
+/* Remove the node at the given position, it goes back to the free nodes */
+static void jit_remove_node(struct jit_queue_s *queue, int pos) {
+    uint8_t node = queue->index[pos];
+
+    if (queue->nodes[node].pkt_type == JIT_PKT_TYPE_BEACON) {
+        queue->num_beacon--;
+    }
+    queue->num_pkt--;
+    memmove(&queue->index[pos], &queue->index[pos + 1], queue->num_pkt - pos);
+    queue->index[queue->num_pkt] = node;
+    if (queue->num_pkt == 0) {
+        queue->max_pre_delay = 0;
+        queue->max_post_delay = 0;
+    }
+}
+
+bool jit_collision_test(uint32_t p1_count_us, uint32_t p1_pre_delay, uint32_t p1_post_delay, uint32_t p2_count_us, uint32_t p2_pre_delay, uint32_t p2_post_delay) {
+    if (((p1_count_us - p2_count_us) <= (p1_pre_delay + p2_post_delay + TX_MARGIN_DELAY)) ||
+        ((p2_count_us - p1_count_us) <= (p2_pre_delay + p1_post_delay + TX_MARGIN_DELAY))) {
+        return true;
+    } else {
+        return false;
+    }
+}
+
+/* Search the earliest queued packet colliding with the given time frame, return its position or -1
+ *  Only the packets which are close enough, given the longest pre/post delays of the queue, are checked:
+ *  the packets before count_us down to count_us - pre_delay - max_post_delay, and the packets after up to
+ *  count_us + post_delay + max_pre_delay.
+ *  Beacon guard can be ignored (Class A/C downlinks), then only TX_START_DELAY is reserved before beacons.
+ */
+static int jit_find_collision(struct jit_queue_s *queue, uint32_t count_us, uint32_t pre_delay, uint32_t post_delay, bool ignore_beacon_guard) {
+    int pos, i;
+    int found = -1;
+    uint32_t target_pre_delay;
+    struct jit_node_s *node;
+
+    pos = jit_lower_bound(queue, count_us);
+
+    /* packets before, the earliest collision is reported */
+    for (i = pos - 1; (i >= 0) && ((count_us - jit_count_us(queue, i)) <= (pre_delay + queue->max_post_delay + TX_MARGIN_DELAY)); i--) {
+        node = &queue->nodes[queue->index[i]];
+        target_pre_delay = (ignore_beacon_guard && (node->pkt_type == JIT_PKT_TYPE_BEACON)) ? TX_START_DELAY : node->pre_delay;
+        if (jit_collision_test(count_us, pre_delay, post_delay, node->pkt.count_us, target_pre_delay, node->post_delay) == true) {
+            found = i;
+        }
+    }
+    if (found != -1) {
+        return found;
+    }
+
+    /* packets after */
+    for (i = pos; (i < queue->num_pkt) && ((jit_count_us(queue, i) - count_us) <= (post_delay + queue->max_pre_delay + TX_MARGIN_DELAY)); i++) {
+        node = &queue->nodes[queue->index[i]];
+        target_pre_delay = (ignore_beacon_guard && (node->pkt_type == JIT_PKT_TYPE_BEACON)) ? TX_START_DELAY : node->pre_delay;
+        if (jit_collision_test(count_us, pre_delay, post_delay, node->pkt.count_us, target_pre_delay, node->post_delay) == true) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS DEFINITION ----------------------------------------- */
 
@@ -69,61 +181,32 @@ bool jit_queue_is_empty(struct jit_queue_s *queue) {
 void jit_queue_init(struct jit_queue_s *queue) {
     int i;
 
+    pthread_once(&cv_jit_once, jit_cond_init);
+
     pthread_mutex_lock(&mx_jit_queue);
 
     memset(queue, 0, sizeof(*queue));
     for (i=0; i<JIT_QUEUE_MAX; i++) {
-        queue->nodes[i].pre_delay = 0;
-        queue->nodes[i].post_delay = 0;
+        queue->index[i] = (uint8_t)i; /* all nodes are free */
     }
 
     pthread_mutex_unlock(&mx_jit_queue);
 }
 
-int compare(const void *a, const void *b, void *arg)
-{
-    struct jit_node_s *p = (struct jit_node_s *)a;
-    struct jit_node_s *q = (struct jit_node_s *)b;
-    int *counter = (int *)arg;
-    int p_count, q_count;
-
-    p_count = p->pkt.count_us;
-    q_count = q->pkt.count_us;
-
-    if (p_count > q_count)
-        *counter = *counter + 1;
-
-    return p_count - q_count;
-}
-
-void jit_sort_queue(struct jit_queue_s *queue) {
-    int counter = 0;
-
-    if (queue->num_pkt == 0) {
-        return;
-    }
-
-    MSG_DEBUG(DEBUG_JIT, "sorting queue in ascending order packet timestamp - queue size:%u\n", queue->num_pkt);
-    qsort_r(queue->nodes, queue->num_pkt, sizeof(queue->nodes[0]), compare, &counter);
-    MSG_DEBUG(DEBUG_JIT, "sorting queue done - swapped:%d\n", counter);
-}
-
-bool jit_collision_test(uint32_t p1_count_us, uint32_t p1_pre_delay, uint32_t p1_post_delay, uint32_t p2_count_us, uint32_t p2_pre_delay, uint32_t p2_post_delay) {
-    if (((p1_count_us - p2_count_us) <= (p1_pre_delay + p2_post_delay + TX_MARGIN_DELAY)) ||
-        ((p2_count_us - p1_count_us) <= (p2_pre_delay + p1_post_delay + TX_MARGIN_DELAY))) {
-        return true;
-    } else {
-        return false;
-    }
+void jit_queue_set_drop_cb(struct jit_queue_s *queue, jit_drop_cb cb, void *arg) {
+    pthread_mutex_lock(&mx_jit_queue);
+    queue->drop_cb = cb;
+    queue->drop_arg = arg;
+    pthread_mutex_unlock(&mx_jit_queue);
 }
 
 enum jit_error_e jit_enqueue(struct jit_queue_s *queue, uint32_t time_us, struct lgw_pkt_tx_s *packet, enum jit_pkt_type_e pkt_type) {
     int i = 0;
     uint32_t packet_post_delay = 0;
     uint32_t packet_pre_delay = 0;
-    uint32_t target_pre_delay = 0;
     enum jit_error_e err_collision;
     uint32_t asap_count_us;
+    struct jit_node_s *node;
 
     MSG_DEBUG(DEBUG_JIT, "Current concentrator time is %u, pkt_type=%d\n", time_us, pkt_type);
 
@@ -143,7 +226,7 @@ enum jit_error_e jit_enqueue(struct jit_queue_s *queue, uint32_t time_us, struct
         case JIT_PKT_TYPE_DOWNLINK_CLASS_B:
         case JIT_PKT_TYPE_DOWNLINK_CLASS_C:
             packet_pre_delay = TX_START_DELAY + TX_JIT_DELAY;
-            packet_post_delay = lgw_time_on_air(packet, NULL) * 1000UL; /* in us */
+            packet_post_delay = lgw_time_on_air_us(packet);
             break;
         case JIT_PKT_TYPE_BEACON:
             /* As defined in LoRaWAN spec */
@@ -175,26 +258,26 @@ enum jit_error_e jit_enqueue(struct jit_queue_s *queue, uint32_t time_us, struct
             */
 
             /* First, try if the ASAP time collides with an already enqueued downlink */
-            for (i=0; i<queue->num_pkt; i++) {
-                if (jit_collision_test(asap_count_us, packet_pre_delay, packet_post_delay, queue->nodes[i].pkt.count_us, queue->nodes[i].pre_delay, queue->nodes[i].post_delay) == true) {
-                    MSG_DEBUG(DEBUG_JIT, "DEBUG: cannot insert IMMEDIATE downlink at count_us=%u, collides with %u (index=%d)\n", asap_count_us, queue->nodes[i].pkt.count_us, i);
-                    break;
-                }
+            i = jit_find_collision(queue, asap_count_us, packet_pre_delay, packet_post_delay, false);
+            if (i != -1) {
+                MSG_DEBUG(DEBUG_JIT, "DEBUG: cannot insert IMMEDIATE downlink at count_us=%u, collides with %u (index=%d)\n", asap_count_us, jit_count_us(queue, i), i);
             }
-            if (i == queue->num_pkt) {
+            if (i == -1) {
                 /* No collision with ASAP time, we can insert it */
                 MSG_DEBUG(DEBUG_JIT, "DEBUG: insert IMMEDIATE downlink ASAP at %u (no collision)\n", asap_count_us);
             } else {
                 /* Search for the best slot then */
                 for (i=0; i<queue->num_pkt; i++) {
-                    asap_count_us = queue->nodes[i].pkt.count_us + queue->nodes[i].post_delay + packet_pre_delay + TX_JIT_DELAY + TX_MARGIN_DELAY;
+                    node = &queue->nodes[queue->index[i]];
+                    asap_count_us = node->pkt.count_us + node->post_delay + packet_pre_delay + TX_JIT_DELAY + TX_MARGIN_DELAY;
                     if (i == (queue->num_pkt - 1)) {
                         /* Last packet index, we can insert after this one */
                         MSG_DEBUG(DEBUG_JIT, "DEBUG: insert IMMEDIATE downlink, last in JiT queue (count_us=%u)\n", asap_count_us);
                     } else {
                         /* Check if packet can be inserted between this index and the next one */
                         MSG_DEBUG(DEBUG_JIT, "DEBUG: try to insert IMMEDIATE downlink (count_us=%u) between index %d and index %d?\n", asap_count_us, i, i+1);
-                        if (jit_collision_test(asap_count_us, packet_pre_delay, packet_post_delay, queue->nodes[i+1].pkt.count_us, queue->nodes[i+1].pre_delay, queue->nodes[i+1].post_delay) == true) {
+                        node = &queue->nodes[queue->index[i+1]];
+                        if (jit_collision_test(asap_count_us, packet_pre_delay, packet_post_delay, node->pkt.count_us, node->pre_delay, node->post_delay) == true) {
                             MSG_DEBUG(DEBUG_JIT, "DEBUG: failed to insert IMMEDIATE downlink (count_us=%u), continue...\n", asap_count_us);
                             continue;
                         } else {
@@ -247,56 +330,56 @@ enum jit_error_e jit_enqueue(struct jit_queue_s *queue, uint32_t time_us, struct
      *        - Valid for both Downlinks and beacon packets
      *        - Beacon guard can be ignored if we try to queue a Class A downlink
      */
-    for (i=0; i<queue->num_pkt; i++) {
-        /* We ignore Beacon Guard for Class A/C downlinks */
-        if (((pkt_type == JIT_PKT_TYPE_DOWNLINK_CLASS_A) || (pkt_type == JIT_PKT_TYPE_DOWNLINK_CLASS_C)) && (queue->nodes[i].pkt_type == JIT_PKT_TYPE_BEACON)) {
-            target_pre_delay = TX_START_DELAY;
-        } else {
-            target_pre_delay = queue->nodes[i].pre_delay;
-        }
-
-        /* Check if there is a collision
-         *  Warning: unsigned arithmetic (handle roll-over)
-         *      t_packet_new - pre_delay_packet_new < t_packet_prev + post_delay_packet_prev (OVERLAP on post delay)
-         *      t_packet_new + post_delay_packet_new > t_packet_prev - pre_delay_packet_prev (OVERLAP on pre delay)
-         */
-        if (jit_collision_test(packet->count_us, packet_pre_delay, packet_post_delay, queue->nodes[i].pkt.count_us, target_pre_delay, queue->nodes[i].post_delay) == true) {
-            switch (queue->nodes[i].pkt_type) {
-                case JIT_PKT_TYPE_DOWNLINK_CLASS_A:
-                case JIT_PKT_TYPE_DOWNLINK_CLASS_B:
-                case JIT_PKT_TYPE_DOWNLINK_CLASS_C:
-                    MSG_DEBUG(DEBUG_JIT_ERROR, "ERROR: Packet (type=%d) REJECTED, collision with packet already programmed at %u (%u)\n", pkt_type, queue->nodes[i].pkt.count_us, packet->count_us);
-                    err_collision = JIT_ERROR_COLLISION_PACKET;
-                    break;
-                case JIT_PKT_TYPE_BEACON:
-                    if (pkt_type != JIT_PKT_TYPE_BEACON) {
-                        /* do not overload logs for beacon/beacon collision, as it is expected to happen with beacon pre-scheduling algorith used */
-                        MSG_DEBUG(DEBUG_JIT_ERROR, "ERROR: Packet (type=%d) REJECTED, collision with beacon already programmed at %u (%u)\n", pkt_type, queue->nodes[i].pkt.count_us, packet->count_us);
-                    }
-                    err_collision = JIT_ERROR_COLLISION_BEACON;
-                    break;
-                default:
-                    MSG("ERROR: Unknown packet type, should not occur, BUG?\n");
-                    assert(0);
-                    break;
-            }
-            pthread_mutex_unlock(&mx_jit_queue);
-            return err_collision;
+    i = jit_find_collision(queue, packet->count_us, packet_pre_delay, packet_post_delay,
+                           (pkt_type == JIT_PKT_TYPE_DOWNLINK_CLASS_A) || (pkt_type == JIT_PKT_TYPE_DOWNLINK_CLASS_C));
+    if (i != -1) {
+        node = &queue->nodes[queue->index[i]];
+        switch (node->pkt_type) {
+            case JIT_PKT_TYPE_DOWNLINK_CLASS_A:
+            case JIT_PKT_TYPE_DOWNLINK_CLASS_B:
+            case JIT_PKT_TYPE_DOWNLINK_CLASS_C:
+                MSG_DEBUG(DEBUG_JIT_ERROR, "ERROR: Packet (type=%d) REJECTED, collision with packet already programmed at %u (%u)\n", pkt_type, node->pkt.count_us, packet->count_us);
+                err_collision = JIT_ERROR_COLLISION_PACKET;
+                break;
+            case JIT_PKT_TYPE_BEACON:
+                if (pkt_type != JIT_PKT_TYPE_BEACON) {
+                    /* do not overload logs for beacon/beacon collision, as it is expected to happen with beacon pre-scheduling algorith used */
+                    MSG_DEBUG(DEBUG_JIT_ERROR, "ERROR: Packet (type=%d) REJECTED, collision with beacon already programmed at %u (%u)\n", pkt_type, node->pkt.count_us, packet->count_us);
+                }
+                err_collision = JIT_ERROR_COLLISION_BEACON;
+                break;
+            default:
+                MSG("ERROR: Unknown packet type, should not occur, BUG?\n");
+                assert(0);
+                break;
         }
+        pthread_mutex_unlock(&mx_jit_queue);
+        return err_collision;
     }
 
     /* Finally enqueue it */
-    /* Insert packet at the end of the queue */
-    memcpy(&(queue->nodes[queue->num_pkt].pkt), packet, sizeof(struct lgw_pkt_tx_s));
-    queue->nodes[queue->num_pkt].pre_delay = packet_pre_delay;
-    queue->nodes[queue->num_pkt].post_delay = packet_post_delay;
-    queue->nodes[queue->num_pkt].pkt_type = pkt_type;
+    /* Insert packet in a free node, at its position in ascending order of packet timestamp */
+    i = jit_lower_bound(queue, packet->count_us);
+    node = &queue->nodes[jit_insert_node(queue, i)];
+    memcpy(&(node->pkt), packet, sizeof(struct lgw_pkt_tx_s));
+    node->pre_delay = packet_pre_delay;
+    node->post_delay = packet_post_delay;
+    node->pkt_type = pkt_type;
     if (pkt_type == JIT_PKT_TYPE_BEACON) {
         queue->num_beacon++;
     }
-    queue->num_pkt++;
-    /* Sort the queue in ascending order of packet timestamp */
-    jit_sort_queue(queue);
+    if (packet_pre_delay > queue->max_pre_delay) {
+        queue->max_pre_delay = packet_pre_delay;
+    }
+    if (packet_post_delay > queue->max_post_delay) {
+        queue->max_post_delay = packet_post_delay;
+    }
+
+    /* Wake up the thread waiting for the first packet of the queue */
+    if (i == 0) {
+        jit_head_changes++;
+        pthread_cond_broadcast(&cv_jit_queue);
+    }
 
     /* Done */
     pthread_mutex_unlock(&mx_jit_queue);
@@ -309,6 +392,8 @@ enum jit_error_e jit_enqueue(struct jit_queue_s *queue, uint32_t time_us, struct
 }
 
 enum jit_error_e jit_dequeue(struct jit_queue_s *queue, int index, struct lgw_pkt_tx_s *packet, enum jit_pkt_type_e *pkt_type) {
+    int i;
+
     if (packet == NULL) {
         MSG("ERROR: invalid parameter\n");
         return JIT_ERROR_INVALID;
@@ -326,21 +411,25 @@ enum jit_error_e jit_dequeue(struct jit_queue_s *queue, int index, struct lgw_pk
 
     pthread_mutex_lock(&mx_jit_queue);
 
-    /* Dequeue requested packet */
+    /* Search the position of the requested node, from its timestamp */
+    for (i = jit_lower_bound(queue, queue->nodes[index].pkt.count_us); i < queue->num_pkt; i++) {
+        if (queue->index[i] == index) {
+            break;
+        }
+    }
+    if (i >= queue->num_pkt) {
+        pthread_mutex_unlock(&mx_jit_queue);
+        MSG("ERROR: cannot dequeue packet, node %d is not in JIT queue\n", index);
+        return JIT_ERROR_INVALID;
+    }
+
+    /* Dequeue requested packet, the order of the others is unchanged */
     memcpy(packet, &(queue->nodes[index].pkt), sizeof(struct lgw_pkt_tx_s));
-    queue->num_pkt--;
     *pkt_type = queue->nodes[index].pkt_type;
     if (*pkt_type == JIT_PKT_TYPE_BEACON) {
-        queue->num_beacon--;
         MSG_DEBUG(DEBUG_BEACON, "--- Beacon dequeued ---\n");
     }
-
-    /* Replace dequeued packet with last packet of the queue */
-    memcpy(&(queue->nodes[index]), &(queue->nodes[queue->num_pkt]), sizeof(struct jit_node_s));
-    memset(&(queue->nodes[queue->num_pkt]), 0, sizeof(struct jit_node_s));
-
-    /* Sort queue in ascending order of packet timestamp */
-    jit_sort_queue(queue);
+    jit_remove_node(queue, i);
 
     /* Done */
     pthread_mutex_unlock(&mx_jit_queue);
@@ -354,8 +443,7 @@ enum jit_error_e jit_dequeue(struct jit_queue_s *queue, int index, struct lgw_pk
 
 enum jit_error_e jit_peek(struct jit_queue_s *queue, uint32_t time_us, int *pkt_idx) {
     /* Return index of node containing a packet inline with given time */
-    int i = 0;
-    int idx_highest_priority = -1;
+    int i;
     if (pkt_idx == NULL) {
         MSG("ERROR: invalid parameter\n");
         return JIT_ERROR_INVALID;
@@ -367,54 +455,42 @@ enum jit_error_e jit_peek(struct jit_queue_s *queue, uint32_t time_us, int *pkt_
 
     pthread_mutex_lock(&mx_jit_queue);
 
-    /* Search for highest priority packet to be sent */
-    for (i=0; i<queue->num_pkt; i++) {
-        /* First check if that packet is outdated:
-         *  If a packet seems too much in advance, and was not rejected at enqueue time,
-         *  it means that we missed it for peeking, we need to drop it
-         *
-         *  Warning: unsigned arithmetic
-         *      t_packet > t_current + TX_MAX_ADVANCE_DELAY
-         */
-        if ((queue->nodes[i].pkt.count_us - time_us) >= TX_MAX_ADVANCE_DELAY) {
-            /* We drop the packet to avoid lock-up */
-            queue->num_pkt--;
-            if (queue->nodes[i].pkt_type == JIT_PKT_TYPE_BEACON) {
-                queue->num_beacon--;
-                MSG("WARNING: --- Beacon dropped (current_time=%u, packet_time=%u) ---\n", time_us, queue->nodes[i].pkt.count_us);
-            } else {
-                MSG("WARNING: --- Packet dropped (current_time=%u, packet_time=%u) ---\n", time_us, queue->nodes[i].pkt.count_us);
-            }
-
-            /* Replace dropped packet with last packet of the queue */
-            memcpy(&(queue->nodes[i]), &(queue->nodes[queue->num_pkt]), sizeof(struct jit_node_s));
-            memset(&(queue->nodes[queue->num_pkt]), 0, sizeof(struct jit_node_s));
-
-            /* Sort queue in ascending order of packet timestamp */
-            jit_sort_queue(queue);
-
-            /* restart loop  after purge to find packet to be sent */
+    /* First drop outdated packets:
+     *  If a packet seems too much in advance, and was not rejected at enqueue time,
+     *  it means that we missed it for peeking, we need to drop it.
+     *  Such packets are in the past, so first in the queue, or far in the future, so last.
+     *
+     *  Warning: unsigned arithmetic
+     *      t_packet > t_current + TX_MAX_ADVANCE_DELAY
+     */
+    while (queue->num_pkt > 0) {
+        if ((jit_count_us(queue, 0) - time_us) >= TX_MAX_ADVANCE_DELAY) {
             i = 0;
-            continue;
+        } else if ((jit_count_us(queue, queue->num_pkt - 1) - time_us) >= TX_MAX_ADVANCE_DELAY) {
+            i = queue->num_pkt - 1;
+        } else {
+            break;
         }
-
-        /* Then look for highest priority packet to be sent:
-         *  Warning: unsigned arithmetic (handle roll-over)
-         *      t_packet < t_highest
-         */
-        if ((idx_highest_priority == -1) || (((queue->nodes[i].pkt.count_us - time_us) < (queue->nodes[idx_highest_priority].pkt.count_us - time_us)))) {
-            idx_highest_priority = i;
+        /* We drop the packet to avoid lock-up */
+        if (queue->nodes[queue->index[i]].pkt_type == JIT_PKT_TYPE_BEACON) {
+            MSG("WARNING: --- Beacon dropped (current_time=%u, packet_time=%u) ---\n", time_us, jit_count_us(queue, i));
+        } else {
+            MSG("WARNING: --- Packet dropped (current_time=%u, packet_time=%u) ---\n", time_us, jit_count_us(queue, i));
         }
+        if (queue->drop_cb != NULL) {
+            queue->drop_cb(&queue->nodes[queue->index[i]].pkt, queue->nodes[queue->index[i]].pkt_type, queue->drop_arg);
+        }
+        jit_remove_node(queue, i);
     }
 
     /* Peek criteria 1: look for a packet to be sent in next TX_JIT_DELAY ms timeframe
+     *  The highest priority packet is the first of the queue
      *  Warning: unsigned arithmetic (handle roll-over)
      *      t_packet < t_current + TX_JIT_DELAY
      */
-    if ((queue->nodes[idx_highest_priority].pkt.count_us - time_us) < TX_JIT_DELAY) {
-        *pkt_idx = idx_highest_priority;
-        MSG_DEBUG(DEBUG_JIT, "peek packet with count_us=%u at index %d\n",
-            queue->nodes[idx_highest_priority].pkt.count_us, idx_highest_priority);
+    if ((queue->num_pkt > 0) && ((jit_count_us(queue, 0) - time_us) < TX_JIT_DELAY)) {
+        *pkt_idx = queue->index[0];
+        MSG_DEBUG(DEBUG_JIT, "peek packet with count_us=%u at index %d\n", jit_count_us(queue, 0), *pkt_idx);
     } else {
         *pkt_idx = -1;
     }
@@ -424,6 +500,57 @@ enum jit_error_e jit_peek(struct jit_queue_s *queue, uint32_t time_us, int *pkt_
     return JIT_ERROR_OK;
 }
 
+int32_t jit_wait(struct jit_queue_s *queue, int nb_queue, uint32_t time_us, uint32_t max_wait_us) {
+    uint32_t wait_us = max_wait_us;
+    uint32_t head_changes;
+    int32_t delay_us;
+    int32_t late_us = -1;
+    struct timespec deadline;
+    struct timespec now;
+    int i;
+
+    pthread_mutex_lock(&mx_jit_queue);
+
+    /* The first packet of a queue is to be peeked TX_JIT_DELAY before its timestamp
+     *  Warning: unsigned arithmetic (handle roll-over)
+     */
+    for (i = 0; i < nb_queue; i++) {
+        if (queue[i].num_pkt > 0) {
+            delay_us = (int32_t)(jit_count_us(&queue[i], 0) - TX_JIT_DELAY - time_us);
+            if (delay_us <= 0) {
+                wait_us = 0;
+            } else if ((uint32_t)delay_us < wait_us) {
+                wait_us = (uint32_t)delay_us;
+            }
+        }
+    }
+
+    if (wait_us > 0) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += wait_us / 1000000;
+        deadline.tv_nsec += (wait_us % 1000000) * 1000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec += 1;
+            deadline.tv_nsec -= 1000000000;
+        }
+        head_changes = jit_head_changes;
+        while (head_changes == jit_head_changes) {
+            if (pthread_cond_timedwait(&cv_jit_queue, &mx_jit_queue, &deadline) == ETIMEDOUT) {
+                /* the thread is running again, with the mutex, that late after the deadline */
+                clock_gettime(CLOCK_MONOTONIC, &now);
+                late_us = (int32_t)((now.tv_sec - deadline.tv_sec) * 1000000 + (now.tv_nsec - deadline.tv_nsec) / 1000);
+                if (late_us < 0) {
+                    late_us = 0;
+                }
+                break;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&mx_jit_queue);
+    return late_us;
+}
+
 void jit_print_queue(struct jit_queue_s *queue, bool show_all, int debug_level) {
     int i = 0;
     int loop_end;
@@ -438,9 +565,9 @@ void jit_print_queue(struct jit_queue_s *queue, bool show_all, int debug_level)
         loop_end = (show_all == true) ? JIT_QUEUE_MAX : queue->num_pkt;
         for (i=0; i<loop_end; i++) {
             MSG_DEBUG(debug_level, " - node[%d]: count_us=%u - type=%d\n",
-                        i,
-                        queue->nodes[i].pkt.count_us,
-                        queue->nodes[i].pkt_type);
+                        queue->index[i],
+                        queue->nodes[queue->index[i]].pkt.count_us,
+                        queue->nodes[queue->index[i]].pkt_type);
         }
 
         pthread_mutex_unlock(&mx_jit_queue);
@@ -14,6 +14,8 @@
     #define _XOPEN_SOURCE 500
 #endif
 
+#define _GNU_SOURCE         /* recvmmsg, sendmmsg */
+
 #include <stdint.h>         /* C99 types */
 #include <stdbool.h>        /* bool type */
 #include <stdio.h>          /* printf, fprintf, snprintf, fopen, fputs */
@@ -28,6 +30,8 @@
 #include <stdlib.h>         /* atoi, exit */
 #include <errno.h>          /* error messages */
 #include <math.h>           /* modf */
+#include <sched.h>          /* sched_param, cpu_set_t */
+#include <sys/mman.h>       /* mlockall */
 
 #include <sys/socket.h>     /* socket specific definitions */
 #include <netinet/in.h>     /* INET constants and stuff */
@@ -38,6 +42,13 @@
 
 #include "trace.h"
 #include "jitqueue.h"
+#include "airtime.h"
+#include "rxring.h"
+#include "meas.h"
+#include "dedup.h"
+#include "rxpk.h"
+#include "txpk.h"
+#include "binpk.h"
 #include "parson.h"
 #include "base64.h"
 #include "loragw_hal.h"
@@ -65,13 +76,19 @@
 #define DEFAULT_KEEPALIVE   5           /* default time interval for downstream keep-alive packet */
 #define DEFAULT_STAT        30          /* default time interval for statistics */
 #define PUSH_TIMEOUT_MS     100
+#define PUSH_ACK_TABLE_SIZE 32          /* max nb of PUSH_DATA datagrams waiting for their PUSH_ACK */
 #define PULL_TIMEOUT_MS     200
 #define GPS_REF_MAX_AGE     30          /* maximum admitted delay in seconds of GPS loss before considering latest GPS sync unusable */
-#define FETCH_SLEEP_MS      10          /* nb of ms waited when a fetch return no packets */
+#define FETCH_SLEEP_MS      10          /* max nb of ms waited for the concentrator to signal data when a fetch return no packets */
+#define PUSH_WINDOW_MAX_MS  1000        /* max nb of ms uplinks can be held to be sent in a same PUSH_DATA */
 #define BEACON_POLL_MS      50          /* time in ms between polling of beacon TX status */
+#define JIT_IDLE_WAIT_US    100000      /* max nb of us waited by the JIT thread for a packet to be due, no TX pending */
+#define JIT_TX_POLL_US      10000       /* max nb of us waited by the JIT thread while a TX is pending, to report its completion */
+#define TX_CNT_ERR_MAX_US   5000        /* max error of the concentrator time estimated for the TX path, a sixth of the JiT queue pre-delay */
+#define JIT_LATE_US         10000       /* JIT thread wakeup lateness counted as late, a third of the JiT queue pre-delay */
+#define THREAD_STACK_SIZE   (1024 * 1024) /* stack size of the threads when the memory is locked */
 
 #define PROTOCOL_VERSION    2           /* v1.3 */
-#define PROTOCOL_JSON_RXPK_FRAME_FORMAT 1
 
 #define PKT_PUSH_DATA   0
 #define PKT_PUSH_ACK    1
@@ -81,10 +98,67 @@
 #define PKT_TX_ACK      5
 
 #define NB_PKT_MAX      255 /* max number of packets per fetch/send cycle */
+#define NB_BOARD_MAX    4   /* max number of concentrator boards run by the forwarder */
 
-#define STATUS_SIZE     200
+#define STATUS_SIZE     512
+#define LAT_JSON_SIZE   320 /* latency object of the status report */
 #define TX_BUFF_SIZE    ((540 * NB_PKT_MAX) + 30 + STATUS_SIZE)
-#define ACK_BUFF_SIZE   64
+#define DOWN_BATCH_MAX  16  /* max number of datagrams received at once by the downstream thread */
+#define TXPK_BATCH_MAX  8   /* max number of packets per PULL_RESP */
+#define DOWN_BUFF_SIZE  4096
+#define ACK_BUFF_SIZE   (32 + (48 * TXPK_BATCH_MAX))
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+/* Concentrator board, with its own HAL context, fetch thread and JiT queues */
+struct board_s {
+    int index; /* board number, "brd" field of rxpk and txpk */
+    lgw_ctx_t *ctx; /* HAL context of the board */
+    pthread_t thrid_rx; /* fetch thread */
+    pthread_t thrid_jit; /* JiT thread */
+
+    /* Packets fetched from the concentrator, waiting to be forwarded (lock-free) */
+    struct rx_ring_s rx_ring;
+
+    /* Just In Time TX scheduling, one queue per TX radio */
+    struct jit_queue_s jit_queue[LGW_TX_CHANNEL_NB_MAX];
+
+    /* Board specificities */
+    int8_t antenna_gain;
+    uint8_t lora_sync_word;
+
+    /* TX capabilities */
+    uint8_t nb_tx_radio; /* number of TX radios of the concentrator, each one has its JiT queue */
+    uint32_t tx_freq_min[LGW_TX_CHANNEL_NB_MAX]; /* lowest frequency supported by TX chain */
+    uint32_t tx_freq_max[LGW_TX_CHANNEL_NB_MAX]; /* highest frequency supported by TX chain */
+
+    /* TX airtime of the radios and frequencies, with their budgets */
+    struct airtime_s airtime;
+
+    uint64_t tx_send_us; /* host time the last downlink was handed to the concentrator */
+};
+
+/* Stages of the packets through the forwarder, their latency is recorded in microseconds */
+enum lat_stage_e {
+    LAT_UP_FETCH,   /* uplink received by the concentrator to fetched by the host (concentrator clock) */
+    LAT_UP_SEND,    /* uplink fetched to sent in a PUSH_DATA */
+    LAT_DW_QUEUE,   /* PULL_RESP received to its downlinks queued */
+    LAT_DW_LEAD,    /* downlink queued to its timestamp (concentrator clock) */
+    LAT_DW_MARGIN,  /* downlink handed to the concentrator to its timestamp (concentrator clock) */
+    LAT_DW_DONE,    /* downlink handed to the concentrator to its TX done report */
+    LAT_JIT_WAKE,   /* end of the JIT thread wait to the thread running again */
+    LAT_NB_STAGE
+};
+
+/* PULL_RESP received, with the packets it holds in the downlinks of the batch */
+struct pull_resp_s {
+    uint8_t token_h; /* token of the TX_ACK */
+    uint8_t token_l;
+    bool is_array; /* "txpk" is an array, each packet has its status in the TX_ACK */
+    int first; /* index of the first downlink */
+    int nb; /* number of downlinks */
+};
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE VARIABLES (GLOBAL) ------------------------------------------- */
@@ -97,6 +171,12 @@ volatile bool quit_sig = false; /* 1 -> application terminates without shutting
 static bool fwd_valid_pkt = true; /* packets with PAYLOAD CRC OK are forwarded */
 static bool fwd_error_pkt = false; /* packets with PAYLOAD CRC ERROR are NOT forwarded */
 static bool fwd_nocrc_pkt = false; /* packets with NO PAYLOAD CRC are NOT forwarded */
+static bool uplink_dedup = false; /* copies of a packet received by several radios are all forwarded */
+static uint32_t dedup_window_us = DEDUP_WINDOW_DEFAULT; /* max count_us difference between copies of a packet */
+
+/* uplink aggregation window */
+static uint32_t push_window_ms = 0; /* max nb of ms the first uplink of a PUSH_DATA is held, 0 = sent as soon as fetched */
+static uint32_t push_max_bytes = 1400; /* PUSH_DATA is sent before the window ends when its uplinks reach that size */
 
 /* network configuration variables */
 static bool gateway_id_auto = false;
@@ -118,62 +198,80 @@ static int sock_up; /* socket for upstream traffic */
 static int sock_down; /* socket for downstream traffic */
 
 /* network protocol variables */
-static struct timeval push_timeout_half = {0, (PUSH_TIMEOUT_MS * 500)}; /* cut in half, critical for throughput */
+static uint8_t protocol_version = PROTOCOL_VERSION; /* PROTOCOL_VERSION for JSON payloads, BINPK_PROTOCOL_VERSION for binary ones */
+static struct timeval push_timeout_half = {0, (PUSH_TIMEOUT_MS * 500)}; /* cut in half, PUSH_ACK are checked at least twice before time-out */
 static struct timeval pull_timeout = {0, (PULL_TIMEOUT_MS * 1000)}; /* non critical for throughput */
 
 /* hardware access control and correction */
-pthread_mutex_t mx_concent = PTHREAD_MUTEX_INITIALIZER; /* control access to the concentrator */
-
-/* measurements to establish statistics */
-static pthread_mutex_t mx_meas_up = PTHREAD_MUTEX_INITIALIZER; /* control access to the upstream measurements */
-static uint32_t meas_nb_rx_rcv = 0; /* count packets received */
-static uint32_t meas_nb_rx_ok = 0; /* count packets received with PAYLOAD CRC OK */
-static uint32_t meas_nb_rx_bad = 0; /* count packets received with PAYLOAD CRC ERROR */
-static uint32_t meas_nb_rx_nocrc = 0; /* count packets received with NO PAYLOAD CRC */
-static uint32_t meas_up_pkt_fwd = 0; /* number of radio packet forwarded to the server */
-static uint32_t meas_up_network_byte = 0; /* sum of UDP bytes sent for upstream traffic */
-static uint32_t meas_up_payload_byte = 0; /* sum of radio payload bytes sent for upstream traffic */
-static uint32_t meas_up_dgram_sent = 0; /* number of datagrams sent for upstream traffic */
-static uint32_t meas_up_ack_rcv = 0; /* number of datagrams acknowledged for upstream traffic */
-
-static pthread_mutex_t mx_meas_dw = PTHREAD_MUTEX_INITIALIZER; /* control access to the downstream measurements */
-static uint32_t meas_dw_pull_sent = 0; /* number of PULL requests sent for downstream traffic */
-static uint32_t meas_dw_ack_rcv = 0; /* number of PULL requests acknowledged for downstream traffic */
-static uint32_t meas_dw_dgram_rcv = 0; /* count PULL response packets received for downstream traffic */
-static uint32_t meas_dw_network_byte = 0; /* sum of UDP bytes sent for upstream traffic */
-static uint32_t meas_dw_payload_byte = 0; /* sum of radio payload bytes sent for upstream traffic */
-static uint32_t meas_nb_tx_ok = 0; /* count packets emitted successfully */
-static uint32_t meas_nb_tx_fail = 0; /* count packets were TX failed for other reasons */
-static uint32_t meas_nb_tx_requested = 0; /* count TX request from server (downlinks) */
-static uint32_t meas_nb_tx_rejected_collision_packet = 0; /* count packets were TX request were rejected due to collision with another packet already programmed */
-static uint32_t meas_nb_tx_rejected_collision_beacon = 0; /* count packets were TX request were rejected due to collision with a beacon already programmed */
-static uint32_t meas_nb_tx_rejected_too_late = 0; /* count packets were TX request were rejected because it is too late to program it */
-static uint32_t meas_nb_tx_rejected_too_early = 0; /* count packets were TX request were rejected because timestamp is too much in advance */
+
+/* measurements to establish statistics, counted by each thread with meas_add() */
+static uint64_t meas_prev[MEAS_NB]; /* counters at the previous report */
 
 static pthread_mutex_t mx_stat_rep = PTHREAD_MUTEX_INITIALIZER; /* control access to the status report */
 static bool report_ready = false; /* true when there is a new report to send to the server */
 static char status_report[STATUS_SIZE]; /* status report as a JSON object */
+static struct binpk_stat_s status_report_bin; /* status report for the binary protocol */
 
 /* auto-quit function */
 static uint32_t autoquit_threshold = 0; /* enable auto-quit after a number of non-acknowledged PULL_DATA (0 = disabled)*/
 
-/* Just In Time TX scheduling */
-static struct jit_queue_s jit_queue[LGW_TX_CHANNEL_NB_MAX];
-
-/* Gateway specificities */
-static int8_t antenna_gain = 0;
+/* Concentrator boards, "radio_conf" object or array of objects */
+static struct board_s boards[NB_BOARD_MAX];
+static int nb_board = 0;
 
-/* LoRa network configuration */
-static uint8_t lora_sync_word = LORA_SYNC_WORD_PUBLIC;
+/* PUSH_DATA datagrams waiting to be acknowledged */
+static pthread_mutex_t mx_push_ack = PTHREAD_MUTEX_INITIALIZER; /* control access to the PUSH_ACK tokens table */
+static struct {
+    bool pending; /* true if waiting for the PUSH_ACK */
+    uint16_t token; /* token of the PUSH_DATA datagram */
+    struct timespec send_time; /* time the PUSH_DATA datagram was sent */
+} push_ack_table[PUSH_ACK_TABLE_SIZE];
 
-/* TX capabilities */
-static uint32_t tx_freq_min[LGW_TX_CHANNEL_NB_MAX]; /* lowest frequency supported by TX chain */
-static uint32_t tx_freq_max[LGW_TX_CHANNEL_NB_MAX]; /* highest frequency supported by TX chain */
+/* Used by the upstream thread to sleep until one of the boards RX rings is not empty */
+static pthread_mutex_t mx_rx_ring = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond_rx_ring = PTHREAD_COND_INITIALIZER;
 
 static uint32_t nb_pkt_log[LGW_RX_CHANNEL_NB_MAX][8]; /* [CH][SF] */
 static uint32_t nb_pkt_received = 0;
 static uint32_t nb_pkt_sent = 0;
 
+/* latency statistics, recorded lock-free by all the threads */
+static struct lgw_hist_s lat_hist[LAT_NB_STAGE];
+static const struct {
+    const char *name; /* name in the status report */
+    const char *label;
+} lat_stage[LAT_NB_STAGE] = {
+    { "upfe", "uplink RX to fetch" },
+    { "upsn", "uplink fetch to PUSH_DATA" },
+    { "dwqu", "PULL_RESP to downlink queued" },
+    { "dwld", "downlink queued to timestamp" },
+    { "dwmg", "downlink sent to timestamp" },
+    { "dwtx", "downlink sent to TX done" },
+    { "jitw", "JIT thread wakeup lateness" }
+};
+
+/* scheduling of the threads, the fetch and JiT threads of all the boards share the same */
+enum thread_e {
+    THREAD_RX,
+    THREAD_UP,
+    THREAD_UP_ACK,
+    THREAD_DOWN,
+    THREAD_JIT,
+    THREAD_NB
+};
+static struct {
+    const char *name; /* name in the "thread_sched" object of the configuration */
+    int priority; /* SCHED_FIFO priority, 0 for the default policy */
+    int cpu; /* CPU the thread is pinned to, -1 for any */
+} thread_sched[THREAD_NB] = {
+    { "rx", 0, -1 },
+    { "up", 0, -1 },
+    { "up_ack", 0, -1 },
+    { "down", 0, -1 },
+    { "jit", 0, -1 }
+};
+static bool mem_lock = false; /* lock all the memory of the process in RAM */
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
 
@@ -181,18 +279,48 @@ static void usage(void);
 
 static void sig_handler(int sigio);
 
+static int parse_board_configuration(JSON_Object * conf_obj, struct board_s * brd);
+
 static int parse_radio_configuration(const char * conf_file);
 
 static int parse_gateway_configuration(const char * conf_file);
 
 static double difftimespec(struct timespec end, struct timespec beginning);
 
+static uint64_t monotonic_ms(void);
+
+static uint64_t monotonic_us(void);
+
+static void lat_record_cnt(enum lat_stage_e stage, uint32_t from_us, uint32_t to_us);
+
+static int tx_time_sample(struct board_s * brd, uint32_t * count_us);
+
+static int report_latency(char *json, int size);
+
+static uint16_t push_ack_register(void);
+
+static void push_ack_expire(struct timespec now);
+
 static void print_nb_pkt_stats(void);
 
+static void tx_done(e_tx_result result, uint32_t count_us, void * arg);
+
+static void jit_dropped(const struct lgw_pkt_tx_s *pkt, enum jit_pkt_type_e pkt_type, void *arg);
+
+static enum jit_error_e jit_enqueue_radio(struct board_s * brd, uint32_t time_us, struct lgw_pkt_tx_s *pkt, enum jit_pkt_type_e pkt_type);
+
+static enum jit_error_e prepare_downlink(struct lgw_pkt_tx_s *txpkt, const struct txpk_info_s *txpk_info, struct board_s **brd_out, enum jit_pkt_type_e *downlink_type, enum jit_error_e *warning_result, int32_t *warning_value);
+
+static void txpk_warning(enum txpk_error_e txpk_err, const struct txpk_info_s *txpk_info);
+
+static void thread_sched_apply(pthread_t thrid, enum thread_e thread);
+
 /* threads */
+void * thread_rx(void * arg); /* one per board, arg is the board */
 void thread_up(void);
 void thread_down(void);
-void thread_jit(void);
+void * thread_jit(void * arg); /* one per board, arg is the board */
+void thread_up_ack(void);
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
@@ -216,35 +344,20 @@ static void sig_handler(int sigio) {
     return;
 }
 
-static int parse_radio_configuration(const char * conf_file) {
+/* Parse the configuration of one board, and submit it to the HAL context of the board */
+static int parse_board_configuration(JSON_Object * conf_obj, struct board_s * brd) {
     int i;
     char param_name[32]; /* used to generate variable parameter names */
     const char *str; /* used to store string value from JSON object */
-    const char conf_obj_name[] = "radio_conf";
-    JSON_Value *root_val = NULL;
     JSON_Value *val = NULL;
-    JSON_Object *conf_obj = NULL;
 
     struct lgw_conf_board_s boardconf;
     struct lgw_conf_channel_rx_s rxconf;
     struct lgw_conf_channel_tx_s txconf;
     uint32_t sf, bw;
-
-    /* try to parse JSON */
-    root_val = json_parse_file_with_comments(conf_file);
-    if (root_val == NULL) {
-        MSG("ERROR: %s is not a valid JSON file\n", conf_file);
-        exit(EXIT_FAILURE);
-    }
-
-    /* point to the gateway configuration object */
-    conf_obj = json_object_get_object(json_value_get_object(root_val), conf_obj_name);
-    if (conf_obj == NULL) {
-        MSG("INFO: %s does not contain a JSON object named %s\n", conf_file, conf_obj_name);
-        return -1;
-    } else {
-        MSG("INFO: %s does contain a JSON object named %s, parsing radio parameters\n", conf_file, conf_obj_name);
-    }
+    uint32_t airtime_window = AIRTIME_WINDOW_DEFAULT;
+    float airtime_max_radio = 0.0;
+    float airtime_max_chan = 0.0;
 
     /* set board configuration */
     memset(&boardconf, 0, sizeof boardconf); /* initialize configuration structure */
@@ -253,13 +366,41 @@ static int parse_radio_configuration(const char * conf_file) {
         strncpy(boardconf.tty_path, str, sizeof boardconf.tty_path);
         boardconf.tty_path[sizeof boardconf.tty_path - 1] = '\0'; /* ensure string termination */
     } else {
-        MSG("ERROR: tty path must be configured in %s\n", conf_file);
+        MSG("ERROR: tty path must be configured for board %d\n", brd->index);
         return -1;
     }
 
     MSG("INFO: tty_path %s\n", boardconf.tty_path);
+    val = json_object_get_value(conf_obj, "rx_event_mode"); /* fetch value (if possible) */
+    if (json_value_get_type(val) == JSONBoolean) {
+        boardconf.rx_event_mode = (bool)json_value_get_boolean(val);
+    } else {
+        boardconf.rx_event_mode = false;
+    }
+    MSG("INFO: RX packets will be %s\n", (boardconf.rx_event_mode == true) ? "pushed by the concentrator" : "polled from the concentrator");
+    val = json_object_get_value(conf_obj, "status_refresh_ms"); /* fetch value (if possible) */
+    if (json_value_get_type(val) == JSONNumber) {
+        boardconf.status_refresh_ms = (uint32_t)json_value_get_number(val);
+    } else {
+        boardconf.status_refresh_ms = 0;
+    }
+    MSG("INFO: concentrator status refreshed every %u ms\n", boardconf.status_refresh_ms);
+    val = json_object_get_value(conf_obj, "com_timeout_ms"); /* fetch value (if possible) */
+    if (json_value_get_type(val) == JSONNumber) {
+        boardconf.com_timeout_ms = (int32_t)json_value_get_number(val);
+        MSG("INFO: MCU frames timeout is %d ms\n", boardconf.com_timeout_ms);
+    } else {
+        boardconf.com_timeout_ms = 0;
+    }
+    val = json_object_get_value(conf_obj, "fast_start"); /* fetch value (if possible) */
+    if (json_value_get_type(val) == JSONBoolean) {
+        boardconf.fast_start = (bool)json_value_get_boolean(val);
+    } else {
+        boardconf.fast_start = false;
+    }
+    MSG("INFO: fast start is %s\n", (boardconf.fast_start == true) ? "enabled" : "disabled");
     /* all parameters parsed, submitting configuration to the HAL */
-    if (lgw_board_setconf(&boardconf) != LGW_HAL_SUCCESS) {
+    if (lgw_ctx_board_setconf(brd->ctx, &boardconf) != LGW_HAL_SUCCESS) {
         MSG("ERROR: Failed to configure board\n");
         return -1;
     }
@@ -268,27 +409,27 @@ static int parse_radio_configuration(const char * conf_file) {
     val = json_object_get_value(conf_obj, "antenna_gain"); /* fetch value (if possible) */
     if (val != NULL) {
         if (json_value_get_type(val) == JSONNumber) {
-            antenna_gain = (int8_t)json_value_get_number(val);
+            brd->antenna_gain = (int8_t)json_value_get_number(val);
         } else {
             MSG("WARNING: Data type for antenna_gain seems wrong, please check\n");
-            antenna_gain = 0;
+            brd->antenna_gain = 0;
         }
     }
-    MSG("INFO: antenna_gain %d dBi\n", antenna_gain);
+    MSG("INFO: antenna_gain %d dBi\n", brd->antenna_gain);
 
     /* set LoRa sync word (public or private) */
     val = json_object_get_value(conf_obj, "lorawan_public"); /* fetch value (if possible) */
     if (json_value_get_type(val) == JSONBoolean) {
         if ((bool)json_value_get_boolean(val) == true) {
-            lora_sync_word = LORA_SYNC_WORD_PUBLIC;
+            brd->lora_sync_word = LORA_SYNC_WORD_PUBLIC;
         } else {
-            lora_sync_word = LORA_SYNC_WORD_PRIVATE;
+            brd->lora_sync_word = LORA_SYNC_WORD_PRIVATE;
         }
     } else {
         MSG("WARNING: Data type for lorawan_public seems wrong, please check\n");
-        lora_sync_word = LORA_SYNC_WORD_PUBLIC;
+        brd->lora_sync_word = LORA_SYNC_WORD_PUBLIC;
     }
-    MSG("INFO: LoRa sync_word 0x%02X (%s)\n", lora_sync_word, (lora_sync_word == LORA_SYNC_WORD_PUBLIC) ? "public" : "private");
+    MSG("INFO: LoRa sync_word 0x%02X (%s)\n", brd->lora_sync_word, (brd->lora_sync_word == LORA_SYNC_WORD_PUBLIC) ? "public" : "private");
 
     /* set configuration for RX channels */
     for (i = 0; i < LGW_RX_CHANNEL_NB_MAX; ++i) {
@@ -362,11 +503,11 @@ static int parse_radio_configuration(const char * conf_file) {
                 MSG("WARNING: no RSSI offset configured for channel %i\n", i);
                 rxconf.rssi_offset = 0.0;
             }
-            rxconf.sync_word = lora_sync_word;
+            rxconf.sync_word = brd->lora_sync_word;
             MSG("INFO: channel %i enabled: frequency %u, bandwidth %uHz, SF%u, RSSI offset %.1f\n", i, rxconf.freq_hz, bw, sf, rxconf.rssi_offset);
         }
         /* all parameters parsed, submitting configuration to the HAL */
-        if (lgw_channel_rx_setconf(i, &rxconf) != LGW_HAL_SUCCESS) {
+        if (lgw_ctx_channel_rx_setconf(brd->ctx, i, &rxconf) != LGW_HAL_SUCCESS) {
             MSG("ERROR: invalid configuration for channel %i\n", i);
             return -1;
         }
@@ -388,22 +529,121 @@ static int parse_radio_configuration(const char * conf_file) {
         if (txconf.enable == false) { /* TX disabled, nothing else to parse */
             MSG("INFO: TX disabled\n");
         } else { /* TX enabled, will parse the other parameters */
-            tx_freq_min[0] = (uint32_t)json_object_dotget_number(conf_obj, "tx.tx_freq_min");
-            tx_freq_max[0] = (uint32_t)json_object_dotget_number(conf_obj, "tx.tx_freq_max");
-            MSG("INFO: TX enabled, freq min %uHz, freq max %uHz\n", tx_freq_min[0], tx_freq_max[0]);
+            brd->tx_freq_min[0] = (uint32_t)json_object_dotget_number(conf_obj, "tx.tx_freq_min");
+            brd->tx_freq_max[0] = (uint32_t)json_object_dotget_number(conf_obj, "tx.tx_freq_max");
+            MSG("INFO: TX enabled, freq min %uHz, freq max %uHz\n", brd->tx_freq_min[0], brd->tx_freq_max[0]);
+            /* other TX radios have the same frequency range, unless configured in "radio_N" */
+            for (i = 1; i < LGW_TX_CHANNEL_NB_MAX; ++i) {
+                brd->tx_freq_min[i] = brd->tx_freq_min[0];
+                brd->tx_freq_max[i] = brd->tx_freq_max[0];
+                snprintf(param_name, sizeof param_name, "tx.radio_%i.tx_freq_min", i);
+                val = json_object_dotget_value(conf_obj, param_name);
+                if (json_value_get_type(val) == JSONNumber) {
+                    brd->tx_freq_min[i] = (uint32_t)json_value_get_number(val);
+                }
+                snprintf(param_name, sizeof param_name, "tx.radio_%i.tx_freq_max", i);
+                val = json_object_dotget_value(conf_obj, param_name);
+                if (json_value_get_type(val) == JSONNumber) {
+                    brd->tx_freq_max[i] = (uint32_t)json_value_get_number(val);
+                }
+                MSG("INFO: TX radio %i, freq min %uHz, freq max %uHz\n", i, brd->tx_freq_min[i], brd->tx_freq_max[i]);
+            }
+            /* airtime budgets over a sliding window, no limit by default */
+            val = json_object_dotget_value(conf_obj, "tx.airtime_window");
+            if (json_value_get_type(val) == JSONNumber) {
+                airtime_window = (uint32_t)json_value_get_number(val);
+            }
+            val = json_object_dotget_value(conf_obj, "tx.airtime_max_radio");
+            if (json_value_get_type(val) == JSONNumber) {
+                airtime_max_radio = (float)json_value_get_number(val);
+            }
+            val = json_object_dotget_value(conf_obj, "tx.airtime_max_channel");
+            if (json_value_get_type(val) == JSONNumber) {
+                airtime_max_chan = (float)json_value_get_number(val);
+            }
+            MSG("INFO: TX airtime budget over %us: %.2f%% per radio, %.2f%% per frequency (0 for no limit)\n", airtime_window, airtime_max_radio, airtime_max_chan);
         }
         /* all parameters parsed, submitting configuration to the HAL */
-        if (lgw_channel_tx_setconf(&txconf) != LGW_HAL_SUCCESS) {
+        if (lgw_ctx_channel_tx_setconf(brd->ctx, &txconf) != LGW_HAL_SUCCESS) {
             MSG("ERROR: invalid configuration for TX\n");
             return -1;
         }
     }
+    if (airtime_init(&brd->airtime, airtime_window, airtime_max_radio, airtime_max_chan) != 0) {
+        MSG("ERROR: invalid TX airtime budget, window must be 1 to %us and budgets 0 to 100%%\n", AIRTIME_WINDOW_MAX_S);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int parse_radio_configuration(const char * conf_file) {
+    int i;
+    int nb;
+    const char conf_obj_name[] = "radio_conf";
+    JSON_Value *root_val = NULL;
+    JSON_Value *val = NULL;
+    JSON_Array *conf_array = NULL;
+    JSON_Object *conf_obj = NULL;
+    struct board_s *brd;
+
+    /* try to parse JSON */
+    root_val = json_parse_file_with_comments(conf_file);
+    if (root_val == NULL) {
+        MSG("ERROR: %s is not a valid JSON file\n", conf_file);
+        exit(EXIT_FAILURE);
+    }
+
+    /* point to the radio configuration, one object per board or a single object for one board */
+    val = json_object_get_value(json_value_get_object(root_val), conf_obj_name);
+    if (json_value_get_type(val) == JSONObject) {
+        nb = 1;
+    } else if (json_value_get_type(val) == JSONArray) {
+        conf_array = json_value_get_array(val);
+        nb = (int)json_array_get_count(conf_array);
+    } else {
+        MSG("INFO: %s does not contain a JSON object named %s\n", conf_file, conf_obj_name);
+        json_value_free(root_val);
+        return -1;
+    }
+    if ((nb < 1) || (nb > NB_BOARD_MAX)) {
+        MSG("ERROR: %s must configure 1 to %d boards, %d found\n", conf_obj_name, NB_BOARD_MAX, nb);
+        json_value_free(root_val);
+        return -1;
+    }
+    MSG("INFO: %s does contain a JSON object named %s, parsing radio parameters of %d board(s)\n", conf_file, conf_obj_name, nb);
+
+    for (i = 0; i < nb; i++) {
+        conf_obj = (conf_array != NULL) ? json_array_get_object(conf_array, i) : json_value_get_object(val);
+        if (conf_obj == NULL) {
+            MSG("ERROR: configuration of board %d is not a JSON object\n", i);
+            json_value_free(root_val);
+            return -1;
+        }
+        brd = &boards[i];
+        brd->index = i;
+        brd->ctx = lgw_ctx_new();
+        if (brd->ctx == NULL) {
+            json_value_free(root_val);
+            return -1;
+        }
+        nb_board = i + 1;
+        MSG("INFO: parsing configuration of board %d\n", i);
+        if (parse_board_configuration(conf_obj, brd) != 0) {
+            json_value_free(root_val);
+            return -1;
+        }
+    }
 
     json_value_free(root_val);
 
     return 0;
 }
 
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 static int parse_gateway_configuration(const char * conf_file) {
     int i;
     const char conf_obj_name[] = "gateway_conf";
@@ -413,6 +653,9 @@ static int parse_gateway_configuration(const char * conf_file) {
     const char *str; /* pointer to sub-strings in the JSON data */
     unsigned long long ull = 0;
     char str_tmp[5] = "\0";
+    JSON_Object *sched_obj = NULL;
+    JSON_Object *thread_obj = NULL;
+    int prio_min, prio_max;
 
     /* try to parse JSON */
     root_val = json_parse_file_with_comments(conf_file);
@@ -511,6 +754,78 @@ static int parse_gateway_configuration(const char * conf_file) {
         fwd_nocrc_pkt = (bool)json_value_get_boolean(val);
     }
     MSG("INFO: packets received with no CRC will%s be forwarded\n", (fwd_nocrc_pkt ? "" : " NOT"));
+    val = json_object_get_value(conf_obj, "uplink_dedup");
+    if (json_value_get_type(val) == JSONBoolean) {
+        uplink_dedup = (bool)json_value_get_boolean(val);
+    }
+    val = json_object_get_value(conf_obj, "dedup_window_us");
+    if (val != NULL) {
+        dedup_window_us = (uint32_t)json_value_get_number(val);
+    }
+    if (uplink_dedup == true) {
+        MSG("INFO: copies of a packet received less than %u us apart will be forwarded once\n", dedup_window_us);
+    } else {
+        MSG("INFO: copies of a packet received by several radios will all be forwarded\n");
+    }
+
+    /* uplink aggregation window (optional) */
+    val = json_object_get_value(conf_obj, "push_window_ms");
+    if (val != NULL) {
+        push_window_ms = (uint32_t)json_value_get_number(val);
+        if (push_window_ms > PUSH_WINDOW_MAX_MS) {
+            MSG("WARNING: push_window_ms %u is too long, set to %u ms\n", push_window_ms, PUSH_WINDOW_MAX_MS);
+            push_window_ms = PUSH_WINDOW_MAX_MS;
+        }
+    }
+    val = json_object_get_value(conf_obj, "push_max_bytes");
+    if (val != NULL) {
+        push_max_bytes = (uint32_t)json_value_get_number(val);
+    }
+    if (push_window_ms > 0) {
+        MSG("INFO: uplinks will be held up to %u ms, or %u bytes, to be sent in a same PUSH_DATA\n", push_window_ms, push_max_bytes);
+    }
+
+    /* real-time priority and CPU of the threads (optional) */
+    sched_obj = json_object_get_object(conf_obj, "thread_sched");
+    if (sched_obj != NULL) {
+        prio_min = sched_get_priority_min(SCHED_FIFO);
+        prio_max = sched_get_priority_max(SCHED_FIFO);
+        for (i = 0; i < THREAD_NB; i++) {
+            thread_obj = json_object_get_object(sched_obj, thread_sched[i].name);
+            if (thread_obj == NULL) {
+                continue;
+            }
+            val = json_object_get_value(thread_obj, "priority");
+            if (val != NULL) {
+                thread_sched[i].priority = (int)json_value_get_number(val);
+                if ((thread_sched[i].priority != 0) && ((thread_sched[i].priority < prio_min) || (thread_sched[i].priority > prio_max))) {
+                    MSG("ERROR: %s thread priority %d is not a SCHED_FIFO priority [%d..%d]\n", thread_sched[i].name, thread_sched[i].priority, prio_min, prio_max);
+                    exit(EXIT_FAILURE);
+                }
+            }
+            val = json_object_get_value(thread_obj, "cpu");
+            if (val != NULL) {
+                thread_sched[i].cpu = (int)json_value_get_number(val);
+                if ((thread_sched[i].cpu < -1) || (thread_sched[i].cpu >= CPU_SETSIZE)) {
+                    MSG("ERROR: %s thread CPU %d is not valid\n", thread_sched[i].name, thread_sched[i].cpu);
+                    exit(EXIT_FAILURE);
+                }
+            }
+            if (thread_sched[i].priority > 0) {
+                MSG("INFO: %s thread will run with SCHED_FIFO priority %d\n", thread_sched[i].name, thread_sched[i].priority);
+            }
+            if (thread_sched[i].cpu >= 0) {
+                MSG("INFO: %s thread will run on CPU %d\n", thread_sched[i].name, thread_sched[i].cpu);
+            }
+        }
+    }
+    val = json_object_get_value(conf_obj, "mlockall");
+    if (json_value_get_type(val) == JSONBoolean) {
+        mem_lock = (bool)json_value_get_boolean(val);
+    }
+    if (mem_lock == true) {
+        MSG("INFO: memory of the process will be locked in RAM\n");
+    }
 
     /* Auto-quit threshold (optional) */
     val = json_object_get_value(conf_obj, "autoquit_threshold");
@@ -519,6 +834,13 @@ static int parse_gateway_configuration(const char * conf_file) {
         MSG("INFO: Auto-quit after %u non-acknowledged PULL_DATA\n", autoquit_threshold);
     }
 
+    /* binary framing of uplinks and downlinks, instead of JSON (optional) */
+    val = json_object_get_value(conf_obj, "binary_protocol");
+    if (json_value_get_type(val) == JSONBoolean) {
+        protocol_version = (bool)json_value_get_boolean(val) ? BINPK_PROTOCOL_VERSION : PROTOCOL_VERSION;
+    }
+    MSG("INFO: %s protocol will be used (version %u)\n", (protocol_version == BINPK_PROTOCOL_VERSION) ? "binary" : "JSON", protocol_version);
+
     /* free JSON parsing data structure */
     json_value_free(root_val);
     return 0;
@@ -533,188 +855,556 @@ static double difftimespec(struct timespec end, struct timespec beginning) {
     return x;
 }
 
-static int send_tx_ack(uint8_t token_h, uint8_t token_l, enum jit_error_e error, int32_t error_value) {
-    uint8_t buff_ack[ACK_BUFF_SIZE]; /* buffer to give feedback to server */
-    int buff_index;
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static uint64_t monotonic_ms(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1000) + (now.tv_nsec / 1000000);
+}
+
+static uint64_t monotonic_us(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1000000) + (now.tv_nsec / 1000);
+}
+
+static uint16_t push_ack_register(void) {
+    int i, j;
+    int slot = -1;
+    uint16_t token;
+    bool in_use;
+
+    pthread_mutex_lock(&mx_push_ack);
+
+    /* get a random token, which is not already waiting for an acknowledge */
+    do {
+        token = (uint16_t)rand();
+        in_use = false;
+        for (j = 0; j < PUSH_ACK_TABLE_SIZE; j++) {
+            if (push_ack_table[j].pending && (push_ack_table[j].token == token)) {
+                in_use = true;
+                break;
+            }
+        }
+    } while (in_use == true);
+
+    /* get a free slot, or replace the oldest datagram if the table is full */
+    for (i = 0; i < PUSH_ACK_TABLE_SIZE; i++) {
+        if (push_ack_table[i].pending == false) {
+            slot = i;
+            break;
+        }
+        if ((slot == -1) || (difftimespec(push_ack_table[slot].send_time, push_ack_table[i].send_time) > 0)) {
+            slot = i;
+        }
+    }
+    if (push_ack_table[slot].pending == true) {
+        meas_add(MEAS_UP_ACK_LOST, 1);
+    }
+    push_ack_table[slot].pending = true;
+    push_ack_table[slot].token = token;
+    clock_gettime(CLOCK_MONOTONIC, &push_ack_table[slot].send_time);
+
+    pthread_mutex_unlock(&mx_push_ack);
+
+    return token;
+}
+
+static void push_ack_expire(struct timespec now) {
+    int i;
+    uint32_t nb_lost = 0;
+    double timeout = (double)push_timeout_half.tv_usec / 500000.0; /* full PUSH_DATA time-out, in seconds */
+
+    pthread_mutex_lock(&mx_push_ack);
+    for (i = 0; i < PUSH_ACK_TABLE_SIZE; i++) {
+        if (push_ack_table[i].pending && (difftimespec(now, push_ack_table[i].send_time) > timeout)) {
+            push_ack_table[i].pending = false;
+            nb_lost += 1;
+        }
+    }
+    pthread_mutex_unlock(&mx_push_ack);
+
+    if (nb_lost > 0) {
+        meas_add(MEAS_UP_ACK_LOST, nb_lost);
+    }
+}
+
+/* Write the status of a downlink as a "txpk_ack" object and account its rejection, return the number of bytes written */
+static int tx_ack_object(char *buff, int size, enum jit_error_e error, int32_t error_value) {
+    const char *name;
+    int meas = -1;
     int j;
 
-    /* reset buffer */
-    memset(&buff_ack, 0, sizeof buff_ack);
+    switch (error) {
+        case JIT_ERROR_OK:
+            name = NULL;
+            break;
+        case JIT_ERROR_FULL:
+        case JIT_ERROR_COLLISION_PACKET:
+            name = "COLLISION_PACKET";
+            meas = MEAS_NB_TX_REJ_COLLISION_PACKET;
+            break;
+        case JIT_ERROR_TOO_LATE:
+            name = "TOO_LATE";
+            meas = MEAS_NB_TX_REJ_TOO_LATE;
+            break;
+        case JIT_ERROR_TOO_EARLY:
+            name = "TOO_EARLY";
+            meas = MEAS_NB_TX_REJ_TOO_EARLY;
+            break;
+        case JIT_ERROR_COLLISION_BEACON:
+            name = "COLLISION_BEACON";
+            meas = MEAS_NB_TX_REJ_COLLISION_BEACON;
+            break;
+        case JIT_ERROR_TX_FREQ:
+            name = "TX_FREQ";
+            break;
+        case JIT_ERROR_TX_POWER:
+            name = "TX_POWER";
+            break;
+        case JIT_ERROR_GPS_UNLOCKED:
+            name = "GPS_UNLOCKED";
+            break;
+        case JIT_ERROR_AIRTIME:
+            name = "AIRTIME";
+            meas = MEAS_NB_TX_REJ_AIRTIME;
+            break;
+        case JIT_ERROR_INVALID:
+            name = "INVALID";
+            break;
+        default:
+            name = "UNKNOWN";
+            break;
+    }
+
+    /* update stats */
+    if (meas != -1) {
+        meas_add(meas, 1);
+    }
+
+    /* the only warning is TX_POWER, given with the power actually used */
+    if (name == NULL) {
+        j = snprintf(buff, size, "{}");
+    } else if (error == JIT_ERROR_TX_POWER) {
+        j = snprintf(buff, size, "{\"warn\":\"%s\",\"value\":%d}", name, error_value);
+    } else {
+        j = snprintf(buff, size, "{\"error\":\"%s\"}", name);
+    }
+    if ((j < 0) || (j >= size)) {
+        MSG("ERROR: [down] snprintf failed line %u\n", (__LINE__ - 2));
+        exit(EXIT_FAILURE);
+    }
+    return j;
+}
+
+/* Write the TX_ACK of a PULL_RESP, with the status of each of its packets, return its size */
+static int tx_ack_build(uint8_t *buff_ack, const struct pull_resp_s *resp, const enum jit_error_e *error, const int32_t *error_value) {
+    int buff_index;
+    int i;
 
     /* Prepare downlink feedback to be sent to server */
-    buff_ack[0] = PROTOCOL_VERSION;
-    buff_ack[1] = token_h;
-    buff_ack[2] = token_l;
+    buff_ack[0] = protocol_version;
+    buff_ack[1] = resp->token_h;
+    buff_ack[2] = resp->token_l;
     buff_ack[3] = PKT_TX_ACK;
     *(uint32_t *)(buff_ack + 4) = net_mac_h;
     *(uint32_t *)(buff_ack + 8) = net_mac_l;
     buff_index = 12; /* 12-byte header */
 
     /* Put no JSON string if there is nothing to report */
-    if (error != JIT_ERROR_OK) {
-        /* start of JSON structure */
-        memcpy((void *)(buff_ack + buff_index), (void *)"{\"txpk_ack\":{", 13);
-        buff_index += 13;
-        /* set downlink error/warning status in JSON structure */
-        switch( error ) {
-            case JIT_ERROR_TX_POWER:
-                memcpy((void *)(buff_ack + buff_index), (void *)"\"warn\":", 7);
-                buff_index += 7;
-                break;
-            default:
-                memcpy((void *)(buff_ack + buff_index), (void *)"\"error\":", 8);
-                buff_index += 8;
-                break;
+    for (i = 0; i < resp->nb; i++) {
+        if (error[i] != JIT_ERROR_OK) {
+            break;
         }
-        /* set error/warning type in JSON structure */
-        switch (error) {
-            case JIT_ERROR_FULL:
-            case JIT_ERROR_COLLISION_PACKET:
-                memcpy((void *)(buff_ack + buff_index), (void *)"\"COLLISION_PACKET\"", 18);
-                buff_index += 18;
-                /* update stats */
-                pthread_mutex_lock(&mx_meas_dw);
-                meas_nb_tx_rejected_collision_packet += 1;
-                pthread_mutex_unlock(&mx_meas_dw);
-                break;
-            case JIT_ERROR_TOO_LATE:
-                memcpy((void *)(buff_ack + buff_index), (void *)"\"TOO_LATE\"", 10);
-                buff_index += 10;
-                /* update stats */
-                pthread_mutex_lock(&mx_meas_dw);
-                meas_nb_tx_rejected_too_late += 1;
-                pthread_mutex_unlock(&mx_meas_dw);
-                break;
-            case JIT_ERROR_TOO_EARLY:
-                memcpy((void *)(buff_ack + buff_index), (void *)"\"TOO_EARLY\"", 11);
-                buff_index += 11;
-                /* update stats */
-                pthread_mutex_lock(&mx_meas_dw);
-                meas_nb_tx_rejected_too_early += 1;
-                pthread_mutex_unlock(&mx_meas_dw);
-                break;
-            case JIT_ERROR_COLLISION_BEACON:
-                memcpy((void *)(buff_ack + buff_index), (void *)"\"COLLISION_BEACON\"", 18);
-                buff_index += 18;
-                /* update stats */
-                pthread_mutex_lock(&mx_meas_dw);
-                meas_nb_tx_rejected_collision_beacon += 1;
-                pthread_mutex_unlock(&mx_meas_dw);
-                break;
-            case JIT_ERROR_TX_FREQ:
-                memcpy((void *)(buff_ack + buff_index), (void *)"\"TX_FREQ\"", 9);
-                buff_index += 9;
-                break;
-            case JIT_ERROR_TX_POWER:
-                memcpy((void *)(buff_ack + buff_index), (void *)"\"TX_POWER\"", 10);
-                buff_index += 10;
-                break;
-            case JIT_ERROR_GPS_UNLOCKED:
-                memcpy((void *)(buff_ack + buff_index), (void *)"\"GPS_UNLOCKED\"", 14);
-                buff_index += 14;
-                break;
-            default:
-                memcpy((void *)(buff_ack + buff_index), (void *)"\"UNKNOWN\"", 9);
-                buff_index += 9;
-                break;
+    }
+    if (i < resp->nb) {
+        /* start of JSON structure, an array of objects in the order of the "txpk" array */
+        memcpy((void *)(buff_ack + buff_index), (void *)"{\"txpk_ack\":", 12);
+        buff_index += 12;
+        if (resp->is_array) {
+            buff_ack[buff_index++] = '[';
         }
-        /* set error/warning details in JSON structure */
-        switch (error) {
-            case JIT_ERROR_TX_POWER:
-                j = snprintf((char *)(buff_ack + buff_index), ACK_BUFF_SIZE-buff_index, ",\"value\":%d", error_value);
-                if (j > 0) {
-                    buff_index += j;
-                } else {
-                    MSG("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 4));
-                    exit(EXIT_FAILURE);
-                }
-                break;
-            default:
-                /* Do nothing */
-                break;
+        for (i = 0; i < resp->nb; i++) {
+            if (i > 0) {
+                buff_ack[buff_index++] = ',';
+            }
+            buff_index += tx_ack_object((char *)(buff_ack + buff_index), ACK_BUFF_SIZE - buff_index, error[i], error_value[i]);
+        }
+        if (resp->is_array) {
+            buff_ack[buff_index++] = ']';
         }
         /* end of JSON structure */
-        memcpy((void *)(buff_ack + buff_index), (void *)"}}", 2);
-        buff_index += 2;
+        buff_ack[buff_index++] = '}';
     }
 
     buff_ack[buff_index] = 0; /* add string terminator, for safety */
 
-    /* send datagram to server */
-    return send(sock_down, (void *)buff_ack, buff_index, 0);
+    return buff_index;
 }
 
-static void print_nb_pkt_stats(void) {
-    int l, m;
+static void tx_done(e_tx_result result, uint32_t count_us, void * arg) {
+    const struct board_s *brd = (const struct board_s *)arg;
 
-    /* DEBUG: print the number of packets received per channel and per SF */
-    MSG_PRINTF(DEBUG_PKT_FWD, "\n");
-    for (l = 0; l < LGW_RX_CHANNEL_NB_MAX; l++) {
-        MSG_PRINTF(DEBUG_PKT_FWD, "CH%d: ", l);
-        for (m = 0; m < 8; m++) {
-            MSG_PRINTF(DEBUG_PKT_FWD, "\t%d", nb_pkt_log[l][m]);
-        }
-        MSG_PRINTF(DEBUG_PKT_FWD, "\n");
+    /* called by the HAL once a downlink is completed, with the TX path of the board locked */
+    meas_add((result == TX_RESULT_OK) ? MEAS_NB_TX_OK : MEAS_NB_TX_FAIL, 1);
+    lgw_hist_record(&lat_hist[LAT_DW_DONE], (uint32_t)(monotonic_us() - brd->tx_send_us));
+
+    if (result == TX_RESULT_OK) {
+        MSG_DEBUG(DEBUG_PKT_FWD, "downlink scheduled at count_us=%u emitted\n", count_us);
+    } else {
+        MSG("WARNING: [jit] downlink scheduled at count_us=%u on board %d not emitted (result %d)\n", count_us, brd->index, result);
     }
-    MSG_PRINTF(DEBUG_PKT_FWD, "\n");
-    MSG_PRINTF(DEBUG_PKT_FWD, "Total number of LoRa packet received: %u\n", nb_pkt_received);
-    MSG_PRINTF(DEBUG_PKT_FWD, "Total number of LoRa packet sent: %u\n", nb_pkt_sent);
 }
 
-/* -------------------------------------------------------------------------- */
-/* --- MAIN FUNCTION -------------------------------------------------------- */
-
-int main(int argc, char ** argv)
-{
-    struct sigaction sigact; /* SIGQUIT&SIGINT&SIGTERM signal handling */
-    int i; /* loop variable and temporary variable for return value */
-    int x;
-    int l, m;
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-    /* configuration file related */
-    const char defaut_conf_fname[] = JSON_CONF_DEFAULT;
-    const char * conf_fname = defaut_conf_fname; /* pointer to a string we won't touch */
+/* A queued packet will not be sent, its airtime is given back to the budgets */
+static void jit_dropped(const struct lgw_pkt_tx_s *pkt, enum jit_pkt_type_e pkt_type, void *arg) {
+    struct board_s * brd = (struct board_s *)arg;
 
-    /* threads */
-    pthread_t thrid_up;
-    pthread_t thrid_down;
-    pthread_t thrid_jit;
+    (void)pkt_type; /* beacons are accounted too */
+    airtime_sub(&brd->airtime, pkt->rf_chain, pkt->freq_hz, lgw_time_on_air_us(pkt));
+}
 
-    /* network socket creation */
-    struct addrinfo hints;
-    struct addrinfo *result; /* store result of getaddrinfo */
-    struct addrinfo *q; /* pointer to move into *result data */
-    char host_name[64];
-    char port_name[64];
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-    /* variables to get local copies of measurements */
-    uint32_t cp_nb_rx_rcv;
-    uint32_t cp_nb_rx_ok;
-    uint32_t cp_nb_rx_bad;
-    uint32_t cp_nb_rx_nocrc;
-    uint32_t cp_up_pkt_fwd;
-    uint32_t cp_up_network_byte;
-    uint32_t cp_up_payload_byte;
-    uint32_t cp_up_dgram_sent;
-    uint32_t cp_up_ack_rcv;
-    uint32_t cp_dw_pull_sent;
-    uint32_t cp_dw_ack_rcv;
-    uint32_t cp_dw_dgram_rcv;
-    uint32_t cp_dw_network_byte;
-    uint32_t cp_dw_payload_byte;
-    uint32_t cp_nb_tx_ok;
-    uint32_t cp_nb_tx_fail;
-    uint32_t cp_nb_tx_requested = 0;
-    uint32_t cp_nb_tx_rejected_collision_packet = 0;
-    uint32_t cp_nb_tx_rejected_collision_beacon = 0;
-    uint32_t cp_nb_tx_rejected_too_late = 0;
-    uint32_t cp_nb_tx_rejected_too_early = 0;
+/* Queue the packet on the first TX radio of the board which supports its frequency, has airtime left and is free at its timestamp */
+static enum jit_error_e jit_enqueue_radio(struct board_s * brd, uint32_t time_us, struct lgw_pkt_tx_s *pkt, enum jit_pkt_type_e pkt_type) {
+    enum jit_error_e result = JIT_ERROR_TX_FREQ;
+    enum jit_error_e err;
+    uint32_t toa_us = lgw_time_on_air_us(pkt);
+    uint64_t time_ms = monotonic_ms();
+    int i;
+
+    for (i = 0; i < brd->nb_tx_radio; i++) {
+        if ((pkt->freq_hz < brd->tx_freq_min[i]) || (pkt->freq_hz > brd->tx_freq_max[i])) {
+            continue;
+        }
+        /* beacons are accounted, but never rejected for airtime */
+        if ((pkt_type != JIT_PKT_TYPE_BEACON) && (airtime_check(&brd->airtime, time_ms, i, pkt->freq_hz, toa_us) == false)) {
+            if (result == JIT_ERROR_TX_FREQ) {
+                result = JIT_ERROR_AIRTIME;
+            }
+            continue;
+        }
+        pkt->rf_chain = (uint8_t)i;
+        err = jit_enqueue(&brd->jit_queue[i], time_us, pkt, pkt_type);
+        if (err == JIT_ERROR_OK) {
+            airtime_add(&brd->airtime, time_ms, i, pkt->freq_hz, toa_us);
+        }
+        if ((err != JIT_ERROR_COLLISION_PACKET) && (err != JIT_ERROR_COLLISION_BEACON) && (err != JIT_ERROR_FULL)) {
+            return err; /* queued, or rejected for the packet itself (eg. too late), which is the same on all radios */
+        }
+        /* the queues are per radio, another one may have room or be free at that time, the first rejection is reported */
+        if ((result == JIT_ERROR_TX_FREQ) || (result == JIT_ERROR_AIRTIME)) {
+            result = err;
+        }
+    }
+
+    return result;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Check a parsed downlink and complete its TX parameters for the board it is sent by, return JIT_ERROR_INVALID if it is to be dropped */
+static enum jit_error_e prepare_downlink(struct lgw_pkt_tx_s *txpkt, const struct txpk_info_s *txpk_info, struct board_s **brd_out, enum jit_pkt_type_e *downlink_type, enum jit_error_e *warning_result, int32_t *warning_value) {
+    struct board_s *brd;
+    int i;
+
+    /* reset error/warning results */
+    *warning_result = JIT_ERROR_OK;
+    *warning_value = 0;
+
+    /* board (optional field, first board by default and for binary records) */
+    if (txpk_info->brd >= nb_board) {
+        MSG("WARNING: [down] board %u is not configured, TX aborted\n", txpk_info->brd);
+        return JIT_ERROR_INVALID;
+    }
+    brd = &boards[txpk_info->brd];
+    *brd_out = brd;
+
+    /* "immediate" tag, or target timestamp (mandatory) */
+    if (txpk_info->imme == true) {
+        /* TX procedure: send immediately */
+        txpkt->tx_mode = IMMEDIATE;
+        *downlink_type = JIT_PKT_TYPE_DOWNLINK_CLASS_C;
+        MSG("INFO: [down] a packet will be sent in \"immediate\" mode\n");
+    } else if (txpk_info->fields & TXPK_FIELD_TMST) {
+        /* TX procedure: send on timestamp value */
+        txpkt->tx_mode = TIMESTAMPED;
+
+        /* Concentrator timestamp is given, we consider it is a Class A downlink */
+        *downlink_type = JIT_PKT_TYPE_DOWNLINK_CLASS_A;
+    } else {
+        MSG("WARNING: [down] no mandatory \"txpk.imme\" or \"txpk.tmst\" object in JSON, TX aborted\n");
+        return JIT_ERROR_INVALID;
+    }
+
+    /* TX power (optional field) */
+    if (txpk_info->fields & TXPK_FIELD_POWE) {
+        txpkt->rf_power -= brd->antenna_gain;
+    }
+
+    /* Lora preamble length (optional field, optimum min value enforced) */
+    if (txpk_info->fields & TXPK_FIELD_PREA) {
+        if (txpkt->preamble < MIN_LORA_PREAMBLE) {
+            txpkt->preamble = (uint16_t)MIN_LORA_PREAMBLE;
+        }
+    } else {
+        txpkt->preamble = (uint16_t)STD_LORA_PREAMBLE;
+    }
+
+    /* set the LoRa sync word */
+    txpkt->sync_word = brd->lora_sync_word;
+
+    /* payload data */
+    if (txpk_info->data_size != txpkt->size) {
+        MSG("WARNING: [down] mismatch between .size and .data size once converter to binary\n");
+    }
+
+    /* check TX frequency before trying to queue packet, on any TX radio of the board */
+    for (i = 0; i < brd->nb_tx_radio; i++) {
+        if ((txpkt->freq_hz >= brd->tx_freq_min[i]) && (txpkt->freq_hz <= brd->tx_freq_max[i])) {
+            break;
+        }
+    }
+    if (i == brd->nb_tx_radio) {
+        MSG("ERROR: Packet REJECTED, unsupported frequency - %u (min:%u,max:%u)\n", txpkt->freq_hz, brd->tx_freq_min[0], brd->tx_freq_max[0]);
+        return JIT_ERROR_TX_FREQ;
+    }
+
+    /* check TX power before trying to queue packet, send a warning if not supported */
+    if ((txpkt->rf_power < TX_POWER_MIN) || (txpkt->rf_power > TX_POWER_MAX)) {
+        /* this RF power is not supported, throw a warning, and use the closest lower power supported */
+        *warning_result = JIT_ERROR_TX_POWER;
+        *warning_value = (int32_t)TX_POWER_DEFAULT;
+        printf("WARNING: Requested TX power is not supported (%ddBm), actual power used: %ddBm\n", txpkt->rf_power, *warning_value);
+        txpkt->rf_power = TX_POWER_DEFAULT;
+    }
+
+    return JIT_ERROR_OK;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Report a txpk which could not be parsed */
+static void txpk_warning(enum txpk_error_e txpk_err, const struct txpk_info_s *txpk_info) {
+    switch (txpk_err) {
+        case TXPK_OK:
+            break;
+        case TXPK_ERROR_NO_TXPK:
+            MSG("WARNING: [down] no \"txpk\" object in JSON, TX aborted\n");
+            break;
+        case TXPK_ERROR_MISSING:
+            MSG("WARNING: [down] no mandatory \"txpk.%s\" object in JSON, TX aborted\n", txpk_info->field);
+            break;
+        case TXPK_ERROR_FORMAT:
+            MSG("WARNING: [down] format error in \"txpk.%s\", TX aborted\n", txpk_info->field);
+            break;
+        default:
+            MSG("WARNING: [down] invalid JSON, TX aborted\n");
+            break;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Set the configured policy and CPU of a thread, the default ones are kept on failure */
+static void thread_sched_apply(pthread_t thrid, enum thread_e thread) {
+    struct sched_param param;
+    cpu_set_t cpus;
+    int i;
+
+    if (thread_sched[thread].priority > 0) {
+        memset(&param, 0, sizeof param);
+        param.sched_priority = thread_sched[thread].priority;
+        i = pthread_setschedparam(thrid, SCHED_FIFO, &param);
+        if (i != 0) {
+            MSG("WARNING: [main] failed to set SCHED_FIFO priority %d of %s thread: %s\n", param.sched_priority, thread_sched[thread].name, strerror(i));
+        }
+    }
+    if (thread_sched[thread].cpu >= 0) {
+        CPU_ZERO(&cpus);
+        CPU_SET(thread_sched[thread].cpu, &cpus);
+        i = pthread_setaffinity_np(thrid, sizeof cpus, &cpus);
+        if (i != 0) {
+            MSG("WARNING: [main] failed to pin %s thread on CPU %d: %s\n", thread_sched[thread].name, thread_sched[thread].cpu, strerror(i));
+        }
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Get the concentrator time for the TX path, estimated without accessing the
+concentrator unless the estimate is too uncertain, return -1 if it is unknown */
+static int tx_time_sample(struct board_s * brd, uint32_t * count_us) {
+    uint32_t err_us = 0;
+
+    if ((lgw_ctx_get_instcnt_estimate(brd->ctx, count_us, &err_us) == LGW_HAL_SUCCESS) && (err_us <= TX_CNT_ERR_MAX_US)) {
+        return 0;
+    }
+
+    /* a new sample of the counter narrows the estimate */
+    MSG_DEBUG(DEBUG_PKT_FWD, "concentrator %d time uncertain by %u us, reading its status\n", brd->index, err_us);
+    if ((lgw_ctx_refresh_status(brd->ctx) == LGW_HAL_SUCCESS) && (lgw_ctx_get_instcnt_estimate(brd->ctx, count_us, &err_us) == LGW_HAL_SUCCESS) && (err_us <= TX_CNT_ERR_MAX_US)) {
+        return 0;
+    }
+    MSG("WARNING: concentrator %d time is unknown (error bound %u us)\n", brd->index, err_us);
+    return -1;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Record the time between two concentrator counter values, a negative one as 0 */
+static void lat_record_cnt(enum lat_stage_e stage, uint32_t from_us, uint32_t to_us) {
+    int32_t d = (int32_t)(to_us - from_us);
+
+    lgw_hist_record(&lat_hist[stage], (d > 0) ? (uint32_t)d : 0);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int lat_json_member(char *json, int size, bool first, const char *name, const struct lgw_hist_s *hist) {
+    return snprintf(json, size, "%s\"%s\":[%u,%u,%u]", first ? "" : ",", name, lgw_hist_percentile(hist, 50.0), lgw_hist_percentile(hist, 99.0), hist->max);
+}
+
+/* Display the latencies recorded since the last report, and write them as a "lat" JSON member, return its size */
+static int report_latency(char *json, int size) {
+    struct lgw_hist_s snapshot;
+    struct lgw_hist_s mcu_rtt;
+    const char *name;
+    int b, i;
+    int n = 0;
+
+    printf("### [LATENCY] ###\n");
+    json[0] = 0;
+    for (i = 0; i < LAT_NB_STAGE; i++) {
+        lgw_hist_collect(&lat_hist[i], &snapshot);
+        if (snapshot.count == 0) {
+            continue;
+        }
+        printf("# %s: %u, p50 %u us, p99 %u us, max %u us\n", lat_stage[i].label, snapshot.count, lgw_hist_percentile(&snapshot, 50.0), lgw_hist_percentile(&snapshot, 99.0), snapshot.max);
+        n += lat_json_member(json + n, size - n, (n == 0), lat_stage[i].name, &snapshot);
+    }
+
+    /* round-trip times of the requests to the MCUs, merged for the JSON report */
+    lgw_hist_reset(&mcu_rtt);
+    for (b = 0; b < nb_board; b++) {
+        for (i = 0; i < LGW_MCU_NB_REQ; i++) {
+            if ((lgw_ctx_get_mcu_rtt(boards[b].ctx, i, &snapshot, &name) != LGW_HAL_SUCCESS) || (snapshot.count == 0)) {
+                continue;
+            }
+            printf("# MCU %d %s: %u, p50 %u us, p99 %u us, max %u us\n", b, name, snapshot.count, lgw_hist_percentile(&snapshot, 50.0), lgw_hist_percentile(&snapshot, 99.0), snapshot.max);
+            lgw_hist_merge(&mcu_rtt, &snapshot);
+        }
+    }
+    if (mcu_rtt.count > 0) {
+        n += lat_json_member(json + n, size - n, (n == 0), "mcu", &mcu_rtt);
+    }
+
+    if (n >= size) {
+        MSG("ERROR: [main] latency report truncated\n");
+        json[0] = 0;
+        return 0;
+    }
+    return n;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void print_nb_pkt_stats(void) {
+    int l, m;
+
+    /* DEBUG: print the number of packets received per channel and per SF */
+    MSG_PRINTF(DEBUG_PKT_FWD, "\n");
+    for (l = 0; l < LGW_RX_CHANNEL_NB_MAX; l++) {
+        MSG_PRINTF(DEBUG_PKT_FWD, "CH%d: ", l);
+        for (m = 0; m < 8; m++) {
+            MSG_PRINTF(DEBUG_PKT_FWD, "\t%d", nb_pkt_log[l][m]);
+        }
+        MSG_PRINTF(DEBUG_PKT_FWD, "\n");
+    }
+    MSG_PRINTF(DEBUG_PKT_FWD, "\n");
+    MSG_PRINTF(DEBUG_PKT_FWD, "Total number of LoRa packet received: %u\n", nb_pkt_received);
+    MSG_PRINTF(DEBUG_PKT_FWD, "Total number of LoRa packet sent: %u\n", nb_pkt_sent);
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char ** argv)
+{
+    struct sigaction sigact; /* SIGQUIT&SIGINT&SIGTERM signal handling */
+    int i; /* loop variable and temporary variable for return value */
+    int x;
+    int l, m;
+    int b;
+    struct board_s *brd;
+
+    /* configuration file related */
+    const char defaut_conf_fname[] = JSON_CONF_DEFAULT;
+    const char * conf_fname = defaut_conf_fname; /* pointer to a string we won't touch */
+
+    /* threads, the fetch and JiT threads are per board */
+    pthread_t thrid_up;
+    pthread_t thrid_up_ack;
+    pthread_t thrid_down;
+    pthread_attr_t thread_attr;
+
+    /* network socket creation */
+    struct addrinfo hints;
+    struct addrinfo *result; /* store result of getaddrinfo */
+    struct addrinfo *q; /* pointer to move into *result data */
+    char host_name[64];
+    char port_name[64];
+
+    /* variables to get local copies of measurements */
+    uint32_t cp_nb_rx_rcv;
+    uint32_t cp_nb_rx_ok;
+    uint32_t cp_nb_rx_bad;
+    uint32_t cp_nb_rx_nocrc;
+    uint32_t cp_nb_rx_lost;
+    uint32_t cp_nb_rx_drop;
+    uint32_t cp_nb_rx_queue_max;
+    uint32_t brd_nb_rx_drop;
+    uint32_t brd_nb_rx_queue_max;
+    uint32_t cp_up_pkt_fwd;
+    uint32_t cp_up_dedup;
+    uint32_t cp_up_network_byte;
+    uint32_t cp_up_payload_byte;
+    uint32_t cp_up_dgram_sent;
+    uint32_t cp_up_ack_rcv;
+    uint32_t cp_up_ack_lost;
+    uint32_t cp_up_ack_rtt_sum;
+    uint32_t cp_up_ack_rtt_min;
+    uint32_t cp_up_ack_rtt_max;
+    uint32_t cp_dw_pull_sent;
+    uint32_t cp_dw_ack_rcv;
+    uint32_t cp_dw_dgram_rcv;
+    uint32_t cp_dw_network_byte;
+    uint32_t cp_dw_payload_byte;
+    uint32_t cp_nb_tx_ok;
+    uint32_t cp_nb_tx_fail;
+    uint32_t cp_jit_late;
+    uint64_t cp_nb_tx_requested;
+    uint64_t cp_nb_tx_rejected_collision_packet;
+    uint64_t cp_nb_tx_rejected_collision_beacon;
+    uint64_t cp_nb_tx_rejected_too_late;
+    uint64_t cp_nb_tx_rejected_too_early;
+    uint64_t cp_nb_tx_rejected_airtime;
+    uint64_t meas_cnt[MEAS_NB];
+    uint64_t meas_delta[MEAS_NB];
+    uint32_t meas_peak_cnt[MEAS_NB_PEAK];
 
     /* concentrator data variables */
     uint32_t trig_tstamp;
     uint32_t inst_tstamp;
     uint64_t eui;
-    float temperature;
+    float temperature = 0.0;
+    float brd_temperature;
     e_temperature_src temp_src;
 
     /* statistics variable */
@@ -725,6 +1415,12 @@ int main(int argc, char ** argv)
     float rx_nocrc_ratio;
     float up_ack_ratio;
     float dw_ack_ratio;
+    float tx_occupancy;
+    float occupancy;
+    float chan_occupancy[AIRTIME_NB_CHAN_MAX];
+    uint32_t chan_freq[AIRTIME_NB_CHAN_MAX];
+    uint64_t time_ms;
+    char lat_json[LAT_JSON_SIZE];
 
     /* Parse command line options */
     while( (i = getopt( argc, argv, "hc:" )) != -1 )
@@ -858,17 +1554,28 @@ int main(int argc, char ** argv)
         }
     }
 
-    /* starting the concentrator */
-    i = lgw_start();
-    if (i == LGW_HAL_SUCCESS) {
-        MSG("INFO: [main] concentrator started, packet can now be received\n");
-    } else {
-        MSG("ERROR: [main] failed to start the concentrator\n");
-        exit(EXIT_FAILURE);
+    /* starting the concentrators */
+    for (b = 0; b < nb_board; b++) {
+        brd = &boards[b];
+        lgw_ctx_tx_set_callback(brd->ctx, tx_done, brd);
+        i = lgw_ctx_start(brd->ctx);
+        if (i == LGW_HAL_SUCCESS) {
+            MSG("INFO: [main] concentrator %d started, packet can now be received\n", b);
+            brd->nb_tx_radio = lgw_ctx_get_nb_tx_radio(brd->ctx);
+            MSG("INFO: [main] %u TX radio(s) available on concentrator %d\n", brd->nb_tx_radio, b);
+        } else {
+            MSG("ERROR: [main] failed to start concentrator %d\n", b);
+            exit(EXIT_FAILURE);
+        }
+        rx_ring_init(&brd->rx_ring);
+        for (i = 0; i < LGW_TX_CHANNEL_NB_MAX; i++) {
+            jit_queue_init(&brd->jit_queue[i]);
+            jit_queue_set_drop_cb(&brd->jit_queue[i], jit_dropped, brd);
+        }
     }
 
-    /* get the concentrator EUI */
-    i = lgw_get_eui(&eui);
+    /* get the EUI of the first concentrator, it identifies the gateway */
+    i = lgw_ctx_get_eui(boards[0].ctx, &eui);
     if (i != LGW_HAL_SUCCESS) {
         printf("ERROR: failed to get concentrator EUI\n");
     } else {
@@ -885,22 +1592,54 @@ int main(int argc, char ** argv)
     net_mac_h = htonl((uint32_t)(0xFFFFFFFF & (lgwm>>32)));
     net_mac_l = htonl((uint32_t)(0xFFFFFFFF &  lgwm  ));
 
+    /* clear the statistics counters, before any thread updates them */
+    meas_init();
+
+    /* lock the memory before the threads start, their stacks are locked as they are created */
+    pthread_attr_init(&thread_attr);
+    if (mem_lock == true) {
+        pthread_attr_setstacksize(&thread_attr, THREAD_STACK_SIZE); /* smaller than the default, all of it is locked */
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+            MSG("WARNING: [main] failed to lock the memory: %s\n", strerror(errno));
+        }
+    }
+
     /* spawn threads to manage upstream and downstream */
-    i = pthread_create( &thrid_up, NULL, (void * (*)(void *))thread_up, NULL);
+    for (b = 0; b < nb_board; b++) {
+        i = pthread_create( &boards[b].thrid_rx, &thread_attr, thread_rx, &boards[b]);
+        if (i != 0) {
+            MSG("ERROR: [main] impossible to create RX fetch thread\n");
+            exit(EXIT_FAILURE);
+        }
+        thread_sched_apply(boards[b].thrid_rx, THREAD_RX);
+    }
+    i = pthread_create( &thrid_up, &thread_attr, (void * (*)(void *))thread_up, NULL);
     if (i != 0) {
         MSG("ERROR: [main] impossible to create upstream thread\n");
         exit(EXIT_FAILURE);
     }
-    i = pthread_create( &thrid_down, NULL, (void * (*)(void *))thread_down, NULL);
+    thread_sched_apply(thrid_up, THREAD_UP);
+    i = pthread_create( &thrid_up_ack, &thread_attr, (void * (*)(void *))thread_up_ack, NULL);
     if (i != 0) {
-        MSG("ERROR: [main] impossible to create downstream thread\n");
+        MSG("ERROR: [main] impossible to create upstream acknowledge thread\n");
         exit(EXIT_FAILURE);
     }
-    i = pthread_create( &thrid_jit, NULL, (void * (*)(void *))thread_jit, NULL);
+    thread_sched_apply(thrid_up_ack, THREAD_UP_ACK);
+    i = pthread_create( &thrid_down, &thread_attr, (void * (*)(void *))thread_down, NULL);
     if (i != 0) {
-        MSG("ERROR: [main] impossible to create JIT thread\n");
+        MSG("ERROR: [main] impossible to create downstream thread\n");
         exit(EXIT_FAILURE);
     }
+    thread_sched_apply(thrid_down, THREAD_DOWN);
+    for (b = 0; b < nb_board; b++) {
+        i = pthread_create( &boards[b].thrid_jit, &thread_attr, thread_jit, &boards[b]);
+        if (i != 0) {
+            MSG("ERROR: [main] impossible to create JIT thread\n");
+            exit(EXIT_FAILURE);
+        }
+        thread_sched_apply(boards[b].thrid_jit, THREAD_JIT);
+    }
+    pthread_attr_destroy(&thread_attr);
 
     /* configure signal handling */
     sigemptyset(&sigact.sa_mask);
@@ -919,27 +1658,36 @@ int main(int argc, char ** argv)
         t = time(NULL);
         strftime(stat_timestamp, sizeof stat_timestamp, "%F %T %Z", gmtime(&t));
 
-        /* access upstream statistics, copy and reset them */
-        pthread_mutex_lock(&mx_meas_up);
-        cp_nb_rx_rcv       = meas_nb_rx_rcv;
-        cp_nb_rx_ok        = meas_nb_rx_ok;
-        cp_nb_rx_bad       = meas_nb_rx_bad;
-        cp_nb_rx_nocrc     = meas_nb_rx_nocrc;
-        cp_up_pkt_fwd      = meas_up_pkt_fwd;
-        cp_up_network_byte = meas_up_network_byte;
-        cp_up_payload_byte = meas_up_payload_byte;
-        cp_up_dgram_sent   = meas_up_dgram_sent;
-        cp_up_ack_rcv      = meas_up_ack_rcv;
-        meas_nb_rx_rcv = 0;
-        meas_nb_rx_ok = 0;
-        meas_nb_rx_bad = 0;
-        meas_nb_rx_nocrc = 0;
-        meas_up_pkt_fwd = 0;
-        meas_up_network_byte = 0;
-        meas_up_payload_byte = 0;
-        meas_up_dgram_sent = 0;
-        meas_up_ack_rcv = 0;
-        pthread_mutex_unlock(&mx_meas_up);
+        /* collect the counters of all the threads, without lock */
+        meas_collect(meas_cnt, meas_peak_cnt);
+        for (i = 0; i < MEAS_NB; i++) {
+            meas_delta[i] = meas_cnt[i] - meas_prev[i];
+            meas_prev[i] = meas_cnt[i];
+        }
+
+        /* upstream statistics since the previous report */
+        cp_nb_rx_rcv       = (uint32_t)meas_delta[MEAS_NB_RX_RCV];
+        cp_nb_rx_ok        = (uint32_t)meas_delta[MEAS_NB_RX_OK];
+        cp_nb_rx_bad       = (uint32_t)meas_delta[MEAS_NB_RX_BAD];
+        cp_nb_rx_nocrc     = (uint32_t)meas_delta[MEAS_NB_RX_NOCRC];
+        cp_nb_rx_lost      = (uint32_t)meas_delta[MEAS_NB_RX_LOST];
+        cp_up_pkt_fwd      = (uint32_t)meas_delta[MEAS_UP_PKT_FWD];
+        cp_up_dedup        = (uint32_t)meas_delta[MEAS_UP_DEDUP];
+        cp_up_network_byte = (uint32_t)meas_delta[MEAS_UP_NETWORK_BYTE];
+        cp_up_payload_byte = (uint32_t)meas_delta[MEAS_UP_PAYLOAD_BYTE];
+        cp_up_dgram_sent   = (uint32_t)meas_delta[MEAS_UP_DGRAM_SENT];
+        cp_up_ack_rcv      = (uint32_t)meas_delta[MEAS_UP_ACK_RCV];
+        cp_up_ack_lost     = (uint32_t)meas_delta[MEAS_UP_ACK_LOST];
+        cp_up_ack_rtt_sum  = (uint32_t)meas_delta[MEAS_UP_ACK_RTT_SUM];
+        cp_up_ack_rtt_min  = meas_peak_cnt[MEAS_UP_ACK_RTT_MIN];
+        cp_up_ack_rtt_max  = meas_peak_cnt[MEAS_UP_ACK_RTT_MAX];
+        cp_nb_rx_drop = 0;
+        cp_nb_rx_queue_max = 0;
+        for (b = 0; b < nb_board; b++) {
+            rx_ring_get_stats(&boards[b].rx_ring, &brd_nb_rx_drop, &brd_nb_rx_queue_max);
+            cp_nb_rx_drop += brd_nb_rx_drop;
+            cp_nb_rx_queue_max = MAX(cp_nb_rx_queue_max, brd_nb_rx_queue_max);
+        }
         if (cp_nb_rx_rcv > 0) {
             rx_ok_ratio = (float)cp_nb_rx_ok / (float)cp_nb_rx_rcv;
             rx_bad_ratio = (float)cp_nb_rx_bad / (float)cp_nb_rx_rcv;
@@ -955,33 +1703,21 @@ int main(int argc, char ** argv)
             up_ack_ratio = 0.0;
         }
 
-        /* access downstream statistics, copy and reset them */
-        pthread_mutex_lock(&mx_meas_dw);
-        cp_dw_pull_sent    =  meas_dw_pull_sent;
-        cp_dw_ack_rcv      =  meas_dw_ack_rcv;
-        cp_dw_dgram_rcv    =  meas_dw_dgram_rcv;
-        cp_dw_network_byte =  meas_dw_network_byte;
-        cp_dw_payload_byte =  meas_dw_payload_byte;
-        cp_nb_tx_ok        =  meas_nb_tx_ok;
-        cp_nb_tx_fail      =  meas_nb_tx_fail;
-        cp_nb_tx_requested                 +=  meas_nb_tx_requested;
-        cp_nb_tx_rejected_collision_packet +=  meas_nb_tx_rejected_collision_packet;
-        cp_nb_tx_rejected_collision_beacon +=  meas_nb_tx_rejected_collision_beacon;
-        cp_nb_tx_rejected_too_late         +=  meas_nb_tx_rejected_too_late;
-        cp_nb_tx_rejected_too_early        +=  meas_nb_tx_rejected_too_early;
-        meas_dw_pull_sent = 0;
-        meas_dw_ack_rcv = 0;
-        meas_dw_dgram_rcv = 0;
-        meas_dw_network_byte = 0;
-        meas_dw_payload_byte = 0;
-        meas_nb_tx_ok = 0;
-        meas_nb_tx_fail = 0;
-        meas_nb_tx_requested = 0;
-        meas_nb_tx_rejected_collision_packet = 0;
-        meas_nb_tx_rejected_collision_beacon = 0;
-        meas_nb_tx_rejected_too_late = 0;
-        meas_nb_tx_rejected_too_early = 0;
-        pthread_mutex_unlock(&mx_meas_dw);
+        /* downstream statistics since the previous report, TX requests since start */
+        cp_dw_pull_sent    = (uint32_t)meas_delta[MEAS_DW_PULL_SENT];
+        cp_dw_ack_rcv      = (uint32_t)meas_delta[MEAS_DW_ACK_RCV];
+        cp_dw_dgram_rcv    = (uint32_t)meas_delta[MEAS_DW_DGRAM_RCV];
+        cp_dw_network_byte = (uint32_t)meas_delta[MEAS_DW_NETWORK_BYTE];
+        cp_dw_payload_byte = (uint32_t)meas_delta[MEAS_DW_PAYLOAD_BYTE];
+        cp_nb_tx_ok        = (uint32_t)meas_delta[MEAS_NB_TX_OK];
+        cp_nb_tx_fail      = (uint32_t)meas_delta[MEAS_NB_TX_FAIL];
+        cp_jit_late        = (uint32_t)meas_delta[MEAS_JIT_LATE];
+        cp_nb_tx_requested                 = meas_cnt[MEAS_NB_TX_REQUESTED];
+        cp_nb_tx_rejected_collision_packet = meas_cnt[MEAS_NB_TX_REJ_COLLISION_PACKET];
+        cp_nb_tx_rejected_collision_beacon = meas_cnt[MEAS_NB_TX_REJ_COLLISION_BEACON];
+        cp_nb_tx_rejected_too_late         = meas_cnt[MEAS_NB_TX_REJ_TOO_LATE];
+        cp_nb_tx_rejected_too_early        = meas_cnt[MEAS_NB_TX_REJ_TOO_EARLY];
+        cp_nb_tx_rejected_airtime          = meas_cnt[MEAS_NB_TX_REJ_AIRTIME];
         if (cp_dw_pull_sent > 0) {
             dw_ack_ratio = (float)cp_dw_ack_rcv / (float)cp_dw_pull_sent;
         } else {
@@ -992,55 +1728,105 @@ int main(int argc, char ** argv)
         printf("\n##### %s #####\n", stat_timestamp);
         printf("### [UPSTREAM] ###\n");
         printf("# RF packets received by concentrator: %u\n", cp_nb_rx_rcv);
+        printf("# RF packets lost by concentrator: %u\n", cp_nb_rx_lost);
+        if (cp_nb_rx_lost > 0) {
+            printf("# WARNING: concentrator RX buffer overflow, packets are not fetched fast enough\n");
+        }
+        printf("# RF packets dropped by forwarder: %u (uplink queue max usage: %u/%u)\n", cp_nb_rx_drop, cp_nb_rx_queue_max, RX_RING_SIZE);
         printf("# CRC_OK: %.2f%%, CRC_FAIL: %.2f%%, NO_CRC: %.2f%%\n", 100.0 * rx_ok_ratio, 100.0 * rx_bad_ratio, 100.0 * rx_nocrc_ratio);
         printf("# RF packets forwarded: %u (%u bytes)\n", cp_up_pkt_fwd, cp_up_payload_byte);
+        if (uplink_dedup == true) {
+            printf("# RF packets not forwarded, copies of another one: %u\n", cp_up_dedup);
+        }
         printf("# PUSH_DATA datagrams sent: %u (%u bytes)\n", cp_up_dgram_sent, cp_up_network_byte);
-        printf("# PUSH_DATA acknowledged: %.2f%%\n", 100.0 * up_ack_ratio);
+        printf("# PUSH_DATA acknowledged: %.2f%% (%u timed out)\n", 100.0 * up_ack_ratio, cp_up_ack_lost);
+        if (cp_up_ack_rcv > 0) {
+            printf("# PUSH_ACK round-trip time: min %u ms, avg %u ms, max %u ms\n", cp_up_ack_rtt_min, cp_up_ack_rtt_sum / cp_up_ack_rcv, cp_up_ack_rtt_max);
+        }
         printf("### [DOWNSTREAM] ###\n");
         printf("# PULL_DATA sent: %u (%.2f%% acknowledged)\n", cp_dw_pull_sent, 100.0 * dw_ack_ratio);
         printf("# PULL_RESP(onse) datagrams received: %u (%u bytes)\n", cp_dw_dgram_rcv, cp_dw_network_byte);
         printf("# RF packets sent to concentrator: %u (%u bytes)\n", (cp_nb_tx_ok+cp_nb_tx_fail), cp_dw_payload_byte);
         printf("# TX errors: %u\n", cp_nb_tx_fail);
+        if (cp_jit_late > 0) {
+            printf("# WARNING: JIT thread woke up more than %u ms late %u times, see its scheduling in \"thread_sched\"\n", JIT_LATE_US / 1000, cp_jit_late);
+        }
         if (cp_nb_tx_requested != 0 ) {
-            printf("# TX rejected (collision packet): %.2f%% (req:%u, rej:%u)\n", 100.0 * cp_nb_tx_rejected_collision_packet / cp_nb_tx_requested, cp_nb_tx_requested, cp_nb_tx_rejected_collision_packet);
-            printf("# TX rejected (collision beacon): %.2f%% (req:%u, rej:%u)\n", 100.0 * cp_nb_tx_rejected_collision_beacon / cp_nb_tx_requested, cp_nb_tx_requested, cp_nb_tx_rejected_collision_beacon);
-            printf("# TX rejected (too late): %.2f%% (req:%u, rej:%u)\n", 100.0 * cp_nb_tx_rejected_too_late / cp_nb_tx_requested, cp_nb_tx_requested, cp_nb_tx_rejected_too_late);
-            printf("# TX rejected (too early): %.2f%% (req:%u, rej:%u)\n", 100.0 * cp_nb_tx_rejected_too_early / cp_nb_tx_requested, cp_nb_tx_requested, cp_nb_tx_rejected_too_early);
-        }
-        printf("### Concentrator Status ###\n");
-        pthread_mutex_lock(&mx_concent);
-        i  = lgw_get_instcnt(&inst_tstamp);
-        i |= lgw_get_trigcnt(&trig_tstamp);
-        pthread_mutex_unlock(&mx_concent);
-        if (i != LGW_HAL_SUCCESS) {
-            printf("# Concentrator counter unknown\n");
-        } else {
-            printf("# Concentrator counter (INST): %u\n", inst_tstamp);
-            printf("# Concentrator counter (PPS):  %u\n", trig_tstamp);
-        }
-        printf("### [JIT] ###\n");
-        /* get timestamp captured on PPM pulse  */
-        jit_print_queue (&jit_queue[0], false, DEBUG_LOG);
-
-        pthread_mutex_lock(&mx_concent);
-        i = lgw_get_temperature(&temperature, &temp_src);
-        pthread_mutex_unlock(&mx_concent);
-        if (i != LGW_HAL_SUCCESS) {
-            printf("### Concentrator temperature unknown ###\n");
-        } else {
-            printf("### Concentrator temperature: %.0f C (source:%s) ###\n", temperature, (temp_src == TEMP_SRC_EXT) ? "sensor" : "mcu");
+            printf("# TX rejected (collision packet): %.2f%% (req:%" PRIu64 ", rej:%" PRIu64 ")\n", 100.0 * cp_nb_tx_rejected_collision_packet / cp_nb_tx_requested, cp_nb_tx_requested, cp_nb_tx_rejected_collision_packet);
+            printf("# TX rejected (collision beacon): %.2f%% (req:%" PRIu64 ", rej:%" PRIu64 ")\n", 100.0 * cp_nb_tx_rejected_collision_beacon / cp_nb_tx_requested, cp_nb_tx_requested, cp_nb_tx_rejected_collision_beacon);
+            printf("# TX rejected (too late): %.2f%% (req:%" PRIu64 ", rej:%" PRIu64 ")\n", 100.0 * cp_nb_tx_rejected_too_late / cp_nb_tx_requested, cp_nb_tx_requested, cp_nb_tx_rejected_too_late);
+            printf("# TX rejected (too early): %.2f%% (req:%" PRIu64 ", rej:%" PRIu64 ")\n", 100.0 * cp_nb_tx_rejected_too_early / cp_nb_tx_requested, cp_nb_tx_requested, cp_nb_tx_rejected_too_early);
+            printf("# TX rejected (airtime): %.2f%% (req:%" PRIu64 ", rej:%" PRIu64 ")\n", 100.0 * cp_nb_tx_rejected_airtime / cp_nb_tx_requested, cp_nb_tx_requested, cp_nb_tx_rejected_airtime);
+        }
+        tx_occupancy = 0.0;
+        for (b = 0; b < nb_board; b++) {
+            brd = &boards[b];
+            if (nb_board > 1) {
+                printf("### Concentrator %d Status ###\n", b);
+            } else {
+                printf("### Concentrator Status ###\n");
+            }
+            i  = lgw_ctx_get_instcnt_now(brd->ctx, &inst_tstamp);
+            i |= lgw_ctx_get_trigcnt(brd->ctx, &trig_tstamp); /* status has just been refreshed */
+            if (i != LGW_HAL_SUCCESS) {
+                printf("# Concentrator counter unknown\n");
+            } else {
+                printf("# Concentrator counter (INST): %u\n", inst_tstamp);
+                printf("# Concentrator counter (PPS):  %u\n", trig_tstamp);
+            }
+            printf("### [JIT] ###\n");
+            /* get timestamp captured on PPM pulse  */
+            for (i = 0; i < brd->nb_tx_radio; i++) {
+                jit_print_queue (&brd->jit_queue[i], false, DEBUG_LOG);
+            }
+            printf("### [AIRTIME] ###\n");
+            time_ms = monotonic_ms();
+            for (i = 0; i < brd->nb_tx_radio; i++) {
+                occupancy = airtime_radio_occupancy(&brd->airtime, time_ms, i);
+                tx_occupancy = MAX(tx_occupancy, occupancy);
+                printf("# TX radio %d: %.2f%%\n", i, occupancy);
+            }
+            x = airtime_chan_occupancy(&brd->airtime, time_ms, chan_freq, chan_occupancy, AIRTIME_NB_CHAN_MAX);
+            for (i = 0; i < x; i++) {
+                printf("# TX frequency %u Hz: %.2f%%\n", chan_freq[i], chan_occupancy[i]);
+            }
+
+            i = lgw_ctx_get_temperature(brd->ctx, &brd_temperature, &temp_src);
+            if (i != LGW_HAL_SUCCESS) {
+                printf("### Concentrator temperature unknown ###\n");
+            } else {
+                printf("### Concentrator temperature: %.0f C (source:%s) ###\n", brd_temperature, (temp_src == TEMP_SRC_EXT) ? "sensor" : "mcu");
+                if (b == 0) {
+                    temperature = brd_temperature; /* the status report has the temperature of the first concentrator */
+                }
+            }
         }
+        x = report_latency(lat_json, sizeof lat_json);
         printf("##### END #####\n");
 
         /* generate a JSON report (will be sent to server by upstream thread) */
         pthread_mutex_lock(&mx_stat_rep);
-        snprintf(status_report, STATUS_SIZE, "\"stat\":{\"time\":\"%s\",\"rxnb\":%u,\"rxok\":%u,\"rxfw\":%u,\"ackr\":%.1f,\"dwnb\":%u,\"txnb\":%u,\"temp\":%.1f}", stat_timestamp, cp_nb_rx_rcv, cp_nb_rx_ok, cp_up_pkt_fwd, 100.0 * up_ack_ratio, cp_dw_dgram_rcv, cp_nb_tx_ok, temperature);
+        snprintf(status_report, STATUS_SIZE, "\"stat\":{\"time\":\"%s\",\"rxnb\":%u,\"rxok\":%u,\"rxfw\":%u,\"ackr\":%.1f,\"dwnb\":%u,\"txnb\":%u,\"txoc\":%.2f,\"temp\":%.1f%s%s%s}", stat_timestamp, cp_nb_rx_rcv, cp_nb_rx_ok, cp_up_pkt_fwd, 100.0 * up_ack_ratio, cp_dw_dgram_rcv, cp_nb_tx_ok, tx_occupancy, temperature, (x > 0) ? ",\"lat\":{" : "", lat_json, (x > 0) ? "}" : "");
+        status_report_bin.time = (uint32_t)t;
+        status_report_bin.rxnb = cp_nb_rx_rcv;
+        status_report_bin.rxok = cp_nb_rx_ok;
+        status_report_bin.rxfw = cp_up_pkt_fwd;
+        status_report_bin.ackr = 100.0 * up_ack_ratio;
+        status_report_bin.dwnb = cp_dw_dgram_rcv;
+        status_report_bin.txnb = cp_nb_tx_ok;
+        status_report_bin.temp = temperature;
         report_ready = true;
         pthread_mutex_unlock(&mx_stat_rep);
     }
 
-    pthread_join(thrid_up, NULL); /* wait for upstream thread to finish (1 fetch cycle max) */
-    pthread_join(thrid_jit, NULL); /* wait for jit thread to finish, too avoid interrupting a USB com (req+ack) with the concentrator */
+    for (b = 0; b < nb_board; b++) {
+        pthread_join(boards[b].thrid_rx, NULL); /* wait for RX fetch threads to finish (1 fetch cycle max) */
+    }
+    pthread_join(thrid_up, NULL); /* wait for upstream thread to finish */
+    pthread_join(thrid_up_ack, NULL); /* wait for upstream acknowledge thread to finish (1 PUSH_ACK time-out max) */
+    for (b = 0; b < nb_board; b++) {
+        pthread_join(boards[b].thrid_jit, NULL); /* wait for jit threads to finish, too avoid interrupting a USB com (req+ack) with the concentrator */
+    }
     pthread_cancel(thrid_down); /* don't wait for downstream thread */
 
     /* if an exit signal was received, try to quit properly */
@@ -1049,11 +1835,14 @@ int main(int argc, char ** argv)
         shutdown(sock_up, SHUT_RDWR);
         shutdown(sock_down, SHUT_RDWR);
         /* stop the hardware */
-        i = lgw_stop();
-        if (i == LGW_HAL_SUCCESS) {
-            MSG("INFO: concentrator stopped successfully\n");
-        } else {
-            MSG("WARNING: failed to stop concentrator successfully\n");
+        for (b = 0; b < nb_board; b++) {
+            i = lgw_ctx_stop(boards[b].ctx);
+            if (i == LGW_HAL_SUCCESS) {
+                MSG("INFO: concentrator %d stopped successfully\n", b);
+            } else {
+                MSG("WARNING: failed to stop concentrator %d successfully\n", b);
+            }
+            lgw_ctx_delete(boards[b].ctx);
         }
     }
 
@@ -1061,32 +1850,118 @@ int main(int argc, char ** argv)
     exit(EXIT_SUCCESS);
 }
 
+/* -------------------------------------------------------------------------- */
+/* --- THREAD 0: FETCHING PACKETS FROM THE CONCENTRATOR --------------------- */
+
+void * thread_rx(void * arg) {
+    struct board_s *brd = (struct board_s *)arg;
+    int i; /* loop variable */
+
+    /* allocate memory for packet fetching */
+    struct lgw_pkt_rx_ref_s rxpkt[NB_PKT_MAX]; /* array containing inbound packets metadata, payloads are kept by the HAL */
+    struct lgw_pkt_rx_ref_s *q; /* pointer on a RX ring slot */
+    int nb_pkt;
+    int nb_queued;
+    uint32_t nb_lost = 0; /* packets lost by the concentrator since start */
+    uint32_t nb_lost_prev = 0;
+    uint64_t fetch_us; /* host time of the fetch */
+    uint32_t fetch_cnt; /* concentrator time of the fetch */
+    bool fetch_cnt_valid;
+
+    while (!exit_sig && !quit_sig) {
+        /* fetch packets, and queue their descriptors in the RX ring */
+        nb_queued = 0;
+        nb_pkt = lgw_ctx_receive_ref(brd->ctx, NB_PKT_MAX, rxpkt);
+        if (nb_pkt > 0) {
+            fetch_us = monotonic_us();
+            fetch_cnt_valid = (lgw_ctx_get_instcnt_estimate(brd->ctx, &fetch_cnt, NULL) == LGW_HAL_SUCCESS); /* no concentrator access */
+            for (i = 0; i < nb_pkt; i++) {
+                if (fetch_cnt_valid) {
+                    lat_record_cnt(LAT_UP_FETCH, rxpkt[i].count_us, fetch_cnt);
+                }
+
+                /* packets are dropped if the ring is full, the concentrator still has to be drained */
+                q = rx_ring_reserve(&brd->rx_ring);
+                if (q == NULL) {
+                    continue;
+                }
+                *q = rxpkt[i]; /* the payload stays in the arena, released by the upstream thread */
+                rx_ring_commit(&brd->rx_ring, fetch_us);
+                nb_queued += 1;
+            }
+        }
+        lgw_ctx_get_rx_lost(brd->ctx, &nb_lost);
+        if (nb_pkt == LGW_HAL_ERROR) {
+            MSG("ERROR: [rx] failed packet fetch on concentrator %d, exiting\n", brd->index);
+            exit(EXIT_FAILURE);
+        }
+
+        /* account for packets lost by the concentrator */
+        if (nb_lost != nb_lost_prev) {
+            MSG("WARNING: [rx] concentrator %d lost %u packets (RX buffer full)\n", brd->index, nb_lost - nb_lost_prev);
+            meas_add(MEAS_NB_RX_LOST, nb_lost - nb_lost_prev);
+            nb_lost_prev = nb_lost;
+        }
+        if (nb_queued < nb_pkt) {
+            MSG("WARNING: [rx] uplink queue full, %d packets dropped\n", nb_pkt - nb_queued);
+        }
+
+        /* wake up the upstream thread */
+        if (nb_queued > 0) {
+            pthread_mutex_lock(&mx_rx_ring);
+            pthread_cond_signal(&cond_rx_ring);
+            pthread_mutex_unlock(&mx_rx_ring);
+        }
+
+        /* wait for the concentrator to signal new data if no packets */
+        if (nb_pkt == 0) {
+            /* no command is exchanged while waiting, no need to lock the concentrator */
+            if (lgw_ctx_wait_rx(brd->ctx, FETCH_SLEEP_MS) == LGW_HAL_ERROR) {
+                MSG("ERROR: [rx] failed to wait for concentrator %d data, exiting\n", brd->index);
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+    MSG("\nINFO: End of RX fetch thread\n");
+    return NULL;
+}
+
 /* -------------------------------------------------------------------------- */
 /* --- THREAD 1: RECEIVING PACKETS AND FORWARDING THEM ---------------------- */
 
 void thread_up(void) {
-    int i, j; /* loop variables */
+    int i, j, b; /* loop variables */
     unsigned pkt_in_dgram; /* nb on Lora packet in the current datagram */
     char stat_timestamp[24];
     time_t t;
 
-    /* allocate memory for packet fetching and processing */
-    struct lgw_pkt_rx_s rxpkt[NB_PKT_MAX]; /* array containing inbound packets + metadata */
-    struct lgw_pkt_rx_s *p; /* pointer on a RX packet */
+    /* packets are processed in place, from the RX rings of the boards */
+    struct lgw_pkt_rx_ref_s *p; /* pointer on a RX packet */
+    struct lgw_pkt_rx_ref_s *rx_pkt[NB_PKT_MAX]; /* packets fetched, all boards merged */
+    uint8_t rx_brd[NB_PKT_MAX]; /* board of each packet fetched */
+    uint64_t rx_time[NB_PKT_MAX]; /* host time each packet was fetched */
+    int brd_nb_pkt[NB_BOARD_MAX]; /* number of packets taken from each RX ring */
+    const struct lgw_pkt_rx_ref_s *fwd_pkt[NB_PKT_MAX]; /* packets to be forwarded */
+    uint8_t fwd_brd[NB_PKT_MAX]; /* board of each packet to be forwarded */
+    uint64_t fwd_time[NB_PKT_MAX]; /* host time each packet to be forwarded was fetched */
+    uint64_t send_us;
+    struct binpk_stat_s stat_bin; /* status report, for the binary protocol */
     int nb_pkt;
+    struct timespec wait_end;
+    uint64_t wait_us;
+    uint64_t first_us; /* host time the oldest packet held was fetched */
+    uint32_t up_size; /* estimated size of the PUSH_DATA of the packets held */
+    bool brd_full;
+
+    /* copies of the packets received by several radios */
+    struct dedup_s dedup;
 
     /* data buffers */
     uint8_t buff_up[TX_BUFF_SIZE]; /* buffer to compose the upstream packet */
     int buff_index;
-    uint8_t buff_ack[32]; /* buffer to receive acknowledges */
 
     /* protocol variables */
-    uint8_t token_h; /* random token for acknowledgement matching */
-    uint8_t token_l; /* random token for acknowledgement matching */
-
-    /* ping measurement variables */
-    struct timespec send_time;
-    struct timespec recv_time;
+    uint16_t token; /* random token for acknowledgement matching */
 
     /* report management variable */
     bool send_report = false;
@@ -1095,37 +1970,83 @@ void thread_up(void) {
     uint32_t mote_addr = 0;
     uint16_t mote_fcnt = 0;
 
-    /* set upstream socket RX timeout */
-    i = setsockopt(sock_up, SOL_SOCKET, SO_RCVTIMEO, (void *)&push_timeout_half, sizeof push_timeout_half);
-    if (i != 0) {
-        MSG("ERROR: [up] setsockopt returned %s\n", strerror(errno));
-        exit(EXIT_FAILURE);
-    }
-
     /* pre-fill the data buffer with fixed fields */
-    buff_up[0] = PROTOCOL_VERSION;
+    buff_up[0] = protocol_version;
     buff_up[3] = PKT_PUSH_DATA;
     *(uint32_t *)(buff_up + 4) = net_mac_h;
     *(uint32_t *)(buff_up + 8) = net_mac_l;
 
+    dedup_init(&dedup, dedup_window_us);
+
     while (!exit_sig && !quit_sig) {
 
-        /* fetch packets */
-        pthread_mutex_lock(&mx_concent);
-        nb_pkt = lgw_receive(NB_PKT_MAX, rxpkt);
-        pthread_mutex_unlock(&mx_concent);
-        if (nb_pkt == LGW_HAL_ERROR) {
-            MSG("ERROR: [up] failed packet fetch, exiting\n");
-            exit(EXIT_FAILURE);
+        /* get packets fetched by the RX threads, board after board */
+        nb_pkt = 0;
+        first_us = UINT64_MAX;
+        up_size = 0;
+        brd_full = false;
+        for (b = 0; b < nb_board; b++) {
+            brd_nb_pkt[b] = (int)MIN(rx_ring_count(&boards[b].rx_ring), (uint32_t)(NB_PKT_MAX - nb_pkt));
+            for (i = 0; i < brd_nb_pkt[b]; i++) {
+                rx_pkt[nb_pkt] = rx_ring_peek(&boards[b].rx_ring, i);
+                rx_time[nb_pkt] = rx_ring_time(&boards[b].rx_ring, i);
+                rx_brd[nb_pkt] = (uint8_t)b;
+                first_us = MIN(first_us, rx_time[nb_pkt]);
+                up_size += (protocol_version == BINPK_PROTOCOL_VERSION) ? (BINPK_RXPK_HEADER_SIZE + rx_pkt[nb_pkt]->size) : RXPK_SIZE_MAX(rx_pkt[nb_pkt]->size);
+                nb_pkt += 1;
+            }
+            if (brd_nb_pkt[b] >= (RX_RING_SIZE / 2)) {
+                brd_full = true; /* leave room to the RX thread */
+            }
         }
 
         /* check if there are status report to send */
         send_report = report_ready; /* copy the variable so it doesn't change mid-function */
         /* no mutex, we're only reading */
 
-        /* wait a short time if no packets, nor status report */
+        /* hold the packets for more to come in the same datagram, until the window of the oldest one ends */
+        if ((push_window_ms > 0) && (nb_pkt > 0) && (nb_pkt < NB_PKT_MAX) && (send_report == false) && (brd_full == false) && (up_size < push_max_bytes)) {
+            send_us = monotonic_us();
+            if (send_us < (first_us + (push_window_ms * 1000))) {
+                wait_us = first_us + (push_window_ms * 1000) - send_us;
+                clock_gettime(CLOCK_REALTIME, &wait_end);
+                wait_end.tv_sec += (time_t)(wait_us / 1000000);
+                wait_end.tv_nsec += (long)(wait_us % 1000000) * 1000;
+                if (wait_end.tv_nsec >= 1000000000) {
+                    wait_end.tv_sec += 1;
+                    wait_end.tv_nsec -= 1000000000;
+                }
+                pthread_mutex_lock(&mx_rx_ring);
+                j = 0;
+                for (b = 0; b < nb_board; b++) {
+                    j += (int)rx_ring_count(&boards[b].rx_ring);
+                }
+                if (j == nb_pkt) {
+                    pthread_cond_timedwait(&cond_rx_ring, &mx_rx_ring, &wait_end);
+                }
+                pthread_mutex_unlock(&mx_rx_ring);
+                continue;
+            }
+        }
+
+        /* wait for the RX thread to push packets if no packets, nor status report */
         if ((nb_pkt == 0) && (send_report == false)) {
-            wait_ms(FETCH_SLEEP_MS);
+            clock_gettime(CLOCK_REALTIME, &wait_end);
+            wait_end.tv_nsec += FETCH_SLEEP_MS * 1000000;
+            if (wait_end.tv_nsec >= 1000000000) {
+                wait_end.tv_sec += 1;
+                wait_end.tv_nsec -= 1000000000;
+            }
+            pthread_mutex_lock(&mx_rx_ring);
+            for (b = 0; b < nb_board; b++) {
+                if (rx_ring_count(&boards[b].rx_ring) != 0) {
+                    break;
+                }
+            }
+            if (b == nb_board) {
+                pthread_cond_timedwait(&cond_rx_ring, &mx_rx_ring, &wait_end);
+            }
+            pthread_mutex_unlock(&mx_rx_ring);
             continue;
         }
 
@@ -1134,21 +2055,13 @@ void thread_up(void) {
         strftime(stat_timestamp, sizeof stat_timestamp, "%F %T %Z", gmtime(&t));
         MSG_DEBUG(DEBUG_PKT_FWD, "\nCurrent time: %s \n", stat_timestamp);
 
-        /* start composing datagram with the header */
-        token_h = (uint8_t)rand(); /* random token */
-        token_l = (uint8_t)rand(); /* random token */
-        buff_up[1] = token_h;
-        buff_up[2] = token_l;
+        /* start composing datagram with the header, the token is set when sending */
         buff_index = 12; /* 12-byte header */
 
-        /* start of JSON structure */
-        memcpy((void *)(buff_up + buff_index), (void *)"{\"rxpk\":[", 9);
-        buff_index += 9;
-
-        /* serialize Lora packets metadata and payload */
+        /* filter packets to be forwarded */
         pkt_in_dgram = 0;
         for (i = 0; i < nb_pkt; ++i) {
-            p = &rxpkt[i];
+            p = rx_pkt[i];
 
             /* Get mote information from current packet (addr, fcnt) */
             /* FHDR - DevAddr */
@@ -1166,290 +2079,151 @@ void thread_up(void) {
             }
 
             /* basic packet filtering */
-            pthread_mutex_lock(&mx_meas_up);
-            meas_nb_rx_rcv += 1;
+            meas_add(MEAS_NB_RX_RCV, 1);
             switch(p->status) {
                 case STAT_CRC_OK:
-                    meas_nb_rx_ok += 1;
+                    meas_add(MEAS_NB_RX_OK, 1);
                     if (!fwd_valid_pkt) {
-                        pthread_mutex_unlock(&mx_meas_up);
                         continue; /* skip that packet */
                     }
                     break;
                 case STAT_CRC_BAD:
-                    meas_nb_rx_bad += 1;
+                    meas_add(MEAS_NB_RX_BAD, 1);
                     if (!fwd_error_pkt) {
-                        pthread_mutex_unlock(&mx_meas_up);
                         continue; /* skip that packet */
                     }
                     break;
                 case STAT_NO_CRC:
-                    meas_nb_rx_nocrc += 1;
+                    meas_add(MEAS_NB_RX_NOCRC, 1);
                     if (!fwd_nocrc_pkt) {
-                        pthread_mutex_unlock(&mx_meas_up);
                         continue; /* skip that packet */
                     }
                     break;
                 default:
                     MSG("WARNING: [up] received packet with unknown status %u (size %u, modulation %u, BW %u, DR %u, RSSI %.1f)\n", p->status, p->size, p->modulation, p->bandwidth, p->datarate, p->rssi);
-                    pthread_mutex_unlock(&mx_meas_up);
                     continue; /* skip that packet */
                     // exit(EXIT_FAILURE);
             }
-            meas_up_pkt_fwd += 1;
-            meas_up_payload_byte += p->size;
-            pthread_mutex_unlock(&mx_meas_up);
             printf( "\nINFO: Received pkt from mote: %08X (fcnt=%u)\n", mote_addr, mote_fcnt );
 
-            /* Start of packet, add inter-packet separator if necessary */
-            if (pkt_in_dgram == 0) {
-                buff_up[buff_index] = '{';
-                ++buff_index;
-            } else {
-                buff_up[buff_index] = ',';
-                buff_up[buff_index+1] = '{';
-                buff_index += 2;
-            }
-
-            /* JSON rxpk frame format version, 8 useful chars */
-            j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, "\"jver\":%d", PROTOCOL_JSON_RXPK_FRAME_FORMAT );
-            if (j > 0) {
-                buff_index += j;
-            } else {
-                MSG("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 4));
-                exit(EXIT_FAILURE);
-            }
-
-            /* RAW timestamp, 8-17 useful chars */
-            j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, ",\"tmst\":%u", p->count_us);
-            if (j > 0) {
-                buff_index += j;
-            } else {
-                MSG("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 4));
-                exit(EXIT_FAILURE);
-            }
-
-            /* Packet concentrator channel, RF chain & RX frequency, 34-36 useful chars */
-            j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, ",\"chan\":%1u,\"freq\":%.6lf,\"foff\":%i", p->channel, ((double)p->freq_hz / 1e6), p->foff_hz);
-            if (j > 0) {
-                buff_index += j;
-            } else {
-                MSG("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 4));
-                exit(EXIT_FAILURE);
-            }
-
-            /* Packet status, 9-10 useful chars */
-            switch (p->status) {
-                case STAT_CRC_OK:
-                    memcpy((void *)(buff_up + buff_index), (void *)",\"stat\":1", 9);
-                    buff_index += 9;
-                    break;
-                case STAT_CRC_BAD:
-                    memcpy((void *)(buff_up + buff_index), (void *)",\"stat\":-1", 10);
-                    buff_index += 10;
-                    break;
-                case STAT_NO_CRC:
-                    memcpy((void *)(buff_up + buff_index), (void *)",\"stat\":0", 9);
-                    buff_index += 9;
-                    break;
-                default:
-                    MSG("ERROR: [up] received packet with unknown status 0x%02X\n", p->status);
-                    memcpy((void *)(buff_up + buff_index), (void *)",\"stat\":?", 9);
-                    buff_index += 9;
-                    exit(EXIT_FAILURE);
-            }
+            /* packet to be serialized */
+            fwd_pkt[pkt_in_dgram] = p;
+            fwd_brd[pkt_in_dgram] = rx_brd[i];
+            fwd_time[pkt_in_dgram] = rx_time[i];
+            ++pkt_in_dgram;
 
-            /* Packet modulation, 13-14 useful chars */
             if (p->modulation == MOD_LORA) {
-                memcpy((void *)(buff_up + buff_index), (void *)",\"modu\":\"LORA\"", 14);
-                buff_index += 14;
-
-                /* Lora datarate & bandwidth, 16-19 useful chars */
-                switch (p->datarate) {
-                    case DR_LORA_SF5:
-                        memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":\"SF5", 12);
-                        buff_index += 12;
-                        break;
-                    case DR_LORA_SF6:
-                        memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":\"SF6", 12);
-                        buff_index += 12;
-                        break;
-                    case DR_LORA_SF7:
-                        memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":\"SF7", 12);
-                        buff_index += 12;
-                        break;
-                    case DR_LORA_SF8:
-                        memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":\"SF8", 12);
-                        buff_index += 12;
-                        break;
-                    case DR_LORA_SF9:
-                        memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":\"SF9", 12);
-                        buff_index += 12;
-                        break;
-                    case DR_LORA_SF10:
-                        memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":\"SF10", 13);
-                        buff_index += 13;
-                        break;
-                    case DR_LORA_SF11:
-                        memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":\"SF11", 13);
-                        buff_index += 13;
-                        break;
-                    case DR_LORA_SF12:
-                        memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":\"SF12", 13);
-                        buff_index += 13;
-                        break;
-                    default:
-                        MSG("ERROR: [up] lora packet with unknown datarate 0x%02X\n", p->datarate);
-                        memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":\"SF?", 12);
-                        buff_index += 12;
-                        exit(EXIT_FAILURE);
-                }
-                switch (p->bandwidth) {
-                    case BW_800KHZ:
-                        memcpy((void *)(buff_up + buff_index), (void *)"BW812\"", 6);
-                        buff_index += 6;
-                        break;
-                    default:
-                        MSG("ERROR: [up] lora packet with unknown bandwidth 0x%02X\n", p->bandwidth);
-                        memcpy((void *)(buff_up + buff_index), (void *)"BW?\"", 4);
-                        buff_index += 4;
-                        exit(EXIT_FAILURE);
-                }
-
-                /* Packet ECC coding rate, 11-13 useful chars */
-                switch (p->coderate) {
-                    case CR_LORA_LI_4_8:
-                        memcpy((void *)(buff_up + buff_index), (void *)",\"codr\":\"4/8LI\"", 15);
-                        buff_index += 15;
-                        break;
-                    default:
-                        MSG("ERROR: [up] lora packet with unknown coderate 0x%02X\n", p->coderate);
-                        memcpy((void *)(buff_up + buff_index), (void *)",\"codr\":\"?\"", 11);
-                        buff_index += 11;
-                        exit(EXIT_FAILURE);
-                }
-
-                /* Lora SNR */
-                j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, ",\"lsnr\":%.1f", p->snr);
-                if (j > 0) {
-                    buff_index += j;
-                } else {
-                    MSG("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 4));
-                    exit(EXIT_FAILURE);
-                }
-            } else {
-                MSG("ERROR: [up] received packet with unknown modulation 0x%02X\n", p->modulation);
-                exit(EXIT_FAILURE);
+                /* Log nb of packets per channel, per SF */
+                nb_pkt_log[p->channel][p->datarate - 5] += 1;
+                nb_pkt_received += 1;
             }
+        }
 
-            /* Channel RSSI, payload size, 18-23 useful chars */
-            j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, ",\"rssi\":%.0f,\"size\":%u", roundf(p->rssi), p->size);
-            if (j > 0) {
-                buff_index += j;
-            } else {
-                MSG("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 4));
-                exit(EXIT_FAILURE);
-            }
+        /* forward only the best copy of the packets received by several radios */
+        if ((uplink_dedup == true) && (pkt_in_dgram > 0)) {
+            j = dedup_filter(&dedup, fwd_pkt, fwd_brd, fwd_time, pkt_in_dgram);
+            meas_add(MEAS_UP_DEDUP, pkt_in_dgram - j);
+            pkt_in_dgram = (unsigned)j;
+        }
+        for (i = 0; i < (int)pkt_in_dgram; i++) {
+            meas_add(MEAS_UP_PKT_FWD, 1);
+            meas_add(MEAS_UP_PAYLOAD_BYTE, fwd_pkt[i]->size);
+        }
 
-            /* Packet base64-encoded payload, 14-350 useful chars */
-            memcpy((void *)(buff_up + buff_index), (void *)",\"data\":\"", 9);
-            buff_index += 9;
-            j = bin_to_b64(p->payload, p->size, (char *)(buff_up + buff_index), 341); /* 255 bytes = 340 chars in b64 + null char */
-            if (j>=0) {
-                buff_index += j;
-            } else {
-                MSG("ERROR: [up] bin_to_b64 failed line %u\n", (__LINE__ - 5));
-                exit(EXIT_FAILURE);
+        /* serialize Lora packets metadata and payload */
+        if (protocol_version == BINPK_PROTOCOL_VERSION) {
+            /* the status report is the last record of the binary payload */
+            if (send_report == true) {
+                pthread_mutex_lock(&mx_stat_rep);
+                report_ready = false;
+                stat_bin = status_report_bin;
+                pthread_mutex_unlock(&mx_stat_rep);
             }
-            buff_up[buff_index] = '"';
-            ++buff_index;
-
-            /* End of packet serialization */
-            buff_up[buff_index] = '}';
-            ++buff_index;
-            ++pkt_in_dgram;
+            j = binpk_rxpk_serialize_batch(fwd_pkt, pkt_in_dgram, (send_report == true) ? &stat_bin : NULL, buff_up + buff_index, TX_BUFF_SIZE - buff_index);
+        } else {
+            /* start of JSON structure */
+            memcpy((void *)(buff_up + buff_index), (void *)"{\"rxpk\":[", 9);
+            buff_index += 9;
+            /* the board is only written when there are several of them */
+            j = rxpk_serialize_batch_brd(fwd_pkt, (nb_board > 1) ? fwd_brd : NULL, pkt_in_dgram, (char *)(buff_up + buff_index), TX_BUFF_SIZE - buff_index - STATUS_SIZE);
+        }
+        if (j < 0) {
+            MSG("ERROR: [up] failed to serialize %u packets\n", pkt_in_dgram);
+            exit(EXIT_FAILURE);
+        }
+        buff_index += j;
 
-            if (p->modulation == MOD_LORA) {
-                /* Log nb of packets per channel, per SF */
-                nb_pkt_log[p->channel][p->datarate - 5] += 1;
-                nb_pkt_received += 1;
+        /* all packets have been serialized, give their payloads back to the HAL and the slots to the RX threads */
+        for (b = 0; b < nb_board; b++) {
+            if (brd_nb_pkt[b] > 0) {
+                lgw_ctx_release_rx(boards[b].ctx, rx_ring_peek(&boards[b].rx_ring, (uint32_t)brd_nb_pkt[b] - 1)); /* releases the older ones too */
+                rx_ring_pop(&boards[b].rx_ring, (uint32_t)brd_nb_pkt[b]);
             }
         }
 
         /* debug logs */
         print_nb_pkt_stats();
 
-        /* restart fetch sequence without sending empty JSON if all packets have been filtered out */
-        if (pkt_in_dgram == 0) {
-            if (send_report == true) {
-                /* need to clean up the beginning of the payload */
-                buff_index -= 8; /* removes "rxpk":[ */
-            } else {
-                /* all packet have been filtered out and no report, restart loop */
+        if (protocol_version == BINPK_PROTOCOL_VERSION) {
+            /* restart fetch sequence if all packets have been filtered out and no report */
+            if ((pkt_in_dgram == 0) && (send_report == false)) {
                 continue;
             }
+            printf("\nbinary up: %u packets%s, %d bytes\n", pkt_in_dgram, (send_report == true) ? " and status" : "", buff_index - 12);
         } else {
-            /* end of packet array */
-            buff_up[buff_index] = ']';
-            ++buff_index;
-            /* add separator if needed */
-            if (send_report == true) {
-                buff_up[buff_index] = ',';
+            /* restart fetch sequence without sending empty JSON if all packets have been filtered out */
+            if (pkt_in_dgram == 0) {
+                if (send_report == true) {
+                    /* need to clean up the beginning of the payload */
+                    buff_index -= 8; /* removes "rxpk":[ */
+                } else {
+                    /* all packet have been filtered out and no report, restart loop */
+                    continue;
+                }
+            } else {
+                /* end of packet array */
+                buff_up[buff_index] = ']';
                 ++buff_index;
+                /* add separator if needed */
+                if (send_report == true) {
+                    buff_up[buff_index] = ',';
+                    ++buff_index;
+                }
             }
-        }
 
-        /* add status report if a new one is available */
-        if (send_report == true) {
-            pthread_mutex_lock(&mx_stat_rep);
-            report_ready = false;
-            j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, "%s", status_report);
-            pthread_mutex_unlock(&mx_stat_rep);
-            if (j > 0) {
-                buff_index += j;
-            } else {
-                MSG("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 5));
-                exit(EXIT_FAILURE);
+            /* add status report if a new one is available */
+            if (send_report == true) {
+                pthread_mutex_lock(&mx_stat_rep);
+                report_ready = false;
+                j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, "%s", status_report);
+                pthread_mutex_unlock(&mx_stat_rep);
+                if (j > 0) {
+                    buff_index += j;
+                } else {
+                    MSG("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 5));
+                    exit(EXIT_FAILURE);
+                }
             }
-        }
 
-        /* end of JSON datagram payload */
-        buff_up[buff_index] = '}';
-        ++buff_index;
-        buff_up[buff_index] = 0; /* add string terminator, for safety */
+            /* end of JSON datagram payload */
+            buff_up[buff_index] = '}';
+            ++buff_index;
+            buff_up[buff_index] = 0; /* add string terminator, for safety */
 
-        printf("\nJSON up: %s\n", (char *)(buff_up + 12)); /* DEBUG: display JSON payload */
+            printf("\nJSON up: %s\n", (char *)(buff_up + 12)); /* DEBUG: display JSON payload */
+        }
 
-        /* send datagram to server */
+        /* send datagram to server, its PUSH_ACK is handled by the upstream acknowledge thread */
+        token = push_ack_register();
+        buff_up[1] = (uint8_t)(token >> 8);
+        buff_up[2] = (uint8_t)(token & 0xFF);
         send(sock_up, (void *)buff_up, buff_index, 0);
-        clock_gettime(CLOCK_MONOTONIC, &send_time);
-        pthread_mutex_lock(&mx_meas_up);
-        meas_up_dgram_sent += 1;
-        meas_up_network_byte += buff_index;
-
-        /* wait for acknowledge (in 2 times, to catch extra packets) */
-        for (i=0; i<2; ++i) {
-            j = recv(sock_up, (void *)buff_ack, sizeof buff_ack, 0);
-            clock_gettime(CLOCK_MONOTONIC, &recv_time);
-            if (j == -1) {
-                if (errno == EAGAIN) { /* timeout */
-                    continue;
-                } else { /* server connection error */
-                    break;
-                }
-            } else if ((j < 4) || (buff_ack[0] != PROTOCOL_VERSION) || (buff_ack[3] != PKT_PUSH_ACK)) {
-                //MSG("WARNING: [up] ignored invalid non-ACL packet\n");
-                continue;
-            } else if ((buff_ack[1] != token_h) || (buff_ack[2] != token_l)) {
-                //MSG("WARNING: [up] ignored out-of sync ACK packet\n");
-                continue;
-            } else {
-                MSG("INFO: [up] PUSH_ACK received in %i ms\n", (int)(1000 * difftimespec(recv_time, send_time)));
-                meas_up_ack_rcv += 1;
-                break;
-            }
+        send_us = monotonic_us();
+        for (i = 0; i < (int)pkt_in_dgram; i++) {
+            lgw_hist_record(&lat_hist[LAT_UP_SEND], (uint32_t)(send_us - fwd_time[i]));
         }
-        pthread_mutex_unlock(&mx_meas_up);
+        meas_add(MEAS_UP_DGRAM_SENT, 1);
+        meas_add(MEAS_UP_NETWORK_BYTE, buff_index);
     }
     MSG("\nINFO: End of upstream thread\n");
 }
@@ -1458,19 +2232,37 @@ void thread_up(void) {
 /* --- THREAD 2: POLLING SERVER AND ENQUEUING PACKETS IN JIT QUEUE ---------- */
 
 void thread_down(void) {
-    int i; /* loop variables */
-
-    /* configuration and metadata for an outbound packet */
-    struct lgw_pkt_tx_s txpkt;
-    bool sent_immediate = false; /* option to sent the packet immediately */
+    int i, j; /* loop variables */
+    struct board_s *brd; /* board which sends the packet */
+
+    /* downlinks of the PULL_RESP received at once, with their board and JiT status */
+    static struct lgw_pkt_tx_s dl_pkt[DOWN_BATCH_MAX * TXPK_BATCH_MAX];
+    static struct txpk_info_s dl_info[DOWN_BATCH_MAX * TXPK_BATCH_MAX];
+    enum txpk_error_e dl_err[DOWN_BATCH_MAX * TXPK_BATCH_MAX];
+    struct board_s *dl_brd[DOWN_BATCH_MAX * TXPK_BATCH_MAX];
+    enum jit_pkt_type_e dl_type[DOWN_BATCH_MAX * TXPK_BATCH_MAX];
+    enum jit_error_e dl_result[DOWN_BATCH_MAX * TXPK_BATCH_MAX];
+    enum jit_error_e dl_warning[DOWN_BATCH_MAX * TXPK_BATCH_MAX];
+    int32_t dl_value[DOWN_BATCH_MAX * TXPK_BATCH_MAX];
+    int nb_dl;
+    struct pull_resp_s resp[DOWN_BATCH_MAX];
+    int nb_resp;
 
     /* local timekeeping variables */
     struct timespec send_time; /* time of the pull request */
     struct timespec recv_time; /* time of return from recv socket call */
-
-    /* data buffers */
-    uint8_t buff_down[1000]; /* buffer to receive downstream packets */
+    uint64_t recv_us; /* same, for latency statistics */
+
+    /* data buffers, the datagrams of a batch are received and acknowledged with a single system call */
+    static uint8_t buff_batch[DOWN_BATCH_MAX][DOWN_BUFF_SIZE]; /* buffers to receive downstream packets */
+    static uint8_t buff_ack[DOWN_BATCH_MAX][ACK_BUFF_SIZE]; /* buffers to give feedback to server */
+    struct iovec iov_down[DOWN_BATCH_MAX];
+    struct mmsghdr msg_down[DOWN_BATCH_MAX];
+    struct iovec iov_ack[DOWN_BATCH_MAX];
+    struct mmsghdr msg_ack[DOWN_BATCH_MAX];
+    uint8_t *buff_down;
     uint8_t buff_req[12]; /* buffer to compose pull requests */
+    int nb_msg;
     int msg_len;
 
     /* protocol variables */
@@ -1479,21 +2271,16 @@ void thread_down(void) {
     bool req_ack = false; /* keep track of whether PULL_DATA was acknowledged or not */
 
     /* JSON parsing variables */
-    JSON_Value *root_val = NULL;
-    JSON_Object *txpk_obj = NULL;
-    JSON_Value *val = NULL; /* needed to detect the absence of some fields */
-    const char *str; /* pointer to sub-strings in the JSON data */
-    short x0, x1;
+    enum txpk_error_e txpk_err;
+    int nb_txpk;
 
     /* auto-quit variable */
     uint32_t autoquit_cnt = 0; /* count the number of PULL_DATA sent since the latest PULL_ACK */
 
-    /* Just In Time downlink */
-    uint32_t current_concentrator_time;
-    enum jit_error_e jit_result = JIT_ERROR_OK;
-    enum jit_pkt_type_e downlink_type;
-    enum jit_error_e warning_result = JIT_ERROR_OK;
-    int32_t warning_value = 0;
+    /* Just In Time downlink, the concentrator time is sampled once per board for a batch */
+    uint32_t current_concentrator_time[NB_BOARD_MAX];
+    bool time_sampled[NB_BOARD_MAX];
+    bool time_valid[NB_BOARD_MAX];
 
     /* set downstream socket RX timeout */
     i = setsockopt(sock_down, SOL_SOCKET, SO_RCVTIMEO, (void *)&pull_timeout, sizeof pull_timeout);
@@ -1503,13 +2290,23 @@ void thread_down(void) {
     }
 
     /* pre-fill the pull request buffer with fixed fields */
-    buff_req[0] = PROTOCOL_VERSION;
+    buff_req[0] = protocol_version;
     buff_req[3] = PKT_PULL_DATA;
     *(uint32_t *)(buff_req + 4) = net_mac_h;
     *(uint32_t *)(buff_req + 8) = net_mac_l;
 
-    /* JIT queue initialization */
-    jit_queue_init(&jit_queue[0]);
+    /* the socket is connected, messages have no address */
+    memset(msg_down, 0, sizeof msg_down);
+    memset(msg_ack, 0, sizeof msg_ack);
+    for (i = 0; i < DOWN_BATCH_MAX; i++) {
+        iov_down[i].iov_base = buff_batch[i];
+        iov_down[i].iov_len = DOWN_BUFF_SIZE - 1;
+        msg_down[i].msg_hdr.msg_iov = &iov_down[i];
+        msg_down[i].msg_hdr.msg_iovlen = 1;
+        iov_ack[i].iov_base = buff_ack[i];
+        msg_ack[i].msg_hdr.msg_iov = &iov_ack[i];
+        msg_ack[i].msg_hdr.msg_iovlen = 1;
+    }
 
     while (!exit_sig && !quit_sig) {
 
@@ -1529,9 +2326,7 @@ void thread_down(void) {
         /* send PULL request and record time */
         send(sock_down, (void *)buff_req, sizeof buff_req, 0);
         clock_gettime(CLOCK_MONOTONIC, &send_time);
-        pthread_mutex_lock(&mx_meas_dw);
-        meas_dw_pull_sent += 1;
-        pthread_mutex_unlock(&mx_meas_dw);
+        meas_add(MEAS_DW_PULL_SENT, 1);
         req_ack = false;
         autoquit_cnt++;
 
@@ -1539,258 +2334,146 @@ void thread_down(void) {
         recv_time = send_time;
         while ((int)difftimespec(recv_time, send_time) < keepalive_time) {
 
-            /* try to receive a datagram */
-            msg_len = recv(sock_down, (void *)buff_down, (sizeof buff_down)-1, 0);
+            /* wait for a datagram, then drain all the ones already queued in the socket */
+            nb_msg = recvmmsg(sock_down, msg_down, DOWN_BATCH_MAX, MSG_WAITFORONE, NULL);
             clock_gettime(CLOCK_MONOTONIC, &recv_time);
+            recv_us = ((uint64_t)recv_time.tv_sec * 1000000) + (recv_time.tv_nsec / 1000);
 
             /* if no network message was received, got back to listening sock_down socket */
-            if (msg_len == -1) {
-                //MSG("WARNING: [down] recv returned %s\n", strerror(errno)); /* too verbose */
+            if (nb_msg == -1) {
+                //MSG("WARNING: [down] recvmmsg returned %s\n", strerror(errno)); /* too verbose */
                 continue;
             }
 
-            /* if the datagram does not respect protocol, just ignore it */
-            if ((msg_len < 4) || (buff_down[0] != PROTOCOL_VERSION) || ((buff_down[3] != PKT_PULL_RESP) && (buff_down[3] != PKT_PULL_ACK))) {
-                MSG("WARNING: [down] ignoring invalid packet len=%d, protocol_version=%d, id=%d\n",
-                        msg_len, buff_down[0], buff_down[3]);
-                continue;
-            }
+            /* parse the PULL_RESP of the batch */
+            nb_dl = 0;
+            nb_resp = 0;
+            for (j = 0; j < nb_msg; j++) {
+                buff_down = buff_batch[j];
+                msg_len = (int)msg_down[j].msg_len;
+
+                /* if the datagram does not respect protocol, just ignore it */
+                if ((msg_len < 4) || (buff_down[0] != protocol_version) || ((buff_down[3] != PKT_PULL_RESP) && (buff_down[3] != PKT_PULL_ACK))) {
+                    MSG("WARNING: [down] ignoring invalid packet len=%d, protocol_version=%d, id=%d\n",
+                            msg_len, buff_down[0], buff_down[3]);
+                    continue;
+                }
 
-            /* if the datagram is an ACK, check token */
-            if (buff_down[3] == PKT_PULL_ACK) {
-                if ((buff_down[1] == token_h) && (buff_down[2] == token_l)) {
-                    if (req_ack) {
-                        MSG("INFO: [down] duplicate ACK received :)\n");
-                    } else { /* if that packet was not already acknowledged */
-                        req_ack = true;
-                        autoquit_cnt = 0;
-                        pthread_mutex_lock(&mx_meas_dw);
-                        meas_dw_ack_rcv += 1;
-                        pthread_mutex_unlock(&mx_meas_dw);
-                        MSG("INFO: [down] PULL_ACK received in %i ms\n", (int)(1000 * difftimespec(recv_time, send_time)));
+                /* if the datagram is an ACK, check token */
+                if (buff_down[3] == PKT_PULL_ACK) {
+                    if ((buff_down[1] == token_h) && (buff_down[2] == token_l)) {
+                        if (req_ack) {
+                            MSG("INFO: [down] duplicate ACK received :)\n");
+                        } else { /* if that packet was not already acknowledged */
+                            req_ack = true;
+                            autoquit_cnt = 0;
+                            meas_add(MEAS_DW_ACK_RCV, 1);
+                            MSG("INFO: [down] PULL_ACK received in %i ms\n", (int)(1000 * difftimespec(recv_time, send_time)));
+                        }
+                    } else { /* out-of-sync token */
+                        MSG("INFO: [down] received out-of-sync ACK\n");
                     }
-                } else { /* out-of-sync token */
-                    MSG("INFO: [down] received out-of-sync ACK\n");
+                    continue;
                 }
-                continue;
-            }
-
-            /* the datagram is a PULL_RESP */
-            buff_down[msg_len] = 0; /* add string terminator, just to be safe */
-            MSG("INFO: [down] PULL_RESP received  - token[%d:%d] :)\n", buff_down[1], buff_down[2]); /* very verbose */
-            printf("\nJSON down: %s\n", (char *)(buff_down + 4)); /* DEBUG: display JSON payload */
-
-            /* initialize TX struct and try to parse JSON */
-            memset(&txpkt, 0, sizeof txpkt);
-            root_val = json_parse_string_with_comments((const char *)(buff_down + 4)); /* JSON offset */
-            if (root_val == NULL) {
-                MSG("WARNING: [down] invalid JSON, TX aborted\n");
-                continue;
-            }
-
-            /* look for JSON sub-object 'txpk' */
-            txpk_obj = json_object_get_object(json_value_get_object(root_val), "txpk");
-            if (txpk_obj == NULL) {
-                MSG("WARNING: [down] no \"txpk\" object in JSON, TX aborted\n");
-                json_value_free(root_val);
-                continue;
-            }
 
-            /* Parse "immediate" tag, or target timestamp, or UTC time to be converted by GPS (mandatory) */
-            i = json_object_get_boolean(txpk_obj,"imme"); /* can be 1 if true, 0 if false, or -1 if not a JSON boolean */
-            if (i == 1) {
-                /* TX procedure: send immediately */
-                sent_immediate = true;
-                downlink_type = JIT_PKT_TYPE_DOWNLINK_CLASS_C;
-                MSG("INFO: [down] a packet will be sent in \"immediate\" mode\n");
-            } else {
-                sent_immediate = false;
-                val = json_object_get_value(txpk_obj,"tmst");
-                if (val != NULL) {
-                    /* TX procedure: send on timestamp value */
-                    txpkt.count_us = (uint32_t)json_value_get_number(val);
-
-                    /* Concentrator timestamp is given, we consider it is a Class A downlink */
-                    downlink_type = JIT_PKT_TYPE_DOWNLINK_CLASS_A;
+                /* the datagram is a PULL_RESP */
+                buff_down[msg_len] = 0; /* add string terminator, just to be safe */
+                MSG("INFO: [down] PULL_RESP received  - token[%d:%d] :)\n", buff_down[1], buff_down[2]); /* very verbose */
+
+                /* parse JSON or binary record, the TX structs are initialized by the parser */
+                if (protocol_version == BINPK_PROTOCOL_VERSION) {
+                    MSG_DEBUG(DEBUG_PKT_FWD, "binary down: %d bytes\n", msg_len - 4);
+                    txpk_err = binpk_txpk_parse(buff_down + 4, msg_len - 4, &dl_pkt[nb_dl], &dl_info[nb_dl]);
+                    dl_err[nb_dl] = txpk_err;
+                    nb_txpk = 1;
+                    resp[nb_resp].is_array = false;
                 } else {
-                    MSG("WARNING: [down] no mandatory \"txpk.imme\" or \"txpk.tmst\" object in JSON, TX aborted\n");
-                    json_value_free(root_val);
+                    printf("\nJSON down: %s\n", (char *)(buff_down + 4)); /* DEBUG: display JSON payload */
+                    txpk_err = txpk_parse_batch((const char *)(buff_down + 4), &dl_pkt[nb_dl], &dl_info[nb_dl], &dl_err[nb_dl], TXPK_BATCH_MAX, &nb_txpk, &resp[nb_resp].is_array); /* JSON offset */
+                }
+
+                /* a single txpk object with an error is not acknowledged, an error in an array is reported in its TX_ACK */
+                if ((txpk_err != TXPK_OK) || ((resp[nb_resp].is_array == false) && (dl_err[nb_dl] != TXPK_OK))) {
+                    txpk_warning((txpk_err != TXPK_OK) ? txpk_err : dl_err[nb_dl], &dl_info[nb_dl]);
                     continue;
                 }
-            }
+                if (nb_txpk > TXPK_BATCH_MAX) {
+                    MSG("WARNING: [down] %d packets in PULL_RESP, only the first %d are sent\n", nb_txpk, TXPK_BATCH_MAX);
+                    nb_txpk = TXPK_BATCH_MAX;
+                }
+                for (i = nb_dl; i < (nb_dl + nb_txpk); i++) {
+                    if (dl_err[i] != TXPK_OK) {
+                        txpk_warning(dl_err[i], &dl_info[i]);
+                        dl_result[i] = JIT_ERROR_INVALID;
+                    } else {
+                        dl_result[i] = prepare_downlink(&dl_pkt[i], &dl_info[i], &dl_brd[i], &dl_type[i], &dl_warning[i], &dl_value[i]);
+                    }
+                }
 
-            /* Parse "No CRC" flag (optional field) */
-            val = json_object_get_value(txpk_obj,"ncrc");
-            if (val != NULL) {
-                txpkt.no_crc = (bool)json_value_get_boolean(val);
-            }
+                /* a single txpk for a board which is not configured, or without any timing, is not acknowledged */
+                if ((resp[nb_resp].is_array == false) && (dl_result[nb_dl] == JIT_ERROR_INVALID)) {
+                    continue;
+                }
 
-            /* parse target frequency (mandatory) */
-            val = json_object_get_value(txpk_obj,"freq");
-            if (val == NULL) {
-                MSG("WARNING: [down] no mandatory \"txpk.freq\" object in JSON, TX aborted\n");
-                json_value_free(root_val);
-                continue;
-            }
-            txpkt.freq_hz = (uint32_t)((double)(1.0e6) * json_value_get_number(val));
+                /* record measurement data */
+                meas_add(MEAS_DW_DGRAM_RCV, 1); /* count only datagrams with no JSON errors */
+                meas_add(MEAS_DW_NETWORK_BYTE, msg_len);
+                for (i = nb_dl; i < (nb_dl + nb_txpk); i++) {
+                    if (dl_result[i] != JIT_ERROR_INVALID) {
+                        meas_add(MEAS_DW_PAYLOAD_BYTE, dl_pkt[i].size);
+                    }
+                }
 
-            /* parse TX power (optional field) */
-            val = json_object_get_value(txpk_obj,"powe");
-            if (val != NULL) {
-                txpkt.rf_power = (int8_t)json_value_get_number(val) - antenna_gain;
+                resp[nb_resp].token_h = buff_down[1];
+                resp[nb_resp].token_l = buff_down[2];
+                resp[nb_resp].first = nb_dl;
+                resp[nb_resp].nb = nb_txpk;
+                nb_resp += 1;
+                nb_dl += nb_txpk;
             }
 
-            /* Parse Lora spreading-factor and modulation bandwidth (mandatory) */
-            str = json_object_get_string(txpk_obj, "datr");
-            if (str == NULL) {
-                MSG("WARNING: [down] no mandatory \"txpk.datr\" object in JSON, TX aborted\n");
-                json_value_free(root_val);
-                continue;
-            }
-            i = sscanf(str, "SF%2hdBW%4hd", &x0, &x1);
-            if (i != 2) {
-                MSG("WARNING: [down] format error in \"txpk.datr\", TX aborted\n");
-                json_value_free(root_val);
-                continue;
-            }
-            switch (x0) {
-                case  5: txpkt.datarate = DR_LORA_SF5;  break;
-                case  6: txpkt.datarate = DR_LORA_SF6;  break;
-                case  7: txpkt.datarate = DR_LORA_SF7;  break;
-                case  8: txpkt.datarate = DR_LORA_SF8;  break;
-                case  9: txpkt.datarate = DR_LORA_SF9;  break;
-                case 10: txpkt.datarate = DR_LORA_SF10; break;
-                case 11: txpkt.datarate = DR_LORA_SF11; break;
-                case 12: txpkt.datarate = DR_LORA_SF12; break;
-                default:
-                    MSG("WARNING: [down] format error in \"txpk.datr\", invalid SF, TX aborted\n");
-                    json_value_free(root_val);
+            /* insert the packets to be sent into the JIT queues, in the order they were received */
+            memset(time_sampled, 0, sizeof time_sampled);
+            for (i = 0; i < nb_dl; i++) {
+                if (dl_result[i] != JIT_ERROR_OK) {
                     continue;
-            }
-            switch (x1) {
-                case 812: txpkt.bandwidth = BW_800KHZ; break;
-                case 800: txpkt.bandwidth = BW_800KHZ; break;
-                default:
-                    MSG("WARNING: [down] format error in \"txpk.datr\", invalid BW, TX aborted\n");
-                    json_value_free(root_val);
+                }
+                brd = dl_brd[i];
+                if (time_sampled[brd->index] == false) {
+                    time_valid[brd->index] = (tx_time_sample(brd, &current_concentrator_time[brd->index]) == 0);
+                    time_sampled[brd->index] = true;
+                }
+                if (time_valid[brd->index] == false) {
+                    /* the time the downlink is due can not be checked, the server may retry it */
+                    dl_result[i] = JIT_ERROR_TOO_LATE;
+                    printf("ERROR: Packet REJECTED, concentrator time unknown\n");
                     continue;
-            }
-
-            /* Parse ECC coding rate (optional field) */
-            str = json_object_get_string(txpk_obj, "codr");
-            if (str == NULL) {
-                MSG("WARNING: [down] no mandatory \"txpk.codr\" object in json, TX aborted\n");
-                json_value_free(root_val);
-                continue;
-            }
-            if ((strcmp(str, "4/8LI") == 0) || (strcmp(str, "4/7LI") == 0)) {
-                txpkt.coderate = CR_LORA_LI_4_8;
-            } else {
-                MSG("WARNING: [down] format error in \"txpk.codr\", TX aborted\n");
-                json_value_free(root_val);
-                continue;
-            }
-
-            /* Parse signal polarity switch (optional field) */
-            val = json_object_get_value(txpk_obj,"ipol");
-            if (val != NULL) {
-                txpkt.invert_pol = (bool)json_value_get_boolean(val);
-            }
-
-            /* parse Lora preamble length (optional field, optimum min value enforced) */
-            val = json_object_get_value(txpk_obj,"prea");
-            if (val != NULL) {
-                i = (int)json_value_get_number(val);
-                if (i >= MIN_LORA_PREAMBLE) {
-                    txpkt.preamble = (uint16_t)i;
-                } else {
-                    txpkt.preamble = (uint16_t)MIN_LORA_PREAMBLE;
                 }
-            } else {
-                txpkt.preamble = (uint16_t)STD_LORA_PREAMBLE;
-            }
-
-            /* set the LoRa sync word */
-            txpkt.sync_word = lora_sync_word;
-
-            /* Parse payload length (mandatory) */
-            val = json_object_get_value(txpk_obj,"size");
-            if (val == NULL) {
-                MSG("WARNING: [down] no mandatory \"txpk.size\" object in JSON, TX aborted\n");
-                json_value_free(root_val);
-                continue;
-            }
-            txpkt.size = (uint16_t)json_value_get_number(val);
-
-            /* Parse payload data (mandatory) */
-            str = json_object_get_string(txpk_obj, "data");
-            if (str == NULL) {
-                MSG("WARNING: [down] no mandatory \"txpk.data\" object in JSON, TX aborted\n");
-                json_value_free(root_val);
-                continue;
-            }
-            i = b64_to_bin(str, strlen(str), txpkt.payload, sizeof txpkt.payload);
-            if (i != txpkt.size) {
-                MSG("WARNING: [down] mismatch between .size and .data size once converter to binary\n");
-            }
-
-            /* free the JSON parse tree from memory */
-            json_value_free(root_val);
-
-            /* select TX mode */
-            if (sent_immediate) {
-                txpkt.tx_mode = IMMEDIATE;
-            } else {
-                txpkt.tx_mode = TIMESTAMPED;
-            }
-
-            /* record measurement data */
-            pthread_mutex_lock(&mx_meas_dw);
-            meas_dw_dgram_rcv += 1; /* count only datagrams with no JSON errors */
-            meas_dw_network_byte += msg_len; /* meas_dw_network_byte */
-            meas_dw_payload_byte += txpkt.size;
-            pthread_mutex_unlock(&mx_meas_dw);
-
-            /* reset error/warning results */
-            jit_result = warning_result = JIT_ERROR_OK;
-            warning_value = 0;
-
-            /* check TX frequency before trying to queue packet */
-            if ((txpkt.freq_hz < tx_freq_min[0]) || (txpkt.freq_hz > tx_freq_max[0])) {
-                jit_result = JIT_ERROR_TX_FREQ;
-                MSG("ERROR: Packet REJECTED, unsupported frequency - %u (min:%u,max:%u)\n", txpkt.freq_hz, tx_freq_min[0], tx_freq_max[0]);
-            }
-
-            /* check TX power before trying to queue packet, send a warning if not supported */
-            if (jit_result == JIT_ERROR_OK) {
-                if ((txpkt.rf_power < TX_POWER_MIN) || (txpkt.rf_power > TX_POWER_MAX)) {
-                    /* this RF power is not supported, throw a warning, and use the closest lower power supported */
-                    warning_result = JIT_ERROR_TX_POWER;
-                    warning_value = (int32_t)TX_POWER_DEFAULT;
-                    printf("WARNING: Requested TX power is not supported (%ddBm), actual power used: %ddBm\n", txpkt.rf_power, warning_value);
-                    txpkt.rf_power = TX_POWER_DEFAULT;
+                dl_result[i] = jit_enqueue_radio(brd, current_concentrator_time[brd->index], &dl_pkt[i], dl_type[i]);
+                if (dl_pkt[i].tx_mode == TIMESTAMPED) {
+                    lat_record_cnt(LAT_DW_LEAD, current_concentrator_time[brd->index], dl_pkt[i].count_us);
                 }
-            }
-
-            /* insert packet to be sent into JIT queue */
-            if (jit_result == JIT_ERROR_OK) {
-                pthread_mutex_lock(&mx_concent);
-                lgw_get_instcnt(&current_concentrator_time);
-                pthread_mutex_unlock(&mx_concent);
-                jit_result = jit_enqueue(&jit_queue[0], current_concentrator_time, &txpkt, downlink_type);
-                if (jit_result != JIT_ERROR_OK) {
-                    printf("ERROR: Packet REJECTED (jit error=%d)\n", jit_result);
+                if (dl_result[i] != JIT_ERROR_OK) {
+                    printf("ERROR: Packet REJECTED (jit error=%d)\n", dl_result[i]);
                 } else {
+                    lgw_hist_record(&lat_hist[LAT_DW_QUEUE], (uint32_t)(monotonic_us() - recv_us));
                     /* In case of a warning having been raised before, we notify it */
-                    jit_result = warning_result;
+                    dl_result[i] = dl_warning[i];
                 }
-                pthread_mutex_lock(&mx_meas_dw);
-                meas_nb_tx_requested += 1;
-                pthread_mutex_unlock(&mx_meas_dw);
+                meas_add(MEAS_NB_TX_REQUESTED, 1);
             }
 
-            /* Send acknoledge datagram to server */
-            send_tx_ack(buff_down[1], buff_down[2], jit_result, warning_value);
+            /* Send acknoledge datagrams to server */
+            for (j = 0; j < nb_resp; j++) {
+                iov_ack[j].iov_len = tx_ack_build(buff_ack[j], &resp[j], &dl_result[resp[j].first], &dl_value[resp[j].first]);
+            }
+            for (j = 0; j < nb_resp; j += i) {
+                i = sendmmsg(sock_down, &msg_ack[j], nb_resp - j, 0);
+                if (i <= 0) {
+                    MSG("WARNING: [down] %d TX_ACK not sent, sendmmsg returned %s\n", nb_resp - j, strerror(errno));
+                    break;
+                }
+            }
         }
     }
     MSG("\nINFO: End of downstream thread\n");
@@ -1820,7 +2503,8 @@ void print_tx_status(uint8_t tx_status) {
 /* -------------------------------------------------------------------------- */
 /* --- THREAD 3: CHECKING PACKETS TO BE SENT FROM JIT QUEUE AND SEND THEM --- */
 
-void thread_jit(void) {
+void * thread_jit(void * arg) {
+    struct board_s *brd = (struct board_s *)arg;
     int result = LGW_HAL_SUCCESS;
     struct lgw_pkt_tx_s pkt;
     int pkt_index = -1;
@@ -1828,31 +2512,51 @@ void thread_jit(void) {
     enum jit_error_e jit_result;
     enum jit_pkt_type_e pkt_type;
     e_status tx_status;
+    int32_t late_us;
     int i;
 
     while (!exit_sig && !quit_sig) {
-        wait_ms(10);
+        /* report completed downlinks, only accesses the concentrator once a TX is expected to be done */
+        result = lgw_ctx_status(brd->ctx, TX_STATUS, &tx_status);
+        if (result == LGW_HAL_ERROR) {
+            MSG("WARNING: [jit] lgw_status failed\n");
+            tx_status = TX_STATUS_UNKNOWN;
+        }
+
+        /* sleep until a packet is due, a new packet is first in queue, or the pending TX has to be polled */
+        if (tx_time_sample(brd, &current_concentrator_time) != 0) {
+            wait_ms(JIT_TX_POLL_US / 1000);
+            continue;
+        }
+        late_us = jit_wait(brd->jit_queue, LGW_TX_CHANNEL_NB_MAX, current_concentrator_time, (tx_status == TX_FREE) ? JIT_IDLE_WAIT_US : JIT_TX_POLL_US);
+
+        /* watchdog of the scheduling of the thread, a late wakeup eats into the margin of the downlink due */
+        if (late_us >= 0) {
+            lgw_hist_record(&lat_hist[LAT_JIT_WAKE], (uint32_t)late_us);
+            if (late_us > JIT_LATE_US) {
+                meas_add(MEAS_JIT_LATE, 1);
+            }
+        }
 
         for (i = 0; i < LGW_TX_CHANNEL_NB_MAX; i++) {
             /* transfer data and metadata to the concentrator, and schedule TX */
-            pthread_mutex_lock(&mx_concent);
-            lgw_get_instcnt(&current_concentrator_time);
-            pthread_mutex_unlock(&mx_concent);
-            jit_result = jit_peek(&jit_queue[i], current_concentrator_time, &pkt_index);
+            if (tx_time_sample(brd, &current_concentrator_time) != 0) {
+                continue; /* packets are peeked again after the next wait */
+            }
+            jit_result = jit_peek(&brd->jit_queue[i], current_concentrator_time, &pkt_index);
             if (jit_result == JIT_ERROR_OK) {
                 if (pkt_index > -1) {
-                    jit_result = jit_dequeue(&jit_queue[i], pkt_index, &pkt, &pkt_type);
+                    jit_result = jit_dequeue(&brd->jit_queue[i], pkt_index, &pkt, &pkt_type);
                     if (jit_result == JIT_ERROR_OK) {
-                        /* check if concentrator is free for sending new packet */
-                        pthread_mutex_lock(&mx_concent); /* may have to wait for a fetch to finish */
-                        result = lgw_status(TX_STATUS, &tx_status);
-                        pthread_mutex_unlock(&mx_concent); /* free concentrator ASAP */
+                        /* check if concentrator is free for sending new packet (tracked by the HAL, no round trip) */
+                        result = lgw_ctx_status(brd->ctx, TX_STATUS, &tx_status);
                         if (result == LGW_HAL_ERROR) {
                             MSG("WARNING: [jit%d] lgw_status failed\n", i);
                         } else {
                             if (tx_status == TX_EMITTING) {
                                 MSG("ERROR: concentrator is currently emitting on rf_chain %d\n", i);
                                 print_tx_status(tx_status);
+                                jit_dropped(&pkt, pkt_type, brd);
                                 continue;
                             } else if (tx_status == TX_SCHEDULED) {
                                 MSG("WARNING: a downlink was already scheduled on rf_chain %d, overwritting it...\n", i);
@@ -1862,24 +2566,24 @@ void thread_jit(void) {
                             }
                         }
 
-                        /* send packet to concentrator */
-                        pthread_mutex_lock(&mx_concent); /* may have to wait for a fetch to finish */
-                        result = lgw_send(&pkt);
-                        pthread_mutex_unlock(&mx_concent); /* free concentrator ASAP */
+                        /* send packet to concentrator, the TX done report is expected after that time */
+                        if (pkt.tx_mode == TIMESTAMPED) {
+                            lat_record_cnt(LAT_DW_MARGIN, current_concentrator_time, pkt.count_us);
+                        }
+                        brd->tx_send_us = monotonic_us();
+                        result = lgw_ctx_send(brd->ctx, &pkt);
                         if (result == LGW_HAL_ERROR) {
-                            pthread_mutex_lock(&mx_meas_dw);
-                            meas_nb_tx_fail += 1;
-                            pthread_mutex_unlock(&mx_meas_dw);
+                            meas_add(MEAS_NB_TX_FAIL, 1);
                             MSG("WARNING: [jit] lgw_send failed on rf_chain %d\n", i);
+                            jit_dropped(&pkt, pkt_type, brd);
                             continue;
                         } else {
-                            pthread_mutex_lock(&mx_meas_dw);
-                            meas_nb_tx_ok += 1;
-                            pthread_mutex_unlock(&mx_meas_dw);
+                            airtime_sent(&brd->airtime, monotonic_ms(), pkt.rf_chain, pkt.freq_hz, lgw_time_on_air_us(&pkt));
+                            /* MEAS_NB_TX_OK is counted by tx_done() once the packet is on air */
                             MSG_DEBUG(DEBUG_PKT_FWD, "lgw_send done on rf_chain %d: count_us=%u\n", i, pkt.count_us);
 
                             /* debug log */
-                            nb_pkt_sent += 1;
+                            __atomic_fetch_add(&nb_pkt_sent, 1, __ATOMIC_RELAXED); /* one JiT thread per board */
                             print_nb_pkt_stats();
                         }
                     } else {
@@ -1894,6 +2598,68 @@ void thread_jit(void) {
         }
     }
     MSG("\nINFO: End of jit thread\n");
+    return NULL;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- THREAD 4: RECEIVING PUSH_ACK AND MATCHING THEM WITH PUSH_DATA -------- */
+
+void thread_up_ack(void) {
+    int i, j; /* loop variables */
+    uint8_t buff_ack[32]; /* buffer to receive acknowledges */
+    uint16_t token;
+    bool matched;
+    uint32_t rtt_ms = 0;
+
+    /* ping measurement variables */
+    struct timespec recv_time;
+
+    /* set upstream socket RX timeout, to check regularly for PUSH_DATA time-out */
+    i = setsockopt(sock_up, SOL_SOCKET, SO_RCVTIMEO, (void *)&push_timeout_half, sizeof push_timeout_half);
+    if (i != 0) {
+        MSG("ERROR: [up] setsockopt returned %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    while (!exit_sig && !quit_sig) {
+        j = recv(sock_up, (void *)buff_ack, sizeof buff_ack, 0);
+        clock_gettime(CLOCK_MONOTONIC, &recv_time);
+
+        /* match the acknowledge with its datagram */
+        if (j == -1) {
+            if ((errno != EAGAIN) && (errno != EINTR)) { /* server connection error */
+                wait_ms(push_timeout_half.tv_usec / 1000);
+            }
+        } else if ((j < 4) || (buff_ack[0] != protocol_version) || (buff_ack[3] != PKT_PUSH_ACK)) {
+            //MSG("WARNING: [up] ignored invalid non-ACL packet\n");
+        } else {
+            token = ((uint16_t)buff_ack[1] << 8) | buff_ack[2];
+            matched = false;
+            pthread_mutex_lock(&mx_push_ack);
+            for (i = 0; i < PUSH_ACK_TABLE_SIZE; i++) {
+                if (push_ack_table[i].pending && (push_ack_table[i].token == token)) {
+                    push_ack_table[i].pending = false;
+                    rtt_ms = (uint32_t)(1000 * difftimespec(recv_time, push_ack_table[i].send_time));
+                    matched = true;
+                    break;
+                }
+            }
+            pthread_mutex_unlock(&mx_push_ack);
+            if (matched == true) {
+                MSG("INFO: [up] PUSH_ACK received in %u ms\n", rtt_ms);
+                meas_add(MEAS_UP_ACK_RCV, 1);
+                meas_add(MEAS_UP_ACK_RTT_SUM, rtt_ms);
+                meas_peak(MEAS_UP_ACK_RTT_MIN, rtt_ms);
+                meas_peak(MEAS_UP_ACK_RTT_MAX, rtt_ms);
+            } else {
+                //MSG("WARNING: [up] ignored out-of sync ACK packet\n");
+            }
+        }
+
+        /* datagrams not acknowledged in time are lost */
+        push_ack_expire(recv_time);
+    }
+    MSG("\nINFO: End of upstream acknowledge thread\n");
 }
 
 /* --- EOF ------------------------------------------------------------------ */
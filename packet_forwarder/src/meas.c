@@ -0,0 +1,109 @@
+/*!
+ * \brief     LoRa 2.4Ghz concentrator : lock-free statistics counters
+ *
+ * License: Revised BSD 3-Clause License, see LICENSE.TXT file include in the project
+ */
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stddef.h>     /* NULL */
+
+#include "meas.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+/* One set per thread, the last one is shared by the threads beyond MEAS_NB_SLOT */
+static struct meas_set_s meas_set[MEAS_NB_SLOT + 1];
+static uint32_t meas_nb_used = 0;
+
+static __thread struct meas_set_s * meas_own = NULL; /* set of the calling thread */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static uint32_t peak_reset(enum meas_peak_e id) {
+    return (id == MEAS_UP_ACK_RTT_MIN) ? UINT32_MAX : 0;
+}
+
+static struct meas_set_s * own_set(void) {
+    uint32_t i;
+
+    if (meas_own == NULL) {
+        i = __atomic_fetch_add(&meas_nb_used, 1, __ATOMIC_RELAXED);
+        meas_own = &meas_set[(i < MEAS_NB_SLOT) ? i : MEAS_NB_SLOT];
+    }
+    return meas_own;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+void meas_init(void) {
+    int i, j;
+
+    for (i = 0; i <= MEAS_NB_SLOT; i++) {
+        for (j = 0; j < MEAS_NB; j++) {
+            meas_set[i].cnt[j] = 0;
+        }
+        for (j = 0; j < MEAS_NB_PEAK; j++) {
+            meas_set[i].peak[j] = peak_reset(j);
+        }
+    }
+    meas_nb_used = 0;
+}
+
+void meas_add(enum meas_e id, uint64_t n) {
+    struct meas_set_s *set = own_set();
+
+    if (set == &meas_set[MEAS_NB_SLOT]) {
+        __atomic_fetch_add(&set->cnt[id], n, __ATOMIC_RELAXED);
+    } else {
+        /* single writer, a plain increment stored atomically for the collector */
+        __atomic_store_n(&set->cnt[id], set->cnt[id] + n, __ATOMIC_RELAXED);
+    }
+}
+
+void meas_peak(enum meas_peak_e id, uint32_t value) {
+    struct meas_set_s *set = own_set();
+    uint32_t x = __atomic_load_n(&set->peak[id], __ATOMIC_RELAXED);
+    bool is_min = (id == MEAS_UP_ACK_RTT_MIN);
+
+    /* the collector resets the value concurrently, hence the compare and swap */
+    while ((is_min ? (value < x) : (value > x)) && !__atomic_compare_exchange_n(&set->peak[id], &x, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        /* x reloaded by the failed exchange */
+    }
+}
+
+void meas_collect(uint64_t cnt[MEAS_NB], uint32_t peak[MEAS_NB_PEAK]) {
+    uint32_t nb_set;
+    uint32_t x;
+    uint32_t i;
+    int j;
+
+    nb_set = __atomic_load_n(&meas_nb_used, __ATOMIC_RELAXED);
+    nb_set = (nb_set < MEAS_NB_SLOT) ? nb_set : MEAS_NB_SLOT;
+    for (j = 0; j < MEAS_NB; j++) {
+        cnt[j] = __atomic_load_n(&meas_set[MEAS_NB_SLOT].cnt[j], __ATOMIC_RELAXED);
+        for (i = 0; i < nb_set; i++) {
+            cnt[j] += __atomic_load_n(&meas_set[i].cnt[j], __ATOMIC_RELAXED);
+        }
+    }
+    if (peak == NULL) {
+        return;
+    }
+    for (j = 0; j < MEAS_NB_PEAK; j++) {
+        peak[j] = peak_reset(j);
+        for (i = 0; i <= MEAS_NB_SLOT; i++) {
+            x = __atomic_exchange_n(&meas_set[i].peak[j], peak_reset(j), __ATOMIC_RELAXED);
+            if ((j == MEAS_UP_ACK_RTT_MIN) ? (x < peak[j]) : (x > peak[j])) {
+                peak[j] = x;
+            }
+        }
+    }
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,244 @@
+/*!
+ * \brief     LoRa 2.4Ghz concentrator : JSON serialization of received packets
+ *
+ * License: Revised BSD 3-Clause License, see LICENSE.TXT file include in the project
+ */
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <string.h>     /* memcpy */
+#include <math.h>       /* rint, lroundf, fabsf, signbit */
+
+#include "rxpk.h"
+#include "base64.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#define ARRAY_SIZE(a)   (sizeof(a) / sizeof((a)[0]))
+
+/* Append a string literal to the buffer */
+#define PUT_STR(p, s)   do { memcpy((p), (s), sizeof(s) - 1); (p) += sizeof(s) - 1; } while (0)
+
+/* Modulation, datarate and coderate fields of a LoRa packet */
+#define LORA_FRAG(sf, bw, cr)   { ",\"modu\":\"LORA\",\"datr\":\"SF" #sf "BW" #bw "\",\"codr\":\"" cr "\"", \
+                                  sizeof(",\"modu\":\"LORA\",\"datr\":\"SF" #sf "BW" #bw "\",\"codr\":\"" cr "\"") - 1 }
+
+#define LORA_FRAGS(bw, cr)      { LORA_FRAG(5, bw, cr), LORA_FRAG(6, bw, cr), LORA_FRAG(7, bw, cr), LORA_FRAG(8, bw, cr), \
+                                  LORA_FRAG(9, bw, cr), LORA_FRAG(10, bw, cr), LORA_FRAG(11, bw, cr), LORA_FRAG(12, bw, cr) }
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS & TYPES -------------------------------------------- */
+
+struct rxpk_frag_s {
+    const char *str;
+    int len;
+};
+
+/* Constant fragments, for each Spreading Factor of each (bandwidth, coderate) supported */
+static const struct {
+    uint8_t bandwidth;
+    uint8_t coderate;
+    struct rxpk_frag_s sf[DR_LORA_SF12 - DR_LORA_SF5 + 1];
+} lora_frags[] = {
+    { BW_800KHZ, CR_LORA_LI_4_8, LORA_FRAGS(812, "4/8LI") }
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* Write an unsigned integer in decimal, return the number of characters */
+static int put_uint(char *buf, uint32_t x) {
+    char tmp[10];
+    int n = 0;
+    int i;
+
+    do {
+        tmp[n++] = (char)('0' + (x % 10));
+        x /= 10;
+    } while (x != 0);
+    for (i = 0; i < n; i++) {
+        buf[i] = tmp[n - 1 - i];
+    }
+    return n;
+}
+
+/* Write a signed integer in decimal, return the number of characters */
+static int put_int(char *buf, int32_t x) {
+    if (x < 0) {
+        buf[0] = '-';
+        return 1 + put_uint(buf + 1, (uint32_t)0 - (uint32_t)x);
+    }
+    return put_uint(buf, (uint32_t)x);
+}
+
+/* Write a frequency in Hz as MHz with 6 decimals, like "%.6lf" */
+static int put_freq(char *buf, uint32_t freq_hz) {
+    uint32_t frac = freq_hz % 1000000;
+    int n, i;
+
+    n = put_uint(buf, freq_hz / 1000000);
+    buf[n++] = '.';
+    for (i = 5; i >= 0; i--) {
+        buf[n + i] = (char)('0' + (frac % 10));
+        frac /= 10;
+    }
+    return n + 6;
+}
+
+/* Write a value with 1 decimal, like "%.1f" */
+static int put_float_1(char *buf, float x) {
+    /* rint rounds ties to even, as printf, the product is exact in double */
+    int32_t tenths = (int32_t)rint((double)x * 10.0);
+    uint32_t mag;
+    int n = 0;
+
+    if (signbit(x)) {
+        buf[n++] = '-';
+        mag = (uint32_t)0 - (uint32_t)tenths;
+    } else {
+        mag = (uint32_t)tenths;
+    }
+    n += put_uint(buf + n, mag / 10);
+    buf[n++] = '.';
+    buf[n++] = (char)('0' + (mag % 10));
+    return n;
+}
+
+/* Write a value rounded to an integer, like "%.0f" of roundf() */
+static int put_float_0(char *buf, float x) {
+    int32_t r = (int32_t)lroundf(x);
+
+    if ((r == 0) && signbit(x)) {
+        buf[0] = '-'; /* negative zero */
+        buf[1] = '0';
+        return 2;
+    }
+    return put_int(buf, r);
+}
+
+static const struct rxpk_frag_s * get_lora_frag(const struct lgw_pkt_rx_ref_s *pkt) {
+    unsigned i;
+
+    if ((pkt->datarate < DR_LORA_SF5) || (pkt->datarate > DR_LORA_SF12)) {
+        return NULL;
+    }
+    for (i = 0; i < ARRAY_SIZE(lora_frags); i++) {
+        if ((lora_frags[i].bandwidth == pkt->bandwidth) && (lora_frags[i].coderate == pkt->coderate)) {
+            return &lora_frags[i].sf[pkt->datarate - DR_LORA_SF5];
+        }
+    }
+    return NULL;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ----------------------------------------- */
+
+int rxpk_serialize(const struct lgw_pkt_rx_ref_s *pkt, char *buf, int buf_size) {
+    return rxpk_serialize_brd(pkt, -1, buf, buf_size);
+}
+
+int rxpk_serialize_brd(const struct lgw_pkt_rx_ref_s *pkt, int brd, char *buf, int buf_size) {
+    const struct rxpk_frag_s *frag;
+    char *p = buf;
+    int j;
+
+    if ((pkt == NULL) || (buf == NULL) || (buf_size < RXPK_SIZE_MAX(pkt->size))) {
+        return -1;
+    }
+    if ((pkt->modulation != MOD_LORA) || (brd > UINT8_MAX)) {
+        return -1;
+    }
+    frag = get_lora_frag(pkt);
+    if (frag == NULL) {
+        return -1;
+    }
+    if (!(fabsf(pkt->snr) < 1000.0) || !(fabsf(pkt->rssi) < 1000.0)) {
+        return -1; /* out of any radio range, would not fit in RXPK_META_SIZE_MAX */
+    }
+
+    /* JSON rxpk frame format version, RAW timestamp */
+    PUT_STR(p, "{\"jver\":");
+    p += put_uint(p, RXPK_FRAME_FORMAT);
+    PUT_STR(p, ",\"tmst\":");
+    p += put_uint(p, pkt->count_us);
+
+    /* Packet concentrator channel & RX frequency */
+    PUT_STR(p, ",\"chan\":");
+    p += put_uint(p, pkt->channel);
+    if (brd >= 0) {
+        PUT_STR(p, ",\"brd\":");
+        p += put_uint(p, (uint32_t)brd);
+    }
+    PUT_STR(p, ",\"freq\":");
+    p += put_freq(p, pkt->freq_hz);
+    PUT_STR(p, ",\"foff\":");
+    p += put_int(p, pkt->foff_hz);
+
+    /* Packet status */
+    switch (pkt->status) {
+        case STAT_CRC_OK:   PUT_STR(p, ",\"stat\":1"); break;
+        case STAT_CRC_BAD:  PUT_STR(p, ",\"stat\":-1"); break;
+        case STAT_NO_CRC:   PUT_STR(p, ",\"stat\":0"); break;
+        default:            return -1;
+    }
+
+    /* Packet modulation, datarate & bandwidth, coderate */
+    memcpy(p, frag->str, frag->len);
+    p += frag->len;
+
+    /* Lora SNR, channel RSSI, payload size */
+    PUT_STR(p, ",\"lsnr\":");
+    p += put_float_1(p, pkt->snr);
+    PUT_STR(p, ",\"rssi\":");
+    p += put_float_0(p, pkt->rssi);
+    PUT_STR(p, ",\"size\":");
+    p += put_uint(p, pkt->size);
+
+    /* Packet base64-encoded payload */
+    PUT_STR(p, ",\"data\":\"");
+    j = bin_to_b64(pkt->payload, pkt->size, p, buf_size - (int)(p - buf));
+    if (j < 0) {
+        return -1;
+    }
+    p += j;
+    PUT_STR(p, "\"}");
+
+    return (int)(p - buf);
+}
+
+int rxpk_serialize_batch(const struct lgw_pkt_rx_ref_s * const pkt[], int nb_pkt, char *buf, int buf_size) {
+    return rxpk_serialize_batch_brd(pkt, NULL, nb_pkt, buf, buf_size);
+}
+
+int rxpk_serialize_batch_brd(const struct lgw_pkt_rx_ref_s * const pkt[], const uint8_t brd[], int nb_pkt, char *buf, int buf_size) {
+    int i, j;
+    int n = 0;
+
+    for (i = 0; i < nb_pkt; i++) {
+        if (i > 0) {
+            if (n >= buf_size) {
+                return -1;
+            }
+            buf[n++] = ',';
+        }
+        j = rxpk_serialize_brd(pkt[i], (brd != NULL) ? brd[i] : -1, buf + n, buf_size - n);
+        if (j < 0) {
+            return -1;
+        }
+        n += j;
+    }
+
+    return n;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
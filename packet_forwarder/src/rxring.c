@@ -0,0 +1,92 @@
+/*!
+ * \brief     LoRa 2.4Ghz concentrator : lock-free queue of received packets
+ *
+ * License: Revised BSD 3-Clause License, see LICENSE.TXT file include in the project
+ */
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdio.h>      /* printf, fprintf, snprintf, fopen, fputs */
+#include <string.h>     /* memset */
+
+#include "trace.h"
+#include "rxring.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#define RX_RING_INDEX(cnt)  ((cnt) & (RX_RING_SIZE - 1))
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS & TYPES -------------------------------------------- */
+
+#if (RX_RING_SIZE & (RX_RING_SIZE - 1)) != 0
+    #error "RX_RING_SIZE must be a power of 2"
+#endif
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ----------------------------------------- */
+
+void rx_ring_init(struct rx_ring_s *ring) {
+    memset(ring, 0, sizeof(*ring));
+}
+
+struct lgw_pkt_rx_ref_s * rx_ring_reserve(struct rx_ring_s *ring) {
+    uint32_t tail;
+    uint32_t nb_pkt;
+
+    /* The consumer releases slots by moving the tail, acquire to see them free */
+    tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    nb_pkt = ring->head - tail;
+    if (nb_pkt >= RX_RING_SIZE) {
+        __atomic_fetch_add(&ring->nb_drop, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    /* Keep track of the highest filling, to size the ring */
+    if ((nb_pkt + 1) > __atomic_load_n(&ring->nb_max, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&ring->nb_max, nb_pkt + 1, __ATOMIC_RELAXED);
+    }
+
+    return &ring->pkt[RX_RING_INDEX(ring->head)];
+}
+
+void rx_ring_commit(struct rx_ring_s *ring, uint64_t time_us) {
+    ring->time_us[RX_RING_INDEX(ring->head)] = time_us;
+
+    /* Release so that the consumer sees the packet content before the new head */
+    __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+
+uint32_t rx_ring_count(struct rx_ring_s *ring) {
+    return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - ring->tail;
+}
+
+struct lgw_pkt_rx_ref_s * rx_ring_peek(struct rx_ring_s *ring, uint32_t index) {
+    return &ring->pkt[RX_RING_INDEX(ring->tail + index)];
+}
+
+uint64_t rx_ring_time(struct rx_ring_s *ring, uint32_t index) {
+    return ring->time_us[RX_RING_INDEX(ring->tail + index)];
+}
+
+void rx_ring_pop(struct rx_ring_s *ring, uint32_t nb_pkt) {
+    /* Release so that the producer only reuses the slots once they have been read */
+    __atomic_store_n(&ring->tail, ring->tail + nb_pkt, __ATOMIC_RELEASE);
+}
+
+void rx_ring_get_stats(struct rx_ring_s *ring, uint32_t *nb_drop, uint32_t *nb_max) {
+    uint32_t x;
+
+    x = __atomic_exchange_n(&ring->nb_drop, 0, __ATOMIC_RELAXED);
+    if (nb_drop != NULL) {
+        *nb_drop = x;
+    }
+    x = __atomic_exchange_n(&ring->nb_max, 0, __ATOMIC_RELAXED);
+    if (nb_max != NULL) {
+        *nb_max = x;
+    }
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,675 @@
+/*!
+ * \brief     LoRa 2.4Ghz concentrator : JSON parsing of packets to be sent
+ *
+ * License: Revised BSD 3-Clause License, see LICENSE.TXT file include in the project
+ */
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdlib.h>     /* strtod */
+#include <string.h>     /* memset, memcmp */
+
+#include "txpk.h"
+#include "base64.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#define KEY_IS(key, len, lit)   (((len) == (int)sizeof(lit) - 1) && (memcmp((key), (lit), (len)) == 0))
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS & TYPES -------------------------------------------- */
+
+#define JSON_DEPTH_MAX  32  /* Maximum nesting of the skipped values */
+#define STR_SIZE_MAX    16  /* Maximum size of the short string fields (datr, codr) */
+#define DATA_SIZE_MAX   (4 * ((sizeof ((struct lgw_pkt_tx_s *)0)->payload + 2) / 3)) /* base64 size of the biggest payload */
+
+/* Packets decoded from the "txpk" object or array of a PULL_RESP */
+struct txpk_batch_s {
+    struct lgw_pkt_tx_s *pkt;   /* Packets array */
+    struct txpk_info_s *info;   /* Info of each packet */
+    enum txpk_error_e *err;     /* Parsing result of each packet */
+    int size;                   /* Number of elements of the arrays */
+    int nb;                     /* Number of txpk objects found */
+    bool is_array;              /* True if "txpk" is an array */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* Skip white spaces and comments */
+static void skip_ws(const char **s) {
+    const char *p = *s;
+
+    while (true) {
+        if ((*p == ' ') || (*p == '\t') || (*p == '\r') || (*p == '\n')) {
+            p++;
+        } else if ((p[0] == '/') && (p[1] == '*')) {
+            p += 2;
+            while ((*p != '\0') && !((p[0] == '*') && (p[1] == '/'))) {
+                p++;
+            }
+            if (*p != '\0') {
+                p += 2;
+            }
+        } else if ((p[0] == '/') && (p[1] == '/')) {
+            while ((*p != '\0') && (*p != '\n')) {
+                p++;
+            }
+        } else {
+            break;
+        }
+    }
+    *s = p;
+}
+
+/* Get a string, without unescaping it */
+static bool get_string(const char **s, const char **str, int *len) {
+    const char *p = *s;
+
+    if (*p != '"') {
+        return false;
+    }
+    p++;
+    *str = p;
+    while (*p != '"') {
+        if (*p == '\0') {
+            return false;
+        }
+        if (*p == '\\') {
+            p++;
+            if (*p == '\0') {
+                return false;
+            }
+        }
+        p++;
+    }
+    *len = (int)(p - *str);
+    *s = p + 1;
+    return true;
+}
+
+static int hex_digit(char c) {
+    if ((c >= '0') && (c <= '9')) {
+        return c - '0';
+    } else if ((c >= 'a') && (c <= 'f')) {
+        return c - 'a' + 10;
+    } else if ((c >= 'A') && (c <= 'F')) {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+/* Unescape an ASCII string got with get_string, return its length or -1 on error */
+static int unescape(const char *str, int len, char *out, int out_size) {
+    int i, k;
+    int n = 0;
+    int d, u;
+
+    for (i = 0; i < len; i++) {
+        if (n >= out_size) {
+            return -1;
+        }
+        if (str[i] != '\\') {
+            out[n++] = str[i];
+            continue;
+        }
+        i++; /* get_string checked that an escape is followed by a char */
+        switch (str[i]) {
+            case '"':  out[n++] = '"'; break;
+            case '\\': out[n++] = '\\'; break;
+            case '/':  out[n++] = '/'; break;
+            case 'b':  out[n++] = '\b'; break;
+            case 'f':  out[n++] = '\f'; break;
+            case 'n':  out[n++] = '\n'; break;
+            case 'r':  out[n++] = '\r'; break;
+            case 't':  out[n++] = '\t'; break;
+            case 'u':
+                /* only ASCII is useful in the txpk fields */
+                if ((i + 4) >= len) {
+                    return -1;
+                }
+                for (k = 1, u = 0; k <= 4; k++) {
+                    d = hex_digit(str[i + k]);
+                    if (d < 0) {
+                        return -1;
+                    }
+                    u = (u << 4) | d;
+                }
+                if (u >= 0x80) {
+                    return -1;
+                }
+                out[n++] = (char)u;
+                i += 4;
+                break;
+            default:
+                return -1;
+        }
+    }
+    return n;
+}
+
+static bool get_number(const char **s, double *x) {
+    char *end;
+
+    /* strtod also accepts hexadecimal, infinity and NaN, which are not JSON */
+    if ((**s != '-') && ((**s < '0') || (**s > '9'))) {
+        return false;
+    }
+    *x = strtod(*s, &end);
+    if (end == *s) {
+        return false;
+    }
+    *s = end;
+    return true;
+}
+
+static bool get_bool(const char **s, bool *b) {
+    if (strncmp(*s, "true", 4) == 0) {
+        *b = true;
+        *s += 4;
+        return true;
+    }
+    if (strncmp(*s, "false", 5) == 0) {
+        *b = false;
+        *s += 5;
+        return true;
+    }
+    return false;
+}
+
+static bool skip_value(const char **s, int depth) {
+    const char *str;
+    int len;
+    double x;
+    bool b;
+    char close;
+
+    if (depth > JSON_DEPTH_MAX) {
+        return false;
+    }
+    switch (**s) {
+        case '"':
+            return get_string(s, &str, &len);
+        case 't':
+        case 'f':
+            return get_bool(s, &b);
+        case 'n':
+            if (strncmp(*s, "null", 4) != 0) {
+                return false;
+            }
+            *s += 4;
+            return true;
+        case '{':
+        case '[':
+            close = (**s == '{') ? '}' : ']';
+            (*s)++;
+            skip_ws(s);
+            if (**s == close) {
+                (*s)++;
+                return true;
+            }
+            while (true) {
+                if (close == '}') {
+                    if (!get_string(s, &str, &len)) {
+                        return false;
+                    }
+                    skip_ws(s);
+                    if (**s != ':') {
+                        return false;
+                    }
+                    (*s)++;
+                    skip_ws(s);
+                }
+                if (!skip_value(s, depth + 1)) {
+                    return false;
+                }
+                skip_ws(s);
+                if (**s == close) {
+                    (*s)++;
+                    return true;
+                }
+                if (**s != ',') {
+                    return false;
+                }
+                (*s)++;
+                skip_ws(s);
+            }
+        default:
+            return get_number(s, &x);
+    }
+}
+
+/* Parse "SFxxBWyyyy" */
+static enum txpk_error_e parse_datr(const char *str, int len, struct lgw_pkt_tx_s *pkt) {
+    int i = 0;
+    int sf = 0;
+    int bw = 0;
+    int n;
+
+    if ((len < 2) || (str[0] != 'S') || (str[1] != 'F')) {
+        return TXPK_ERROR_FORMAT;
+    }
+    for (i = 2, n = 0; (i < len) && (n < 2) && (str[i] >= '0') && (str[i] <= '9'); i++, n++) {
+        sf = (sf * 10) + (str[i] - '0');
+    }
+    if ((n == 0) || ((i + 2) > len) || (str[i] != 'B') || (str[i + 1] != 'W')) {
+        return TXPK_ERROR_FORMAT;
+    }
+    for (i += 2, n = 0; (i < len) && (n < 4) && (str[i] >= '0') && (str[i] <= '9'); i++, n++) {
+        bw = (bw * 10) + (str[i] - '0');
+    }
+    if (n == 0) {
+        return TXPK_ERROR_FORMAT;
+    }
+
+    if ((sf < DR_LORA_SF5) || (sf > DR_LORA_SF12)) {
+        return TXPK_ERROR_FORMAT;
+    }
+    pkt->datarate = (uint32_t)sf;
+    switch (bw) {
+        case 812: pkt->bandwidth = BW_800KHZ; break;
+        case 800: pkt->bandwidth = BW_800KHZ; break;
+        default: return TXPK_ERROR_FORMAT;
+    }
+    return TXPK_OK;
+}
+
+static bool is_b64_char(char c) {
+    return (((c >= 'A') && (c <= 'Z')) || ((c >= 'a') && (c <= 'z')) || ((c >= '0') && (c <= '9')) ||
+            (c == '+') || (c == '/') || (c == '='));
+}
+
+/* Parse one member of the txpk object */
+static enum txpk_error_e parse_member(const char *key, int key_len, const char **s, struct lgw_pkt_tx_s *pkt, struct txpk_info_s *info) {
+    const char *str;
+    int len;
+    double x;
+    bool b;
+    int i;
+    char buf[STR_SIZE_MAX];
+    char data[DATA_SIZE_MAX];
+
+    if (KEY_IS(key, key_len, "imme")) {
+        /* anything but true is not immediate */
+        if (get_bool(s, &b)) {
+            info->imme = b;
+            info->fields |= TXPK_FIELD_IMME;
+            return TXPK_OK;
+        }
+        return skip_value(s, 0) ? TXPK_OK : TXPK_ERROR_JSON;
+    }
+    if (KEY_IS(key, key_len, "tmst")) {
+        info->field = "tmst";
+        if (!get_number(s, &x)) {
+            return TXPK_ERROR_FORMAT;
+        }
+        pkt->count_us = (uint32_t)x;
+        info->fields |= TXPK_FIELD_TMST;
+        return TXPK_OK;
+    }
+    if (KEY_IS(key, key_len, "ncrc")) {
+        info->field = "ncrc";
+        if (!get_bool(s, &b)) {
+            return TXPK_ERROR_FORMAT;
+        }
+        pkt->no_crc = b;
+        info->fields |= TXPK_FIELD_NCRC;
+        return TXPK_OK;
+    }
+    if (KEY_IS(key, key_len, "freq")) {
+        info->field = "freq";
+        if (!get_number(s, &x)) {
+            return TXPK_ERROR_FORMAT;
+        }
+        pkt->freq_hz = (uint32_t)((double)(1.0e6) * x);
+        info->fields |= TXPK_FIELD_FREQ;
+        return TXPK_OK;
+    }
+    if (KEY_IS(key, key_len, "powe")) {
+        info->field = "powe";
+        if (!get_number(s, &x)) {
+            return TXPK_ERROR_FORMAT;
+        }
+        pkt->rf_power = (int8_t)x;
+        info->fields |= TXPK_FIELD_POWE;
+        return TXPK_OK;
+    }
+    if (KEY_IS(key, key_len, "datr")) {
+        info->field = "datr";
+        if (**s != '"') {
+            return TXPK_ERROR_FORMAT;
+        }
+        if (!get_string(s, &str, &len)) {
+            return TXPK_ERROR_JSON;
+        }
+        len = unescape(str, len, buf, STR_SIZE_MAX);
+        if ((len < 0) || (parse_datr(buf, len, pkt) != TXPK_OK)) {
+            return TXPK_ERROR_FORMAT;
+        }
+        info->fields |= TXPK_FIELD_DATR;
+        return TXPK_OK;
+    }
+    if (KEY_IS(key, key_len, "codr")) {
+        info->field = "codr";
+        if (**s != '"') {
+            return TXPK_ERROR_FORMAT;
+        }
+        if (!get_string(s, &str, &len)) {
+            return TXPK_ERROR_JSON;
+        }
+        len = unescape(str, len, buf, STR_SIZE_MAX);
+        if (KEY_IS(buf, len, "4/8LI") || KEY_IS(buf, len, "4/7LI")) {
+            pkt->coderate = CR_LORA_LI_4_8;
+        } else {
+            return TXPK_ERROR_FORMAT;
+        }
+        info->fields |= TXPK_FIELD_CODR;
+        return TXPK_OK;
+    }
+    if (KEY_IS(key, key_len, "ipol")) {
+        info->field = "ipol";
+        if (!get_bool(s, &b)) {
+            return TXPK_ERROR_FORMAT;
+        }
+        pkt->invert_pol = b;
+        info->fields |= TXPK_FIELD_IPOL;
+        return TXPK_OK;
+    }
+    if (KEY_IS(key, key_len, "prea")) {
+        info->field = "prea";
+        if (!get_number(s, &x)) {
+            return TXPK_ERROR_FORMAT;
+        }
+        pkt->preamble = (x < 0) ? 0 : ((x > UINT16_MAX) ? UINT16_MAX : (uint16_t)x);
+        info->fields |= TXPK_FIELD_PREA;
+        return TXPK_OK;
+    }
+    if (KEY_IS(key, key_len, "brd")) {
+        info->field = "brd";
+        if (!get_number(s, &x) || (x < 0) || (x > UINT8_MAX)) {
+            return TXPK_ERROR_FORMAT;
+        }
+        info->brd = (uint8_t)x;
+        info->fields |= TXPK_FIELD_BRD;
+        return TXPK_OK;
+    }
+    if (KEY_IS(key, key_len, "size")) {
+        info->field = "size";
+        if (!get_number(s, &x)) {
+            return TXPK_ERROR_FORMAT;
+        }
+        pkt->size = (uint16_t)x;
+        info->fields |= TXPK_FIELD_SIZE;
+        return TXPK_OK;
+    }
+    if (KEY_IS(key, key_len, "data")) {
+        info->field = "data";
+        if (**s != '"') {
+            return TXPK_ERROR_FORMAT;
+        }
+        if (!get_string(s, &str, &len)) {
+            return TXPK_ERROR_JSON;
+        }
+        /* decoded from the JSON string, unless '/' were escaped */
+        if (memchr(str, '\\', len) != NULL) {
+            len = unescape(str, len, data, sizeof data);
+            if (len < 0) {
+                return TXPK_ERROR_FORMAT;
+            }
+            str = data;
+        }
+        /* the base64 decoder does not accept invalid characters */
+        for (i = 0; i < len; i++) {
+            if (!is_b64_char(str[i])) {
+                return TXPK_ERROR_FORMAT;
+            }
+        }
+        info->data_size = b64_to_bin(str, len, pkt->payload, sizeof pkt->payload);
+        if (info->data_size < 0) {
+            return TXPK_ERROR_FORMAT;
+        }
+        info->fields |= TXPK_FIELD_DATA;
+        return TXPK_OK;
+    }
+
+    /* unused field */
+    return skip_value(s, 0) ? TXPK_OK : TXPK_ERROR_JSON;
+}
+
+/* Parse an object, members of the txpk object are decoded, the others skipped */
+static enum txpk_error_e parse_object(const char **s, bool is_txpk, bool *txpk_found, struct lgw_pkt_tx_s *pkt, struct txpk_info_s *info) {
+    enum txpk_error_e err;
+    const char *key;
+    int key_len;
+
+    if (**s != '{') {
+        return TXPK_ERROR_JSON;
+    }
+    (*s)++;
+    skip_ws(s);
+    if (**s == '}') {
+        (*s)++;
+        return TXPK_OK;
+    }
+    while (true) {
+        if (!get_string(s, &key, &key_len)) {
+            return TXPK_ERROR_JSON;
+        }
+        skip_ws(s);
+        if (**s != ':') {
+            return TXPK_ERROR_JSON;
+        }
+        (*s)++;
+        skip_ws(s);
+
+        if (is_txpk) {
+            err = parse_member(key, key_len, s, pkt, info);
+        } else if (KEY_IS(key, key_len, "txpk") && (**s == '{')) {
+            *txpk_found = true;
+            err = parse_object(s, true, txpk_found, pkt, info);
+        } else {
+            err = skip_value(s, 0) ? TXPK_OK : TXPK_ERROR_JSON;
+        }
+        if (err != TXPK_OK) {
+            return err;
+        }
+
+        skip_ws(s);
+        if (**s == '}') {
+            (*s)++;
+            return TXPK_OK;
+        }
+        if (**s != ',') {
+            return TXPK_ERROR_JSON;
+        }
+        (*s)++;
+        skip_ws(s);
+    }
+}
+
+/* Check the mandatory fields are present, "imme" or "tmst" are checked by the caller */
+static enum txpk_error_e check_mandatory(struct txpk_info_s *info) {
+    info->field = NULL;
+    if ((info->fields & TXPK_FIELD_MANDATORY) != TXPK_FIELD_MANDATORY) {
+        if (!(info->fields & TXPK_FIELD_FREQ)) {
+            info->field = "freq";
+        } else if (!(info->fields & TXPK_FIELD_DATR)) {
+            info->field = "datr";
+        } else if (!(info->fields & TXPK_FIELD_CODR)) {
+            info->field = "codr";
+        } else if (!(info->fields & TXPK_FIELD_SIZE)) {
+            info->field = "size";
+        } else {
+            info->field = "data";
+        }
+        return TXPK_ERROR_MISSING;
+    }
+    return TXPK_OK;
+}
+
+/* Decode a txpk object in the next packet of the batch, an invalid packet is skipped up to the next one */
+static enum txpk_error_e parse_batch_txpk(const char **s, struct txpk_batch_s *batch) {
+    enum txpk_error_e err;
+    const char *start = *s;
+    bool txpk_found;
+    int n = batch->nb;
+
+    batch->nb++;
+    if (n >= batch->size) {
+        return skip_value(s, 0) ? TXPK_OK : TXPK_ERROR_JSON;
+    }
+    memset(&batch->pkt[n], 0, sizeof batch->pkt[n]);
+    memset(&batch->info[n], 0, sizeof batch->info[n]);
+
+    err = parse_object(s, true, &txpk_found, &batch->pkt[n], &batch->info[n]);
+    if (err == TXPK_OK) {
+        err = check_mandatory(&batch->info[n]);
+    } else if (err != TXPK_ERROR_JSON) {
+        *s = start;
+        if (!skip_value(s, 0)) {
+            return TXPK_ERROR_JSON;
+        }
+    } else {
+        return TXPK_ERROR_JSON;
+    }
+    batch->err[n] = err;
+    return TXPK_OK;
+}
+
+/* Parse the root object, the "txpk" object or the objects of the "txpk" array are decoded, the other members skipped */
+static enum txpk_error_e parse_batch_root(const char **s, struct txpk_batch_s *batch) {
+    enum txpk_error_e err;
+    const char *key;
+    int key_len;
+
+    if (**s != '{') {
+        return TXPK_ERROR_JSON;
+    }
+    (*s)++;
+    skip_ws(s);
+    if (**s == '}') {
+        (*s)++;
+        return TXPK_OK;
+    }
+    while (true) {
+        if (!get_string(s, &key, &key_len)) {
+            return TXPK_ERROR_JSON;
+        }
+        skip_ws(s);
+        if (**s != ':') {
+            return TXPK_ERROR_JSON;
+        }
+        (*s)++;
+        skip_ws(s);
+
+        if (KEY_IS(key, key_len, "txpk") && (**s == '{')) {
+            err = parse_batch_txpk(s, batch);
+        } else if (KEY_IS(key, key_len, "txpk") && (**s == '[')) {
+            batch->is_array = true;
+            (*s)++;
+            skip_ws(s);
+            err = TXPK_OK;
+            if (**s == ']') {
+                (*s)++;
+            } else {
+                while (true) {
+                    err = (**s == '{') ? parse_batch_txpk(s, batch) : TXPK_ERROR_JSON;
+                    if (err != TXPK_OK) {
+                        break;
+                    }
+                    skip_ws(s);
+                    if (**s == ']') {
+                        (*s)++;
+                        break;
+                    }
+                    if (**s != ',') {
+                        err = TXPK_ERROR_JSON;
+                        break;
+                    }
+                    (*s)++;
+                    skip_ws(s);
+                }
+            }
+        } else {
+            err = skip_value(s, 0) ? TXPK_OK : TXPK_ERROR_JSON;
+        }
+        if (err != TXPK_OK) {
+            return err;
+        }
+
+        skip_ws(s);
+        if (**s == '}') {
+            (*s)++;
+            return TXPK_OK;
+        }
+        if (**s != ',') {
+            return TXPK_ERROR_JSON;
+        }
+        (*s)++;
+        skip_ws(s);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ----------------------------------------- */
+
+enum txpk_error_e txpk_parse(const char *json, struct lgw_pkt_tx_s *pkt, struct txpk_info_s *info) {
+    enum txpk_error_e err;
+    bool txpk_found = false;
+    const char *s = json;
+
+    if ((json == NULL) || (pkt == NULL) || (info == NULL)) {
+        return TXPK_ERROR_JSON;
+    }
+    memset(pkt, 0, sizeof *pkt);
+    memset(info, 0, sizeof *info);
+
+    skip_ws(&s);
+    err = parse_object(&s, false, &txpk_found, pkt, info);
+    if (err != TXPK_OK) {
+        return err;
+    }
+    if (txpk_found == false) {
+        return TXPK_ERROR_NO_TXPK;
+    }
+
+    return check_mandatory(info);
+}
+
+enum txpk_error_e txpk_parse_batch(const char *json, struct lgw_pkt_tx_s *pkt, struct txpk_info_s *info, enum txpk_error_e *err, int size, int *nb_pkt, bool *is_array) {
+    enum txpk_error_e x;
+    struct txpk_batch_s batch;
+    const char *s = json;
+
+    if ((json == NULL) || (pkt == NULL) || (info == NULL) || (err == NULL) || (nb_pkt == NULL) || (is_array == NULL)) {
+        return TXPK_ERROR_JSON;
+    }
+    *nb_pkt = 0;
+    *is_array = false;
+
+    batch.pkt = pkt;
+    batch.info = info;
+    batch.err = err;
+    batch.size = size;
+    batch.nb = 0;
+    batch.is_array = false;
+
+    skip_ws(&s);
+    x = parse_batch_root(&s, &batch);
+    if (x != TXPK_OK) {
+        return x;
+    }
+    if (batch.nb == 0) {
+        return TXPK_ERROR_NO_TXPK;
+    }
+    *nb_pkt = batch.nb;
+    *is_array = batch.is_array;
+
+    return TXPK_OK;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,244 @@
+/*!
+ * \brief     Check the TX airtime budgets over the sliding window
+ *
+ * License: Revised BSD 3-Clause License, see LICENSE.TXT file include in the project
+ */
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf */
+#include <stdlib.h>     /* EXIT_FAILURE */
+#include <unistd.h>     /* getopt */
+#include <math.h>       /* fabsf */
+
+#include "airtime.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define WINDOW_S        60          /* 1 s bins */
+#define TIME_START      1000000000  /* host time of the first packet, in ms */
+#define FREQ_A          2403000000
+#define FREQ_B          2425000000
+#define FREQ_C          2479000000
+#define TOA_US          1000000
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* describe command line options */
+void usage(void) {
+    printf("Available options:\n");
+    printf(" -h print this help\n");
+}
+
+static bool near(float x, float ref) {
+    return (fabsf(x - ref) < 0.01f);
+}
+
+/* check, queue and send a packet, as done by the packet forwarder */
+static bool tx_packet(struct airtime_s *at, uint64_t time_ms, uint32_t freq_hz, uint32_t toa_us) {
+    if (airtime_check(at, time_ms, 0, freq_hz, toa_us) == false) {
+        return false;
+    }
+    airtime_add(at, time_ms, 0, freq_hz, toa_us);
+    airtime_sent(at, time_ms, 0, freq_hz, toa_us);
+    return true;
+}
+
+/* queued packets count in the budgets, until sent or dropped */
+static int check_pending(void) {
+    struct airtime_s at;
+    uint32_t freq[AIRTIME_NB_CHAN_MAX];
+    float occ[AIRTIME_NB_CHAN_MAX];
+    int nb_err = 0;
+    int i;
+
+    /* 5% per radio of 60 s: 3 packets of 1 s queued, the next one rejected */
+    airtime_init(&at, WINDOW_S, 5.0, 0.0);
+    for (i = 0; i < 3; i++) {
+        if (airtime_check(&at, TIME_START, 0, FREQ_A, TOA_US) == false) {
+            printf("ERROR: packet %d rejected while queued\n", i);
+            nb_err += 1;
+        }
+        airtime_add(&at, TIME_START, 0, FREQ_A, TOA_US);
+    }
+    if (airtime_check(&at, TIME_START, 0, FREQ_B, TOA_US) == true) {
+        printf("ERROR: queued packets not counted in the budget\n");
+        nb_err += 1;
+    }
+    if (!near(airtime_radio_occupancy(&at, TIME_START, 0), 0.0)) {
+        printf("ERROR: queued packets counted in the occupancy\n");
+        nb_err += 1;
+    }
+
+    /* dropped packets give their airtime back, a sent one enters the window */
+    airtime_sub(&at, 0, FREQ_A, TOA_US);
+    airtime_sub(&at, 0, FREQ_A, TOA_US);
+    airtime_sent(&at, TIME_START + 1000, 0, FREQ_A, TOA_US);
+    if (!near(airtime_radio_occupancy(&at, TIME_START + 1000, 0), 100.0 / 60)) {
+        printf("ERROR: wrong radio occupancy after a packet sent\n");
+        nb_err += 1;
+    }
+    for (i = 0; i < 2; i++) {
+        if (tx_packet(&at, TIME_START + 2000, FREQ_B, TOA_US) == false) {
+            printf("ERROR: airtime of the dropped packets not given back\n");
+            nb_err += 1;
+        }
+    }
+    if (tx_packet(&at, TIME_START + 2000, FREQ_B, TOA_US) == true) {
+        printf("ERROR: budget not enforced after the drops\n");
+        nb_err += 1;
+    }
+
+    /* a channel with packets queued is not reused */
+    airtime_init(&at, WINDOW_S, 0.0, 5.0);
+    airtime_add(&at, TIME_START, 0, FREQ_A, TOA_US);
+    for (i = 1; i < AIRTIME_NB_CHAN_MAX; i++) {
+        tx_packet(&at, TIME_START, FREQ_A + i * 1000000, TOA_US);
+    }
+    tx_packet(&at, TIME_START + 70000, FREQ_C, TOA_US);
+    airtime_chan_occupancy(&at, TIME_START + 70000, freq, occ, AIRTIME_NB_CHAN_MAX);
+    if ((freq[0] != FREQ_A) || (freq[1] != FREQ_C)) {
+        printf("ERROR: channel of a queued packet reused\n");
+        nb_err += 1;
+    }
+
+    return nb_err;
+}
+
+static int check_budgets(void) {
+    struct airtime_s at;
+    uint32_t freq[AIRTIME_NB_CHAN_MAX];
+    float occ[AIRTIME_NB_CHAN_MAX];
+    int nb_err = 0;
+    int i, n;
+
+    if ((airtime_init(&at, 0, 10.0, 5.0) != -1) || (airtime_init(&at, AIRTIME_WINDOW_MAX_S + 1, 10.0, 5.0) != -1) ||
+        (airtime_init(&at, WINDOW_S, 101.0, 5.0) != -1) || (airtime_init(&at, WINDOW_S, 10.0, -1.0) != -1)) {
+        printf("ERROR: invalid parameters not detected\n");
+        nb_err += 1;
+    }
+
+    /* 10% per radio and 5% per frequency of 60 s: 6 and 3 packets of 1 s */
+    airtime_init(&at, WINDOW_S, 10.0, 5.0);
+    for (i = 0; i < 3; i++) {
+        if (tx_packet(&at, TIME_START + i * 1000, FREQ_A, TOA_US) == false) {
+            printf("ERROR: packet %d rejected on channel A\n", i);
+            nb_err += 1;
+        }
+    }
+    if (tx_packet(&at, TIME_START + 3000, FREQ_A, TOA_US) == true) {
+        printf("ERROR: channel budget not enforced\n");
+        nb_err += 1;
+    }
+    for (i = 0; i < 3; i++) {
+        if (tx_packet(&at, TIME_START + 10000 + i * 1000, FREQ_B, TOA_US) == false) {
+            printf("ERROR: packet %d rejected on channel B\n", i);
+            nb_err += 1;
+        }
+    }
+    if (tx_packet(&at, TIME_START + 20000, FREQ_C, TOA_US) == true) {
+        printf("ERROR: radio budget not enforced\n");
+        nb_err += 1;
+    }
+    if (!near(airtime_radio_occupancy(&at, TIME_START + 20000, 0), 10.0) || !near(airtime_radio_occupancy(&at, TIME_START + 20000, 1), 0.0)) {
+        printf("ERROR: wrong radio occupancy\n");
+        nb_err += 1;
+    }
+    n = airtime_chan_occupancy(&at, TIME_START + 20000, freq, occ, AIRTIME_NB_CHAN_MAX);
+    if ((n != 2) || (freq[0] != FREQ_A) || !near(occ[0], 5.0) || (freq[1] != FREQ_B) || !near(occ[1], 5.0)) {
+        printf("ERROR: wrong channel occupancy\n");
+        nb_err += 1;
+    }
+
+    /* the packets of channel A leave the window one bin at a time */
+    if (!near(airtime_radio_occupancy(&at, TIME_START + 60000, 0), 100.0 * 5 / 60) ||
+        !near(airtime_radio_occupancy(&at, TIME_START + 62500, 0), 100.0 * 3 / 60)) {
+        printf("ERROR: window does not slide\n");
+        nb_err += 1;
+    }
+    if ((tx_packet(&at, TIME_START + 62500, FREQ_A, TOA_US) == false) || (tx_packet(&at, TIME_START + 62500, FREQ_B, TOA_US) == true)) {
+        printf("ERROR: budget not released by the window\n");
+        nb_err += 1;
+    }
+    if (!near(airtime_radio_occupancy(&at, TIME_START + 200000, 0), 0.0)) {
+        printf("ERROR: window not cleared after a long idle time\n");
+        nb_err += 1;
+    }
+
+    /* a packet longer than the budget is never accepted, no budget means no limit */
+    if (tx_packet(&at, TIME_START + 200000, FREQ_A, 3000001) == true) {
+        printf("ERROR: packet longer than the budget accepted\n");
+        nb_err += 1;
+    }
+    airtime_init(&at, WINDOW_S, 0.0, 0.0);
+    for (i = 0; i < 100; i++) {
+        if (tx_packet(&at, TIME_START, FREQ_A, TOA_US) == false) {
+            printf("ERROR: packet rejected without budget\n");
+            nb_err += 1;
+            break;
+        }
+    }
+
+    /* channels table: full, then reused once a frequency has left the window */
+    airtime_init(&at, WINDOW_S, 0.0, 5.0);
+    for (i = 0; i < AIRTIME_NB_CHAN_MAX; i++) {
+        tx_packet(&at, TIME_START, FREQ_A + i * 1000000, TOA_US);
+    }
+    tx_packet(&at, TIME_START + 1000, FREQ_C, TOA_US);
+    n = airtime_chan_occupancy(&at, TIME_START + 1000, freq, occ, AIRTIME_NB_CHAN_MAX);
+    if ((n != AIRTIME_NB_CHAN_MAX) || (freq[AIRTIME_NB_CHAN_MAX - 1] == FREQ_C)) {
+        printf("ERROR: channels table overflow\n");
+        nb_err += 1;
+    }
+    tx_packet(&at, TIME_START + 70000, FREQ_C, TOA_US);
+    n = airtime_chan_occupancy(&at, TIME_START + 70000, freq, occ, AIRTIME_NB_CHAN_MAX);
+    if ((n != AIRTIME_NB_CHAN_MAX) || (freq[0] != FREQ_C) || !near(occ[0], 100.0 / 60)) {
+        printf("ERROR: unused channel not reused\n");
+        nb_err += 1;
+    }
+
+    return nb_err;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv) {
+    int i, j;
+
+    /* parse command line options */
+    while ((i = getopt (argc, argv, "h")) != -1) {
+        switch (i) {
+            case 'h':
+                usage();
+                return EXIT_SUCCESS;
+            default:
+                printf("ERROR: argument parsing\n");
+                usage();
+                return EXIT_FAILURE;
+        }
+    }
+
+    j = check_budgets() + check_pending();
+    if (j > 0) {
+        printf("FAILED: %d errors\n", j);
+        return EXIT_FAILURE;
+    }
+    printf("Airtime budgets are enforced over the sliding window, queued packets included\n");
+
+    return EXIT_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,220 @@
+/*!
+ * \brief     Check the binary framing of packets, and compare its size with JSON
+ *
+ * License: Revised BSD 3-Clause License, see LICENSE.TXT file include in the project
+ */
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf */
+#include <stdlib.h>     /* EXIT_FAILURE, rand */
+#include <unistd.h>     /* getopt */
+#include <string.h>     /* memcmp */
+
+#include "loragw_hal.h"
+#include "rxpk.h"
+#include "binpk.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define NB_PKT_BATCH    32
+#define PAYLOAD_SIZE    32      /* payload size for the size comparison */
+#define BUFF_SIZE       (NB_PKT_BATCH * RXPK_SIZE_MAX(255))
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+/* PUSH_DATA payload expected for the reference packet, without status */
+static const uint8_t rxpk_ref[] = {
+    0x01, 0x00,                                         /* 1 record, no status */
+    0x01, 0x02, 0x03, 0x04, 0x90, 0x8A, 0x90, 0x40,     /* tmst, freq */
+    0xFF, 0xFF, 0xFD, 0x27, 0x02, 0x01, 0x01, 0x0C,     /* foff, chan, stat, modu, SF */
+    0x03, 0x2C, 0x18, 0x03, 0xFE, 0x9E, 0x00, 0x33,     /* BW, codr, size, rssi, lsnr */
+    0xAA, 0xBB, 0xCC                                    /* payload */
+};
+
+/* PULL_RESP payload of the reference downlink */
+static const uint8_t txpk_ref[] = {
+    0x02, 0xD1, 0x5A, 0x2F, 0xC3, 0x90, 0x5C, 0xC9,     /* flags, tmst, freq... */
+    0x80, 0x0A, 0x01, 0x0B, 0x03, 0x2C, 0x18, 0x00,     /* ...freq, powe, modu, SF, BW, codr, prea... */
+    0x0C, 0x04, 0x01, 0x02, 0x03, 0x04                  /* ...prea, size, payload */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* describe command line options */
+void usage(void) {
+    printf("Available options:\n");
+    printf(" -h print this help\n");
+}
+
+/* reference packet, with its payload written to a buffer of at least 3 bytes */
+static void ref_pkt(struct lgw_pkt_rx_ref_s *p, uint8_t *payload) {
+    memset(p, 0, sizeof *p);
+    p->count_us = 0x01020304;
+    p->freq_hz = 2425000000;
+    p->foff_hz = -729;
+    p->channel = 2;
+    p->status = STAT_CRC_OK;
+    p->modulation = MOD_LORA;
+    p->datarate = DR_LORA_SF12;
+    p->bandwidth = BW_800KHZ;
+    p->coderate = CR_LORA_LI_4_8;
+    p->rssi = -35.4;
+    p->snr = 5.1;
+    p->size = 3;
+    payload[0] = 0xAA;
+    payload[1] = 0xBB;
+    payload[2] = 0xCC;
+    p->payload = payload;
+}
+
+static int check_rxpk(void) {
+    struct lgw_pkt_rx_ref_s pkt;
+    uint8_t payload[3];
+    const struct lgw_pkt_rx_ref_s *pkt_ptr[1] = { &pkt };
+    struct binpk_stat_s stat = { 1, 2, 3, 4, 50.0, 6, 7, -1.25 };
+    uint8_t buf[128];
+    int nb_err = 0;
+    int n;
+
+    ref_pkt(&pkt, payload);
+    n = binpk_rxpk_serialize_batch(pkt_ptr, 1, NULL, buf, sizeof buf);
+    if ((n != (int)sizeof rxpk_ref) || (memcmp(buf, rxpk_ref, n) != 0)) {
+        printf("ERROR: rxpk record is different from the reference\n");
+        nb_err += 1;
+    }
+
+    /* status record, ackr in 0.1% and temp in 0.1 C */
+    n = binpk_rxpk_serialize_batch(pkt_ptr, 0, &stat, buf, sizeof buf);
+    if ((n != BINPK_PUSH_HEADER_SIZE + BINPK_STAT_SIZE) || (buf[0] != 0) || (buf[1] != BINPK_PUSH_FLAG_STAT) ||
+        (buf[2 + 3] != 1) || (buf[2 + 15] != 4) || (buf[2 + 16] != 0x01) || (buf[2 + 17] != 0xF4) ||
+        (buf[2 + 25] != 7) || (buf[2 + 26] != 0xFF) || (buf[2 + 27] != 0xF3)) {
+        printf("ERROR: stat record is different from the reference\n");
+        nb_err += 1;
+    }
+
+    /* errors */
+    if (binpk_rxpk_serialize_batch(pkt_ptr, 1, &stat, buf, sizeof rxpk_ref + BINPK_STAT_SIZE - 1) != -1) {
+        printf("ERROR: buffer too small not detected\n");
+        nb_err += 1;
+    }
+    pkt.status = 0xFF;
+    if (binpk_rxpk_serialize_batch(pkt_ptr, 1, NULL, buf, sizeof buf) != -1) {
+        printf("ERROR: unknown status not detected\n");
+        nb_err += 1;
+    }
+
+    return nb_err;
+}
+
+static int check_txpk(void) {
+    struct lgw_pkt_tx_s pkt;
+    struct txpk_info_s info;
+    uint8_t buf[sizeof txpk_ref];
+    int nb_err = 0;
+
+    if ((binpk_txpk_parse(txpk_ref, sizeof txpk_ref, &pkt, &info) != TXPK_OK) ||
+        (info.imme != false) || !(info.fields & TXPK_FIELD_TMST) || !(info.fields & TXPK_FIELD_PREA) ||
+        (pkt.count_us != 3512348611U) || (pkt.freq_hz != 2422000000) || (pkt.rf_power != 10) ||
+        (pkt.datarate != DR_LORA_SF11) || (pkt.bandwidth != BW_800KHZ) || (pkt.coderate != CR_LORA_LI_4_8) ||
+        (pkt.invert_pol != true) || (pkt.no_crc != false) || (pkt.preamble != 12) ||
+        (pkt.size != 4) || (info.data_size != 4) || (memcmp(pkt.payload, txpk_ref + 18, 4) != 0)) {
+        printf("ERROR: txpk record not decoded as expected\n");
+        nb_err += 1;
+    }
+
+    /* errors */
+    if (binpk_txpk_parse(txpk_ref, BINPK_TXPK_HEADER_SIZE - 1, &pkt, &info) != TXPK_ERROR_JSON) {
+        printf("ERROR: truncated record not detected\n");
+        nb_err += 1;
+    }
+    memcpy(buf, txpk_ref, sizeof buf);
+    buf[14] = 5; /* 4/5 */
+    if ((binpk_txpk_parse(buf, sizeof buf, &pkt, &info) != TXPK_ERROR_FORMAT) || (strcmp(info.field, "codr") != 0)) {
+        printf("ERROR: unsupported coderate not detected\n");
+        nb_err += 1;
+    }
+    memcpy(buf, txpk_ref, sizeof buf);
+    buf[11] = 13; /* SF13 */
+    if ((binpk_txpk_parse(buf, sizeof buf, &pkt, &info) != TXPK_ERROR_FORMAT) || (strcmp(info.field, "datr") != 0)) {
+        printf("ERROR: unsupported datarate not detected\n");
+        nb_err += 1;
+    }
+
+    return nb_err;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv) {
+    int i, j, k;
+    static struct lgw_pkt_rx_ref_s pkt[NB_PKT_BATCH];
+    static uint8_t payload[NB_PKT_BATCH][PAYLOAD_SIZE];
+    const struct lgw_pkt_rx_ref_s *pkt_ptr[NB_PKT_BATCH];
+    static char buf_json[BUFF_SIZE];
+    static uint8_t buf[BUFF_SIZE];
+    int n_json, n;
+
+    /* parse command line options */
+    while ((i = getopt (argc, argv, "h")) != -1) {
+        switch (i) {
+            case 'h':
+                usage();
+                return EXIT_SUCCESS;
+            default:
+                printf("ERROR: argument parsing\n");
+                usage();
+                return EXIT_FAILURE;
+        }
+    }
+
+    /* check the records against their reference */
+    j = check_rxpk() + check_txpk();
+    if (j > 0) {
+        printf("FAILED: %d errors\n", j);
+        return EXIT_FAILURE;
+    }
+    printf("Binary records match the reference\n");
+
+    /* compare the size with JSON, on a batch of packets */
+    srand(1);
+    for (i = 0; i < NB_PKT_BATCH; i++) {
+        ref_pkt(&pkt[i], payload[i]);
+        pkt[i].count_us = (uint32_t)rand();
+        pkt[i].size = PAYLOAD_SIZE;
+        for (k = 0; k < PAYLOAD_SIZE; k++) {
+            payload[i][k] = (uint8_t)rand();
+        }
+        pkt_ptr[i] = &pkt[i];
+    }
+    n_json = rxpk_serialize_batch(pkt_ptr, NB_PKT_BATCH, buf_json, sizeof buf_json);
+    n = binpk_rxpk_serialize_batch(pkt_ptr, NB_PKT_BATCH, NULL, buf, sizeof buf);
+    if ((n_json < 0) || (n < 0)) {
+        printf("FAILED: batch serialization\n");
+        return EXIT_FAILURE;
+    }
+    n_json += 11; /* with {"rxpk":[ and ]} */
+    if (n >= n_json) {
+        printf("FAILED: binary batch of %d bytes, not smaller than JSON (%d bytes)\n", n, n_json);
+        return EXIT_FAILURE;
+    }
+    printf("%d packets of %d bytes: %d bytes in JSON, %d in binary\n", NB_PKT_BATCH, PAYLOAD_SIZE, n_json, n);
+
+    return EXIT_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,144 @@
+/*!
+ * \brief     Check the removal of the copies of an uplink
+ *
+ * License: Revised BSD 3-Clause License, see LICENSE.TXT file include in the project
+ */
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf */
+#include <stdlib.h>     /* EXIT_FAILURE */
+#include <string.h>     /* memset */
+#include <unistd.h>     /* getopt */
+
+#include "dedup.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define WINDOW_US       10000
+#define BATCH_NB        4       /* packets per batch, at most */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static struct lgw_pkt_rx_ref_s rx[BATCH_NB];
+static uint8_t payload[BATCH_NB][32];
+static const struct lgw_pkt_rx_ref_s *pkt[BATCH_NB];
+static uint8_t brd[BATCH_NB];
+static uint64_t time_us[BATCH_NB];
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* describe command line options */
+void usage(void) {
+    printf("Available options:\n");
+    printf(" -h print this help\n");
+}
+
+/* packet i of the batch, with a payload numbered id */
+static void set_pkt(int i, uint32_t id, uint32_t count_us, float rssi, uint8_t board) {
+    memset(&rx[i], 0, sizeof rx[i]);
+    rx[i].count_us = count_us;
+    rx[i].rssi = rssi;
+    rx[i].size = 16;
+    memset(payload[i], 0, sizeof payload[i]);
+    payload[i][0] = 0x40;
+    memcpy(&payload[i][1], &id, sizeof id);
+    rx[i].payload = payload[i];
+    pkt[i] = &rx[i];
+    brd[i] = board;
+    time_us[i] = (uint64_t)i;
+}
+
+static int check_filter(void) {
+    struct dedup_s dd;
+    int nb_err = 0;
+    int n;
+
+    dedup_init(&dd, WINDOW_US);
+
+    /* the same packet heard by 3 radios, the best copy is kept at the place of the first one */
+    set_pkt(0, 1, 1000000, -90.0, 0);
+    set_pkt(1, 2, 1000100, -80.0, 0);
+    set_pkt(2, 1, 1000050, -70.0, 0);
+    set_pkt(3, 1, 1000020, -75.0, 0);
+    n = dedup_filter(&dd, pkt, brd, time_us, 4);
+    if ((n != 2) || (pkt[0] != &rx[2]) || (time_us[0] != 2) || (pkt[1] != &rx[1]) || (time_us[1] != 1)) {
+        printf("ERROR: copies in a batch not removed (%d kept)\n", n);
+        nb_err += 1;
+    }
+
+    /* a late copy is dropped, out of the window or from another board it is a new packet */
+    set_pkt(0, 1, 1000000 + WINDOW_US, -60.0, 0);
+    set_pkt(1, 1, 1000050 + 2 * WINDOW_US, -60.0, 0);
+    set_pkt(2, 2, 1000100, -60.0, 1);
+    n = dedup_filter(&dd, pkt, brd, time_us, 3);
+    if ((n != 2) || (pkt[0] != &rx[1]) || (pkt[1] != &rx[2]) || (brd[1] != 1)) {
+        printf("ERROR: copies of a previous batch not handled (%d kept)\n", n);
+        nb_err += 1;
+    }
+
+    /* the counter wraps */
+    set_pkt(0, 3, 0xFFFFFF00, -60.0, 0);
+    set_pkt(1, 3, 0x00000100, -50.0, 0);
+    n = dedup_filter(&dd, pkt, brd, time_us, 2);
+    if ((n != 1) || (pkt[0] != &rx[1])) {
+        printf("ERROR: copies around the counter wrap not removed (%d kept)\n", n);
+        nb_err += 1;
+    }
+
+    /* payloads of a different size are different packets */
+    set_pkt(0, 4, 2000000, -60.0, 0);
+    set_pkt(1, 4, 2000000, -60.0, 0);
+    rx[1].size = 15;
+    n = dedup_filter(&dd, pkt, brd, time_us, 2);
+    if (n != 2) {
+        printf("ERROR: packets of different sizes removed (%d kept)\n", n);
+        nb_err += 1;
+    }
+
+    return nb_err;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv) {
+    int i, j;
+
+    /* parse command line options */
+    while ((i = getopt (argc, argv, "h")) != -1) {
+        switch (i) {
+            case 'h':
+                usage();
+                return EXIT_SUCCESS;
+            default:
+                printf("ERROR: argument parsing\n");
+                usage();
+                return EXIT_FAILURE;
+        }
+    }
+
+    j = check_filter();
+    if (j > 0) {
+        printf("FAILED: %d errors\n", j);
+        return EXIT_FAILURE;
+    }
+    printf("Copies of the uplinks are removed\n");
+
+    return EXIT_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,258 @@
+/*!
+ * \brief     Check the JiT queue against a brute-force reference
+ *
+ * License: Revised BSD 3-Clause License, see LICENSE.TXT file include in the project
+ */
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf, fflush */
+#include <stdlib.h>     /* EXIT_FAILURE, rand */
+#include <unistd.h>     /* getopt, dup, dup2 */
+#include <string.h>     /* memset */
+#include <fcntl.h>      /* open */
+
+#include "loragw_hal.h"
+#include "jitqueue.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define TIME_START              (0xFFFFFFFFU - 2000000U)    /* to check the counter roll-over */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* describe command line options */
+void usage(void) {
+    printf("Available options:\n");
+    printf(" -h print this help\n");
+    printf(" -n <uint>  number of random operations to be checked against the reference [1..]\n");
+}
+
+static void ref_pkt(struct lgw_pkt_tx_s *p, uint32_t count_us, uint16_t size) {
+    memset(p, 0, sizeof *p);
+    p->freq_hz = 2425000000;
+    p->tx_mode = TIMESTAMPED;
+    p->count_us = count_us;
+    p->rf_power = 10;
+    p->datarate = DR_LORA_SF7;
+    p->bandwidth = BW_800KHZ;
+    p->coderate = CR_LORA_LI_4_8;
+    p->preamble = 8;
+    p->size = size;
+}
+
+static bool collision(uint32_t p1_count_us, uint32_t p1_pre_delay, uint32_t p1_post_delay, uint32_t p2_count_us, uint32_t p2_pre_delay, uint32_t p2_post_delay) {
+    return ((p1_count_us - p2_count_us) <= (p1_pre_delay + p2_post_delay + TX_MARGIN_DELAY)) ||
+           ((p2_count_us - p1_count_us) <= (p2_pre_delay + p1_post_delay + TX_MARGIN_DELAY));
+}
+
+/* reference: does the packet collide with any queued one, as checked by the original linear scan */
+static bool ref_collision(const struct jit_queue_s *queue, const struct lgw_pkt_tx_s *pkt, enum jit_pkt_type_e pkt_type) {
+    uint32_t pre, post, target_pre;
+    const struct jit_node_s *n;
+    int i;
+
+    if (pkt_type == JIT_PKT_TYPE_BEACON) {
+        pre = TX_START_DELAY + BEACON_GUARD + TX_JIT_DELAY;
+        post = BEACON_RESERVED;
+    } else {
+        pre = TX_START_DELAY + TX_JIT_DELAY;
+        post = lgw_time_on_air_us(pkt);
+    }
+    for (i = 0; i < queue->num_pkt; i++) {
+        n = &queue->nodes[queue->index[i]];
+        target_pre = ((pkt_type == JIT_PKT_TYPE_DOWNLINK_CLASS_A) && (n->pkt_type == JIT_PKT_TYPE_BEACON)) ? TX_START_DELAY : n->pre_delay;
+        if (collision(pkt->count_us, pre, post, n->pkt.count_us, target_pre, n->post_delay)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* reference: node to be peeked, after the outdated ones are dropped */
+static int ref_peek(const struct jit_queue_s *queue, uint32_t time_us, int *nb_valid) {
+    const struct jit_node_s *n;
+    int best = -1;
+    int i;
+
+    *nb_valid = 0;
+    for (i = 0; i < queue->num_pkt; i++) {
+        n = &queue->nodes[queue->index[i]];
+        if ((n->pkt.count_us - time_us) >= TX_MAX_ADVANCE_DELAY) {
+            continue;
+        }
+        *nb_valid += 1;
+        if ((best == -1) || ((n->pkt.count_us - time_us) < (queue->nodes[best].pkt.count_us - time_us))) {
+            best = queue->index[i];
+        }
+    }
+    if ((best != -1) && ((queue->nodes[best].pkt.count_us - time_us) >= TX_JIT_DELAY)) {
+        best = -1;
+    }
+    return best;
+}
+
+/* the index is a permutation of the nodes, and the packets are in timestamp order */
+static bool check_index(const struct jit_queue_s *queue) {
+    bool seen[JIT_QUEUE_MAX] = { false };
+    int nb_beacon = 0;
+    int i;
+
+    for (i = 0; i < JIT_QUEUE_MAX; i++) {
+        if (seen[queue->index[i]]) {
+            return false;
+        }
+        seen[queue->index[i]] = true;
+    }
+    for (i = 0; i < queue->num_pkt; i++) {
+        if ((i > 0) && ((int32_t)(queue->nodes[queue->index[i]].pkt.count_us - queue->nodes[queue->index[i-1]].pkt.count_us) < 0)) {
+            return false;
+        }
+        if (queue->nodes[queue->index[i]].pkt_type == JIT_PKT_TYPE_BEACON) {
+            nb_beacon += 1;
+        }
+    }
+    return (nb_beacon == queue->num_beacon);
+}
+
+/* random enqueue/peek/dequeue sequence, checked against the reference */
+static int check_random(struct jit_queue_s *queue, unsigned int nb_op) {
+    struct lgw_pkt_tx_s pkt;
+    enum jit_pkt_type_e pkt_type;
+    enum jit_error_e err;
+    uint32_t time_us = TIME_START;
+    int nb_err = 0;
+    int idx, idx_ref, nb_valid;
+    bool coll;
+    unsigned int k;
+
+    jit_queue_init(queue);
+    for (k = 0; (k < nb_op) && (nb_err < 10); k++) {
+        if ((rand() % 3) != 0) {
+            /* enqueue a Class A downlink, or sometimes a beacon after the downlinks time frame */
+            if ((rand() % 20) == 0) {
+                pkt_type = JIT_PKT_TYPE_BEACON;
+                ref_pkt(&pkt, time_us + 4000000 + (uint32_t)(rand() % 4000000), 17);
+            } else {
+                pkt_type = JIT_PKT_TYPE_DOWNLINK_CLASS_A;
+                ref_pkt(&pkt, time_us + 100000 + (uint32_t)(rand() % 4000000), 1 + rand() % 64);
+            }
+            coll = ref_collision(queue, &pkt, pkt_type);
+            idx = queue->num_pkt;
+            err = jit_enqueue(queue, time_us, &pkt, pkt_type);
+            if (idx == JIT_QUEUE_MAX) {
+                if (err != JIT_ERROR_FULL) {
+                    fprintf(stderr, "ERROR: op %u, full queue not detected (%d)\n", k, err);
+                    nb_err += 1;
+                }
+            } else if (coll != ((err == JIT_ERROR_COLLISION_PACKET) || (err == JIT_ERROR_COLLISION_BEACON))) {
+                fprintf(stderr, "ERROR: op %u, enqueue at %u returned %d, collision %sexpected\n", k, pkt.count_us, err, coll ? "" : "not ");
+                nb_err += 1;
+            } else if (!coll && (err != JIT_ERROR_OK)) {
+                fprintf(stderr, "ERROR: op %u, enqueue at %u returned %d\n", k, pkt.count_us, err);
+                nb_err += 1;
+            }
+        } else {
+            /* time goes on, peek and dequeue the next packet */
+            time_us += (uint32_t)(rand() % 100000);
+            idx_ref = ref_peek(queue, time_us, &nb_valid);
+            err = jit_peek(queue, time_us, &idx);
+            if ((queue->num_pkt == 0) && (err == JIT_ERROR_EMPTY)) {
+                /* nothing to peek */
+            } else if ((err != JIT_ERROR_OK) || (idx != idx_ref) || (queue->num_pkt != nb_valid)) {
+                fprintf(stderr, "ERROR: op %u, peek at %u returned %d (index %d), %d expected\n", k, time_us, err, idx, idx_ref);
+                nb_err += 1;
+            } else if (idx != -1) {
+                err = jit_dequeue(queue, idx, &pkt, &pkt_type);
+                if ((err != JIT_ERROR_OK) || ((pkt.count_us - time_us) >= TX_JIT_DELAY)) {
+                    fprintf(stderr, "ERROR: op %u, dequeue of node %d returned %d\n", k, idx, err);
+                    nb_err += 1;
+                }
+                /* a node not in the queue cannot be dequeued */
+                if ((queue->num_pkt > 0) && (jit_dequeue(queue, idx, &pkt, &pkt_type) != JIT_ERROR_INVALID)) {
+                    fprintf(stderr, "ERROR: op %u, free node %d dequeued\n", k, idx);
+                    nb_err += 1;
+                }
+            }
+        }
+        if (!check_index(queue)) {
+            fprintf(stderr, "ERROR: op %u, queue index is not consistent\n", k);
+            nb_err += 1;
+        }
+    }
+
+    return nb_err;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv) {
+    int i, j;
+    unsigned int arg_u;
+    unsigned int nb_op = 200000;
+    static struct jit_queue_s queue;
+    int fd_null, fd_stdout;
+    int nb_err;
+
+    /* parse command line options */
+    while ((i = getopt (argc, argv, "hn:")) != -1) {
+        switch (i) {
+            case 'h':
+                usage();
+                return EXIT_SUCCESS;
+            case 'n':
+                j = sscanf(optarg, "%u", &arg_u);
+                if ((j != 1) || (arg_u < 1)) {
+                    printf("ERROR: argument parsing of -n argument. Use -h to print help\n");
+                    return EXIT_FAILURE;
+                }
+                nb_op = arg_u;
+                break;
+            default:
+                printf("ERROR: argument parsing\n");
+                usage();
+                return EXIT_FAILURE;
+        }
+    }
+
+    /* the queue logs every rejected or dropped packet, keep them out of the test output */
+    fflush(stdout);
+    fd_stdout = dup(STDOUT_FILENO);
+    fd_null = open("/dev/null", O_WRONLY);
+    if ((fd_stdout < 0) || (fd_null < 0)) {
+        printf("ERROR: failed to redirect stdout\n");
+        return EXIT_FAILURE;
+    }
+    dup2(fd_null, STDOUT_FILENO);
+
+    srand(1);
+    nb_err = check_random(&queue, nb_op);
+
+    fflush(stdout);
+    dup2(fd_stdout, STDOUT_FILENO);
+    close(fd_null);
+    close(fd_stdout);
+
+    if (nb_err > 0) {
+        printf("FAILED: %d errors\n", nb_err);
+        return EXIT_FAILURE;
+    }
+    printf("JiT queue matches the reference on %u random operations\n", nb_op);
+
+    return EXIT_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,177 @@
+/*!
+ * \brief     Check the lock-free statistics counters
+ *
+ * License: Revised BSD 3-Clause License, see LICENSE.TXT file include in the project
+ */
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf */
+#include <stdlib.h>     /* EXIT_FAILURE */
+#include <unistd.h>     /* getopt */
+#include <pthread.h>
+
+#include "meas.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define NB_THREAD       (MEAS_NB_SLOT + 4) /* some threads share the extra set */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static unsigned int nb_loop = 1000000;
+static bool done = false;
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* describe command line options */
+void usage(void) {
+    printf("Available options:\n");
+    printf(" -h print this help\n");
+    printf(" -n <uint>  number of counts by each thread [1..]\n");
+}
+
+/* count as the upstream thread does for each packet, with a peak each 1000 packets */
+static void * thread_count(void *arg) {
+    uint32_t index = (uint32_t)(uintptr_t)arg;
+    unsigned int k;
+
+    for (k = 0; k < nb_loop; k++) {
+        meas_add(MEAS_NB_RX_RCV, 1);
+        meas_add(MEAS_UP_PAYLOAD_BYTE, 10);
+        if ((k % 1000) == 0) {
+            meas_peak(MEAS_UP_ACK_RTT_MIN, 100 + index);
+            meas_peak(MEAS_UP_ACK_RTT_MAX, 100 + index);
+        }
+    }
+    return NULL;
+}
+
+/* collect while the threads count, the counters must only increase */
+static void * thread_collect(void *arg) {
+    static uint64_t cnt[MEAS_NB];
+    uint64_t prev = 0;
+    int *nb_err = (int *)arg;
+
+    while (__atomic_load_n(&done, __ATOMIC_RELAXED) == false) {
+        meas_collect(cnt, NULL);
+        if (cnt[MEAS_NB_RX_RCV] < prev) {
+            printf("ERROR: counter went back from %llu to %llu\n", (unsigned long long)prev, (unsigned long long)cnt[MEAS_NB_RX_RCV]);
+            *nb_err += 1;
+            break;
+        }
+        prev = cnt[MEAS_NB_RX_RCV];
+    }
+    return NULL;
+}
+
+static int run_threads(void * (*fn)(void *), int nb_thread) {
+    pthread_t thrid[NB_THREAD];
+    int i;
+
+    for (i = 0; i < nb_thread; i++) {
+        if (pthread_create(&thrid[i], NULL, fn, (void *)(uintptr_t)i) != 0) {
+            printf("ERROR: failed to create thread %d\n", i);
+            return -1;
+        }
+    }
+    for (i = 0; i < nb_thread; i++) {
+        pthread_join(thrid[i], NULL);
+    }
+    return 0;
+}
+
+static int check_counters(void) {
+    uint64_t cnt[MEAS_NB];
+    uint32_t peak[MEAS_NB_PEAK];
+    pthread_t thrid_collect;
+    int nb_err = 0;
+
+    meas_init();
+    meas_collect(cnt, peak);
+    if ((cnt[MEAS_NB_RX_RCV] != 0) || (peak[MEAS_UP_ACK_RTT_MIN] != UINT32_MAX) || (peak[MEAS_UP_ACK_RTT_MAX] != 0)) {
+        printf("ERROR: counters not cleared\n");
+        nb_err += 1;
+    }
+
+    done = false;
+    pthread_create(&thrid_collect, NULL, thread_collect, &nb_err);
+    if (run_threads(thread_count, NB_THREAD) != 0) {
+        return nb_err + 1;
+    }
+    __atomic_store_n(&done, true, __ATOMIC_RELAXED);
+    pthread_join(thrid_collect, NULL);
+
+    /* nothing lost, including the threads sharing the extra set */
+    meas_collect(cnt, peak);
+    if ((cnt[MEAS_NB_RX_RCV] != (uint64_t)NB_THREAD * nb_loop) || (cnt[MEAS_UP_PAYLOAD_BYTE] != (uint64_t)NB_THREAD * nb_loop * 10)) {
+        printf("ERROR: %llu counts, %llu expected\n", (unsigned long long)cnt[MEAS_NB_RX_RCV], (unsigned long long)NB_THREAD * nb_loop);
+        nb_err += 1;
+    }
+    if ((peak[MEAS_UP_ACK_RTT_MIN] != 100) || (peak[MEAS_UP_ACK_RTT_MAX] != 100 + NB_THREAD - 1)) {
+        printf("ERROR: peaks %u and %u, expected 100 and %u\n", peak[MEAS_UP_ACK_RTT_MIN], peak[MEAS_UP_ACK_RTT_MAX], 100 + NB_THREAD - 1);
+        nb_err += 1;
+    }
+
+    /* peaks are reset by the collection, counters are not */
+    meas_collect(cnt, peak);
+    if ((cnt[MEAS_NB_RX_RCV] != (uint64_t)NB_THREAD * nb_loop) || (peak[MEAS_UP_ACK_RTT_MIN] != UINT32_MAX) || (peak[MEAS_UP_ACK_RTT_MAX] != 0)) {
+        printf("ERROR: wrong collection reset\n");
+        nb_err += 1;
+    }
+
+    return nb_err;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv) {
+    int i, j;
+    unsigned int arg_u;
+
+    /* parse command line options */
+    while ((i = getopt (argc, argv, "hn:")) != -1) {
+        switch (i) {
+            case 'h':
+                usage();
+                return EXIT_SUCCESS;
+            case 'n':
+                j = sscanf(optarg, "%u", &arg_u);
+                if ((j != 1) || (arg_u < 1)) {
+                    printf("ERROR: argument parsing of -n argument. Use -h to print help\n");
+                    return EXIT_FAILURE;
+                }
+                nb_loop = arg_u;
+                break;
+            default:
+                printf("ERROR: argument parsing\n");
+                usage();
+                return EXIT_FAILURE;
+        }
+    }
+
+    j = check_counters();
+    if (j > 0) {
+        printf("FAILED: %d errors\n", j);
+        return EXIT_FAILURE;
+    }
+    printf("No count lost by %d threads collected concurrently\n", NB_THREAD);
+
+    return EXIT_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,214 @@
+/*!
+ * \brief     Check the rxpk serializer against snprintf formatting, and measure its speed
+ *
+ * License: Revised BSD 3-Clause License, see LICENSE.TXT file include in the project
+ */
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf fprintf */
+#include <stdlib.h>     /* EXIT_FAILURE, rand */
+#include <unistd.h>     /* getopt */
+#include <string.h>     /* memcmp */
+#include <math.h>       /* roundf */
+#include <time.h>       /* clock_gettime */
+
+#include "loragw_hal.h"
+#include "base64.h"
+#include "bench.h"
+#include "rxpk.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define NB_PKT_BATCH    32
+#define BUFF_SIZE       (NB_PKT_BATCH * RXPK_SIZE_MAX(255))
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* describe command line options */
+void usage(void) {
+    printf("Available options:\n");
+    printf(" -h print this help\n");
+    printf(" -n <uint>  number of batches of %d packets to be serialized for the benchmark [1..]\n", NB_PKT_BATCH);
+}
+
+/* reference serialization, with the stdio formatting used originally by the packet forwarder */
+static int serialize_ref(const struct lgw_pkt_rx_ref_s *p, char *buf, int buf_size) {
+    const char *stat;
+    int n, j;
+
+    switch (p->status) {
+        case STAT_CRC_OK:   stat = "1"; break;
+        case STAT_CRC_BAD:  stat = "-1"; break;
+        case STAT_NO_CRC:   stat = "0"; break;
+        default:            return -1;
+    }
+    n = snprintf(buf, buf_size, "{\"jver\":%d,\"tmst\":%u,\"chan\":%1u,\"freq\":%.6lf,\"foff\":%i,\"stat\":%s,\"modu\":\"LORA\",\"datr\":\"SF%uBW812\",\"codr\":\"4/8LI\",\"lsnr\":%.1f,\"rssi\":%.0f,\"size\":%u,\"data\":\"",
+                 RXPK_FRAME_FORMAT, p->count_us, p->channel, ((double)p->freq_hz / 1e6), p->foff_hz, stat, p->datarate, p->snr, roundf(p->rssi), p->size);
+    j = bin_to_b64(p->payload, p->size, buf + n, buf_size - n);
+    if (j < 0) {
+        return -1;
+    }
+    n += j;
+    n += snprintf(buf + n, buf_size - n, "\"}");
+    return n;
+}
+
+/* random packet, with its payload written to a buffer of 256 bytes */
+static void random_pkt(struct lgw_pkt_rx_ref_s *p, uint8_t *payload) {
+    static const uint8_t status[] = { STAT_CRC_OK, STAT_CRC_BAD, STAT_NO_CRC };
+    int i;
+
+    memset(p, 0, sizeof *p);
+    p->freq_hz = 2400000000 + (uint32_t)(rand() % 100000000);
+    p->channel = (uint8_t)(rand() % 3);
+    p->status = status[rand() % 3];
+    p->count_us = (uint32_t)rand() * 2U + (uint32_t)(rand() & 1);
+    p->foff_hz = (rand() % 400001) - 200000;
+    p->modulation = MOD_LORA;
+    p->bandwidth = BW_800KHZ;
+    p->datarate = (uint32_t)(DR_LORA_SF5 + rand() % 8);
+    p->coderate = CR_LORA_LI_4_8;
+    p->rssi = (float)(-(rand() % 140)) + (float)(rand() % 4) / 4.0f; /* quarter dB steps, ties to be rounded */
+    p->snr = (float)((rand() % 60) - 30) / 4.0f;
+    p->size = (uint16_t)(rand() % 256);
+    for (i = 0; i < p->size; i++) {
+        payload[i] = (uint8_t)rand();
+    }
+    p->payload = payload;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv) {
+    int i, j, k;
+    unsigned int arg_u;
+    unsigned int nb_loop = 10000;
+    static struct lgw_pkt_rx_ref_s pkt[NB_PKT_BATCH];
+    static uint8_t payload[NB_PKT_BATCH][256];
+    const struct lgw_pkt_rx_ref_s *pkt_ptr[NB_PKT_BATCH];
+    static char buf_ref[BUFF_SIZE];
+    static char buf[BUFF_SIZE];
+    int n_ref, n;
+    unsigned int nb_err = 0;
+    struct timespec start, end;
+    double ns_ref, ns;
+
+    /* parse command line options */
+    while ((i = getopt (argc, argv, "hn:")) != -1) {
+        switch (i) {
+            case 'h':
+                usage();
+                return EXIT_SUCCESS;
+            case 'n':
+                j = sscanf(optarg, "%u", &arg_u);
+                if ((j != 1) || (arg_u < 1)) {
+                    printf("ERROR: argument parsing of -n argument. Use -h to print help\n");
+                    return EXIT_FAILURE;
+                }
+                nb_loop = arg_u;
+                break;
+            default:
+                printf("ERROR: argument parsing\n");
+                usage();
+                return EXIT_FAILURE;
+        }
+    }
+
+    /* check the serializer output against the reference, on random packets */
+    srand(1);
+    for (i = 0; i < 100000; i++) {
+        random_pkt(&pkt[0], payload[0]);
+        n_ref = serialize_ref(&pkt[0], buf_ref, sizeof buf_ref);
+        n = rxpk_serialize(&pkt[0], buf, sizeof buf);
+        if ((n != n_ref) || (memcmp(buf, buf_ref, n) != 0)) {
+            if (nb_err < 5) {
+                printf("ERROR: mismatch\n  ref: %.*s\n  got: %.*s\n", n_ref, buf_ref, (n > 0) ? n : 0, buf);
+            }
+            nb_err += 1;
+        }
+    }
+
+    /* check the corner cases */
+    pkt[0].freq_hz = 2400000001;
+    pkt[0].foff_hz = INT32_MIN;
+    pkt[0].count_us = UINT32_MAX;
+    pkt[0].snr = -0.25;
+    pkt[0].rssi = -0.75;
+    pkt[0].size = 0;
+    n_ref = serialize_ref(&pkt[0], buf_ref, sizeof buf_ref);
+    n = rxpk_serialize(&pkt[0], buf, sizeof buf);
+    if ((n != n_ref) || (memcmp(buf, buf_ref, n) != 0)) {
+        printf("ERROR: mismatch\n  ref: %.*s\n  got: %.*s\n", n_ref, buf_ref, (n > 0) ? n : 0, buf);
+        nb_err += 1;
+    }
+    n = rxpk_serialize_brd(&pkt[0], UINT8_MAX, buf, sizeof buf);
+    if ((n != n_ref + 10) || (memcmp(buf + 36, ",\"brd\":255", 10) != 0) || (n > RXPK_SIZE_MAX(0))) {
+        printf("ERROR: board field not written as expected: %.*s\n", (n > 0) ? n : 0, buf);
+        nb_err += 1;
+    }
+    if (rxpk_serialize(&pkt[0], buf, RXPK_SIZE_MAX(0) - 1) != -1) {
+        printf("ERROR: buffer too small not detected\n");
+        nb_err += 1;
+    }
+    pkt[0].bandwidth = BW_400KHZ;
+    if (rxpk_serialize(&pkt[0], buf, sizeof buf) != -1) {
+        printf("ERROR: unsupported bandwidth not detected\n");
+        nb_err += 1;
+    }
+
+    if (nb_err > 0) {
+        printf("FAILED: %u mismatches\n", nb_err);
+        return EXIT_FAILURE;
+    }
+    printf("Serializer output matches the reference\n");
+
+    /* benchmark both, on a batch of packets */
+    for (i = 0; i < NB_PKT_BATCH; i++) {
+        random_pkt(&pkt[i], payload[i]);
+        pkt_ptr[i] = &pkt[i];
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (k = 0; k < (int)nb_loop; k++) {
+        n_ref = 0;
+        for (i = 0; i < NB_PKT_BATCH; i++) {
+            if (i > 0) {
+                buf_ref[n_ref++] = ',';
+            }
+            n_ref += serialize_ref(pkt_ptr[i], buf_ref + n_ref, sizeof buf_ref - n_ref);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    ns_ref = elapsed_ns(start, end) / ((double)nb_loop * NB_PKT_BATCH);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (k = 0; k < (int)nb_loop; k++) {
+        n = rxpk_serialize_batch(pkt_ptr, NB_PKT_BATCH, buf, sizeof buf);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    ns = elapsed_ns(start, end) / ((double)nb_loop * NB_PKT_BATCH);
+
+    if ((n != n_ref) || (memcmp(buf, buf_ref, n) != 0)) {
+        printf("FAILED: batch mismatch\n");
+        return EXIT_FAILURE;
+    }
+    printf("snprintf:        %.0f ns/packet\n", ns_ref);
+    printf("rxpk_serialize:  %.0f ns/packet (x%.1f)\n", ns, ns_ref / ns);
+
+    return EXIT_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
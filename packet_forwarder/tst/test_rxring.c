@@ -0,0 +1,201 @@
+/*!
+ * \brief     Check the queue of received packets, alone and between two threads
+ *
+ * License: Revised BSD 3-Clause License, see LICENSE.TXT file include in the project
+ */
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf */
+#include <stdlib.h>     /* EXIT_FAILURE */
+#include <string.h>     /* memset */
+#include <unistd.h>     /* getopt */
+#include <pthread.h>
+#include <sched.h>      /* sched_yield */
+
+#include "rxring.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static struct rx_ring_s ring;
+static unsigned int nb_loop = 1000000;
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* describe command line options */
+void usage(void) {
+    printf("Available options:\n");
+    printf(" -h print this help\n");
+    printf(" -n <uint>  number of packets sent from a thread to another one [1..]\n");
+}
+
+/* push a packet numbered by its count_us, return -1 if the ring is full */
+static int push(uint32_t n) {
+    struct lgw_pkt_rx_ref_s *p;
+
+    p = rx_ring_reserve(&ring);
+    if (p == NULL) {
+        return -1;
+    }
+    memset(p, 0, sizeof *p);
+    p->count_us = n;
+    rx_ring_commit(&ring, (uint64_t)n * 10);
+    return 0;
+}
+
+static int check_ring(void) {
+    uint32_t nb_drop, nb_max;
+    uint32_t i, n = 0, m = 0;
+    int nb_err = 0;
+
+    rx_ring_init(&ring);
+    if ((rx_ring_count(&ring) != 0) || (rx_ring_reserve(&ring) == NULL)) {
+        printf("ERROR: new ring is not empty\n");
+        nb_err += 1;
+    }
+
+    /* fill the ring, the next packet is dropped */
+    for (i = 0; i < RX_RING_SIZE; i++) {
+        if (push(n++) != 0) {
+            printf("ERROR: packet %u not queued\n", i);
+            nb_err += 1;
+        }
+    }
+    if ((push(n) == 0) || (rx_ring_count(&ring) != RX_RING_SIZE)) {
+        printf("ERROR: packet queued in a full ring\n");
+        nb_err += 1;
+    }
+    rx_ring_get_stats(&ring, &nb_drop, &nb_max);
+    if ((nb_drop != 1) || (nb_max != RX_RING_SIZE)) {
+        printf("ERROR: counters of a full ring are %u dropped, %u max\n", nb_drop, nb_max);
+        nb_err += 1;
+    }
+
+    /* pop some, fill again so that the ring wraps, packets are read in order */
+    rx_ring_pop(&ring, RX_RING_SIZE / 2 + 3);
+    m += RX_RING_SIZE / 2 + 3;
+    for (i = 0; i < (RX_RING_SIZE / 2 + 3); i++) {
+        push(n++);
+    }
+    if (rx_ring_count(&ring) != RX_RING_SIZE) {
+        printf("ERROR: %u packets in the ring after the wrap\n", rx_ring_count(&ring));
+        nb_err += 1;
+    }
+    for (i = 0; i < rx_ring_count(&ring); i++) {
+        if ((rx_ring_peek(&ring, i)->count_us != (m + i)) || (rx_ring_time(&ring, i) != ((uint64_t)(m + i) * 10))) {
+            printf("ERROR: packet %u of the ring is %u\n", i, rx_ring_peek(&ring, i)->count_us);
+            nb_err += 1;
+            break;
+        }
+    }
+
+    /* empty it */
+    rx_ring_pop(&ring, rx_ring_count(&ring));
+    rx_ring_get_stats(&ring, &nb_drop, &nb_max);
+    if ((rx_ring_count(&ring) != 0) || (nb_drop != 0)) {
+        printf("ERROR: ring not empty after the last pop\n");
+        nb_err += 1;
+    }
+
+    return nb_err;
+}
+
+/* producer, as the fetch thread: a full ring is retried after giving the CPU to the consumer */
+static void * thread_push(void *arg) {
+    uint32_t n;
+
+    (void)arg;
+    for (n = 0; n < nb_loop; ) {
+        if (push(n) == 0) {
+            n += 1;
+        } else {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+/* consumer, as the upstream thread: every packet is received once, in order */
+static int check_threads(void) {
+    pthread_t thrid;
+    uint32_t i, nb, n = 0;
+    int nb_err = 0;
+
+    rx_ring_init(&ring);
+    if (pthread_create(&thrid, NULL, thread_push, NULL) != 0) {
+        printf("ERROR: impossible to create the producer thread\n");
+        return 1;
+    }
+    while (n < nb_loop) {
+        nb = rx_ring_count(&ring);
+        for (i = 0; i < nb; i++) {
+            if (rx_ring_peek(&ring, i)->count_us != (n + i)) {
+                nb_err += 1;
+            }
+        }
+        rx_ring_pop(&ring, nb);
+        n += nb;
+        if (nb == 0) {
+            sched_yield();
+        }
+    }
+    pthread_join(thrid, NULL);
+
+    if (nb_err > 0) {
+        printf("ERROR: %d packets out of order between the threads\n", nb_err);
+    }
+    return nb_err;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv) {
+    int i, j;
+    unsigned int arg_u;
+    int nb_err;
+
+    /* parse command line options */
+    while ((i = getopt (argc, argv, "hn:")) != -1) {
+        switch (i) {
+            case 'h':
+                usage();
+                return EXIT_SUCCESS;
+            case 'n':
+                j = sscanf(optarg, "%u", &arg_u);
+                if ((j != 1) || (arg_u < 1)) {
+                    printf("ERROR: argument parsing of -n argument. Use -h to print help\n");
+                    return EXIT_FAILURE;
+                }
+                nb_loop = arg_u;
+                break;
+            default:
+                printf("ERROR: argument parsing\n");
+                usage();
+                return EXIT_FAILURE;
+        }
+    }
+
+    nb_err = check_ring() + check_threads();
+    if (nb_err > 0) {
+        printf("FAILED: %d errors\n", nb_err);
+        return EXIT_FAILURE;
+    }
+    printf("RX ring is consistent, also between two threads\n");
+
+    return EXIT_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,209 @@
+/*!
+ * \brief     Check the txpk parser on PULL_RESP payloads, against parson
+ *
+ * License: Revised BSD 3-Clause License, see LICENSE.TXT file include in the project
+ */
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf */
+#include <stdlib.h>     /* EXIT_FAILURE */
+#include <unistd.h>     /* getopt */
+#include <string.h>     /* memcmp */
+
+#include "loragw_hal.h"
+#include "parson.h"
+#include "base64.h"
+#include "txpk.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define TXPK_REF    "{\"txpk\":{\"imme\":false,\"tmst\":3512348611,\"freq\":2425.5,\"rfch\":0,\"powe\":10,\"modu\":\"LORA\",\"datr\":\"SF7BW812\",\"codr\":\"4/8LI\",\"ipol\":true,\"prea\":12,\"size\":32,\"data\":\"H3P3N2i9qc4yt7rK7ldqoeCVJGBybzPY5h1Dd7P7p8v=\"}}"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+struct test_case_s {
+    const char *json;
+    enum txpk_error_e err;
+    const char *field;
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static const struct test_case_s test_cases[] = {
+    { TXPK_REF, TXPK_OK, NULL },
+    { "{\"txpk\":{\"tmst\":1,\"freq\":2403,\"brd\":3,\"datr\":\"SF5BW812\",\"codr\":\"4\\/8LI\",\"size\":3,\"data\":\"\\/\\/\\/\\/\"}}", TXPK_OK, NULL },
+    { "/* comment */ { \"txpk\" : { \"imme\" : true , \"freq\" : 2403 , \"datr\" : \"SF12BW800\" , \"codr\" : \"4/7LI\" , // comment\n \"size\" : 0 , \"data\" : \"\" } }", TXPK_OK, NULL },
+    { "{\"other\":{\"a\":[1,{\"b\":\"}\\\"\"},null,-1.5e3]},\"txpk\":{\"tmst\":1,\"freq\":2403,\"datr\":\"SF5BW812\",\"codr\":\"4/8LI\",\"size\":1,\"data\":\"AA==\"}}", TXPK_OK, NULL },
+    { "{\"txpk\":{\"tmst\":1,\"freq\":2403,\"datr\":\"SF5BW812\",\"codr\":\"4/8LI\",\"size\":1,\"data\":\"AA==\"}", TXPK_ERROR_JSON, NULL },
+    { "{\"txpk\":{\"tmst\":1,\"freq\":2403,\"datr\":\"SF5BW812\",\"codr\":\"4/8LI\",\"size\":1,\"data\":\"AA==}}", TXPK_ERROR_JSON, NULL },
+    { "{\"rxpk\":{}}", TXPK_ERROR_NO_TXPK, NULL },
+    { "{\"txpk\":[]}", TXPK_ERROR_NO_TXPK, NULL },
+    { "{\"txpk\":{\"tmst\":1,\"datr\":\"SF5BW812\",\"codr\":\"4/8LI\",\"size\":1,\"data\":\"AA==\"}}", TXPK_ERROR_MISSING, "freq" },
+    { "{\"txpk\":{\"tmst\":1,\"freq\":2403,\"datr\":\"SF5BW812\",\"codr\":\"4/8LI\",\"size\":1}}", TXPK_ERROR_MISSING, "data" },
+    { "{\"txpk\":{\"tmst\":1,\"freq\":2403,\"datr\":\"SF13BW812\",\"codr\":\"4/8LI\",\"size\":1,\"data\":\"AA==\"}}", TXPK_ERROR_FORMAT, "datr" },
+    { "{\"txpk\":{\"tmst\":1,\"freq\":2403,\"datr\":\"SF5BW400\",\"codr\":\"4/8LI\",\"size\":1,\"data\":\"AA==\"}}", TXPK_ERROR_FORMAT, "datr" },
+    { "{\"txpk\":{\"tmst\":1,\"freq\":2403,\"datr\":\"SF5BW812\",\"codr\":\"4/5\",\"size\":1,\"data\":\"AA==\"}}", TXPK_ERROR_FORMAT, "codr" },
+    { "{\"txpk\":{\"tmst\":1,\"freq\":2403,\"datr\":\"SF5BW812\",\"codr\":\"4/8LI\",\"brd\":256,\"size\":1,\"data\":\"AA==\"}}", TXPK_ERROR_FORMAT, "brd" },
+    { "{\"txpk\":{\"tmst\":\"1\",\"freq\":2403,\"datr\":\"SF5BW812\",\"codr\":\"4/8LI\",\"size\":1,\"data\":\"AA==\"}}", TXPK_ERROR_FORMAT, "tmst" },
+    { "{\"txpk\":{\"tmst\":1,\"freq\":2403,\"datr\":\"SF5BW812\",\"codr\":\"4/8LI\",\"size\":1,\"data\":\"A*==\"}}", TXPK_ERROR_FORMAT, "data" },
+};
+
+/* PULL_RESP with several txpk, the second one being invalid */
+#define TXPK_BATCH  "{\"txpk\":[{\"imme\":true,\"freq\":2403,\"datr\":\"SF5BW812\",\"codr\":\"4/8LI\",\"size\":1,\"data\":\"AA==\"}, " \
+                    "{\"tmst\":2,\"freq\":2403,\"datr\":\"SF13BW812\",\"codr\":\"4/8LI\",\"size\":1,\"data\":\"AA==\"}," \
+                    "{\"tmst\":3,\"freq\":2425,\"brd\":1,\"datr\":\"SF12BW812\",\"codr\":\"4/8LI\",\"size\":2,\"data\":\"AAE=\"}]}"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* describe command line options */
+void usage(void) {
+    printf("Available options:\n");
+    printf(" -h print this help\n");
+}
+
+/* reference parsing with parson, as originally done by the packet forwarder */
+static int parse_ref(const char *json, struct lgw_pkt_tx_s *pkt) {
+    JSON_Value *root_val;
+    JSON_Object *txpk_obj;
+    const char *str;
+
+    memset(pkt, 0, sizeof *pkt);
+    root_val = json_parse_string_with_comments(json);
+    if (root_val == NULL) {
+        return -1;
+    }
+    txpk_obj = json_object_get_object(json_value_get_object(root_val), "txpk");
+    if (txpk_obj == NULL) {
+        json_value_free(root_val);
+        return -1;
+    }
+    pkt->count_us = (uint32_t)json_object_get_number(txpk_obj, "tmst");
+    pkt->freq_hz = (uint32_t)((double)(1.0e6) * json_object_get_number(txpk_obj, "freq"));
+    pkt->rf_power = (int8_t)json_object_get_number(txpk_obj, "powe");
+    pkt->datarate = DR_LORA_SF7;
+    pkt->bandwidth = BW_800KHZ;
+    pkt->coderate = CR_LORA_LI_4_8;
+    pkt->invert_pol = (bool)json_object_get_boolean(txpk_obj, "ipol");
+    pkt->preamble = (uint16_t)json_object_get_number(txpk_obj, "prea");
+    pkt->size = (uint16_t)json_object_get_number(txpk_obj, "size");
+    str = json_object_get_string(txpk_obj, "data");
+    b64_to_bin(str, strlen(str), pkt->payload, sizeof pkt->payload);
+    json_value_free(root_val);
+    return 0;
+}
+
+/* check the decoding of several txpk per PULL_RESP, return the number of errors */
+static int check_batch(void) {
+    struct lgw_pkt_tx_s pkt[3];
+    struct txpk_info_s info[3];
+    enum txpk_error_e err[3];
+    bool is_array;
+    int nb_err = 0;
+    int n;
+
+    if ((txpk_parse_batch(TXPK_BATCH, pkt, info, err, 3, &n, &is_array) != TXPK_OK) || (n != 3) || (is_array != true) ||
+        (err[0] != TXPK_OK) || (info[0].imme != true) || (pkt[0].datarate != DR_LORA_SF5) ||
+        (err[1] != TXPK_ERROR_FORMAT) || (strcmp(info[1].field, "datr") != 0) ||
+        (err[2] != TXPK_OK) || (pkt[2].count_us != 3) || (pkt[2].freq_hz != 2425000000) || (info[2].brd != 1) ||
+        (pkt[2].size != 2) || (info[2].data_size != 2) || (pkt[2].payload[1] != 1)) {
+        printf("ERROR: txpk array not decoded as expected\n");
+        nb_err += 1;
+    }
+
+    /* only the first packets are decoded if the arrays are too small, all are counted */
+    if ((txpk_parse_batch(TXPK_BATCH, pkt, info, err, 1, &n, &is_array) != TXPK_OK) || (n != 3) || (err[0] != TXPK_OK)) {
+        printf("ERROR: txpk array bigger than the batch not detected\n");
+        nb_err += 1;
+    }
+
+    /* a single txpk object is a batch of one */
+    if ((txpk_parse_batch(TXPK_REF, pkt, info, err, 3, &n, &is_array) != TXPK_OK) || (n != 1) || (is_array != false) ||
+        (err[0] != TXPK_OK) || (pkt[0].count_us != 3512348611U) || (pkt[0].size != 32)) {
+        printf("ERROR: single txpk not decoded as a batch\n");
+        nb_err += 1;
+    }
+
+    /* errors of the whole datagram */
+    if ((txpk_parse_batch("{\"txpk\":[]}", pkt, info, err, 3, &n, &is_array) != TXPK_ERROR_NO_TXPK) ||
+        (txpk_parse_batch("{\"txpk\":[{\"tmst\":1},1]}", pkt, info, err, 3, &n, &is_array) != TXPK_ERROR_JSON) ||
+        (txpk_parse_batch("{\"txpk\":[{\"tmst\":1,\"freq\":\"x\"} {\"tmst\":1}]}", pkt, info, err, 3, &n, &is_array) != TXPK_ERROR_JSON)) {
+        printf("ERROR: invalid txpk array not detected\n");
+        nb_err += 1;
+    }
+
+    return nb_err;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv) {
+    int i;
+    unsigned int k;
+    unsigned int nb_err = 0;
+    enum txpk_error_e err;
+    struct txpk_info_s info;
+    struct lgw_pkt_tx_s pkt, pkt_ref;
+
+    /* parse command line options */
+    while ((i = getopt (argc, argv, "h")) != -1) {
+        switch (i) {
+            case 'h':
+                usage();
+                return EXIT_SUCCESS;
+            default:
+                printf("ERROR: argument parsing\n");
+                usage();
+                return EXIT_FAILURE;
+        }
+    }
+
+    /* check error detection */
+    for (k = 0; k < sizeof test_cases / sizeof test_cases[0]; k++) {
+        err = txpk_parse(test_cases[k].json, &pkt, &info);
+        if ((err != test_cases[k].err) || ((test_cases[k].field != NULL) && ((info.field == NULL) || (strcmp(info.field, test_cases[k].field) != 0)))) {
+            printf("ERROR: case %u returned %d (field %s), %d (field %s) expected\n", k, err, (info.field != NULL) ? info.field : "-",
+                   test_cases[k].err, (test_cases[k].field != NULL) ? test_cases[k].field : "-");
+            nb_err += 1;
+        }
+    }
+
+    /* check decoded fields against parson */
+    parse_ref(TXPK_REF, &pkt_ref);
+    txpk_parse(TXPK_REF, &pkt, &info);
+    if ((pkt.count_us != pkt_ref.count_us) || (pkt.freq_hz != pkt_ref.freq_hz) || (pkt.rf_power != pkt_ref.rf_power) ||
+        (pkt.datarate != pkt_ref.datarate) || (pkt.bandwidth != pkt_ref.bandwidth) || (pkt.coderate != pkt_ref.coderate) ||
+        (pkt.invert_pol != pkt_ref.invert_pol) || (pkt.preamble != pkt_ref.preamble) || (pkt.size != pkt_ref.size) ||
+        (info.data_size != pkt.size) || (memcmp(pkt.payload, pkt_ref.payload, pkt.size) != 0) || (info.imme != false) ||
+        (info.fields & TXPK_FIELD_NCRC) || !(info.fields & TXPK_FIELD_TMST) || (info.brd != 0)) {
+        printf("ERROR: decoded packet is different from parson\n");
+        nb_err += 1;
+    }
+
+    nb_err += check_batch();
+
+    if (nb_err > 0) {
+        printf("FAILED: %u errors\n", nb_err);
+        return EXIT_FAILURE;
+    }
+    printf("txpk parser checks passed\n");
+
+    return EXIT_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
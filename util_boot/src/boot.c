@@ -56,7 +56,7 @@ void usage(void) {
 int main(int argc, char **argv)
 {
     int i, x;
-    int fd;
+    static s_mcu mcu;
 
     /* SPI interfaces */
     const char tty_path_default[] = TTY_PATH_DEFAULT;
@@ -88,21 +88,21 @@ int main(int argc, char **argv)
     }
 
     /*  */
-    fd = mcu_open(tty_path);
-    if (fd == -1) {
+    x = mcu_open(&mcu, tty_path);
+    if (x != 0) {
         printf("ERROR: failed to connect\n");
         return EXIT_FAILURE;
     }
 
     /*  */
-    x = mcu_boot(fd);
+    x = mcu_boot(&mcu);
     if (x != 0) {
         printf("ERROR: failed to connect\n");
         return EXIT_FAILURE;
     }
 
     /*  */
-    x = mcu_close(fd);
+    x = mcu_close(&mcu);
     if (x != 0) {
         printf("ERROR: failed to disconnect\n");
         return EXIT_FAILURE;
@@ -0,0 +1,864 @@
+/*!
+ * \brief     Simulator of the concentrator MCU, on a pseudo-terminal, to run
+ *            the HAL and the packet forwarder without hardware
+ *
+ * License: Revised BSD 3-Clause License, see LICENSE.TXT file include in the project
+ */
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* posix_openpt, ptsname, cfmakeraw and ppoll are not part of C99 */
+#define _GNU_SOURCE
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>   /* PRIu64 */
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>       /* ppoll */
+#include <termios.h>
+#include <signal.h>     /* sigaction */
+
+#include "loragw_hal.h"
+#include "loragw_mcu.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#define RAND_RANGE(min, max) (rand() % (max + 1 - min) + min)
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define TTY_LINK_DEFAULT    "/tmp/ttyMCU"
+#define MCU_VERSION         "V01.00.01" /* must match the version expected by the HAL */
+
+#define NB_RADIO_TX         1
+#define NB_RADIO_RX         NB_RADIO_RX_MAX
+
+#define RX_FIFO_MAX         255     /* lost messages are counted on a byte */
+#define OUT_QUEUE_NB        512     /* frames waiting for their latency to elapse */
+#define IN_BUF_SIZE         (2 * (CMD_OFFSET__DATA + MCU_WRITE_SIZE_MAX))
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+struct sim_pkt_s {
+    uint8_t     radio;
+    uint32_t    count_us;
+    int32_t     freq_offset;
+    int8_t      snr;
+    int8_t      rssi;
+    uint8_t     size;
+    uint8_t     payload[255];
+};
+
+struct sim_radio_s {
+    bool        on;             /* configured by a CONFIG_RX request */
+    uint32_t    freq_hz;
+    uint16_t    preamble;
+    uint8_t     sf;
+    uint8_t     bw;
+    double      rate;           /* uplinks per second */
+    bool        rx_busy;        /* a packet is being received */
+    uint8_t     rx_size;
+    uint64_t    rx_start;       /* host time of the packet being received */
+    uint64_t    rx_end;
+    uint64_t    next;           /* host time of the next packet on air */
+    uint16_t    fcnt;
+    uint16_t    nb_crc_ok;      /* wraps, as the MCU counters */
+    uint16_t    nb_crc_err;
+    uint64_t    nb_gen;         /* statistics */
+    uint64_t    nb_deliv;
+    uint64_t    nb_lost;
+    uint64_t    nb_half_duplex;
+};
+
+struct sim_tx_s {
+    e_tx_msg_status status;
+    uint64_t    start;          /* host time of the start and end of the emission */
+    uint64_t    end;
+    uint32_t    start_cnt;      /* counter value at the start of the emission */
+    uint64_t    nb_req;         /* statistics */
+    uint64_t    nb_done;
+    uint64_t    nb_late;
+};
+
+struct sim_out_s {
+    uint64_t    due;            /* host time the frame is written at */
+    uint16_t    size;
+    uint8_t     buf[CMD_OFFSET__DATA + MCU_READ_SIZE_MAX];
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static int exit_sig = 0; /* 1 -> application terminates cleanly */
+
+static int fd_master = -1;
+
+/* simulation parameters */
+static bool push_evt = false;
+static bool tx_on_pps = false;
+static unsigned fifo_size = 16;
+static unsigned rx_msg_max = 8;
+static unsigned size_min = 16;
+static unsigned size_max = 32;
+static unsigned crc_err_pct = 0;
+static unsigned latency_us = 0;
+static unsigned jitter_us = 0;
+static double drift = 1.0;
+
+/* simulation state */
+static uint64_t t0;
+static struct sim_radio_s radio[NB_RADIO_RX];
+static struct sim_tx_s tx;
+static struct sim_pkt_s fifo[RX_FIFO_MAX];
+static unsigned fifo_start = 0;
+static unsigned fifo_nb = 0;
+static unsigned fifo_lost = 0;
+static uint8_t evt_id = 0;
+
+static struct sim_out_s out[OUT_QUEUE_NB];
+static unsigned out_start = 0;
+static unsigned out_nb = 0;
+static uint64_t out_last_due = 0;
+
+static uint64_t nb_req[256];
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS ---------------------------------------------------- */
+
+/* describe command line options */
+static void usage(void) {
+    printf("Library version information: %s\n", lgw_version_info());
+    printf("Available options:\n");
+    printf(" -h print this help\n");
+    printf(" -l [path]     link to the simulated TTY, to be used as tty_path (default %s)\n", TTY_LINK_DEFAULT);
+    printf(" -r [r0,r1,r2] uplinks per second on each RX radio, a single value for all (default 0)\n");
+    printf(" -z [min:max]  payload size range of the uplinks, in bytes (default 16:32)\n");
+    printf(" -c [pct]      percentage of uplinks received with a CRC error (default 0)\n");
+    printf(" -e            push the uplinks and TX status as events (for rx_event_mode)\n");
+    printf(" -q [nb]       depth of the RX FIFO, full FIFO loses uplinks (default 16, max %d)\n", RX_FIFO_MAX);
+    printf(" -m [nb]       max messages returned by a GET_RX_MSG request (default 8)\n");
+    printf(" -a [us]       latency added to every answer and event (default 0)\n");
+    printf(" -j [us]       random jitter added to the latency (default 0)\n");
+    printf(" -p [ppm]      drift of the MCU counter (default 0)\n");
+    printf(" -w            the TX start is wired to the PPS input\n");
+    printf(" -s [sec]      statistics period, 0 to disable (default 10)\n");
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void sig_handler(int sigio) {
+    (void)sigio;
+    exit_sig = 1;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static uint64_t host_us(void) {
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000 + (uint64_t)(t.tv_nsec / 1000);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* MCU counter at a host time */
+static uint32_t count_of(uint64_t host) {
+    return (uint32_t)(uint64_t)((double)(host - t0) * drift);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* host time of a counter value, the closer one around now (counter wraps) */
+static uint64_t host_of(uint32_t count, uint64_t now) {
+    int32_t delta = (int32_t)(count - count_of(now));
+
+    return (uint64_t)((int64_t)now + (int64_t)((double)delta / drift));
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* exponential inter-arrival time, for a Poisson traffic */
+static uint64_t next_arrival(double rate) {
+    double u = ((double)rand() + 1.0) / ((double)RAND_MAX + 2.0);
+
+    return (uint64_t)(-log(u) / rate * 1e6);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static inline void put_u32_be(uint8_t * buf, uint32_t v) {
+    buf[0] = (uint8_t)(v >> 24);
+    buf[1] = (uint8_t)(v >> 16);
+    buf[2] = (uint8_t)(v >> 8);
+    buf[3] = (uint8_t)(v >> 0);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void out_flush(uint64_t now) {
+    struct sim_out_s * o;
+    ssize_t n;
+    size_t done;
+
+    while ((out_nb > 0) && (out[out_start].due <= now)) {
+        o = &out[out_start];
+        for (done = 0; done < o->size; done += (size_t)n) {
+            n = write(fd_master, o->buf + done, o->size - done);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    n = 0;
+                    continue;
+                }
+                printf("ERROR: failed to write on the TTY: %s\n", strerror(errno));
+                exit_sig = 1;
+                return;
+            }
+        }
+        out_start = (out_start + 1) % OUT_QUEUE_NB;
+        out_nb -= 1;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* queue a frame, written once the latency elapsed, in order as on a serial link */
+static uint8_t * out_frame(uint8_t id, e_order_cmd cmd, uint16_t size, uint64_t now) {
+    struct sim_out_s * o;
+    uint64_t due;
+
+    if (out_nb == OUT_QUEUE_NB) {
+        out_flush(UINT64_MAX); /* the host is not reading, stop delaying */
+    }
+
+    due = now + latency_us + ((jitter_us > 0) ? (uint64_t)(rand() % (jitter_us + 1)) : 0);
+    if (due < out_last_due) {
+        due = out_last_due;
+    }
+    out_last_due = due;
+
+    o = &out[(out_start + out_nb) % OUT_QUEUE_NB];
+    out_nb += 1;
+    o->due = due;
+    o->size = CMD_OFFSET__DATA + size;
+    o->buf[CMD_OFFSET__ID] = id;
+    o->buf[CMD_OFFSET__SIZE_MSB] = (uint8_t)(size >> 8);
+    o->buf[CMD_OFFSET__SIZE_LSB] = (uint8_t)(size >> 0);
+    o->buf[CMD_OFFSET__CMD] = (uint8_t)cmd;
+    memset(o->buf + CMD_OFFSET__DATA, 0, size);
+
+    return o->buf + CMD_OFFSET__DATA;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void out_evt_msg(const struct sim_pkt_s * pkt, uint64_t now) {
+    uint8_t * p;
+
+    p = out_frame(evt_id++, ORDER_ID__EVT_MSG_RECEIVE, EVT_MSG_RECEIVE__PAYLOAD + pkt->size, now);
+    p[EVT_MSG_RECEIVE__RADIO_IDX] = pkt->radio;
+    put_u32_be(&p[EVT_MSG_RECEIVE__TIMESTAMP_31_24], pkt->count_us);
+    put_u32_be(&p[EVT_MSG_RECEIVE__ERROR_FREQ_31_24], (uint32_t)pkt->freq_offset);
+    p[EVT_MSG_RECEIVE__SNR] = (uint8_t)pkt->snr;
+    p[EVT_MSG_RECEIVE__RSSI] = (uint8_t)pkt->rssi;
+    p[EVT_MSG_RECEIVE__PAYLOAD_LEN] = pkt->size;
+    memcpy(&p[EVT_MSG_RECEIVE__PAYLOAD], pkt->payload, pkt->size);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static uint32_t radio_toa(const struct sim_radio_s * r, uint8_t size) {
+    struct lgw_pkt_tx_s pkt;
+
+    memset(&pkt, 0, sizeof pkt);
+    pkt.bandwidth = (e_bandwidth)r->bw;
+    pkt.datarate = (e_spreading_factor)r->sf;
+    pkt.coderate = CR_LORA_LI_4_8;
+    pkt.preamble = r->preamble;
+    pkt.size = size;
+
+    return lgw_time_on_air_us(&pkt);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* build the uplink received by a radio, a LoRaWAN unconfirmed data up frame */
+static void rx_complete(int i, uint64_t now) {
+    struct sim_radio_s * r = &radio[i];
+    struct sim_pkt_s * pkt;
+    uint8_t size;
+    int j;
+
+    r->rx_busy = false;
+
+    /* no reception while the TX is on air */
+    if ((tx.status == TX_STATUS__ON_AIR || tx.status == TX_STATUS__DONE) && (tx.start < r->rx_end) && (tx.end > r->rx_start)) {
+        r->nb_half_duplex += 1;
+        return;
+    }
+    if ((crc_err_pct > 0) && ((unsigned)(rand() % 100) < crc_err_pct)) {
+        r->nb_crc_err += 1;
+        return;
+    }
+    r->nb_crc_ok += 1;
+
+    if (push_evt == false && fifo_nb == fifo_size) {
+        fifo_lost += 1;
+        r->nb_lost += 1;
+        return;
+    }
+
+    pkt = &fifo[(fifo_start + fifo_nb) % RX_FIFO_MAX];
+    size = r->rx_size;
+    pkt->radio = (uint8_t)i;
+    pkt->count_us = count_of(r->rx_end);
+    pkt->freq_offset = RAND_RANGE(-5000, 5000);
+    pkt->snr = (int8_t)RAND_RANGE(-5, 12);
+    pkt->rssi = (int8_t)RAND_RANGE(-110, -50);
+    pkt->size = size;
+    pkt->payload[0] = 0x40; /* MHDR: unconfirmed data up */
+    pkt->payload[1] = (uint8_t)(r->fcnt & 0xFF); /* DevAddr, one device per 256 frames */
+    pkt->payload[2] = (uint8_t)i;
+    pkt->payload[3] = 0x00;
+    pkt->payload[4] = 0x26;
+    pkt->payload[5] = 0x00; /* FCtrl */
+    pkt->payload[6] = (uint8_t)(r->fcnt >> 8); /* FCnt */
+    pkt->payload[7] = (uint8_t)(r->fcnt >> 0);
+    pkt->payload[8] = 1; /* FPort */
+    for (j = 9; j < size; j++) {
+        pkt->payload[j] = (uint8_t)rand(); /* FRMPayload and MIC */
+    }
+    r->fcnt += 1;
+    r->nb_deliv += 1;
+
+    if (push_evt == true) {
+        out_evt_msg(pkt, now);
+    } else {
+        fifo_nb += 1;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void tx_update(uint64_t now) {
+    uint8_t * p;
+
+    if (tx.status == TX_STATUS__LOADED && now >= tx.start) {
+        tx.status = TX_STATUS__ON_AIR;
+    }
+    if (tx.status == TX_STATUS__ON_AIR && now >= tx.end) {
+        tx.status = TX_STATUS__DONE;
+        tx.nb_done += 1;
+        if (push_evt == true) {
+            p = out_frame(evt_id++, ORDER_ID__EVT_TX_STATUS, ACK_GET_TX_STATUS_SIZE, now);
+            p[ACK_GET_TX_STATUS__STATUS] = TX_STATUS__DONE;
+        }
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* run the radios and the TX up to now, return the host time of the next change */
+static uint64_t sim_update(uint64_t now) {
+    uint64_t next = UINT64_MAX;
+    struct sim_radio_s * r;
+    uint32_t toa;
+    int i;
+
+    tx_update(now);
+    if (tx.status == TX_STATUS__LOADED) {
+        next = tx.start;
+    } else if (tx.status == TX_STATUS__ON_AIR) {
+        next = tx.end;
+    }
+
+    for (i = 0; i < NB_RADIO_RX; i++) {
+        r = &radio[i];
+        if (r->on == false || r->rate <= 0.0) {
+            continue;
+        }
+        if (r->rx_busy == true && now >= r->rx_end) {
+            rx_complete(i, now);
+        }
+        if (r->rx_busy == false && now >= r->next) {
+            r->rx_size = (uint8_t)RAND_RANGE((int)size_min, (int)size_max);
+            toa = radio_toa(r, r->rx_size);
+            r->rx_busy = true;
+            r->rx_start = r->next;
+            r->rx_end = r->next + toa;
+            r->next = r->rx_end + next_arrival(r->rate);
+            r->nb_gen += 1;
+        }
+        if (r->rx_busy == true && r->rx_end < next) {
+            next = r->rx_end;
+        }
+        if (r->rx_busy == false && r->next < next) {
+            next = r->next;
+        }
+    }
+
+    return next;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void handle_req(uint8_t id, uint8_t cmd, const uint8_t * req, uint16_t size, uint64_t now) {
+    struct sim_radio_s * r;
+    struct lgw_pkt_tx_s pkt;
+    uint16_t nb_bytes;
+    unsigned nb, i;
+    uint8_t * p;
+
+    nb_req[cmd] += 1;
+
+    switch (cmd) {
+        case ORDER_ID__REQ_PING:
+            p = out_frame(id, ORDER_ID__ACK_PING, ACK_PING_SIZE, now);
+            for (i = 0; i < 12; i++) {
+                p[ACK_PING__UNIQUE_ID_0 + i] = (uint8_t)(0xA0 + i);
+            }
+            memcpy(&p[ACK_PING__VERSION_0], MCU_VERSION, 9);
+            p[ACK_PING__NB_RADIO_TX] = NB_RADIO_TX;
+            p[ACK_PING__NB_RADIO_RX] = NB_RADIO_RX;
+            break;
+
+        case ORDER_ID__REQ_CONFIG_RX:
+            p = out_frame(id, ORDER_ID__ACK_CONFIG_RX, ACK_CONFIG_RX_SIZE, now);
+            if ((size < REQ_CONF_RX_SIZE) || (req[REQ_CONF_RX__RADIO_IDX] >= NB_RADIO_RX)) {
+                p[ACK_CONFIG_RX__STATUS] = CONFIG_RX_SATUS__ERROR_PARAM;
+                break;
+            }
+            r = &radio[req[REQ_CONF_RX__RADIO_IDX]];
+            r->freq_hz = ((uint32_t)req[REQ_CONF_RX__FREQ_31_24] << 24) | ((uint32_t)req[REQ_CONF_RX__FREQ_23_16] << 16) |
+                         ((uint32_t)req[REQ_CONF_RX__FREQ_15_8] << 8) | ((uint32_t)req[REQ_CONF_RX__FREQ_7_0] << 0);
+            r->preamble = (uint16_t)((req[REQ_CONF_RX__PREAMBLE_LEN_15_8] << 8) | req[REQ_CONF_RX__PREAMBLE_LEN_7_0]);
+            r->sf = req[REQ_CONF_RX__SF];
+            r->bw = req[REQ_CONF_RX__BW];
+            r->on = (radio_toa(r, (uint8_t)size_max) > 0);
+            r->rx_busy = false;
+            r->next = now + ((r->rate > 0.0) ? next_arrival(r->rate) : 0);
+            p[ACK_CONFIG_RX__STATUS] = (r->on == true) ? CONFIG_RX_SATUS__DONE : CONFIG_RX_SATUS__ERROR_PARAM;
+            break;
+
+        case ORDER_ID__REQ_PREPARE_TX:
+            p = out_frame(id, ORDER_ID__ACK_PREPARE_TX, ACK_PREPARE_TX_SIZE, now);
+            if ((size < REQ_PREPARE_TX__PAYLOAD) || (size < REQ_PREPARE_TX__PAYLOAD + req[REQ_PREPARE_TX__PAYLOAD_LEN])) {
+                p[ACK_PREPARE_TX__STATUS] = PREPARE_TX_STATUS__INVALID;
+                break;
+            }
+            memset(&pkt, 0, sizeof pkt);
+            pkt.bandwidth = (e_bandwidth)req[REQ_PREPARE_TX__BW];
+            pkt.datarate = (e_spreading_factor)req[REQ_PREPARE_TX__SF];
+            pkt.coderate = (e_coding_rate)(req[REQ_PREPARE_TX__CR] + 1);
+            pkt.no_header = (req[REQ_PREPARE_TX__USE_IMPLICIT_HEADER] != 0);
+            pkt.no_crc = (req[REQ_PREPARE_TX__USE_CRC] == 0);
+            pkt.preamble = (uint16_t)((req[REQ_PREPARE_TX__PREAMBLE_15_8] << 8) | req[REQ_PREPARE_TX__PREAMBLE_7_0]);
+            pkt.size = req[REQ_PREPARE_TX__PAYLOAD_LEN];
+            tx.nb_req += 1;
+            tx.end = lgw_time_on_air_us(&pkt);
+            if (tx.end == 0) {
+                p[ACK_PREPARE_TX__STATUS] = PREPARE_TX_STATUS__INVALID;
+                tx.status = TX_STATUS__ERROR_PARAM;
+                break;
+            }
+            if (req[REQ_PREPARE_TX__MSG_IS_TIMESTAMP] != 0) {
+                tx.start_cnt = ((uint32_t)req[REQ_PREPARE_TX__TIMESTAMP_31_24] << 24) | ((uint32_t)req[REQ_PREPARE_TX__TIMESTAMP_23_16] << 16) |
+                               ((uint32_t)req[REQ_PREPARE_TX__TIMESTAMP_15_8] << 8) | ((uint32_t)req[REQ_PREPARE_TX__TIMESTAMP_7_0] << 0);
+                tx.start = host_of(tx.start_cnt, now);
+            } else {
+                tx.start_cnt = count_of(now);
+                tx.start = now;
+            }
+            tx.end += tx.start;
+            if (tx.start < now) {
+                tx.nb_late += 1;
+                tx.status = TX_STATUS__ERROR_FAIL_TO_SEND;
+            } else {
+                tx.status = TX_STATUS__LOADED; /* replaces the one not sent yet, if any */
+            }
+            p[ACK_PREPARE_TX__STATUS] = PREPARE_TX_STATUS__OK;
+            break;
+
+        case ORDER_ID__REQ_GET_STATUS:
+            p = out_frame(id, ORDER_ID__ACK_GET_STATUS, ACK_GET_STATUS__RX_STATUS + 4 * NB_RADIO_RX, now);
+            put_u32_be(&p[ACK_GET_STATUS__SYSTEM_TIME_31_24], (uint32_t)((now - t0) / 1000));
+            put_u32_be(&p[ACK_GET_STATUS__PRECISE_TIMER_31_24], count_of(now));
+            if (tx_on_pps == true && tx.nb_done > 0) {
+                p[ACK_GET_STATUS__PPS_STATUS] = PPS_STATUS__LOCK;
+                put_u32_be(&p[ACK_GET_STATUS__PPS_TIME_31_24], tx.start_cnt);
+            } else {
+                p[ACK_GET_STATUS__PPS_STATUS] = PPS_STATUS__NEVER_LOCK;
+            }
+            p[ACK_GET_STATUS__TEMPERATURE_STATUS] = 1;
+            p[ACK_GET_STATUS__TEMPERATURE_15_8] = (uint8_t)(2512 >> 8); /* 25.12 C */
+            p[ACK_GET_STATUS__TEMPERATURE_7_0] = (uint8_t)(2512 & 0xFF);
+            p[ACK_GET_STATUS__MCU_TEMPERATURE] = 30;
+            for (i = 0; i < NB_RADIO_RX; i++) {
+                p[ACK_GET_STATUS__RX_STATUS + 4 * i + 0] = (uint8_t)(radio[i].nb_crc_ok >> 8);
+                p[ACK_GET_STATUS__RX_STATUS + 4 * i + 1] = (uint8_t)(radio[i].nb_crc_ok >> 0);
+                p[ACK_GET_STATUS__RX_STATUS + 4 * i + 2] = (uint8_t)(radio[i].nb_crc_err >> 8);
+                p[ACK_GET_STATUS__RX_STATUS + 4 * i + 3] = (uint8_t)(radio[i].nb_crc_err >> 0);
+            }
+            break;
+
+        case ORDER_ID__REQ_GET_RX_MSG:
+            nb = (fifo_nb < rx_msg_max) ? fifo_nb : rx_msg_max;
+            nb_bytes = 0;
+            for (i = 0; i < nb; i++) {
+                nb_bytes += CMD_OFFSET__DATA + EVT_MSG_RECEIVE__PAYLOAD + fifo[(fifo_start + i) % RX_FIFO_MAX].size;
+            }
+            p = out_frame(id, ORDER_ID__ACK_GET_RX_MSG, ACK_GET_RX_MSG_SIZE, now);
+            p[ACK_GET_RX_MSG__NB_MSG] = (uint8_t)nb;
+            p[ACK_GET_RX_MSG__NB_BYTES_15_8] = (uint8_t)(nb_bytes >> 8);
+            p[ACK_GET_RX_MSG__NB_BYTES_7_0] = (uint8_t)(nb_bytes >> 0);
+            p[ACK_GET_RX_MSG__MSG_PENDING] = (fifo_nb > nb) ? 1 : 0;
+            p[ACK_GET_RX_MSG__LOST_MESSAGE] = (uint8_t)((fifo_lost < 255) ? fifo_lost : 255);
+            fifo_lost = 0;
+            for (i = 0; i < nb; i++) {
+                out_evt_msg(&fifo[fifo_start], now);
+                fifo_start = (fifo_start + 1) % RX_FIFO_MAX;
+                fifo_nb -= 1;
+            }
+            break;
+
+        case ORDER_ID__REQ_GET_TX_STATUS:
+            tx_update(now);
+            p = out_frame(id, ORDER_ID__ACK_GET_TX_STATUS, ACK_GET_TX_STATUS_SIZE, now);
+            p[ACK_GET_TX_STATUS__STATUS] = (uint8_t)tx.status;
+            break;
+
+        case ORDER_ID__REQ_RESET:
+            p = out_frame(id, ORDER_ID__ACK_RESET, ACK_RESET_SIZE, now);
+            if (size < REQ_RESET_SIZE) {
+                p[ACK_RESET__STATUS] = 1;
+                break;
+            }
+            if (req[REQ_RESET__TYPE] == RESET_TYPE__GTW || req[REQ_RESET__TYPE] == RESET_TYPE__TX) {
+                tx.status = TX_STATUS__IDLE;
+            }
+            if (req[REQ_RESET__TYPE] == RESET_TYPE__GTW || req[REQ_RESET__TYPE] == RESET_TYPE__RX_ALL) {
+                for (i = 0; i < NB_RADIO_RX; i++) {
+                    radio[i].on = false;
+                }
+                fifo_nb = 0;
+                fifo_lost = 0;
+            } else if (req[REQ_RESET__TYPE] >= RESET_TYPE__RX1 && req[REQ_RESET__TYPE] < RESET_TYPE__RX1 + NB_RADIO_RX) {
+                radio[req[REQ_RESET__TYPE] - RESET_TYPE__RX1].on = false;
+            }
+            p[ACK_RESET__STATUS] = 0;
+            break;
+
+        case ORDER_ID__REQ_SET_COEF_TEMP_RSSI:
+            (void)out_frame(id, ORDER_ID__ACK_SET_COEF_TEMP_RSSI, 0, now);
+            break;
+
+        case ORDER_ID__REQ_READ_REGS:
+            p = out_frame(id, ORDER_ID__ACK_READ_REGS, ACK_READ_REG_SIZE, now);
+            p[ACK_READ_REG__VALUE] = 0x55;
+            break;
+
+        case ORDER_ID__REQ_WRITE_REGS:
+            (void)out_frame(id, ORDER_ID__ACK_WRITE_REGS, ACK_WRITE_REG_SIZE, now);
+            break;
+
+        case ORDER_ID__REQ_BOOTLOADER_MODE:
+            (void)out_frame(id, ORDER_ID__ACK_BOOTLOADER_MODE, ACK_BOOTLOADER_MODE_SIZE, now);
+            break;
+
+        default:
+            (void)out_frame(id, ORDER_ID__UNKNOW_CMD, ORDER_UNKNOW_CMD_SIZE, now);
+            break;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void print_stats(uint64_t now) {
+    int i;
+
+    printf("### [MCU SIM] %.1f s ###\n", (double)(now - t0) / 1e6);
+    for (i = 0; i < NB_RADIO_RX; i++) {
+        printf("# radio %d: %s, uplinks on air %" PRIu64 ", delivered %" PRIu64 ", lost %" PRIu64 ", half-duplex %" PRIu64 ", CRC err %u\n",
+                i, (radio[i].on == true) ? "on" : "off", radio[i].nb_gen, radio[i].nb_deliv, radio[i].nb_lost,
+                radio[i].nb_half_duplex, radio[i].nb_crc_err);
+    }
+    printf("# TX: requested %" PRIu64 ", sent %" PRIu64 ", late %" PRIu64 "\n", tx.nb_req, tx.nb_done, tx.nb_late);
+    printf("# requests: ping %" PRIu64 ", status %" PRIu64 ", rx_msg %" PRIu64 ", tx_status %" PRIu64 ", others %" PRIu64 "\n",
+            nb_req[ORDER_ID__REQ_PING], nb_req[ORDER_ID__REQ_GET_STATUS], nb_req[ORDER_ID__REQ_GET_RX_MSG],
+            nb_req[ORDER_ID__REQ_GET_TX_STATUS],
+            nb_req[ORDER_ID__REQ_CONFIG_RX] + nb_req[ORDER_ID__REQ_PREPARE_TX] + nb_req[ORDER_ID__REQ_RESET] +
+            nb_req[ORDER_ID__REQ_READ_REGS] + nb_req[ORDER_ID__REQ_WRITE_REGS]);
+    printf("# RX FIFO: %u/%u\n", fifo_nb, fifo_size);
+    fflush(stdout);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int parse_rates(const char * arg) {
+    char * end;
+    double v;
+    int i = 0;
+
+    while (i < NB_RADIO_RX) {
+        v = strtod(arg, &end);
+        if ((end == arg) || (v < 0.0)) {
+            return -1;
+        }
+        radio[i++].rate = v;
+        if (*end != ',') {
+            break;
+        }
+        arg = end + 1;
+    }
+    if (*end != '\0') {
+        return -1;
+    }
+    /* a single value is used for all radios */
+    if (i == 1) {
+        for (; i < NB_RADIO_RX; i++) {
+            radio[i].rate = radio[0].rate;
+        }
+    }
+
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv)
+{
+    int i;
+    unsigned arg_u, arg_u2;
+    double arg_f;
+
+    const char link_default[] = TTY_LINK_DEFAULT;
+    const char * link_path = link_default;
+    int fd_slave;
+    char * slave_path;
+    struct termios tty;
+    struct sigaction sigact;
+
+    struct pollfd pfd;
+    struct timespec timeout;
+    uint8_t in_buf[IN_BUF_SIZE];
+    size_t in_len = 0;
+    uint16_t size;
+    ssize_t n;
+    uint64_t now, next, stat_period = 10000000, stat_next;
+
+    /* parse command line options */
+    while ((i = getopt(argc, argv, "hl:r:z:c:eq:m:a:j:p:ws:")) != -1) {
+        switch (i) {
+            case 'h':
+                usage();
+                return -1;
+
+            case 'l':
+                link_path = optarg;
+                break;
+
+            case 'r':
+                if (parse_rates(optarg) != 0) {
+                    printf("ERROR: argument parsing of -r argument. Use -h to print help\n");
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case 'z':
+                if ((sscanf(optarg, "%u:%u", &arg_u, &arg_u2) != 2) || (arg_u < 9) || (arg_u > arg_u2) || (arg_u2 > 255)) {
+                    printf("ERROR: argument parsing of -z argument, sizes in [9..255]. Use -h to print help\n");
+                    return EXIT_FAILURE;
+                }
+                size_min = arg_u;
+                size_max = arg_u2;
+                break;
+
+            case 'c':
+                if ((sscanf(optarg, "%u", &arg_u) != 1) || (arg_u > 100)) {
+                    printf("ERROR: argument parsing of -c argument. Use -h to print help\n");
+                    return EXIT_FAILURE;
+                }
+                crc_err_pct = arg_u;
+                break;
+
+            case 'e':
+                push_evt = true;
+                break;
+
+            case 'q':
+                if ((sscanf(optarg, "%u", &arg_u) != 1) || (arg_u < 1) || (arg_u > RX_FIFO_MAX)) {
+                    printf("ERROR: argument parsing of -q argument. Use -h to print help\n");
+                    return EXIT_FAILURE;
+                }
+                fifo_size = arg_u;
+                break;
+
+            case 'm':
+                if ((sscanf(optarg, "%u", &arg_u) != 1) || (arg_u < 1) || (arg_u > 255)) {
+                    printf("ERROR: argument parsing of -m argument. Use -h to print help\n");
+                    return EXIT_FAILURE;
+                }
+                rx_msg_max = arg_u;
+                break;
+
+            case 'a':
+                if (sscanf(optarg, "%u", &arg_u) != 1) {
+                    printf("ERROR: argument parsing of -a argument. Use -h to print help\n");
+                    return EXIT_FAILURE;
+                }
+                latency_us = arg_u;
+                break;
+
+            case 'j':
+                if (sscanf(optarg, "%u", &arg_u) != 1) {
+                    printf("ERROR: argument parsing of -j argument. Use -h to print help\n");
+                    return EXIT_FAILURE;
+                }
+                jitter_us = arg_u;
+                break;
+
+            case 'p':
+                if ((sscanf(optarg, "%lf", &arg_f) != 1) || (fabs(arg_f) > 1000.0)) {
+                    printf("ERROR: argument parsing of -p argument. Use -h to print help\n");
+                    return EXIT_FAILURE;
+                }
+                drift = 1.0 + arg_f * 1e-6;
+                break;
+
+            case 'w':
+                tx_on_pps = true;
+                break;
+
+            case 's':
+                if (sscanf(optarg, "%u", &arg_u) != 1) {
+                    printf("ERROR: argument parsing of -s argument. Use -h to print help\n");
+                    return EXIT_FAILURE;
+                }
+                stat_period = (uint64_t)arg_u * 1000000;
+                break;
+
+            default:
+                printf("ERROR: argument parsing\n");
+                usage();
+                return EXIT_FAILURE;
+        }
+    }
+
+    /* create the pseudo-terminal, in raw mode as the MCU USB CDC */
+    fd_master = posix_openpt(O_RDWR | O_NOCTTY);
+    if ((fd_master < 0) || (grantpt(fd_master) != 0) || (unlockpt(fd_master) != 0) || ((slave_path = ptsname(fd_master)) == NULL)) {
+        printf("ERROR: failed to create the pseudo-terminal: %s\n", strerror(errno));
+        return EXIT_FAILURE;
+    }
+    /* the slave stays open, so that the master reads nothing but the host requests */
+    fd_slave = open(slave_path, O_RDWR | O_NOCTTY);
+    if (fd_slave < 0 || tcgetattr(fd_slave, &tty) != 0) {
+        printf("ERROR: failed to open %s: %s\n", slave_path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    cfmakeraw(&tty);
+    tcsetattr(fd_slave, TCSANOW, &tty);
+    unlink(link_path);
+    if (symlink(slave_path, link_path) != 0) {
+        printf("ERROR: failed to link %s to %s: %s\n", link_path, slave_path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    printf("INFO: MCU simulator on %s, linked as %s\n", slave_path, link_path);
+    printf("INFO: uplinks/s %.2f,%.2f,%.2f, %s, latency %u+%u us, drift %.1f ppm\n",
+            radio[0].rate, radio[1].rate, radio[2].rate,
+            (push_evt == true) ? "pushed as events" : "fetched from the FIFO",
+            latency_us, jitter_us, (drift - 1.0) * 1e6);
+    fflush(stdout);
+
+    /* configure signal handling */
+    sigemptyset(&sigact.sa_mask);
+    sigact.sa_flags = 0;
+    sigact.sa_handler = sig_handler;
+    sigaction(SIGQUIT, &sigact, NULL);
+    sigaction(SIGINT, &sigact, NULL);
+    sigaction(SIGTERM, &sigact, NULL);
+
+    srand((unsigned)time(NULL));
+    t0 = host_us();
+    stat_next = t0 + stat_period;
+    pfd.fd = fd_master;
+    pfd.events = POLLIN;
+
+    while (exit_sig == 0) {
+        now = host_us();
+        next = sim_update(now);
+        out_flush(now);
+        if (out_nb > 0 && out[out_start].due < next) {
+            next = out[out_start].due;
+        }
+        if (stat_period > 0) {
+            if (now >= stat_next) {
+                print_stats(now);
+                stat_next += stat_period;
+            }
+            if (stat_next < next) {
+                next = stat_next;
+            }
+        }
+
+        /* wait for the next request, or the next change of the simulation */
+        if (next > now + 1000000) {
+            next = now + 1000000;
+        }
+        timeout.tv_sec = (time_t)((next > now) ? (next - now) / 1000000 : 0);
+        timeout.tv_nsec = (long)((next > now) ? ((next - now) % 1000000) * 1000 : 0);
+        if (ppoll(&pfd, 1, &timeout, NULL) <= 0) {
+            continue;
+        }
+
+        n = read(fd_master, in_buf + in_len, sizeof in_buf - in_len);
+        if (n <= 0) {
+            if (n < 0 && errno != EINTR && errno != EAGAIN) {
+                printf("ERROR: failed to read the TTY: %s\n", strerror(errno));
+                break;
+            }
+            continue;
+        }
+        in_len += (size_t)n;
+
+        /* handle the complete requests, the simulation being up to date */
+        now = host_us();
+        (void)sim_update(now);
+        while (in_len >= CMD_OFFSET__DATA) {
+            size = (uint16_t)((in_buf[CMD_OFFSET__SIZE_MSB] << 8) | in_buf[CMD_OFFSET__SIZE_LSB]);
+            if (size > MCU_WRITE_SIZE_MAX) {
+                printf("ERROR: invalid request size %u, flushing input\n", size);
+                in_len = 0;
+                break;
+            }
+            if (in_len < (size_t)(CMD_OFFSET__DATA + size)) {
+                break; /* wait for the end of the request */
+            }
+            handle_req(in_buf[CMD_OFFSET__ID], in_buf[CMD_OFFSET__CMD], in_buf + CMD_OFFSET__DATA, size, now);
+            in_len -= CMD_OFFSET__DATA + size;
+            memmove(in_buf, in_buf + CMD_OFFSET__DATA + size, in_len);
+        }
+        out_flush(now);
+    }
+
+    print_stats(host_us());
+    unlink(link_path);
+    close(fd_slave);
+    close(fd_master);
+
+    return 0;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -50,6 +50,18 @@
 #define ARRAY_SIZE(a)   (sizeof(a) / sizeof((a)[0]))
 
 #define PROTOCOL_VERSION    2
+#define PROTOCOL_VERSION_BIN    3   /* binary framing of uplinks and downlinks */
+
+/* Binary framing, see PROTOCOL.md of the packet forwarder */
+#define BIN_PUSH_FLAG_STAT      0x01
+#define BIN_RXPK_HEADER_SIZE    24
+#define BIN_STAT_SIZE           28
+#define BIN_TXPK_HEADER_SIZE    18
+#define BIN_TXPK_FLAG_IMME      0x01
+#define BIN_TXPK_FLAG_IPOL      0x02
+#define BIN_TXPK_FLAG_NCRC      0x04
+#define BIN_MODU_LORA           1
+#define BIN_CODR_LI             0x10
 
 /* Get a particular bit value from a byte */
 /* b: any byte
@@ -72,6 +84,16 @@
 #define DEFAULT_PAYLOAD_SIZE        4       /* payload size, bytes */
 #define PUSH_TIMEOUT_MS             100
 
+/* Stress mode */
+#define STRESS_REPORT_S             5       /* period of the reports, seconds */
+#define STRESS_TXPK_MAX             8       /* biggest "txpk" array accepted by the packet forwarder */
+#define STRESS_TPL_SIZE             192     /* size of a txpk object template */
+#define FREQ_NB_MAX                 100
+
+/* Uplink logging */
+#define LOG_BUFF_SIZE               (1 << 20)   /* buffered writes, flushed at regular interval */
+#define LOG_FLUSH_MS                1000
+
 /* -------------------------------------------------------------------------- */
 /* --- CUSTOM TYPES --------------------------------------------------------- */
 
@@ -103,8 +125,24 @@ typedef struct
     uint8_t     pl_size;
     bool        ipol;
     bool        crc_enable;
+    double      stress_rate; /* stress mode, downlinks per second */
+    uint8_t     stress_nb; /* downlinks per PULL_RESP */
+    uint32_t    stress_lead_ms; /* scheduled downlinks in advance of the gateway time, 0 for immediate */
 } thread_params_t;
 
+/* TX_ACK statistics of the stress mode, written by the main thread only */
+typedef struct
+{
+    uint64_t    dgram_sent;
+    uint64_t    pkt_sent;
+    uint64_t    ack;
+    uint64_t    pkt_acc;
+    uint64_t    pkt_warn;
+    uint64_t    pkt_rej[9]; /* per tx_ack_error, last is for unknown errors */
+    uint64_t    rtt_sum_us;
+    uint32_t    rtt_max_us;
+} stress_stat_t;
+
 /* -------------------------------------------------------------------------- */
 /* --- GLOBAL VARIABLES ----------------------------------------------------- */
 
@@ -116,10 +154,27 @@ static int quit_sig = 0; /* 1 -> application terminates without shutting down th
 static bool sockaddr_valid = false;
 static struct sockaddr_storage dist_addr_down;
 static socklen_t addr_len_down = sizeof dist_addr_down;
+static uint8_t protocol_version_down = PROTOCOL_VERSION; /* protocol version of the latest PULL_DATA, used for PULL_RESP */
 
 /* Thread variables */
 static pthread_mutex_t mx_sockaddr = PTHREAD_MUTEX_INITIALIZER; /* control access to the sockaddr info */
 
+/* Stress mode variables */
+static bool stress = false;
+static pthread_mutex_t mx_tmst = PTHREAD_MUTEX_INITIALIZER; /* control access to the gateway time reference */
+static bool tmst_valid = false;
+static uint32_t tmst_ref; /* tmst of the latest uplink */
+static uint64_t tmst_ref_us; /* host time it was received at */
+static uint32_t stress_send_us[65536]; /* host time each PULL_RESP token was sent at */
+static uint8_t stress_send_nb[65536]; /* number of downlinks of each PULL_RESP token */
+static stress_stat_t stress_stat;
+static char stress_tpl[FREQ_NB_MAX][STRESS_TPL_SIZE]; /* txpk objects after the timing fields, up to the data */
+static int stress_tpl_len[FREQ_NB_MAX];
+
+static const char * const tx_ack_error[] = {
+    "TOO_LATE", "TOO_EARLY", "COLLISION_PACKET", "COLLISION_BEACON", "TX_FREQ", "GPS_UNLOCKED", "AIRTIME", "INVALID"
+};
+
 /* -------------------------------------------------------------------------- */
 /* --- SUBFUNCTIONS DECLARATION --------------------------------------------- */
 
@@ -127,6 +182,14 @@ static void sig_handler( int sigio );
 static void usage( void );
 static void * thread_down( const void * arg );
 static void log_csv(FILE * file, uint8_t * buf);
+static void log_csv_bin(FILE * file, const uint8_t * buf, int size);
+static uint64_t monotonic_us( void );
+static int stress_template( const thread_params_t * params );
+static void stress_tmst_update( const uint8_t * buf, int size, uint8_t version );
+static void stress_tx_ack( const uint8_t * buf, int size );
+
+/* Packet traces, disabled in stress mode */
+#define PRINT_PKT( ... ) do { if( stress == false ) { printf( __VA_ARGS__ ); } } while( 0 )
 
 /* -------------------------------------------------------------------------- */
 /* --- MAIN FUNCTION -------------------------------------------------------- */
@@ -146,6 +209,7 @@ int main( int argc, char **argv )
     const char * log_fname = NULL; /* pointer to a string we won't touch */
     FILE * log_file = NULL;
     bool is_first = true;
+    uint64_t log_flush_us = 0;
 
     /* Server socket creation */
     int sock; /* socket file descriptor */
@@ -191,14 +255,17 @@ int main( int argc, char **argv )
         .freq_step = 0.2,
         .freq_nb = 1,
         .ipol = false,
-        .crc_enable = false
+        .crc_enable = false,
+        .stress_rate = 0.0,
+        .stress_nb = 1,
+        .stress_lead_ms = 0
     };
 
     /* Threads ID */
     pthread_t thrid_down;
 
     /* Parse command line options */
-    while( ( i = getopt( argc, argv, "b:c:f:hikj:l:p:r:s:t:x:z:A:F:P:m:d:q:" ) ) != -1 )
+    while( ( i = getopt( argc, argv, "b:c:f:hikj:l:p:r:s:t:x:z:A:F:P:m:d:q:S:N:T:" ) ) != -1 )
     {
         switch( i )
         {
@@ -418,6 +485,48 @@ int main( int argc, char **argv )
 
                 break;
 
+            case 'S': /* -S <float>  stress mode rate, downlinks per second */
+                j = sscanf( optarg, "%lf", &arg_f );
+                if( (j != 1) || (arg_f <= 0.0) || (arg_f > 1E5) )
+                {
+                    printf( "ERROR: argument parsing of -S argument\n" );
+                    usage( );
+                    return EXIT_FAILURE;
+                }
+                else
+                {
+                    thread_params.stress_rate = arg_f;
+                }
+                break;
+
+            case 'N': /* -N <uint>  stress mode, downlinks per PULL_RESP */
+                j = sscanf( optarg, "%u", &arg_u );
+                if( (j != 1) || (arg_u < 1) || (arg_u > STRESS_TXPK_MAX) )
+                {
+                    printf( "ERROR: argument parsing of -N argument\n" );
+                    usage( );
+                    return EXIT_FAILURE;
+                }
+                else
+                {
+                    thread_params.stress_nb = (uint8_t)arg_u;
+                }
+                break;
+
+            case 'T': /* -T <uint>  stress mode, lead of the scheduled downlinks in ms */
+                j = sscanf( optarg, "%u", &arg_u );
+                if( j != 1 )
+                {
+                    printf( "ERROR: argument parsing of -T argument\n" );
+                    usage( );
+                    return EXIT_FAILURE;
+                }
+                else
+                {
+                    thread_params.stress_lead_ms = (uint32_t)arg_u;
+                }
+                break;
+
             default:
                 printf( "ERROR: argument parsing options, use -h option for help\n" );
                 usage( );
@@ -433,8 +542,25 @@ int main( int argc, char **argv )
         return EXIT_FAILURE;
     }
 
+    /* Stress mode: precomputed downlinks, no trace nor artificial latency */
+    if( thread_params.stress_rate > 0.0 )
+    {
+        stress = true;
+        if( stress_template( &thread_params ) != 0 )
+        {
+            return EXIT_FAILURE;
+        }
+    }
+
     /* Start message */
-    printf( "+++ Start of network uplink logger (30ms delay) +++\n" );
+    if( stress == true )
+    {
+        printf( "+++ Start of network stress test, %.1f downlinks/s +++\n", thread_params.stress_rate );
+    }
+    else
+    {
+        printf( "+++ Start of network uplink logger (30ms delay) +++\n" );
+    }
 
     /* Configure socket for uplink forwarding if required */
     if( fwd_uplink == true )
@@ -553,6 +679,7 @@ int main( int argc, char **argv )
             printf( "ERROR: impossible to create log file %s\n", log_fname );
             return EXIT_FAILURE;
         }
+        setvbuf( log_file, NULL, _IOFBF, LOG_BUFF_SIZE );
     }
 
     /* Configure signal handling */
@@ -583,27 +710,30 @@ int main( int argc, char **argv )
         }
 
         /* Display info about the sender */
-        x = getnameinfo( (struct sockaddr *)&dist_addr, addr_len, host_name, sizeof host_name, port_name, sizeof port_name, NI_NUMERICHOST );
-        if( x == -1 )
+        if( stress == false )
         {
-            printf( "ERROR: getnameinfo returned %s \n", gai_strerror( x ) );
-            return EXIT_FAILURE;
+            x = getnameinfo( (struct sockaddr *)&dist_addr, addr_len, host_name, sizeof host_name, port_name, sizeof port_name, NI_NUMERICHOST );
+            if( x == -1 )
+            {
+                printf( "ERROR: getnameinfo returned %s \n", gai_strerror( x ) );
+                return EXIT_FAILURE;
+            }
         }
-        printf( " -> pkt in , host %s (port %s), %i bytes", host_name, port_name, byte_nb );
+        PRINT_PKT( " -> pkt in , host %s (port %s), %i bytes", host_name, port_name, byte_nb );
 
         /* Check and parse the payload */
         if( byte_nb < 12 )
         {
             /* Not enough bytes for packet from gateway */
-            printf( " (too short for GW <-> MAC protocol)\n" );
+            PRINT_PKT( " (too short for GW <-> MAC protocol)\n" );
             continue;
         }
         /* Don't touch the token in position 1-2, it will be sent back "as is" for acknowledgement */
 
-        /* Check protocol version number */
-        if( databuf_up[0] != PROTOCOL_VERSION )
+        /* Check protocol version number, the acknowledge uses the same one */
+        if( ( databuf_up[0] != PROTOCOL_VERSION ) && ( databuf_up[0] != PROTOCOL_VERSION_BIN ) )
         {
-            printf( ", invalid version %u\n", databuf_up[0] );
+            PRINT_PKT( ", invalid version %u\n", databuf_up[0] );
             continue;
         }
         raw_mac_h = *( (uint32_t *)( databuf_up + 4 ) );
@@ -614,17 +744,22 @@ int main( int argc, char **argv )
         switch( databuf_up[3] )
         {
             case PKT_PUSH_DATA:
-                printf( ", PUSH_DATA from gateway 0x%08X%08X\n", (uint32_t)( gw_mac >> 32 ), (uint32_t)( gw_mac & 0xFFFFFFFF ) );
+                PRINT_PKT( ", PUSH_DATA from gateway 0x%08X%08X\n", (uint32_t)( gw_mac >> 32 ), (uint32_t)( gw_mac & 0xFFFFFFFF ) );
                 ack_command = PKT_PUSH_ACK;
                 no_ack = false;
+                if( ( stress == true ) && ( byte_nb < (int)sizeof databuf_up ) )
+                {
+                    databuf_up[byte_nb] = 0; /* string terminator for JSON */
+                    stress_tmst_update( &databuf_up[12], byte_nb - 12, databuf_up[0] );
+                }
                 if( fwd_uplink == false )
                 {
-                    printf( "<-  pkt out, PUSH_ACK for host %s (port %s)", host_name, port_name );
+                    PRINT_PKT( "<-  pkt out, PUSH_ACK for host %s (port %s)", host_name, port_name );
                 }
                 else
                 {
                     /* Forward uplink if required */
-                    printf( "<-  pkt out, PUSH_ACK for host %s (port %s), FORWARD PUSH_DATA to %s (port %s)", host_name, port_name, serv_addr, serv_port_fwd );
+                    PRINT_PKT( "<-  pkt out, PUSH_ACK for host %s (port %s), FORWARD PUSH_DATA to %s (port %s)", host_name, port_name, serv_addr, serv_port_fwd );
                     x = send( sock_fwd, (void *)databuf_up, byte_nb, 0 );
                     if( x == -1 )
                     {
@@ -634,47 +769,59 @@ int main( int argc, char **argv )
                 break;
 
             case PKT_PULL_DATA:
-                printf( ", PULL_DATA from gateway 0x%08X%08X\n", (uint32_t)( gw_mac >> 32 ), (uint32_t)( gw_mac & 0xFFFFFFFF ) );
+                PRINT_PKT( ", PULL_DATA from gateway 0x%08X%08X\n", (uint32_t)( gw_mac >> 32 ), (uint32_t)( gw_mac & 0xFFFFFFFF ) );
                 ack_command = PKT_PULL_ACK;
                 no_ack = false;
-                printf( "<-  pkt out, PULL_ACK for host %s (port %s)", host_name, port_name );
+                PRINT_PKT( "<-  pkt out, PULL_ACK for host %s (port %s)", host_name, port_name );
                 /* Record who sent the PULL_DATA for the downlink thread to known where to send PULL_RESP */
                 memcpy( &dist_addr_down, &dist_addr, sizeof(struct sockaddr_storage) );
                 memcpy( &addr_len_down, &addr_len, sizeof(socklen_t) );
                 pthread_mutex_lock( &mx_sockaddr );
                 sockaddr_valid = true;
+                protocol_version_down = databuf_up[0];
                 pthread_mutex_unlock( &mx_sockaddr );
                 break;
 
             case PKT_TX_ACK:
-                printf( ", TX_ACK from gateway 0x%08X%08X\n", (uint32_t)( gw_mac >> 32 ), (uint32_t)( gw_mac & 0xFFFFFFFF ) );
+                PRINT_PKT( ", TX_ACK from gateway 0x%08X%08X\n", (uint32_t)( gw_mac >> 32 ), (uint32_t)( gw_mac & 0xFFFFFFFF ) );
                 no_ack = true;
+                if( stress == true )
+                {
+                    if( byte_nb < (int)sizeof databuf_up )
+                    {
+                        databuf_up[byte_nb] = 0; /* string terminator for JSON */
+                    }
+                    stress_tx_ack( databuf_up, byte_nb );
+                }
                 break;
 
             default:
-                printf( ", unexpected command %u\n", databuf_up[3] );
+                PRINT_PKT( ", unexpected command %u\n", databuf_up[3] );
                 continue;
         }
 
         /* Add some artificial latency */
-        usleep( 30000 ); /* 30 ms */
+        if( stress == false )
+        {
+            usleep( 30000 ); /* 30 ms */
+        }
 
         /* Send acknowledge and check return value */
         if( no_ack == false )
         {
             memset( databuf_ack, 0, 4 );
-            databuf_ack[0] = PROTOCOL_VERSION;
+            databuf_ack[0] = databuf_up[0];
             databuf_ack[1] = databuf_up[1];
             databuf_ack[2] = databuf_up[2];
             databuf_ack[3] = ack_command;
-            byte_nb = sendto( sock, (void *)databuf_ack, 4, 0, (struct sockaddr *)&dist_addr, addr_len );
-            if( byte_nb == -1 )
+            x = sendto( sock, (void *)databuf_ack, 4, 0, (struct sockaddr *)&dist_addr, addr_len );
+            if( x == -1 )
             {
                 printf( ", send error:%s\n", strerror( errno ) );
             }
             else
             {
-                printf( ", %i bytes sent for ACK\n", byte_nb );
+                PRINT_PKT( ", %i bytes sent for ACK\n", x );
             }
         }
 
@@ -688,7 +835,21 @@ int main( int argc, char **argv )
                     fprintf(log_file, "tmst,chan,freq,stat,modu,datr,bw,codr,rssi,lsnr,size,data\n");
                     is_first = false;
                 }
-                log_csv( log_file, &databuf_up[12] );
+                if( databuf_up[0] == PROTOCOL_VERSION_BIN )
+                {
+                    log_csv_bin( log_file, &databuf_up[12], byte_nb - 12 );
+                }
+                else
+                {
+                    log_csv( log_file, &databuf_up[12] );
+                }
+
+                /* Buffered writes, the file is flushed at regular interval */
+                if( monotonic_us( ) >= log_flush_us )
+                {
+                    fflush( log_file );
+                    log_flush_us = monotonic_us( ) + LOG_FLUSH_MS * 1000;
+                }
             }
         }
     }
@@ -710,6 +871,23 @@ int main( int argc, char **argv )
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+static void log_hex(FILE * file, const uint8_t * data, int size)
+{
+    static const char digits[] = "0123456789abcdef";
+    char line[2 * 255 + 1];
+    int j;
+
+    for( j = 0; j < size; j++ )
+    {
+        line[2 * j] = digits[data[j] >> 4];
+        line[2 * j + 1] = digits[data[j] & 0x0F];
+    }
+    line[2 * size] = '\0';
+    fputs( line, file );
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 static void log_csv(FILE * file, uint8_t * buf)
 {
     JSON_Object * rxpk = NULL;
@@ -717,7 +895,7 @@ static void log_csv(FILE * file, uint8_t * buf)
     JSON_Array * rxpk_array = NULL;
     JSON_Value * root_val = NULL;
     JSON_Value * val = NULL;
-    int i, j, rxpk_nb, x;
+    int i, rxpk_nb, x;
     const char * str; /* pointer to sub-strings in the JSON data */
     short x0, x1;
     uint8_t payload[255];
@@ -879,22 +1057,81 @@ static void log_csv(FILE * file, uint8_t * buf)
                 return;
             }
             fprintf(file, "," );
-            for( j = 0; j < size; j++ )
-            {
-                fprintf(file, "%02x", payload[j] );
-            }
+            log_hex( file, payload, size );
 
             /* End line */
             fprintf(file, "\n" );
         }
     }
 
-    fflush(file);
     json_value_free( root_val );
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+static uint32_t get_u32( const uint8_t * p )
+{
+    return ( (uint32_t)p[0] << 24 ) | ( (uint32_t)p[1] << 16 ) | ( (uint32_t)p[2] << 8 ) | (uint32_t)p[3];
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void log_csv_bin(FILE * file, const uint8_t * buf, int size)
+{
+    int i, nb_pkt;
+    int index;
+    const uint8_t * rec;
+    uint8_t codr;
+
+    if( file == NULL )
+    {
+        printf("ERROR: no file opened\n");
+        return;
+    }
+
+    /* Header: number of rxpk records and flags */
+    if( size < 2 )
+    {
+        printf( "ERROR: binary PUSH_DATA too short\n" );
+        return;
+    }
+    nb_pkt = buf[0];
+    index = 2;
+
+    /* Fixed-layout records, each one followed by its payload */
+    for( i = 0; i < nb_pkt; i++ )
+    {
+        rec = buf + index;
+        if( ( ( size - index ) < BIN_RXPK_HEADER_SIZE ) || ( ( size - index ) < ( BIN_RXPK_HEADER_SIZE + rec[19] ) ) )
+        {
+            printf( "ERROR: binary rxpk record %d truncated\n", i );
+            return;
+        }
+        if( rec[14] != BIN_MODU_LORA )
+        {
+            printf( "ERROR: unknown modulation %u\n", rec[14] );
+            return;
+        }
+        codr = rec[18];
+        fprintf(file, "%u,%u,%f,%d,LORA,%u,%u,4/%u%s,%.1f,%.1f,%u,", get_u32( rec ), rec[12], get_u32( rec + 4 ) / 1E6, (int8_t)rec[13],
+                rec[15], ( rec[16] << 8 ) | rec[17], codr & 0x0F, ( codr & BIN_CODR_LI ) ? "LI" : "",
+                (int16_t)( ( rec[20] << 8 ) | rec[21] ) / 10.0, (int16_t)( ( rec[22] << 8 ) | rec[23] ) / 10.0, rec[19] );
+        log_hex( file, &rec[BIN_RXPK_HEADER_SIZE], rec[19] );
+
+        /* End line */
+        fprintf(file, "\n" );
+        index += BIN_RXPK_HEADER_SIZE + rec[19];
+    }
+
+    /* Status record */
+    if( ( buf[1] & BIN_PUSH_FLAG_STAT ) && ( ( size - index ) < BIN_STAT_SIZE ) )
+    {
+        printf( "ERROR: binary stat record truncated\n" );
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 static void usage( void )
 {
     printf( "~~~ Available options ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n" );
@@ -911,12 +1148,15 @@ static void usage( void )
     printf( " -i                Set inverted polarity true\n" );
     printf( " -k                Set CRC enabled\n" );
     printf( " -t <uint>         Number of milliseconds between two downlinks\n" );
-    printf( " -x <uint>         Number of downlinks to be sent\n" );
+    printf( " -x <uint>         Number of downlinks to be sent (0 for no limit in stress mode)\n" );
     printf( " -P <udp port>     UDP port of the Packet Forwarder\n" );
     printf( " -A <ip address>   IP address to be used for uplink forwarding (optional)\n" );
     printf( " -F <udp port>     UDP port to be used for uplink forwarding (optional)\n" );
     printf( " -l <filename>     uplink logging CSV filename (optional)\n" );
     printf( " -B                Bypass downlink, for uplink logging only (optional)\n" );
+    printf( " -S <float>        Stress mode, downlinks per second, replaces -t (optional)\n" );
+    printf( " -N <uint>         Stress mode, downlinks per PULL_RESP [1..%d] (optional)\n", STRESS_TXPK_MAX );
+    printf( " -T <uint>         Stress mode, downlinks scheduled <uint> ms after the latest uplink time, 0 for immediate (optional)\n" );
     printf( "~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n" );
     printf( "~~~ Examples ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n" );
     printf( " Log uplinks into a CSV file, no downlink:\n" );
@@ -925,6 +1165,8 @@ static void usage( void )
     printf( "   ./net_downlink -f 2422 -s 12 -b 812 -c \"4/8LI\" -r 8 -i -z 32 -t 500 -x 100 -P 1730\n" );
     printf( " Log uplinks into CSV file while sending downlinks:\n" );
     printf( "   ./net_downlink -f 2422 -s 12 -b 812 -c \"4/8LI\" -r 8 -i -z 32 -t 500 -x 100 -P 1730 -l log.csv\n" );
+    printf( " Stress the gateway with 1000 downlinks/s, by 4 per PULL_RESP, scheduled 200 ms ahead:\n" );
+    printf( "   ./net_downlink -f 2422 -j 8:0.8 -s 5 -b 812 -z 16 -S 1000 -N 4 -T 200 -P 1730\n" );
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
@@ -1019,6 +1261,425 @@ void prepare_downlink_json( const thread_params_t * params, uint32_t pkt_sent, J
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+int prepare_downlink_bin( const thread_params_t * params, uint32_t pkt_sent, uint8_t * buf )
+{
+    int j;
+    uint32_t freq_hz;
+    uint8_t codr;
+
+    if( strncmp( params->modulation, "LORA", 4 ) != 0 )
+    {
+        printf( "ERROR: wrong modulation\n" );
+        return -1;
+    }
+    codr = (uint8_t)( params->coding_rate[2] - '0' );
+    if( strstr( params->coding_rate, "LI" ) != NULL )
+    {
+        codr |= BIN_CODR_LI;
+    }
+
+    /* Fixed-layout txpk record, multi-byte fields are big endian */
+    buf[0] = BIN_TXPK_FLAG_IMME | ( params->ipol ? BIN_TXPK_FLAG_IPOL : 0 ) | ( ( params->crc_enable == false ) ? BIN_TXPK_FLAG_NCRC : 0 );
+    memset( &buf[1], 0, 4 ); /* tmst, ignored in immediate mode */
+    freq_hz = (uint32_t)( ( params->freq_mhz + ( ( pkt_sent % params->freq_nb ) * params->freq_step ) ) * 1E6 + 0.5 );
+    buf[5] = (uint8_t)( freq_hz >> 24 );
+    buf[6] = (uint8_t)( freq_hz >> 16 );
+    buf[7] = (uint8_t)( freq_hz >> 8 );
+    buf[8] = (uint8_t)freq_hz;
+    buf[9] = (uint8_t)params->rf_power;
+    buf[10] = BIN_MODU_LORA;
+    buf[11] = params->spread_factor;
+    buf[12] = (uint8_t)( params->bandwidth_khz >> 8 );
+    buf[13] = (uint8_t)params->bandwidth_khz;
+    buf[14] = codr;
+    buf[15] = (uint8_t)( params->preamb_size >> 8 );
+    buf[16] = (uint8_t)params->preamb_size;
+    buf[17] = params->pl_size;
+
+    /* Raw payload, last bytes filled with downlink counter (32 bits) */
+    memset( &buf[BIN_TXPK_HEADER_SIZE], 0, params->pl_size );
+    for( j = 0; ( j < params->pl_size ) && ( j < 4 ); j++ )
+    {
+        buf[BIN_TXPK_HEADER_SIZE + params->pl_size - ( j + 1 )] = (uint8_t)( (pkt_sent >> (j * 8)) & 0xFF );
+    }
+
+    return BIN_TXPK_HEADER_SIZE + params->pl_size;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static uint64_t monotonic_us( void )
+{
+    struct timespec t;
+
+    clock_gettime( CLOCK_MONOTONIC, &t );
+    return (uint64_t)t.tv_sec * 1000000 + (uint64_t)( t.tv_nsec / 1000 );
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int stress_template( const thread_params_t * params )
+{
+    int i, j;
+
+    if( strncmp( params->modulation, "LORA", 4 ) != 0 )
+    {
+        printf( "ERROR: wrong modulation\n" );
+        return -1;
+    }
+
+    /* Same fields as prepare_downlink_json, one template per frequency */
+    for( i = 0; i < params->freq_nb; i++ )
+    {
+        j = snprintf( stress_tpl[i], STRESS_TPL_SIZE, "\"freq\":%.6f,\"powe\":%d,\"modu\":\"LORA\",\"datr\":\"SF%uBW%u\",\"codr\":\"%s\",\"ipol\":%s,\"prea\":%u,\"ncrc\":%s,\"size\":%u,\"data\":\"",
+                      params->freq_mhz + ( i * params->freq_step ), params->rf_power, params->spread_factor, params->bandwidth_khz, params->coding_rate,
+                      params->ipol ? "true" : "false", params->preamb_size, ( params->crc_enable == false ) ? "true" : "false", params->pl_size );
+        if( ( j < 0 ) || ( j >= STRESS_TPL_SIZE ) )
+        {
+            printf( "ERROR: failed to build downlink template\n" );
+            return -1;
+        }
+        stress_tpl_len[i] = j;
+    }
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Write a txpk object from its template, return its length */
+static int stress_txpk_json( const thread_params_t * params, uint32_t pkt_sent, bool imme, uint32_t tmst, char * buf )
+{
+    uint8_t payload[255];
+    int i, j, n;
+
+    if( imme == true )
+    {
+        memcpy( buf, "{\"imme\":true,", 13 );
+        n = 13;
+    }
+    else
+    {
+        n = sprintf( buf, "{\"imme\":false,\"tmst\":%u,", tmst );
+    }
+    i = pkt_sent % params->freq_nb;
+    memcpy( &buf[n], stress_tpl[i], stress_tpl_len[i] );
+    n += stress_tpl_len[i];
+
+    /* Last bytes of payload filled with downlink counter (32 bits) */
+    memset( payload, 0, params->pl_size );
+    for( j = 0; ( j < params->pl_size ) && ( j < 4 ); j++ )
+    {
+        payload[params->pl_size - ( j + 1 )] = (uint8_t)( (pkt_sent >> (j * 8)) & 0xFF );
+    }
+    j = bin_to_b64( payload, params->pl_size, &buf[n], 341 );
+    if( j < 0 )
+    {
+        printf( "ERROR: failed to convert payload to base64 string\n" );
+        j = 0;
+    }
+    n += j;
+    buf[n++] = '"';
+    buf[n++] = '}';
+
+    return n;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Keep the tmst of the latest uplink, as reference of the gateway time */
+static void stress_tmst_update( const uint8_t * buf, int size, uint8_t version )
+{
+    const char * str;
+    uint32_t tmst;
+
+    if( version == PROTOCOL_VERSION_BIN )
+    {
+        if( ( size < ( 2 + BIN_RXPK_HEADER_SIZE ) ) || ( buf[0] == 0 ) )
+        {
+            return;
+        }
+        tmst = get_u32( &buf[2] );
+    }
+    else
+    {
+        str = strstr( (const char *)buf, "\"tmst\":" );
+        if( str == NULL )
+        {
+            return;
+        }
+        tmst = (uint32_t)strtoul( str + 7, NULL, 10 );
+    }
+
+    pthread_mutex_lock( &mx_tmst );
+    tmst_ref = tmst;
+    tmst_ref_us = monotonic_us( );
+    tmst_valid = true;
+    pthread_mutex_unlock( &mx_tmst );
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void stress_ack_object( const JSON_Object * obj )
+{
+    const char * str;
+    unsigned i;
+
+    str = json_object_get_string( obj, "error" );
+    if( str == NULL )
+    {
+        __atomic_fetch_add( &stress_stat.pkt_acc, 1, __ATOMIC_RELAXED );
+        if( json_object_get_value( obj, "warn" ) != NULL )
+        {
+            __atomic_fetch_add( &stress_stat.pkt_warn, 1, __ATOMIC_RELAXED );
+        }
+        return;
+    }
+    for( i = 0; i < ARRAY_SIZE( tx_ack_error ); i++ )
+    {
+        if( strcmp( str, tx_ack_error[i] ) == 0 )
+        {
+            break;
+        }
+    }
+    __atomic_fetch_add( &stress_stat.pkt_rej[i], 1, __ATOMIC_RELAXED );
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Account the downlinks accepted and rejected by a TX_ACK, buf being null terminated */
+static void stress_tx_ack( const uint8_t * buf, int size )
+{
+    JSON_Value * root_val;
+    JSON_Value * val;
+    JSON_Array * arr;
+    uint16_t token;
+    uint32_t rtt;
+    size_t i;
+
+    token = (uint16_t)( ( buf[1] << 8 ) | buf[2] );
+    rtt = (uint32_t)monotonic_us( ) - stress_send_us[token];
+    __atomic_fetch_add( &stress_stat.ack, 1, __ATOMIC_RELAXED );
+    __atomic_fetch_add( &stress_stat.rtt_sum_us, rtt, __ATOMIC_RELAXED );
+    if( rtt > __atomic_load_n( &stress_stat.rtt_max_us, __ATOMIC_RELAXED ) )
+    {
+        __atomic_store_n( &stress_stat.rtt_max_us, rtt, __ATOMIC_RELAXED );
+    }
+
+    /* No JSON: all the downlinks were accepted */
+    if( size <= 12 )
+    {
+        __atomic_fetch_add( &stress_stat.pkt_acc, stress_send_nb[token], __ATOMIC_RELAXED );
+        return;
+    }
+
+    root_val = json_parse_string( (const char *)&buf[12] );
+    val = json_object_get_value( json_value_get_object( root_val ), "txpk_ack" );
+    if( json_value_get_type( val ) == JSONObject )
+    {
+        stress_ack_object( json_value_get_object( val ) );
+    }
+    else if( json_value_get_type( val ) == JSONArray )
+    {
+        arr = json_value_get_array( val );
+        for( i = 0; i < json_array_get_count( arr ); i++ )
+        {
+            stress_ack_object( json_array_get_object( arr, i ) );
+        }
+    }
+    else
+    {
+        printf( "ERROR: invalid TX_ACK JSON\n" );
+    }
+    json_value_free( root_val );
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void stress_report( uint64_t elapsed_us, uint64_t pkt_prev )
+{
+    stress_stat_t st;
+    uint64_t nb_rej = 0;
+    unsigned i;
+
+    st.dgram_sent = __atomic_load_n( &stress_stat.dgram_sent, __ATOMIC_RELAXED );
+    st.pkt_sent = __atomic_load_n( &stress_stat.pkt_sent, __ATOMIC_RELAXED );
+    st.ack = __atomic_load_n( &stress_stat.ack, __ATOMIC_RELAXED );
+    st.pkt_acc = __atomic_load_n( &stress_stat.pkt_acc, __ATOMIC_RELAXED );
+    st.pkt_warn = __atomic_load_n( &stress_stat.pkt_warn, __ATOMIC_RELAXED );
+    for( i = 0; i < ARRAY_SIZE( st.pkt_rej ); i++ )
+    {
+        st.pkt_rej[i] = __atomic_load_n( &stress_stat.pkt_rej[i], __ATOMIC_RELAXED );
+        nb_rej += st.pkt_rej[i];
+    }
+    st.rtt_sum_us = __atomic_load_n( &stress_stat.rtt_sum_us, __ATOMIC_RELAXED );
+    st.rtt_max_us = __atomic_load_n( &stress_stat.rtt_max_us, __ATOMIC_RELAXED );
+
+    printf( "### [STRESS] ###\n" );
+    printf( "# PULL_RESP sent: %llu (%llu downlinks, %.1f downlinks/s)\n", (unsigned long long)st.dgram_sent, (unsigned long long)st.pkt_sent,
+            ( elapsed_us > 0 ) ? ( st.pkt_sent - pkt_prev ) * 1E6 / elapsed_us : 0.0 );
+    printf( "# TX_ACK received: %llu (%.2f%%), round-trip avg %.1f ms, max %.1f ms\n", (unsigned long long)st.ack,
+            ( st.dgram_sent > 0 ) ? 100.0 * st.ack / st.dgram_sent : 0.0,
+            ( st.ack > 0 ) ? st.rtt_sum_us / 1E3 / st.ack : 0.0, st.rtt_max_us / 1E3 );
+    printf( "# downlinks accepted: %llu (%llu with warning), rejected: %llu", (unsigned long long)st.pkt_acc, (unsigned long long)st.pkt_warn,
+            (unsigned long long)nb_rej );
+    for( i = 0; i < ARRAY_SIZE( st.pkt_rej ); i++ )
+    {
+        if( st.pkt_rej[i] > 0 )
+        {
+            printf( ", %s %llu", ( i < ARRAY_SIZE( tx_ack_error ) ) ? tx_ack_error[i] : "UNKNOWN", (unsigned long long)st.pkt_rej[i] );
+        }
+    }
+    printf( "\n##################\n" );
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Send the downlinks at given rate, from templates, until stopped or nb_loop are sent */
+static void stress_down( const thread_params_t * params )
+{
+    uint8_t databuf_down[4096];
+    uint8_t version;
+    uint32_t tmst = 0;
+    uint32_t step_us;
+    uint32_t pkt_sent = 0;
+    uint16_t token = 0;
+    uint64_t period_ns;
+    uint64_t start_us, report_us, report_prev_us, report_pkt = 0;
+    struct timespec next;
+    bool imme = ( params->stress_lead_ms == 0 );
+    bool ready;
+    int i, nb, size, byte_nb;
+
+    period_ns = (uint64_t)( 1E9 * params->stress_nb / params->stress_rate );
+    step_us = (uint32_t)( 1E6 / params->stress_rate ); /* between downlinks of a PULL_RESP */
+    if( ( params->pl_size + 40 + STRESS_TPL_SIZE ) * STRESS_TXPK_MAX + 16 > (int)sizeof databuf_down )
+    {
+        printf( "ERROR: downlinks too big for a PULL_RESP\n" );
+        return;
+    }
+
+    ready = false;
+    while( !exit_sig && !quit_sig && ( ( params->nb_loop == 0 ) || ( pkt_sent < params->nb_loop ) ) )
+    {
+        /* Wait for socket address, and the gateway time for scheduled downlinks */
+        pthread_mutex_lock( &mx_sockaddr );
+        version = protocol_version_down;
+        i = sockaddr_valid;
+        pthread_mutex_unlock( &mx_sockaddr );
+        pthread_mutex_lock( &mx_tmst );
+        if( imme == false )
+        {
+            i = i && tmst_valid;
+            tmst = tmst_ref + (uint32_t)( monotonic_us( ) - tmst_ref_us ) + params->stress_lead_ms * 1000;
+        }
+        pthread_mutex_unlock( &mx_tmst );
+        if( i == false )
+        {
+            printf( "Waiting for socket to be ready%s...\n", ( imme == false ) ? " and an uplink" : "" );
+            usleep( 500000 ); /* 500 ms */
+            continue;
+        }
+        if( ready == false )
+        {
+            /* start of the test */
+            ready = true;
+            clock_gettime( CLOCK_MONOTONIC, &next );
+            start_us = monotonic_us( );
+            report_prev_us = start_us;
+            report_us = start_us + STRESS_REPORT_S * 1000000;
+            if( ( version == PROTOCOL_VERSION_BIN ) && ( params->stress_nb > 1 ) )
+            {
+                printf( "WARNING: a binary PULL_RESP holds a single downlink, -N ignored\n" );
+            }
+        }
+
+        /* Number of downlinks in this PULL_RESP */
+        nb = ( version == PROTOCOL_VERSION_BIN ) ? 1 : params->stress_nb;
+        if( ( params->nb_loop > 0 ) && ( nb > (int)( params->nb_loop - pkt_sent ) ) )
+        {
+            nb = params->nb_loop - pkt_sent;
+        }
+
+        databuf_down[0] = version;
+        databuf_down[1] = (uint8_t)( token >> 8 );
+        databuf_down[2] = (uint8_t)token;
+        databuf_down[3] = PKT_PULL_RESP;
+        if( version == PROTOCOL_VERSION_BIN )
+        {
+            size = 4 + prepare_downlink_bin( params, pkt_sent, &databuf_down[4] );
+            if( imme == false )
+            {
+                databuf_down[4] &= ~BIN_TXPK_FLAG_IMME;
+                databuf_down[5] = (uint8_t)( tmst >> 24 );
+                databuf_down[6] = (uint8_t)( tmst >> 16 );
+                databuf_down[7] = (uint8_t)( tmst >> 8 );
+                databuf_down[8] = (uint8_t)tmst;
+            }
+        }
+        else
+        {
+            size = 4 + sprintf( (char *)&databuf_down[4], ( nb > 1 ) ? "{\"txpk\":[" : "{\"txpk\":" );
+            for( i = 0; i < nb; i++ )
+            {
+                if( i > 0 )
+                {
+                    databuf_down[size++] = ',';
+                }
+                size += stress_txpk_json( params, pkt_sent + i, imme, tmst + i * step_us, (char *)&databuf_down[size] );
+            }
+            if( nb > 1 )
+            {
+                databuf_down[size++] = ']';
+            }
+            databuf_down[size++] = '}';
+        }
+
+        stress_send_nb[token] = (uint8_t)nb;
+        stress_send_us[token] = (uint32_t)monotonic_us( );
+        byte_nb = sendto( params->sock, (void *)databuf_down, size, 0, (struct sockaddr *)&dist_addr_down, addr_len_down );
+        if( byte_nb == -1 )
+        {
+            printf( "ERROR: failed to send downlink to socket - %s\n", strerror( errno ) );
+        }
+        else
+        {
+            __atomic_fetch_add( &stress_stat.dgram_sent, 1, __ATOMIC_RELAXED );
+            __atomic_fetch_add( &stress_stat.pkt_sent, nb, __ATOMIC_RELAXED );
+        }
+        pkt_sent += nb;
+        token += 1;
+
+        if( monotonic_us( ) >= report_us )
+        {
+            stress_report( monotonic_us( ) - report_prev_us, report_pkt );
+            report_prev_us = monotonic_us( );
+            report_pkt = __atomic_load_n( &stress_stat.pkt_sent, __ATOMIC_RELAXED );
+            report_us += STRESS_REPORT_S * 1000000;
+        }
+
+        /* Absolute deadlines, the rate does not depend on the time spent sending */
+        next.tv_nsec += period_ns % 1000000000;
+        next.tv_sec += period_ns / 1000000000 + next.tv_nsec / 1000000000;
+        next.tv_nsec %= 1000000000;
+        clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL );
+    }
+
+    if( ready == true )
+    {
+        report_us = monotonic_us( );
+        /* Let the last TX_ACK come */
+        if( !exit_sig && !quit_sig )
+        {
+            usleep( 1000000 ); /* 1 s */
+        }
+        printf( "\nINFO: stress test over %.1f s\n", ( report_us - start_us ) / 1E6 );
+        stress_report( report_us - start_us, 0 );
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 static void * thread_down( const void * arg )
 {
     int x;
@@ -1035,9 +1696,17 @@ static void * thread_down( const void * arg )
 
     /* Downstream data variables */
     uint8_t databuf_down[4096];
+    uint8_t version;
     uint32_t nb_loop;
     uint32_t pkt_sent = 0;
 
+    if( stress == true )
+    {
+        stress_down( params );
+        printf( "\nINFO: End of downstream thread for RF 0\n" );
+        return NULL;
+    }
+
     /* Global loop is the max loop defined */
     nb_loop = params->nb_loop;
     while( !exit_sig && !quit_sig && (pkt_sent < nb_loop) && (nb_loop > 0) )
@@ -1051,6 +1720,7 @@ static void * thread_down( const void * arg )
             usleep( 500000 ); /* 500 ms */
             continue;
         }
+        version = protocol_version_down;
         pthread_mutex_unlock( &mx_sockaddr );
 
         /* Display info about the sender */
@@ -1062,41 +1732,65 @@ static void * thread_down( const void * arg )
             continue;
         }
 
-        /* Prepare JSON object to be sent */
-        root_val = json_value_init_object( );
-        if( root_val == NULL )
+        /* Binary record, if the gateway uses the binary protocol */
+        if( version == PROTOCOL_VERSION_BIN )
         {
-            printf( "ERROR: failed to initialize JSON root object\n" );
-        }
-        else
-        {
-            /* Prepare the txpk JSON object */
-            prepare_downlink_json( params, pkt_sent, root_val );
-
-            /* Convert JSON object to string */
-            serialized_string = json_serialize_to_string( root_val );
-            printf( "%s\n", serialized_string );
-
-            /* Send JSON string to socket */
-            memset( databuf_down, 0, 4096 );
-            databuf_down[0] = PROTOCOL_VERSION;
+            databuf_down[0] = PROTOCOL_VERSION_BIN;
             databuf_down[1] = 0;
             databuf_down[2] = 0;
             databuf_down[3] = PKT_PULL_RESP;
-            memcpy( &databuf_down[4], (uint8_t*)serialized_string, strlen(serialized_string) );
-            byte_nb = sendto( params->sock, (void *)databuf_down, strlen(serialized_string) + 4, 0, (struct sockaddr *)&dist_addr_down, addr_len_down );
-            if( byte_nb == -1 )
+            x = prepare_downlink_bin( params, pkt_sent, &databuf_down[4] );
+            if( x >= 0 )
             {
-                printf( "ERROR: failed to send downlink to socket - %s\n", strerror( errno ) );
+                byte_nb = sendto( params->sock, (void *)databuf_down, x + 4, 0, (struct sockaddr *)&dist_addr_down, addr_len_down );
+                if( byte_nb == -1 )
+                {
+                    printf( "ERROR: failed to send downlink to socket - %s\n", strerror( errno ) );
+                }
+                else
+                {
+                    printf( "<-  pkt out, binary PULL_RESP for host %s (port %s), %i bytes sent for downlink (%d)\n", host_name, port_name, byte_nb, pkt_sent );
+                }
             }
-            else
+        }
+        else
+        {
+            /* Prepare JSON object to be sent */
+            root_val = json_value_init_object( );
+            if( root_val == NULL )
             {
-                printf( "<-  pkt out, PULL_RESP for host %s (port %s), %i bytes sent for downlink (%d)\n", host_name, port_name, byte_nb, pkt_sent );
+                printf( "ERROR: failed to initialize JSON root object\n" );
             }
+            else
+            {
+                /* Prepare the txpk JSON object */
+                prepare_downlink_json( params, pkt_sent, root_val );
+
+                /* Convert JSON object to string */
+                serialized_string = json_serialize_to_string( root_val );
+                printf( "%s\n", serialized_string );
+
+                /* Send JSON string to socket */
+                memset( databuf_down, 0, 4096 );
+                databuf_down[0] = PROTOCOL_VERSION;
+                databuf_down[1] = 0;
+                databuf_down[2] = 0;
+                databuf_down[3] = PKT_PULL_RESP;
+                memcpy( &databuf_down[4], (uint8_t*)serialized_string, strlen(serialized_string) );
+                byte_nb = sendto( params->sock, (void *)databuf_down, strlen(serialized_string) + 4, 0, (struct sockaddr *)&dist_addr_down, addr_len_down );
+                if( byte_nb == -1 )
+                {
+                    printf( "ERROR: failed to send downlink to socket - %s\n", strerror( errno ) );
+                }
+                else
+                {
+                    printf( "<-  pkt out, PULL_RESP for host %s (port %s), %i bytes sent for downlink (%d)\n", host_name, port_name, byte_nb, pkt_sent );
+                }
 
-            /* free JSON memory */
-            json_free_serialized_string( serialized_string );
-            json_value_free( root_val );
+                /* free JSON memory */
+                json_free_serialized_string( serialized_string );
+                json_value_free( root_val );
+            }
         }
 
         /* One more downlink sent */